@@ -0,0 +1,70 @@
+//----------------------------------------------------------------------------
+//
+// File:		audio-capture.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Write multi-channel audio to a .wav file on a background thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef AUDIO_CAPTURE_HPP_
+#define AUDIO_CAPTURE_HPP_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "background-writer.hpp"
+#include "wave-file.hpp"
+
+// Samples are copied on the emulation thread and written on a writer thread.
+// When the queue is full AddSamples waits for the writer so nothing is lost.
+
+class cAudioCapture
+{
+	std::string                 m_FileName;
+	int                         m_Channels;
+	size_t                      m_FramesWritten;
+
+	cWaveFile                   m_File;
+
+	std::atomic<bool>           m_Failed;
+
+	cBackgroundWriter<std::vector<INT16>> m_Writer;
+
+	void WriteBlock( const std::vector<INT16> & );
+
+public:
+
+	cAudioCapture( const std::string &, int, int );
+	~cAudioCapture( );
+
+	bool IsActive( ) const;
+	int GetChannels( ) const				{ return m_Channels; }
+
+	void AddSamples( const INT16 *, size_t );
+
+private:
+
+	cAudioCapture( const cAudioCapture & ) = delete;		// no implementation
+	void operator =( const cAudioCapture & ) = delete;	// no implementation
+
+};
+
+#endif
@@ -0,0 +1,70 @@
+//----------------------------------------------------------------------------
+//
+// File:		audio-ring.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Lock-free single producer/single consumer sample buffer
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef AUDIO_RING_HPP_
+#define AUDIO_RING_HPP_
+
+#include <atomic>
+#include <vector>
+#include "common.hpp"
+
+// The emulation thread is the only writer and the audio callback the only
+// reader, so the head and tail indices are all the synchronization needed.
+
+class cAudioRing
+{
+	std::vector<INT16>      m_Buffer;
+	size_t                  m_Mask;
+
+	std::atomic<size_t>     m_Head;			// Total samples written (producer)
+	std::atomic<size_t>     m_Tail;			// Total samples read (consumer)
+
+public:
+
+	cAudioRing( );
+	~cAudioRing( );
+
+	// Not thread safe - call before the audio device is started
+	void Resize( size_t );
+
+	size_t Capacity( ) const				{ return m_Buffer.size( ); }
+	size_t Available( ) const;
+	size_t Space( ) const;
+
+	// Running totals - used to follow a sample from the writer to the reader
+	size_t GetWritten( ) const				{ return m_Head.load( std::memory_order_acquire ); }
+	size_t GetRead( ) const					{ return m_Tail.load( std::memory_order_acquire ); }
+
+	size_t Write( const INT16 *, size_t );
+	size_t Read( INT16 *, size_t );
+
+private:
+
+	cAudioRing( const cAudioRing & ) = delete;			// no implementation
+	void operator =( const cAudioRing & ) = delete;	// no implementation
+
+};
+
+#endif
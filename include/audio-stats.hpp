@@ -0,0 +1,99 @@
+//----------------------------------------------------------------------------
+//
+// File:		audio-stats.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Audio latency, under-run & callback timing statistics
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef AUDIO_STATS_HPP_
+#define AUDIO_STATS_HPP_
+
+#include <atomic>
+#include <string>
+#include "common.hpp"
+
+// Counters are updated on the emulation and audio threads and read from the
+// main thread, so everything is atomic and nothing here ever blocks.
+//
+// Latency is measured one register write at a time: the write is stamped with
+// the host time and the output frame it lands in, and the probe completes when
+// the audio callback hands that frame to the device.
+
+class cAudioStats
+{
+	int                     m_SampleRate;
+	int                     m_DeviceSamples;
+
+	std::atomic<UINT32>     m_Underruns;			// Device callback found too few samples
+	std::atomic<UINT32>     m_Overruns;				// Samples dropped because the output buffer was full
+	std::atomic<UINT32>     m_SpeechUnderruns;		// Speech FIFO or rendered samples ran dry while talking
+	std::atomic<UINT32>     m_SpeechOverruns;		// Data written to a full speech FIFO
+
+	std::atomic<UINT32>     m_Callbacks;
+	std::atomic<UINT64>     m_CallbackTime;			// us
+	std::atomic<UINT32>     m_CallbackMax;			// us
+
+	std::atomic<bool>       m_ProbeActive;
+	std::atomic<UINT64>     m_ProbeFrame;
+	std::atomic<INT64>      m_ProbeTime;			// us
+
+	std::atomic<UINT32>     m_Latencies;
+	std::atomic<UINT64>     m_LatencyTotal;			// us
+	std::atomic<UINT32>     m_LatencyLast;			// us
+	std::atomic<UINT32>     m_LatencyMax;			// us
+
+	static void StoreMax( std::atomic<UINT32> &, UINT32 );
+
+public:
+
+	cAudioStats( );
+	~cAudioStats( );
+
+	// Host time in microseconds
+	static INT64 Now( );
+
+	void SetDevice( int, int );
+
+	void AddUnderrun( )						{ m_Underruns++; }
+	void AddOverrun( )						{ m_Overruns++; }
+	void AddSpeechUnderrun( )				{ m_SpeechUnderruns++; }
+	void AddSpeechOverrun( )				{ m_SpeechOverruns++; }
+
+	void AddCallback( INT64 );
+
+	// Emulation thread - a write at host time (us) will be heard in the given output frame
+	bool IsProbeActive( ) const				{ return m_ProbeActive.load( std::memory_order_acquire ); }
+	void StartProbe( UINT64, INT64 );
+	void CancelProbe( );
+
+	// Audio thread - frames [first, first + count) were just handed to the device
+	void CheckProbe( UINT64, size_t );
+
+	std::string Format( ) const;
+
+private:
+
+	cAudioStats( const cAudioStats & ) = delete;			// no implementation
+	void operator =( const cAudioStats & ) = delete;	// no implementation
+
+};
+
+#endif
@@ -0,0 +1,213 @@
+//----------------------------------------------------------------------------
+//
+// File:		background-writer.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Queue of items written out by a background thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef BACKGROUND_WRITER_HPP_
+#define BACKGROUND_WRITER_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Items are queued by the emulation thread and handed, in order, to the write
+// function on a writer thread that is started when the first item is queued.
+// An item stays at the head of the queue until it has been written.  With a
+// limit, Queue waits for room so nothing is dropped, and written items are
+// kept so their storage can be picked up again with Reuse.  The owner must
+// call Stop before tearing down anything the write function uses.
+
+template<class Type> class cBackgroundWriter
+{
+	std::function<void( const Type & )> m_Write;
+	size_t                      m_Limit;
+
+	mutable std::mutex          m_Mutex;
+	std::condition_variable     m_ItemReady;
+	std::condition_variable     m_ItemDone;
+	std::deque<Type>            m_Queue;
+	std::vector<Type>           m_FreeList;
+	bool                        m_Stopping;
+
+	std::thread                 m_Writer;
+
+	void WriterThread( )
+	{
+		for( ;; )
+		{
+			std::unique_lock<std::mutex> lock( m_Mutex );
+
+			m_ItemReady.wait( lock, [ this ]{ return m_Stopping || !m_Queue.empty( ); });
+
+			if( m_Queue.empty( ))
+			{
+				break;
+			}
+
+			// Elements of a deque don't move when others are added at the back
+			Type &item = m_Queue.front( );
+
+			lock.unlock( );
+
+			m_Write( item );
+
+			lock.lock( );
+
+			if( m_Limit != 0 )
+			{
+				m_FreeList.push_back( std::move( item ));
+			}
+			m_Queue.pop_front( );
+
+			lock.unlock( );
+
+			m_ItemDone.notify_all( );
+		}
+	}
+
+public:
+
+	cBackgroundWriter( std::function<void( const Type & )> write, size_t limit = 0 ) :
+		m_Write( std::move( write )),
+		m_Limit( limit ),
+		m_Mutex( ),
+		m_ItemReady( ),
+		m_ItemDone( ),
+		m_Queue( ),
+		m_FreeList( ),
+		m_Stopping( false ),
+		m_Writer( )
+	{
+	}
+
+	~cBackgroundWriter( )
+	{
+		Stop( );
+	}
+
+	void Queue( Type item )
+	{
+		{
+			std::unique_lock<std::mutex> lock( m_Mutex );
+
+			if( m_Limit != 0 )
+			{
+				m_ItemDone.wait( lock, [ this ]{ return m_Queue.size( ) < m_Limit; });
+			}
+
+			if( ! m_Writer.joinable( ))
+			{
+				m_Writer = std::thread( &cBackgroundWriter::WriterThread, this );
+			}
+
+			m_Queue.push_back( std::move( item ));
+		}
+
+		m_ItemReady.notify_one( );
+	}
+
+	// Hands back an item that has already been written, if there is one
+	bool Reuse( Type *item )
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+
+		if( m_FreeList.empty( ))
+		{
+			return false;
+		}
+
+		*item = std::move( m_FreeList.back( ));
+		m_FreeList.pop_back( );
+
+		return true;
+	}
+
+	// Waits until everything queued so far has been written
+	void Wait( )
+	{
+		std::unique_lock<std::mutex> lock( m_Mutex );
+
+		m_ItemDone.wait( lock, [ this ]{ return m_Queue.empty( ); });
+	}
+
+	// Is an item that matches still queued or being written?
+	template<class Match> bool Find( Match match ) const
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+
+		for( auto &item : m_Queue )
+		{
+			if( match( item ))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Offer an item to those still waiting to be written (not the one that may be being written) -
+	// returns true if one of them took it in
+	template<class Join> bool Combine( Join join )
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+
+		for( size_t i = 1; i < m_Queue.size( ); i++ )
+		{
+			if( join( m_Queue[ i ] ))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Writes whatever is still queued and ends the writer thread
+	void Stop( )
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_Mutex );
+			m_Stopping = true;
+		}
+
+		m_ItemReady.notify_one( );
+
+		if( m_Writer.joinable( ))
+		{
+			m_Writer.join( );
+		}
+	}
+
+private:
+
+	cBackgroundWriter( const cBackgroundWriter & ) = delete;		// no implementation
+	void operator =( const cBackgroundWriter & ) = delete;	// no implementation
+
+};
+
+#endif
@@ -80,4 +80,30 @@ public:
 	virtual auto next( ) -> int;
 };
 
+// Non-virtual reader used by the track decoders.  The stream is unpacked up
+// front (first bit in the MSB, skipped bit pairs merged the way next( ) does)
+// so any run of up to 16 bits can be fetched with a single 24-bit read.
+
+class cBitReader
+{
+	std::vector<UINT8>                 bits;
+	size_t                             totalBits { 0 };
+
+public:
+
+	cBitReader( const std::vector<UINT8> &data, size_t size, bool skip, bool lsb );
+
+	auto size( ) const -> size_t							{ return totalBits; }
+
+	// Returns 'count' (1-16) bits starting at 'offset' with the first bit in the MSB
+	auto peek( size_t offset, int count ) const -> UINT32
+	{
+		const UINT8 *ptr = bits.data( ) + offset / 8;
+
+		UINT32 window = ( ptr[ 0 ] << 16 ) | ( ptr[ 1 ] << 8 ) | ptr[ 2 ];
+
+		return ( window >> ( 24 - offset % 8 - count )) & (( 1 << count ) - 1 );
+	}
+};
+
 #endif
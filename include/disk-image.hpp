@@ -29,7 +29,10 @@
 #ifndef DISK_IMAGE_HPP_
 #define DISK_IMAGE_HPP_
 
+#include <deque>
+#include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "disk-track.hpp"
@@ -57,16 +60,63 @@ struct sSectorInfo
 	int                         DataMark;
 };
 
+// Copies of the tracks that changed in an image - the file can be updated from
+// these on another thread while the image itself carries on being used
+
+class cDiskSnapshot
+{
+	size_t                      NumTracks;
+	size_t                      NumHeads;
+	std::map<
+	  std::pair<size_t,size_t>,
+	  cDiskTrack>               Tracks;						// Keyed by (track, head)
+
+public:
+
+	cDiskSnapshot( size_t numTracks = 0, size_t numHeads = 0 );
+
+	auto GetNumHeads( ) const -> size_t		{ return NumHeads; }
+	auto GetNumTracks( ) const -> size_t	{ return NumTracks; }
+
+	auto IsEmpty( ) const -> bool			{ return Tracks.empty( ); }
+
+	auto AddTrack( size_t, size_t, const cDiskTrack & ) -> void;
+
+	// Returns nullptr for tracks that haven't changed
+	auto GetTrack( size_t, size_t ) const -> const iDiskTrack *;
+
+	// Add the changes in a later snapshot of the same image
+	auto Merge( cDiskSnapshot && ) -> bool;
+};
+
 class cDiskImage
 {
+	// Cached location of a logical sector - valid while the track's generation is unchanged
+	struct sLogicalSector
+	{
+		UINT32                  generation;
+		iDiskSector            *sector;
+	};
+
 	size_t                      NumTracks;
 	size_t                      NumHeads;
 	cRefPtr<iDiskSerializer>    Serializer;
 	std::vector<
 	  std::vector<cDiskTrack>>  Track;
 
+	size_t                      IndexSectors;				// Sectors per track used to build the logical index
+	std::vector<sLogicalSector> LogicalIndex;
+
+	size_t                      StreamLimit;				// Most tracks kept loaded while streaming (0 = not streaming)
+	mutable std::deque<
+	  std::pair<size_t,size_t>> StreamedTracks;				// Tracks loaded while streaming, oldest first
+
+	auto StreamTrack( size_t, size_t ) const -> void;
+
 public:
 
+	cDiskImage( );
+
 	static auto FormatTrack( track::Format format, size_t tIndex, size_t hIndex, size_t noSectors, size_t interleave ) -> sDataBuffer;
 	static auto FormatTrack( track::Format format, const std::vector<sSectorInfo> &sectorInfo ) -> sDataBuffer;
 	static auto FormatTrack( const sDiskGap gapInfo[ 5 ], const std::vector<sSectorInfo> &sectorInfo ) -> sDataBuffer;
@@ -85,12 +135,22 @@ public:
 
 	auto GetTrack( size_t, size_t ) const -> const iDiskTrack *;
 
+	auto GetLogicalSector( size_t, size_t ) -> iDiskSector *;
+
 	auto HasChanged( ) const -> bool;
 	auto ClearChanged( ) -> void;
+	auto GetChangedTracks( ) const -> std::vector<std::pair<size_t,size_t>>;
+	auto GetSnapshot( ) const -> cDiskSnapshot;
+	auto MarkChanged( size_t, size_t ) -> void;
 
 	auto SetLoadOnDemand( iDiskSerializer * ) -> void;
+	auto GetLoadSerializer( ) const -> iDiskSerializer *;
 
 	auto CompleteLoad( ) const -> void;
+
+	auto LoadTracks( size_t threads ) -> void;
+
+	auto SetStreaming( size_t tracks ) -> void;
 };
 
 #endif
@@ -29,6 +29,9 @@
 #ifndef DISK_MEDIA_HPP_
 #define DISK_MEDIA_HPP_
 
+#include <set>
+#include <string>
+#include <utility>
 #include "cBaseObject.hpp"
 #include "disk-image.hpp"
 #include "idisk-serializer.hpp"
@@ -43,6 +46,8 @@
 
 #define MAX_TRACK_SIZE			15000
 
+class cDiskWriter;
+
 class cDiskMedia :
 	public virtual cBaseObject
 {
@@ -52,6 +57,12 @@ class cDiskMedia :
 
 	std::unique_ptr<cDiskImage> m_Image;
 
+	// Updates handed to a cDiskWriter that haven't been confirmed yet
+	std::string                 m_WriteName;
+	std::set<std::pair<size_t,size_t>> m_WriteTracks;
+
+	static size_t               LoadThreads;
+
 public:
 
 	cDiskMedia( cDiskImage * );
@@ -70,14 +81,26 @@ public:
 
 	const char *GetName( ) const	{ return m_FileName.c_str( ); }
 
+	// Tools that work on whole images can decode them up front on several threads
+	// (the default of 1 leaves tracks to be loaded as they are used)
+	static void SetLoadThreads( size_t threads )	{ LoadThreads = threads; }
+
+	static std::string LocateImage( const char * );
+
 	void ClearDisk( );
 
 	bool LoadFile( const char *, eDiskFormat );
 	bool SaveFile( bool = false );
+	bool SaveFile( cDiskWriter * );
+	bool QueueUpdate( cDiskWriter * );
 	bool SaveFileAs( const char *, eDiskFormat );
 
+	bool CheckWrites( cDiskWriter *, bool );
+	bool HasPendingWrites( ) const	{ return ! m_WriteName.empty( ); }
+
 	iDiskTrack *GetTrack( size_t, size_t );
 	iSector *GetSector( int, int, int );
+	iDiskSector *GetLogicalSector( int, int );
 
 protected:
 
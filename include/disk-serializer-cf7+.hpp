@@ -56,6 +56,7 @@ public:
 	virtual bool LoadFile( const char *filename, cDiskImage *image ) override;
 	virtual bool SaveFile( const cDiskImage &image, const char *filename ) override;
 	virtual bool LoadTrack( size_t cylinder, size_t head, iDiskTrack *track ) override;
+	virtual bool GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions ) override;
 
 	// cDiskSerializer methods
 	virtual FILE *OpenForWrite( const std::string &name ) override;
@@ -65,6 +66,14 @@ public:
 protected:
 
 	size_t GetMaxVolume( const char *filename );
+	size_t VolumeOffset( ) const;
+
+	bool PrepareImage( cDiskImage *image );
+
+	// cDiskSerializer methods
+	virtual bool ReplacesFile( ) const override;
+	virtual bool SupportsMapping( ) const override;
+	virtual bool ReadMapping( cDiskImage *image ) override;
 
 };
 
@@ -113,12 +113,18 @@ namespace HxC
 }
 
 #include "disk-serializer.hpp"
+#include "idisk-track.hpp"
 
 class cDiskSerializerHFE :
 	public cDiskSerializer
 {
 	std::vector<UINT8> FileBuffer;
 
+	// Track layout of the file - kept after the file buffer is released
+	std::vector<HxC::pictrack> TrackLUT;
+	size_t TrackSides;
+	track::Format TrackFormat;
+
 public:
 
 	cDiskSerializerHFE( );
@@ -131,13 +137,13 @@ public:
 	virtual eDiskFormat GetFormat( ) const override;
 	virtual bool LoadTrack( size_t cylinder, size_t head, iDiskTrack *track ) override;
 	virtual void LoadComplete( ) override;
+	virtual bool SupportsParallelLoad( ) const override;
+	virtual bool GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions ) override;
 
 	// cDiskSerializer methods
 	virtual bool ReadFile( FILE *file, cDiskImage *image ) override;
 	virtual bool WriteFile( const cDiskImage &image, FILE *file ) override;
 
-protected:
-
 };
 
 #endif
@@ -42,6 +42,14 @@ class cDiskSerializerPC99 :
 		sDataBuffer         data;
 	};
 
+	// Location of each track in the file (indexed by head * m_NumTracks + track)
+	size_t                  m_NumTracks;
+	std::vector<size_t>     m_TrackOffset;
+
+	// Tracks read from the file, moved into the image as they are used (same indexing)
+	track::Format           m_Format;
+	std::vector<sTrackInfo> m_TrackData;
+
 public:
 
 	cDiskSerializerPC99( );
@@ -52,13 +60,19 @@ public:
 	// iDiskSerializer methods
 	virtual bool SupportsFeatures( const cDiskImage &image ) override;
 	virtual eDiskFormat GetFormat( ) const override;
+	virtual bool LoadTrack( size_t cylinder, size_t head, iDiskTrack *track ) override;
+	virtual void LoadComplete( ) override;
+	virtual bool SupportsParallelLoad( ) const override;
 	virtual bool ReadFile( FILE *file, cDiskImage *image ) override;
 	virtual bool WriteFile( const cDiskImage &image, FILE *file ) override;
+	virtual bool GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions ) override;
 
 	static void fuzz( const uint8_t *data, size_t size );
 
 protected:
 
+	void RecordLayout( size_t numTracks, const std::vector<size_t> &sizes );
+
 	static void AddClockLocations( sTrackInfo &track, track::Format format, size_t offset );
 	static const UINT8 *FindAddressMark( UINT8 mask, UINT8 mark, track::Format format, const UINT8 *ptr, const UINT8 *max );
 	static sTrackInfo FindTrack( track::Format format, const UINT8 *start, const UINT8 *max );
@@ -30,10 +30,17 @@
 #define DISK_SERIALIZER_V9T9_HPP_
 
 #include "disk-serializer.hpp"
+#include "idisk-track.hpp"
 
 class cDiskSerializerV9T9 :
 	public cDiskSerializer
 {
+	// Geometry of the image file
+	size_t          m_NumTracks;
+	size_t          m_NumSides;
+	size_t          m_NumSectors;
+	track::Format   m_Format;
+
 public:
 
 	cDiskSerializerV9T9( );
@@ -46,6 +53,16 @@ public:
 	virtual eDiskFormat GetFormat( ) const override;
 	virtual bool ReadFile( FILE *file, cDiskImage *image ) override;
 	virtual bool WriteFile( const cDiskImage &image, FILE *file ) override;
+	virtual bool LoadTrack( size_t cylinder, size_t head, iDiskTrack *track ) override;
+	virtual bool GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions ) override;
+
+protected:
+
+	static void GetGeometry( const UINT8 *vib, size_t size, size_t *tracks, size_t *sides, size_t *sectors, track::Format *format );
+
+	// cDiskSerializer methods
+	virtual bool SupportsMapping( ) const override;
+	virtual bool ReadMapping( cDiskImage *image ) override;
 };
 
 #endif
@@ -29,8 +29,12 @@
 #ifndef DISK_SERIALIZER_HPP_
 #define DISK_SERIALIZER_HPP_
 
+#include <memory>
+#include <string>
+#include <vector>
 #include "cBaseObject.hpp"
 #include "idisk-serializer.hpp"
+#include "mapped-file.hpp"
 
 class cDiskSerializer :
 	public virtual cBaseObject,
@@ -39,6 +43,10 @@ class cDiskSerializer :
 protected:
 
 	FILE *m_DemandLoadFile;
+	std::unique_ptr<cMappedFile> m_MappedFile;
+	std::string m_FileName;						// Image the file layout information refers to
+	std::string m_ValidName;					// Where m_FileName was found on the host
+	bool m_Streaming;							// Tracks may be asked for more than once
 
 public:
 
@@ -53,8 +61,15 @@ public:
 	virtual std::string RawFileName( const char *filename ) const override;
 	virtual bool LoadFile( const char *filename, cDiskImage *image ) override;
 	virtual bool SaveFile( const cDiskImage &image, const char *filename ) override;
+	virtual std::string GetUpdateName( const char *filename ) const override;
+	virtual bool GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions ) override;
 	virtual bool LoadTrack( size_t cylinder, size_t head, iDiskTrack *track ) override;
 	virtual void LoadComplete( ) override;
+	virtual bool SupportsParallelLoad( ) const override;
+	virtual void SetStreaming( bool streaming ) override;
+
+	// Write the regions to the file through a journal - safe to call from any thread
+	static bool CommitRegions( const std::string &name, const std::vector<sDiskRegion> &regions );
 
 protected:
 
@@ -63,6 +78,21 @@ protected:
 
 	virtual bool ReadFile( FILE *file, cDiskImage *image ) = 0;
 	virtual bool WriteFile( const cDiskImage &image, FILE *file ) = 0;
+
+	// Formats that rewrite the whole file replace it rather than write over it
+	virtual bool ReplacesFile( ) const;
+
+	// Sector based formats can serve tracks straight from a mapping of the file
+	virtual bool SupportsMapping( ) const;
+	virtual bool ReadMapping( cDiskImage *image );
+
+	bool UpdateFile( const std::string &name, const std::vector<sDiskRegion> &regions );
+
+	static std::string JournalName( const std::string &name );
+	static bool WriteJournal( const std::string &name, const std::vector<sDiskRegion> &regions );
+	static void RemoveJournal( const std::string &name );
+	static bool ReplayJournal( const std::string &name );
+	static bool WriteRegions( const std::string &name, const std::vector<sDiskRegion> &regions );
 };
 
 #endif
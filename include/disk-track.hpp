@@ -29,6 +29,7 @@
 #ifndef DISK_TRACK_HPP_
 #define DISK_TRACK_HPP_
 
+#include <array>
 #include <vector>
 
 #include "idisk-track.hpp"
@@ -38,19 +39,32 @@ class cDiskTrack :
 	public iDiskTrack
 {
 	bool                        Dirty;
+	bool                        LayoutChanged;				// Track has been (re)written since the last save
+	UINT64                      ChangedSectors;				// Bitmap of sectors (by index) modified since the last save
 	track::Format               Format;						// Encoding used for this track
 	std::vector<size_t>         Clock;						// List of all clock patterns on the track
 	sDataBuffer                 Data;						// Byte aligned image of complete track
 	std::vector<cDiskSector>    Sector;						// List of all sectors on the track
+	std::array<UINT8,256>       SectorMap;					// Index of the first sector with each logical sector number
+	UINT32                      Generation;					// Incremented each time the list of sectors is rebuilt
 
 public:
 
 	cDiskTrack( );
+	cDiskTrack( const cDiskTrack & );
+	cDiskTrack( cDiskTrack && ) noexcept;
+
+	cDiskTrack &operator =( const cDiskTrack & );
+	cDiskTrack &operator =( cDiskTrack && ) noexcept;
 
 	virtual auto HasChanged( ) const -> bool override;
 
 	virtual auto ClearChanged( ) -> void override;
 
+	virtual auto HasLayoutChanged( ) const -> bool override;
+
+	virtual auto GetChangedSectors( ) const -> std::vector<iDiskSector*> override;
+
 	virtual auto GetFormat( ) const -> track::Format override;
 
 	virtual auto Read( ) const -> sDataBuffer override;
@@ -61,6 +75,10 @@ public:
 
 	virtual auto GetClockLocations( ) const -> std::vector<size_t> override;
 
+	virtual auto GetSize( ) const -> size_t override;
+
+	virtual auto GetOffset( const iDiskSector *sector ) const -> size_t override;
+
 	virtual auto GetSectors( ) const -> std::vector<iDiskSector*> override;
 
 	virtual auto GetSector( int logicalCylinder, int logicalHead, int logicalSector ) -> iDiskSector * override;
@@ -68,15 +86,25 @@ public:
 	virtual auto GetSector( int logicalCylinder, int logicalHead, int logicalSector ) const -> const iDiskSector * override;
 
 	auto Erase( ) -> void;
+	auto Release( ) -> void;
+	auto MarkChanged( ) -> void;
 	auto IsEmpty( ) const -> bool;
 
+	auto GetGeneration( ) const -> UINT32	{ return Generation; }
+
 	auto VerifyID( const UINT8 *id ) const -> bool;
 	auto VerifyData( const UINT8 *data, size_t size ) const -> bool;
 	auto DataModified( const UINT8 *data, size_t size ) -> void;
 
+	// Fold in the changes recorded by an earlier copy of this track
+	auto MergeChanges( const cDiskTrack &earlier ) -> void;
+
 protected:
 
 	auto LocateSectors( ) -> void;
+	auto AdoptSectors( const UINT8 *base ) -> void;
+
+	auto FindSector( int logicalCylinder, int logicalHead, int logicalSector ) const -> const cDiskSector *;
 
 };
 
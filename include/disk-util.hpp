@@ -34,7 +34,7 @@
 #include <vector>
 #include "common.hpp"
 
-class cBitStream;
+class cBitReader;
 
 struct sDataFragment
 {
@@ -44,8 +44,8 @@ struct sDataFragment
 	std::vector<unsigned char>	byteData		{ };
 };
 
-extern std::list<sDataFragment> DecodeDataFM( cBitStream &stream );
-extern std::list<sDataFragment> DecodeDataMFM( cBitStream &stream );
+extern std::list<sDataFragment> DecodeDataFM( const cBitReader &stream );
+extern std::list<sDataFragment> DecodeDataMFM( const cBitReader &stream );
 
 extern std::vector<UINT8> EncodeDataFM( const std::list<sDataFragment> &fragments, bool lsb );
 extern std::vector<UINT8> EncodeDataMFM( const std::list<sDataFragment> &fragments, bool lsb );
@@ -0,0 +1,81 @@
+//----------------------------------------------------------------------------
+//
+// File:		disk-writer.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Background thread that writes disk image updates
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DISK_WRITER_HPP_
+#define DISK_WRITER_HPP_
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "background-writer.hpp"
+#include "disk-image.hpp"
+#include "idisk-serializer.hpp"
+
+// The emulation thread queues snapshots of the changed parts of an image and
+// the writer thread commits them to the file in order.  Barrier waits until
+// everything queued so far has been written.  Files that couldn't be updated
+// are remembered until the owner asks about them with HasFailed.
+
+class cDiskWriter
+{
+	struct sRequest
+	{
+		std::string                 name;
+		cRefPtr<iDiskSerializer>    serializer;
+		cDiskSnapshot               snapshot;
+	};
+
+	std::mutex                  m_Mutex;
+	std::set<std::string>       m_Failed;
+
+	cBackgroundWriter<sRequest> m_Writer;
+
+	void Commit( const sRequest & );
+
+public:
+
+	cDiskWriter( );
+	~cDiskWriter( );
+
+	void Write( const std::string &, iDiskSerializer *, cDiskSnapshot );
+
+	// Returns false if any update has failed that hasn't been reported by HasFailed
+	bool Barrier( );
+
+	bool HasFailed( const std::string & );
+
+	// Is an update to the file still queued or being written?
+	bool IsPending( const std::string & );
+
+private:
+
+	cDiskWriter( const cDiskWriter & ) = delete;		// no implementation
+	void operator =( const cDiskWriter & ) = delete;	// no implementation
+
+};
+
+#endif
@@ -0,0 +1,104 @@
+//----------------------------------------------------------------------------
+//
+// File:		frame-capture.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Write rendered frames to PPM/PNG files or a YUV4MPEG2 stream
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef FRAME_CAPTURE_HPP_
+#define FRAME_CAPTURE_HPP_
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "background-writer.hpp"
+
+enum CAPTURE_FORMAT_E
+{
+	CAPTURE_PPM,
+	CAPTURE_PNG,
+	CAPTURE_Y4M
+};
+
+// Frames are copied on the emulation thread and encoded on a writer thread.
+// When the queue is full AddFrame waits for the writer so no frames are lost.
+
+class cFrameCapture
+{
+	struct sFrame
+	{
+		int                     width;
+		int                     height;
+		std::vector<UINT32>     pixels;
+	};
+
+	std::string                 m_FileName;
+	CAPTURE_FORMAT_E            m_Format;
+	int                         m_FrameRate;
+	size_t                      m_FrameLimit;
+	size_t                      m_FramesQueued;
+	size_t                      m_FramesWritten;
+
+	FILE                       *m_Stream;
+	bool                        m_HeaderWritten;
+	std::vector<UINT8>          m_Buffer;
+	std::vector<UINT8>          m_Encoded;
+
+	std::atomic<bool>           m_Failed;
+
+	cBackgroundWriter<sFrame>   m_Writer;
+
+	sFrame AllocateFrame( int, int );
+	void QueueFrame( sFrame && );
+
+	void WriteQueuedFrame( const sFrame & );
+
+	bool WriteFrame( const sFrame * );
+	bool WritePPM( const sFrame *, FILE * );
+	bool WritePNG( const sFrame *, FILE * );
+	bool WriteY4M( const sFrame *, FILE * );
+
+	std::string GetFrameName( size_t ) const;
+
+public:
+
+	cFrameCapture( const std::string &, int, size_t = 0 );
+	~cFrameCapture( );
+
+	static bool GetFormat( const std::string &, CAPTURE_FORMAT_E * );
+	static bool IsValidName( const std::string & );
+
+	bool IsActive( ) const;
+
+	void AddFrame( int, int, const UINT32 * );
+	void AddFrame( int, int, const UINT8 *, const UINT32 * );
+	void AddFrame( int, int, UINT32 );
+
+private:
+
+	cFrameCapture( const cFrameCapture & ) = delete;		// no implementation
+	void operator =( const cFrameCapture & ) = delete;	// no implementation
+
+};
+
+#endif
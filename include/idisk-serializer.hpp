@@ -29,7 +29,10 @@
 #ifndef IDISK_SERIALIZER_HPP_
 #define IDISK_SERIALIZER_HPP_
 
+#include <string>
+#include <vector>
 #include "iBaseObject.hpp"
+#include "isector.hpp"
 
 enum eDiskFormat
 {
@@ -45,6 +48,14 @@ enum eDiskFormat
 struct iDiskTrack;
 
 class cDiskImage;
+class cDiskSnapshot;
+
+// A block of bytes to be written to an image file at the given offset
+struct sDiskRegion
+{
+	size_t          offset;
+	sDataBuffer     data;
+};
 
 struct iDiskSerializer : virtual iBaseObject
 {
@@ -62,8 +73,20 @@ struct iDiskSerializer : virtual iBaseObject
 	virtual auto LoadFile( const char *filename, cDiskImage *image ) -> bool = 0;
 	virtual auto SaveFile( const cDiskImage &image, const char *filename ) -> bool = 0;
 
+	// The file to update in place if the image was loaded from (or saved to) filename - empty if it can't be
+	virtual auto GetUpdateName( const char *filename ) const -> std::string = 0;
+
+	// The regions of the file that hold the changed tracks - safe to call from another thread
+	virtual auto GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions ) -> bool = 0;
+
 	virtual auto LoadTrack( size_t cylinder, size_t head, iDiskTrack *track ) -> bool = 0;
 	virtual auto LoadComplete( ) -> void = 0;
+
+	// True if LoadTrack can be called for different tracks on several threads at once
+	virtual auto SupportsParallelLoad( ) const -> bool = 0;
+
+	// While streaming, a track may be released and loaded again
+	virtual auto SetStreaming( bool streaming ) -> void = 0;
 };
 
 #endif
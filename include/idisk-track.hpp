@@ -49,6 +49,10 @@ struct iDiskTrack
 
 	virtual auto ClearChanged( ) -> void = 0;
 
+	virtual auto HasLayoutChanged( ) const -> bool = 0;
+
+	virtual auto GetChangedSectors( ) const -> std::vector<iDiskSector*> = 0;
+
 	virtual auto GetFormat( ) const -> track::Format = 0;
 
 	virtual auto Read( ) const -> sDataBuffer = 0;
@@ -59,6 +63,10 @@ struct iDiskTrack
 
 	virtual auto GetClockLocations( ) const -> std::vector<size_t> = 0;
 
+	// Size of the track and the position of a sector's ID address mark in bytes from the index hole
+	virtual auto GetSize( ) const -> size_t = 0;
+	virtual auto GetOffset( const iDiskSector *sector ) const -> size_t = 0;
+
 	virtual auto GetSectors( ) const -> std::vector<iDiskSector*> = 0;
 
 	virtual auto GetSector( int logicalCylinder, int logicalHead, int logicalSector ) -> iDiskSector * = 0;
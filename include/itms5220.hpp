@@ -32,6 +32,7 @@
 #include "common.hpp"
 #include "iBaseObject.hpp"
 
+struct iTMS9900;
 struct iTMS9919;
 struct iComputer;
 
@@ -40,6 +41,13 @@ struct iTMS5220 :
 {
 	virtual void SetSoundChip( iTMS9919 * ) = 0;
 	virtual void SetComputer( iComputer * ) = 0;
+	virtual void SetCPU( iTMS9900 *cpu, UINT32 clockSpeed ) = 0;
+
+	// Advance the chip to the given CPU clock
+	virtual void Update( UINT32 clockCycles ) = 0;
+
+	// Output samples per nominal sample - the sound chip's adjustment to its output rate
+	virtual void SetRateAdjust( double ) = 0;
 
 	virtual bool AudioCallback( INT16 *, int ) = 0;
 
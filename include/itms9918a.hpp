@@ -32,6 +32,7 @@
 #include "common.hpp"
 #include "iBaseObject.hpp"
 
+struct iTMS9900;
 struct iTMS9901;
 
 struct iTMS9918A :
@@ -40,6 +41,8 @@ struct iTMS9918A :
 	virtual void SetMemory( UINT8 * ) = 0;
 
 	virtual void SetPIC( iTMS9901 *pic, int level ) = 0;
+	virtual void SetCPU( iTMS9900 *cpu, UINT32 clockSpeed ) = 0;
+	virtual void SetFrameClock( UINT32 clock ) = 0;
 
 	virtual void Reset( ) = 0;
 
@@ -47,6 +50,7 @@ struct iTMS9918A :
 	virtual UINT16 GetAddress( ) = 0;
 
 	virtual void WriteData( UINT8 data ) = 0;
+	virtual void WriteMemory( UINT16 address, const UINT8 *data, size_t length ) = 0;
 	virtual void WriteRegister( size_t reg, UINT8 value ) = 0;
 
 	virtual UINT8 ReadData( ) = 0;
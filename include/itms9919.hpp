@@ -33,12 +33,15 @@
 #include "iBaseObject.hpp"
 
 struct iTMS5220;
+struct iTMS9900;
 
 struct iTMS9919 :
 	virtual iBaseObject
 {
 	virtual void SetSpeechSynthesizer( iTMS5220 * ) = 0;
+	virtual void SetCPU( iTMS9900 *cpu, UINT32 clockSpeed ) = 0;
 	virtual void WriteData( UINT8 data ) = 0;
+	virtual void Update( UINT32 clockCycles ) = 0;
 	virtual int GetPlaybackFrequency( ) = 0;
 
 protected:
@@ -0,0 +1,72 @@
+//----------------------------------------------------------------------------
+//
+// File:		mapped-file.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Memory-mapped view of a disk image file
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+#include <string>
+#include "common.hpp"
+
+#if ( defined( OS_LINUX ) || defined( OS_MACOSX )) && ! defined( OS_AMIGAOS )
+	#define HAVE_MMAP
+#endif
+
+// A shared (read/write if permitted) mapping of a whole file.  Changes made
+// through GetData( ) reach the file when Flush is called or the mapping is
+// closed.  On platforms without mmap Open always fails and callers fall back
+// to stdio.
+
+class cMappedFile
+{
+	std::string             m_FileName;
+	UINT8                  *m_Data;
+	size_t                  m_Size;
+	bool                    m_IsWritable;
+
+public:
+
+	cMappedFile( );
+	~cMappedFile( );
+
+	bool Open( const std::string & );
+	void Close( );
+
+	bool IsOpen( ) const					{ return m_Data != nullptr; }
+	bool IsWritable( ) const				{ return m_IsWritable; }
+
+	const std::string &GetName( ) const		{ return m_FileName; }
+	UINT8 *GetData( ) const					{ return m_Data; }
+	size_t GetSize( ) const					{ return m_Size; }
+
+	bool Flush( size_t, size_t );
+
+private:
+
+	cMappedFile( const cMappedFile & ) = delete;		// no implementation
+	void operator =( const cMappedFile & ) = delete;	// no implementation
+
+};
+
+#endif
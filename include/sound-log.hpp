@@ -0,0 +1,107 @@
+//----------------------------------------------------------------------------
+//
+// File:		sound-log.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Compact cycle-stamped log of sound & speech chip accesses
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef SOUND_LOG_HPP_
+#define SOUND_LOG_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+// The log is a command stream in the spirit of VGM:
+//
+//   "TISL" version(1) clock-speed(4)    File header (little-endian)
+//   0x50 dd                             TMS9919 write
+//   0x54 dd                             TMS5220 write
+//   0x55                                TMS5220 read (reading can advance the ROM address)
+//   0x5F                                TMS5220 reset
+//   0x61 nn ...                         Wait n CPU cycles (7 bits per byte, low bits first)
+//   0x66                                End of data
+
+enum SOUND_LOG_EVENT_E
+{
+	LOG_TMS9919_WRITE       = 0x50,
+	LOG_TMS5220_WRITE       = 0x54,
+	LOG_TMS5220_READ        = 0x55,
+	LOG_TMS5220_RESET       = 0x5F,
+	LOG_WAIT                = 0x61,
+	LOG_END                 = 0x66
+};
+
+class cSoundLog
+{
+public:
+
+	struct sEvent
+	{
+		UINT64              clock;				// CPU cycles since the start of the log
+		SOUND_LOG_EVENT_E   type;
+		UINT8               data;
+	};
+
+private:
+
+	FILE                   *m_File;
+	bool                    m_Writing;
+	bool                    m_Started;
+	UINT32                  m_ClockSpeed;
+	UINT32                  m_LastClock;
+	UINT64                  m_Clock;
+	size_t                  m_Events;
+	std::vector<UINT8>      m_Buffer;
+
+	bool Flush( );
+
+public:
+
+	cSoundLog( );
+	~cSoundLog( );
+
+	bool Create( const std::string &, UINT32 );
+	bool Open( const std::string & );
+	bool Close( );
+
+	bool IsOpen( ) const				{ return m_File != nullptr; }
+	UINT32 GetClockSpeed( ) const		{ return m_ClockSpeed; }
+	size_t GetEvents( ) const			{ return m_Events; }
+
+	// Recording - clock is the CPU's free running cycle counter
+	void Write( UINT32, SOUND_LOG_EVENT_E, UINT8 = 0 );
+
+	// The CPU clock was replaced (i.e. a restored image) - carry on from it without a wait
+	void Resync( UINT32 );
+
+	// Playback
+	bool Read( sEvent * );
+
+private:
+
+	cSoundLog( const cSoundLog & ) = delete;			// no implementation
+	void operator =( const cSoundLog & ) = delete;	// no implementation
+
+};
+
+#endif
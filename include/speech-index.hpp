@@ -0,0 +1,82 @@
+//----------------------------------------------------------------------------
+//
+// File:		speech-index.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Sorted phrase index for TMS5220 speech ROMs
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef SPEECH_INDEX_HPP_
+#define SPEECH_INDEX_HPP_
+
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+// The speech ROM stores its phrases as a binary tree that has to be walked a
+// node at a time. The index flattens the tree once into a sorted array so a
+// phrase can be found with a binary search (case is ignored, as on the chip).
+// The cache file only holds the sorted node offsets and a checksum of the ROM
+// it was built from, so a stale cache is simply rebuilt.
+
+class cSpeechIndex
+{
+public:
+
+	struct sPhrase
+	{
+		std::string     phrase;
+		UINT16          phraseOffset;
+		UINT16          dataOffset;
+		UINT8           dataLength;
+	};
+
+private:
+
+	std::vector<sPhrase>    m_Phrases;
+
+	static UINT32 Checksum( const UINT8 *, size_t );
+
+	static bool ReadNode( const UINT8 *, size_t, size_t, sPhrase * );
+
+public:
+
+	cSpeechIndex( );
+	~cSpeechIndex( );
+
+	static std::string GetCacheName( const std::string & );
+
+	bool Build( const UINT8 *, size_t );
+	bool Load( const std::string &, const UINT8 *, size_t );
+	bool Save( const std::string &, const UINT8 *, size_t ) const;
+	bool Open( const std::string &, const UINT8 *, size_t );
+
+	const sPhrase *Find( const char *, size_t ) const;
+
+	const std::vector<sPhrase> &GetPhrases( ) const		{ return m_Phrases; }
+
+private:
+
+	cSpeechIndex( const cSpeechIndex & ) = delete;			// no implementation
+	void operator =( const cSpeechIndex & ) = delete;	// no implementation
+
+};
+
+#endif
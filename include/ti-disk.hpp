@@ -31,8 +31,13 @@
 #define TIDISK_HPP_
 
 //#include "stateobject.hpp"
+#include <functional>
+#include <map>
+#include <queue>
+#include <vector>
 #include "device.hpp"
 #include "disk-media.hpp"
+#include "disk-writer.hpp"
 
 #define REG_STATUS			0x5FF0
 #define REG_RD_TRACK		0x5FF2
@@ -64,6 +69,18 @@
 
 #define STATUS_NOT_FOUND		( STATUS_CRC_ERROR | STATUS_LOST_DATA )
 
+// Approximate cost of the DSR routines replaced by the high-level (fast) disk path
+#define DSR_CLOCKS_PER_CALL		2000		// Parameter checks, drive select, VIB/FDR lookup
+#define DSR_CLOCKS_PER_SECTOR	7680		// ~30 clocks per byte to move a sector to/from VDP
+
+// FD1771 timing with a 300 RPM drive
+#define MS_PER_REV				200
+#define INDEX_PULSE_DEGREES		10			// Arc of the disk that passes while the index hole is over the sensor
+#define HEAD_SETTLE_MS			10			// Head settling time (Type I verify, Type II/III 'E' flag)
+#define RNF_REVOLUTIONS			2			// Revolutions searched for an ID before giving up with Record Not Found
+
+class cFile;
+
 class cDiskDevice :
 	public virtual cStateObject,
 	public virtual cDevice
@@ -74,6 +91,14 @@ class cDiskDevice :
 		TRAP_DISK
 	};
 
+	enum ENTRY_TYPE_E
+	{
+		ENTRY_SECTOR_IO,			// Subprogram >10
+		ENTRY_FILE_INPUT,			// Subprogram >14
+		ENTRY_FILE_OUTPUT,			// Subprogram >15
+		ENTRY_DEVICE				// DSK1-DSK3 (PAB based file I/O)
+	};
+
 	enum CMD_STATE_E
 	{
 		CMD_NONE,
@@ -81,12 +106,41 @@ class cDiskDevice :
 		CMD_READ_TRACK,
 		CMD_READ_SECTOR,
 		CMD_WRITE_TRACK,
-		CMD_WRITE_SECTOR
+		CMD_WRITE_SECTOR,
+		CMD_SEARCH					// Looking for an ID that isn't on the track
+	};
+
+	enum EVENT_TYPE_E
+	{
+		EVENT_INDEX_START,			// Index hole reaches the sensor
+		EVENT_INDEX_END,			// Index hole has passed the sensor
+		EVENT_COMMAND_DONE			// The command in progress has run its course
+	};
+
+	struct sEvent
+	{
+		UINT64          time;
+		EVENT_TYPE_E    type;
+		UINT32          command;						// Command that scheduled the event - stale events are ignored
+
+		bool operator >( const sEvent &other ) const	{ return time > other.time; }
 	};
 
 	int                 m_StepDirection;
+
+	// Rotational timing - in CPU clocks, with the index hole at the head every m_ClocksPerRev clocks
 	UINT32              m_ClocksPerRev;
-	UINT32              m_ClockStart;
+	UINT32              m_LastClocks;			// CPU clock count the controller was last brought up to
+	UINT64              m_Clock;				// Running total of CPU clocks (doesn't wrap)
+	UINT64              m_ClockStart;			// Start of the revolution the current transfer is timed from
+	UINT64              m_CommandEnd;			// When the command in progress finishes on its own
+	size_t              m_DataOffset;			// Position on the track of the first byte transferred
+	size_t              m_TrackBytes;			// Bytes that pass under the head in one revolution
+	UINT32              m_CommandID;
+	bool                m_IndexPulse;
+	bool                m_TypeIStatus;			// Status bit 1 is the index pulse rather than DRQ
+
+	std::priority_queue<sEvent,std::vector<sEvent>,std::greater<sEvent>> m_Events;
 
 	// CRU bits
 	int                 m_HardwareBits;
@@ -98,6 +152,7 @@ class cDiskDevice :
 	bool                m_TransferEnabled;
 
 	cRefPtr<cDiskMedia> m_DiskMedia[ 3 ];
+	cDiskWriter         m_DiskWriter;			// Writes changed disks back to the host in the background
 	cDiskMedia         *m_CurDisk;
 	iDiskTrack         *m_CurTrack;
 	iDiskSector        *m_CurSector;
@@ -118,9 +173,14 @@ class cDiskDevice :
 
 	CMD_STATE_E         m_CmdInProgress;
 
+	// High-level DSR support
+	std::map<ADDRESS,ENTRY_TYPE_E> m_EntryPoints;
+	bool                m_ReturnPending;
+
 public:
 
 	static std::string  DiskImage[ 3 ];
+	static bool         HighLevelDSR;
 
 public:
 
@@ -143,9 +203,17 @@ public:
 	void LoadDisk( int, const char * );
 	void UnLoadDisk( int );
 
+	// Test hook - drive the FD1771 registers without a console or DSR. The CPU only
+	// supplies the clock, and the values are on the (inverted) data bus as the DSR sees them.
+	void AttachCPU( iTMS9900 *cpu )							{ m_pCPU = cpu; }
+	UINT8 WriteRegister( ADDRESS address, UINT8 value )		{ return WriteMemory( address, value ); }
+	UINT8 ReadRegister( ADDRESS address )					{ return ReadMemory( address, 0 ); }
+
 private:
 
-	void FlushDisk( cRefPtr<cDiskMedia> & );
+	void FlushDisk( cRefPtr<cDiskMedia> &, bool = true );
+	void QueueWrites( cDiskMedia * );
+	void WaitForWrites( );
 	void FindSector( );
 
 	void CompleteCommand( );
@@ -170,6 +238,32 @@ private:
 
 	void HandleCommand( UINT8 );
 
+	// Rotational timing
+	void UpdateClock( );
+	void HandleEvent( const sEvent & );
+	void ScheduleEvent( UINT64, EVENT_TYPE_E );
+	void ScheduleCompletion( UINT64 );
+	void HoldCPU( UINT64 );
+	UINT64 SearchStart( UINT8 ) const;
+	UINT64 NextRevolution( UINT64 ) const;
+	UINT64 ByteTime( size_t ) const;
+	bool DataRequest( ) const;
+	iDiskSector *NextSector( UINT64, int ) const;
+	void StartTransfer( size_t, size_t, size_t, UINT64 );
+	void StartTransfer( const iDiskSector *, UINT64 );
+	void RecordNotFound( UINT64 );
+
+	// High-level DSR support
+	void FindEntryPoints( );
+	iDiskSector *FindLogicalSector( int, int );
+	cRefPtr<cFile> OpenFile( int, const std::string & );
+	cRefPtr<cFile> OpenFile( int, ADDRESS );
+	bool SectorIO( );
+	bool FileInput( );
+	bool FileOutput( );
+	bool LoadProgram( );
+	UINT8 ReadEntryPoint( ADDRESS, UINT8 );
+
 	// cDevice Methods
 	virtual void ActivateInternal( ) override;
 	virtual UINT8 WriteMemory( ADDRESS, UINT8 ) override;
@@ -46,6 +46,12 @@ class cConsoleTI994A :
 	int                 m_KeyBuffer[ 50 ];
 	int                 m_GromCounter;
 
+	bool                m_WaitForScreen;
+	bool                m_ScreenMatched;
+	UINT64              m_ScreenHash;
+	int                 m_ScreenFrames;
+	int                 m_FrameLimit;
+
 public:
 
 	cConsoleTI994A( iCartridge *ctg, iTMS9918A * = nullptr );
@@ -57,6 +63,9 @@ public:
 	virtual bool Step( ) override;
 	virtual bool LoadImage( const char * ) override;
 
+	void WaitForScreenHash( UINT64, int );
+	bool ScreenMatched( ) const		{ return m_ScreenMatched; }
+
 protected:
 
 	void Refresh( bool );
@@ -65,6 +74,7 @@ protected:
 	void EditRegisters( );
 
 	// cTI994A virtual functions
+	virtual bool VideoRetrace( ) override;
 	virtual UINT8 VideoReadBreakPoint( ADDRESS address, UINT8 data ) override;
 	virtual UINT8 VideoWriteBreakPoint( ADDRESS address, UINT8 data ) override;
 	virtual UINT8 GromReadBreakPoint( ADDRESS address, UINT8 data ) override;
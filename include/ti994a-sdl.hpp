@@ -41,6 +41,7 @@ class cSdlTI994A :
 	UINT32              m_StartClock;
 
 	UINT32              m_VideoUpdateEvent;
+	UINT32              m_StatsTime;
 	std::atomic<int>    m_RefreshCount;
 
 	SDL_Thread         *m_pThread;
@@ -74,6 +75,8 @@ protected:
 	void KeyPressed( SDL_Keysym keysym );
 	void KeyReleased( SDL_Keysym keysym );
 
+	void ShowAudioStats( );
+
 	void StartThread( );
 	void StopThread( );
 
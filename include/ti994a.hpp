@@ -47,6 +47,8 @@ struct iTMS5220;
 
 struct iCartridge;
 
+class cSoundLog;
+
 class cTI994A :
 	public virtual cBaseObject,
 	public virtual iComputer
@@ -92,6 +94,8 @@ protected:
 
 	UINT8              *m_VideoMemory;			// Pointer to 16K of Video RAM
 
+	cSoundLog          *m_SoundLog;
+
 public:
 
 	cTI994A( iCartridge *, iTMS9918A * = nullptr, iTMS9919 * = nullptr, iTMS5220 * = nullptr );
@@ -126,6 +130,10 @@ public:
 	virtual bool SaveImage( const char * ) override;
 	virtual bool LoadImage( const char * ) override;
 
+	// Record all sound & speech chip accesses to a file
+	bool StartSoundLog( const std::string & );
+	void StopSoundLog( );
+
 protected:
 
 	virtual std::optional<sStateSection> SaveState( );
@@ -142,6 +150,8 @@ protected:
 	void UpdateMemory( int );
 	void UpdateBreakpoint( int, bool );
 
+	void ApplyClockSpeed( );
+
 	static void _TimerHookProc( );
 	virtual void TimerHookProc( UINT32 );
 	virtual bool VideoRetrace( );
@@ -30,6 +30,7 @@
 #ifndef TMS5220_HPP_
 #define TMS5220_HPP_
 
+#include <vector>
 #include "cBaseObject.hpp"
 #include "itms5220.hpp"
 #include "istateobject.hpp"
@@ -69,7 +70,10 @@ const int RC_ORDER                       = 10;		// # of Reflection Coefficients
 const int SAMPLE_RATE                    = 8000;	// 8 KHz
 const int INTERPOLATION_SAMPLES          = 25;		// 3.125 ms
 
+class cAudioStats;
+
 struct iTI994A;
+struct iTMS9900;
 struct iTMS9919;
 
 class cTMS5220 :
@@ -86,6 +90,7 @@ protected:
 		bool       Repeat;
 		bool       Stop;
 		double     Reflection[ RC_ORDER ];
+		int        Coefficient[ RC_ORDER ];		// Reflection * 512 (as stored in the chip)
 	};
 
 	struct sReadState
@@ -124,6 +129,12 @@ protected:
 
 	iComputer     *m_Computer;
 
+	// Emulated time - frames are consumed from the FIFO on the CPU's clock
+	iTMS9900      *m_CPU;
+	UINT32         m_ClockSpeed;
+	UINT32         m_LastClock;
+	INT64          m_StepTime;			// clocks * SAMPLE_RATE until the next interpolation step
+
 	// 8 KHz speech buffer
 	int            m_PitchIndex;
 	double         m_FilterHistory[ 2 ][ RC_ORDER + 1 ];
@@ -139,22 +150,44 @@ protected:
 	int            m_PlaybackSamplesLeft;
 	double        *m_PlaybackDataPtr;
 
+	// Samples synthesized ahead of the audio output
+	std::vector<double> m_Backlog;
+	double         m_BacklogPos;			// Read position (between samples when the rate is adjusted)
+	double         m_BacklogStep;			// Backlog samples per output sample
+	double         m_LastSample;
+
+	cAudioStats   *m_Stats;
+
+	int            m_Random;				// Unvoiced excitation noise (13-bit LFSR) - used by both models
+
+	// Bit-exact integer model of the chip
+	bool           m_FixedPoint;
+	int            m_PreviousEnergy;
+	int            m_LatticeU[ RC_ORDER + 1 ];
+	int            m_LatticeX[ RC_ORDER ];
+
 	void LoadAddress( UINT8 data );
 
 	bool WaitForBitsFIFO( int );
 
 	void StoreDataFIFO( UINT8 data );
+	void RenderAhead( int );
+	void HoldCPU( int );
+	void RenderStep( );
 
 	UINT8 ReadBitsFIFO( int );
 	UINT8 ReadBitsROM( int );
 	UINT8 ReadBits( int );
 
 	bool CreateNextBuffer( );
+	bool NoiseBit( );
+	void SynthesizeFloat( const sSpeechParams & );
+	void SynthesizeFixed( const sSpeechParams & );
 	bool ConvertBuffer( );
 	bool GetNextBuffer( );
 
 	static char *FormatParameters( const sSpeechParams &, bool );
-	static void InterpolateParameters( int, const sSpeechParams &, const sSpeechParams &, sSpeechParams * );
+	static void InterpolateParameters( int, const sSpeechParams &, const sSpeechParams &, sSpeechParams *, bool );
 
 	bool ReadFrame( sSpeechParams *, bool );
 
@@ -162,12 +195,24 @@ public:
 
 	cTMS5220( );
 
+	// Use the chip's integer lattice filter & LFSR instead of floating point
+	void SetFixedPoint( bool );
+
+	// The statistics object must outlive the synthesizer
+	void SetAudioStats( cAudioStats * );
+
+	const UINT8 *GetSpeechROM( ) const		{ return m_SpeechRom; }
+	size_t GetSpeechROMSize( ) const		{ return sizeof( m_SpeechRom ); }
+
 	// iBaseObject Methods
 	virtual const void *GetInterface( const std::string &name ) const override;
 
 	// iTMS5220 methods
 	virtual void SetSoundChip( iTMS9919 * ) override;
 	virtual void SetComputer( iComputer * ) override;
+	virtual void SetCPU( iTMS9900 *, UINT32 ) override;
+	virtual void Update( UINT32 ) override;
+	virtual void SetRateAdjust( double ) override;
 	virtual bool AudioCallback( INT16 *, int ) override;
 	virtual void Reset( ) override;
 	virtual UINT8 WriteData( UINT8 ) override;
@@ -29,8 +29,11 @@
 #ifndef TMS9918A_CONSOLE_HPP_
 #define TMS9918A_CONSOLE_HPP_
 
+#include <vector>
 #include "tms9918a.hpp"
 
+class cFrameCapture;
+
 class cConsoleTMS9918A :
 	public cTMS9918A
 {
@@ -39,20 +42,29 @@ protected:
 	UINT8               m_Bias;
 	int                 m_Width;
 
+	// Frames are rendered from VRAM for capture since there is no bitmap display
+	cFrameCapture      *m_Capture;
+	std::vector<UINT8>  m_Frame;
+
 	// cTMS9918A protected methods
 	virtual bool SetMode( int ) override;
 	virtual void FlipAddressing( ) override;
 
+	void MarkMemoryChange( unsigned, UINT8 );
+
 public:
 
 	cConsoleTMS9918A( int );
 
 	void SetBias( UINT8 );
+	void SetCapture( cFrameCapture * );
 
 	// cTMS9918A public methods
 	virtual void Reset( ) override;
 	virtual void WriteData( UINT8 ) override;
+	virtual void WriteMemory( UINT16, const UINT8 *, size_t ) override;
 	virtual void WriteRegister( size_t, UINT8 ) override;
+	virtual bool Retrace( ) override;
 	virtual void Render( ) override;
 
 protected:
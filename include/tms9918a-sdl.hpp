@@ -32,22 +32,18 @@
 #include "tms9918a.hpp"
 
 class cBitMap;
+class cFrameCapture;
 
 #define FILL_SIZE		256
 
+#define ROW_HEIGHT		8
+#define ALL_ROWS		(( 1u << ( VDP_HEIGHT / ROW_HEIGHT )) - 1 )
+
 #define COLOR_R(color)	( static_cast<UINT8>( color >>  0 ))
 #define COLOR_G(color)	( static_cast<UINT8>( color >>  8 ))
 #define COLOR_B(color)	( static_cast<UINT8>( color >> 16 ))
 #define COLOR_A(color)	( static_cast<UINT8>( color >> 24 ))
 
-struct sRGBQUAD
-{
-	UINT8         r;
-	UINT8         g;
-	UINT8         b;
-	UINT8         a;
-};
-
 class cSdlTMS9918A :
 	public cTMS9918A
 {
@@ -61,6 +57,11 @@ class cSdlTMS9918A :
 
 	bool          m_ScreenChanged[ 0x03C0 ];
 
+	UINT32        m_RowsChanged;		// Character rows redrawn since the last UpdateScreen
+	UINT32        m_SpriteRows;			// Character rows covered by sprites in the last frame
+	UINT32        m_TextureRows;		// Character rows waiting to be uploaded to the texture
+	bool          m_PresentNeeded;
+
 	bool          m_PatternChanged[ 256 * 3 ];
 	int           m_CharUse        [ 256 * 3 ];
 	int           m_SpriteCharUse  [ 256 ];
@@ -76,6 +77,11 @@ class cSdlTMS9918A :
 	cBitMap      *m_BitmapScreen;
 	cBitMap      *m_BitmapSpriteScreen;
 	UINT8         m_CharacterPattern[ 3 * 256 ][ 8 * 8 ];
+	UINT8         m_RasterScreen[ VDP_HEIGHT ][ VDP_WIDTH ];
+	bool          m_RasterFrame;
+
+	cFrameCapture *m_Capture;
+	cBitMap      *m_CaptureSource;		// Unscaled copy of the current frame (nullptr while blanked)
 
 	SDL_mutex    *m_Mutex;
 
@@ -87,7 +93,7 @@ class cSdlTMS9918A :
 
 public:
 
-	cSdlTMS9918A( sRGBQUAD[ 17 ], int = 60, bool = false, bool = false, int = 1 );
+	cSdlTMS9918A( const sRGBQUAD[ 17 ], int = 60, bool = false, bool = false, int = 1 );
 
 	// iStateObject methods
 	virtual bool ParseState( const sStateSection &state ) override;
@@ -95,14 +101,20 @@ public:
 	// iTMS9918A methods
 	virtual void Reset( ) override;
 	virtual void WriteData( UINT8 ) override;
+	virtual void WriteMemory( UINT16, const UINT8 *, size_t ) override;
 	virtual void WriteRegister( size_t, UINT8 ) override;
 	virtual bool Retrace( ) override;
 	virtual void Render( ) override;
 
-	void SetColorTable( sRGBQUAD[ 17 ] );
+	void SetColorTable( const sRGBQUAD[ 17 ] );
 	void SetFrameRate( int, int );
+	void SetCapture( cFrameCapture * );
 
 	void ResizeWindow( int x, int y );
+	void Redraw( );
+
+	// Shown after the name in the window title (nullptr for just the name)
+	void SetCaption( const char * );
 
 	cBitMap *GetScreen( );
 
@@ -111,7 +123,7 @@ protected:
 	void CreateMainWindow( int, int, int );
 	void CreateMainWindowFullScreen( int );
 
-	void DrawSprite( int );
+	UINT32 DrawSprite( int );
 	cBitMap *UpdateSprites( );
 
 	void UpdateCharacterPatternGraphics( int, UINT8, UINT8, UINT8 * );
@@ -127,14 +139,20 @@ protected:
 	int GetScreenHeight( )	{ return 24; }
 
 	void MarkScreenChanges( int );
+	void MarkMemoryChange( unsigned, UINT8 );
 
 	bool RefreshInvalid( );
 	bool RefreshGraphics( );
 	bool RefreshBitMap( );
 	bool RefreshMultiColor( );
+	bool RefreshRaster( );
+
+	bool RefreshScreen( );
+	void CaptureFrame( );
 
 	void BlankScreen( );
 	void UpdateScreen( );
+	void UpdateTexture( UINT32 );
 
 	// cTMS9918A protected methods
 	virtual bool SetMode( int ) override;
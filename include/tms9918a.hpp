@@ -30,6 +30,7 @@
 #ifndef TMS9918A_HPP_
 #define TMS9918A_HPP_
 
+#include <vector>
 #include "cBaseObject.hpp"
 #include "stateobject.hpp"
 #include "itms9918a.hpp"
@@ -52,12 +53,28 @@
 #define TI_GRAY					0x0E
 #define TI_WHITE				0x0F
 
+struct sRGBQUAD
+{
+	UINT8         r;
+	UINT8         g;
+	UINT8         b;
+	UINT8         a;
+};
+
+#define COLOR_TABLES	3
+
+// The selectable TI palettes - entry 0x10 is the text mode foreground
+extern const sRGBQUAD ColorTable[ COLOR_TABLES ][ 17 ];
+
 #define VDP_TIMER				0L
 #define VPD_INTERRUPT_INTERVAL	17				// 60 Hz(16.666 msec)
 
 #define VDP_WIDTH				256
 #define VDP_HEIGHT				192
 
+#define VDP_LINES_60HZ			262
+#define VDP_LINES_50HZ			313
+
 #define MEM_IMAGE_TABLE			0x01
 #define MEM_PATTERN_TABLE		0x02
 #define MEM_COLOR_TABLE			0x04
@@ -138,6 +155,13 @@ struct sSpriteDescriptor
 	UINT8                    data[ 256 ][ 8 ];
 };
 
+struct sRegisterEvent
+{
+	int                      line;			// First scanline that sees the new value
+	UINT8                    reg;
+	UINT8                    value;
+};
+
 class cTMS9918A :
 	public virtual cBaseObject,
 	public virtual cStateObject,
@@ -163,6 +187,11 @@ protected:
 	int                 m_InterruptLevel;
 	iTMS9901           *m_PIC;
 
+	iTMS9900           *m_CPU;
+	UINT32              m_LineClocks;				// CPU clocks per scanline (16.16 fixed point)
+	UINT32              m_FrameClock;				// CPU clock at the last retrace
+	int                 m_LinesPerFrame;
+
 	ADDRESS             m_Address;
 	UINT16              m_Transfer;
 	UINT16              m_Shift;
@@ -173,9 +202,20 @@ protected:
 
 	UINT8               m_ReadAhead;
 
+	UINT8               m_LineRegister[ 8 ];		// Register values at the top of the current frame
+	UINT8               m_FrameRegister[ 8 ];		// Register values at the top of the last frame
+	std::vector<sRegisterEvent> m_RegisterEvents;	// Mid-frame register writes in the current frame
+	std::vector<sRegisterEvent> m_FrameEvents;		// Mid-frame register writes in the last frame
+
 	UINT8               m_MemoryType[ 0x4000 ];
 
 	UINT8               m_MaxSprite[ 256 ];
+	UINT32              m_SpriteChanged;			// Sprites whose row masks need to be rebuilt
+	UINT32              m_LineSprites[ 256 ];		// Sprites that cover each scanline
+	UINT8               m_SpriteLine[ 32 ];			// First scanline covered by each sprite
+	int                 m_SpriteRange[ 32 ];		// Number of scanlines covered (0 if offscreen)
+	int                 m_SpriteLeft[ 32 ];
+	UINT32              m_SpriteMask[ 32 ][ 32 ];	// 1-bit row masks (MSB is the leftmost pixel)
 	bool                m_SpritesDirty;
 	bool                m_SpritesRefreshed;
 	bool                m_CoincidenceFlag;
@@ -199,10 +239,13 @@ public:
 	// iTMS9918A Methods
 	virtual void SetMemory( UINT8 * ) override;
 	virtual void SetPIC( iTMS9901 *pic, int level ) override;
+	virtual void SetCPU( iTMS9900 *cpu, UINT32 clockSpeed ) override;
+	virtual void SetFrameClock( UINT32 clock ) override;
 	virtual void Reset( ) override;
 	virtual void SetAddress( UINT8 address ) override;
 	virtual UINT16 GetAddress( ) override;
 	virtual void WriteData( UINT8 data ) override;
+	virtual void WriteMemory( UINT16 address, const UINT8 *data, size_t length ) override;
 	virtual void WriteRegister( size_t reg, UINT8 value ) override;
 	virtual UINT8 ReadData( ) override;
 	virtual UINT8 ReadRegister( size_t reg ) override;
@@ -224,6 +267,13 @@ public:
 	ADDRESS GetSpriteAttrTable( ) const			{ return static_cast<ADDRESS>( m_SpriteAttrTableIndex ); }
 	ADDRESS GetSpriteDescTable( ) const			{ return static_cast<ADDRESS>( m_SpriteDescTableIndex ); }
 
+	int GetScanline( ) const;
+	bool HasRasterEffects( ) const				{ return !m_FrameEvents.empty( ); }
+
+	void RenderFrame( UINT8 *pixels ) const;
+
+	UINT64 GetScreenHash( ) const;
+
 protected:
 
 	virtual bool SetMode( int );
@@ -231,9 +281,13 @@ protected:
 
 	void FillTable( size_t, size_t, UINT8 );
 
-	void GetSpritePattern( int index, int loX, int hiX, int loY, int hiY, int data[ 32 ] );
-	bool SpritesCoincident( int, int );
-	bool CheckCoincidence( const bool[ 32 ] );
+	void RenderScanline( const UINT8 reg[ 8 ], int line, UINT8 *pixels ) const;
+	void RenderSprites( const UINT8 reg[ 8 ], int line, UINT8 *pixels ) const;
+
+	void SpritePatternChanged( size_t );
+	void UpdateSpriteMasks( int );
+	bool SpritesCoincident( int, int ) const;
+	bool CheckCoincidence( UINT32 ) const;
 
 	void CheckSprites( );
 
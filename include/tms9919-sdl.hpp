@@ -34,38 +34,24 @@
 class cSdlTMS9919 :
 	public cTMS9919
 {
-	struct sVoiceInfo
-	{
-		float  period;
-		float  toggle;
-		int    setting;
-	};
-
-	int                 m_VolumeTable[ 16 ];
-
 	bool                m_Initialized;
 	int                 m_MasterVolume;
 
 	SDL_AudioSpec       m_AudioSpec;
-	sVoiceInfo          m_Info[ 4 ];
-	int                 m_ShiftRegister;
-	int                 m_NoiseGenerator;
 	INT16              *m_MixBuffer;
 
 	static void _AudioCallback( void *, Uint8 *, int );
 	void AudioCallback( Uint8 *, int );
 
-	virtual void SetNoise( uint8_t, uint8_t ) override;
-	virtual void SetFrequency( uint8_t, uint16_t ) override;
-	virtual void SetAttenuation( uint8_t, uint8_t ) override;
-
 public:
 
-	cSdlTMS9919( int = 44100 );
+	cSdlTMS9919( int = 44100, bool = false );
 
 	// iTMS9919 Methods
 	virtual int GetPlaybackFrequency( ) override;
 
+	virtual void SetAudioStats( cAudioStats * ) override;
+
 	int	 GetMasterVolume( ) const		{ return m_MasterVolume; }
 	void SetMasterVolume( int );
 
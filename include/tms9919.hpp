@@ -30,12 +30,21 @@
 #ifndef TMS9919_HPP_
 #define TMS9919_HPP_
 
+#include <vector>
 #include "common.hpp"
 #include "cBaseObject.hpp"
 #include "itms9919.hpp"
 #include "istateobject.hpp"
+#include "audio-ring.hpp"
 
 struct iTMS5220;
+struct iTMS9900;
+
+class cAudioCapture;
+class cAudioStats;
+
+// Stems are interleaved in this order: tone 0, tone 1, tone 2, noise, speech
+constexpr int SOUND_STEMS = 5;
 
 class cTMS9919 :
 	public virtual cBaseObject,
@@ -50,7 +59,22 @@ protected:
 		NOISE_WHITE
 	};
 
+	struct sWriteEvent
+	{
+		UINT32   clock;
+		UINT8    data;
+	};
+
+	struct sVoiceInfo
+	{
+		double   period;					// Samples between output transitions (0 = silent)
+		double   next;						// Time of the next transition
+		int      sign;
+		int      level;						// Current output (sign * volume)
+	};
+
 	cRefPtr<iTMS5220>   m_pSpeechSynthesizer;
+	iTMS9900           *m_CPU;
 
 	uint8_t             m_LastData;
 
@@ -59,20 +83,93 @@ protected:
 	uint8_t             m_NoiseColor;
 	uint8_t             m_NoiseType;
 
+	// Sample generation (only active once SetSampleRate has been called)
+	UINT32              m_ClockSpeed;
+	int                 m_SampleRate;
+	double              m_SamplesPerClock;
+	UINT32              m_LastClock;
+	double              m_Time;					// Current time (in samples) relative to m_Deltas[ 0 ]
+	double              m_Accumulator[ 4 ];
+
+	// Adaptive rate control
+	double              m_RateAdjust;
+	double              m_RateDrift;
+	size_t              m_TargetFill;
+	double              m_FillAverage;
+
+	int                 m_VolumeTable[ 16 ];
+	sVoiceInfo          m_Info[ 4 ];
+	int                 m_ShiftRegister;
+	int                 m_NoiseGenerator;
+
+	// The voices share the first buffer unless they're needed separately (stems or panning)
+	int                 m_DeltaBuffers;
+	int                 m_OutputChannels;
+	float               m_Pan[ SOUND_STEMS ];		// -1.0 (left) to 1.0 (right)
+	cAudioCapture      *m_StemCapture;
+
+	// Optional statistics (not owned) and the pending latency probe
+	cAudioStats        *m_Stats;
+	size_t              m_ProbeEvent;
+	INT64               m_ProbeTime;
+
+	std::vector<sWriteEvent> m_Events;
+	std::vector<float>  m_Deltas[ 4 ];
+	std::vector<INT16>  m_Samples;
+	std::vector<INT16>  m_Stems;
+	std::vector<INT16>  m_Speech;
+
+	cAudioRing          m_Output;
+
 	virtual void SetNoise( uint8_t, uint8_t );
 	virtual void SetFrequency( uint8_t, uint16_t );
 	virtual void SetAttenuation( uint8_t, uint8_t );
 
+	void ProcessData( UINT8 );
+
+	void UpdateVoice( int );
+	void RunVoices( double );
+	void AddStep( int, double, int );
+	void ReserveDeltas( double );
+	void UpdateDeltaBuffers( );
+	void FlushSamples( );
+	void MixVoices( size_t );
+	void WriteOutput( const INT16 *, size_t );
+	void AdjustRate( );
+
 public:
 
 	cTMS9919( );
 
+	void SetSampleRate( int );
+	void SetTargetLatency( size_t );
+
+	// Stereo output pans each stem between left (-1.0) and right (1.0)
+	void SetOutputChannels( int );
+	void SetPanning( int, double );
+	int GetOutputChannels( ) const				{ return m_OutputChannels; }
+
+	// Takes ownership of the capture object
+	void SetStemCapture( cAudioCapture * );
+
+	// The statistics object must outlive the sound chip
+	virtual void SetAudioStats( cAudioStats * );
+	cAudioStats *GetAudioStats( ) const		{ return m_Stats; }
+
+	// Used when there's no CPU to keep time
+	void GenerateSamples( size_t );
+
+	size_t ReadSamples( INT16 *, size_t );
+	size_t GetBufferedSamples( ) const;
+
 	// iBaseObject Methods
 	virtual const void *GetInterface( const std::string &name ) const override;
 
 	// iTMS9919 Methods
 	virtual void SetSpeechSynthesizer( iTMS5220 * ) override;
+	virtual void SetCPU( iTMS9900 *, UINT32 ) override;
 	virtual void WriteData( UINT8 data ) override;
+	virtual void Update( UINT32 ) override;
 	virtual int GetPlaybackFrequency( ) override;
 
 	// iStateObject Methods
@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------
+//
+// File:		wave-file.hpp
+// Date:		18-Oct-2026
+//
+// Description:	Simple 16-bit PCM .wav file writer
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef WAVE_FILE_HPP_
+#define WAVE_FILE_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+// Samples are interleaved when there is more than one channel. The header is
+// written with placeholder lengths and patched when the file is closed.
+
+class cWaveFile
+{
+	FILE                   *m_File;
+	int                     m_SampleRate;
+	int                     m_Channels;
+	size_t                  m_Frames;
+	std::vector<UINT8>      m_Buffer;
+
+	bool WriteHeader( );
+
+public:
+
+	cWaveFile( );
+	~cWaveFile( );
+
+	bool Open( const std::string &, int, int = 1 );
+	bool Write( const INT16 *, size_t );
+	bool Close( );
+
+	bool IsOpen( ) const				{ return m_File != nullptr; }
+	size_t GetFrames( ) const			{ return m_Frames; }
+
+	static bool Save( const std::string &, int, int, const INT16 *, size_t );
+
+private:
+
+	cWaveFile( const cWaveFile & ) = delete;		// no implementation
+	void operator =( const cWaveFile & ) = delete;	// no implementation
+
+};
+
+#endif
@@ -26,6 +26,9 @@
 //
 //----------------------------------------------------------------------------
 
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -35,6 +38,7 @@
 #include "cartridge.hpp"
 #include "ti994a-console.hpp"
 #include "tms9918a-console.hpp"
+#include "frame-capture.hpp"
 #include "device-support.hpp"
 #include "ti-disk.hpp"
 #include "cf7+.hpp"
@@ -45,6 +49,41 @@
 DBG_REGISTER( __FILE__ );
 
 static std::string consoleFile { };
+static std::string captureFile { };
+static bool        waitForScreen = false;
+static UINT64      screenHash    = 0;
+static int         screenFrames  = 0;
+
+bool ParseCapture( const char *arg, void * )
+{
+	FUNCTION_ENTRY( nullptr, "ParseCapture", true );
+
+	arg = strchr( arg, '=' ) + 1;
+
+	// The console screen (and the screen hash) are written to stdout, so they'd end up in the video
+	if( strcmp( arg, "-" ) == 0 )
+	{
+		fprintf( stderr, "ti99sim-console can't capture to stdout - give a .y4m file instead\n" );
+		return false;
+	}
+
+	CAPTURE_FORMAT_E format;
+	if( cFrameCapture::GetFormat( arg, &format ) == false )
+	{
+		fprintf( stderr, "Capture file '%s' must end in .ppm, .png, or .y4m\n", arg );
+		return false;
+	}
+
+	if( cFrameCapture::IsValidName( arg ) == false )
+	{
+		fprintf( stderr, "Capture file '%s' may only contain a single %%d or %%0Nd frame number\n", arg );
+		return false;
+	}
+
+	captureFile = arg;
+
+	return true;
+}
 
 bool ParseCF7( const char *arg, void * )
 {
@@ -87,6 +126,54 @@ bool ParseDisk( const char *arg, void * )
 	return true;
 }
 
+bool ParseScreenHash( const char *arg, void * )
+{
+	FUNCTION_ENTRY( nullptr, "ParseScreenHash", true );
+
+	arg = strchr( arg, '=' ) + 1;
+
+	char *end = nullptr;
+
+	errno = 0;
+	unsigned long long hash = strtoull( arg, &end, 16 );
+
+	// strtoull would take a sign or leading spaces as well
+	if( ! isxdigit( *arg ) || ( errno != 0 ) || (( *end != '\0' ) && ( *end != ',' )))
+	{
+		fprintf( stderr, "Invalid screen hash '%s'\n", arg );
+		return false;
+	}
+
+	// Without a frame limit we wait for as long as it takes
+	long frames = 0;
+
+	if( *end == ',' )
+	{
+		const char *limit = end + 1;
+
+		errno = 0;
+		frames = strtol( limit, &end, 10 );
+
+		if( ! isdigit( *limit ) || ( *end != '\0' ) || ( errno != 0 ) || ( frames > INT_MAX ))
+		{
+			fprintf( stderr, "Invalid frame limit '%s'\n", limit );
+			return false;
+		}
+
+		if( frames <= 0 )
+		{
+			fprintf( stderr, "Frame limit must be positive\n" );
+			return false;
+		}
+	}
+
+	waitForScreen = true;
+	screenHash    = hash;
+	screenFrames  = static_cast<int>( frames );
+
+	return true;
+}
+
 bool IsType( const char *filename, const char *type )
 {
 	FUNCTION_ENTRY( nullptr, "IsType", true );
@@ -111,17 +198,22 @@ int main( int argc, char *argv[] )
 	int refreshRate = 60;
 	bool useCF7     = true;
 	bool useUCSD    = false;
+	int captureFrames = 0;
 
 	sOption optList[ ] =
 	{
+		{  0,  "capture=*<filename>", OPT_NONE,                      0,     nullptr,         ParseCapture,   "Save frames to <filename> (.ppm/.png files or a .y4m stream)" },
+		{  0,  "capture-frames=*n",   OPT_VALUE_PARSE_INT,           0,     &captureFrames,  nullptr,        "Stop capturing after n frames" },
 		{  0,  "cf7=*<filename>",     OPT_NONE,                      0,     nullptr,         ParseCF7,       "Use <filename> for CF7+ disk image" },
 		{  0,  "console=*<filename>", OPT_NONE,                      0,     nullptr,         ParseConsole,   "Use <filename> for system ROM image" },
 		{  0,  "dsk*n=<filename>",    OPT_NONE,                      0,     nullptr,         ParseDisk,      "Use <filename> disk image for DSKn" },
+		{  0,  "fast-disk",           OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &cDiskDevice::HighLevelDSR, nullptr, "Service DSR sector & file loads directly (skips FD1771 emulation)" },
 		{  0,  "no-cf7",              OPT_VALUE_SET | OPT_SIZE_BOOL, false, &useCF7,         nullptr,        "Disable CF7+ disk support" },
 		{  0,  "NTSC",                OPT_VALUE_SET | OPT_SIZE_INT,  60,    &refreshRate,    nullptr,        "Emulate a NTSC display (60Hz)" },
 		{  0,  "PAL",                 OPT_VALUE_SET | OPT_SIZE_INT,  50,    &refreshRate,    nullptr,        "Emulate a PAL display (50Hz)" },
 		{  0,  "ucsd",                OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &useUCSD,        nullptr,        "Enable the UCSD p-System device if present" },
 		{ 'v', "verbose*=n",          OPT_VALUE_PARSE_INT,           1,     &verbose,        nullptr,        "Display extra information" },
+		{  0,  "wait-for-screen-hash=*h", OPT_NONE,                  0,     nullptr,         ParseScreenHash, "Run until the screen hash is h (append ,n to give up after n frames)" },
 	};
 
 	std::string ctgFile;
@@ -190,9 +282,21 @@ int main( int argc, char *argv[] )
 
 	cRefPtr<cCartridge> consoleROM = consoleFile.empty( ) ? nullptr : new cCartridge( consoleFile );
 
-	cRefPtr<cTMS9918A> vdp = new cConsoleTMS9918A( refreshRate );
+	cConsoleTMS9918A *consoleVDP = new cConsoleTMS9918A( refreshRate );
+
+	if( !captureFile.empty( ))
+	{
+		consoleVDP->SetCapture( new cFrameCapture( captureFile, refreshRate, ( captureFrames > 0 ) ? captureFrames : 0 ));
+	}
 
-	cRefPtr<iComputer> computer = new cConsoleTI994A( consoleROM, vdp );
+	cRefPtr<cTMS9918A> vdp = consoleVDP;
+
+	cRefPtr<cConsoleTI994A> computer = new cConsoleTI994A( consoleROM, vdp );
+
+	if( waitForScreen )
+	{
+		computer->WaitForScreenHash( screenHash, screenFrames );
+	}
 
 	if( auto console = computer->GetConsole( ))
 	{
@@ -240,5 +344,16 @@ int main( int argc, char *argv[] )
 
 	RestoreConsoleSettings( );
 
+	if( waitForScreen || ( verbose >= 2 ))
+	{
+		fprintf( stdout, "Screen hash: %016llX\n", static_cast<unsigned long long>( vdp->GetScreenHash( )));
+	}
+
+	// Let scripts tell whether the expected screen was reached
+	if( waitForScreen && !computer->ScreenMatched( ))
+	{
+		return 1;
+	}
+
 	return 0;
 }
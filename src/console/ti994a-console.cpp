@@ -61,7 +61,12 @@ cConsoleTI994A::cConsoleTI994A( iCartridge *ctg, iTMS9918A *vdp ) :
 	m_ColumnSelect( 0 ),
 	m_KeyHead( 0 ),
 	m_KeyTail( 0 ),
-	m_GromCounter( 0 )
+	m_GromCounter( 0 ),
+	m_WaitForScreen( false ),
+	m_ScreenMatched( false ),
+	m_ScreenHash( 0 ),
+	m_ScreenFrames( 0 ),
+	m_FrameLimit( 0 )
 {
 	memset( m_KeyBuffer, 0, sizeof( m_KeyBuffer ));
 }
@@ -197,18 +202,28 @@ void cConsoleTI994A::Run( )
 		STEP, RUN
 	};
 
-	ADDRESS bkptPC = 0x0070;
+	// Waiting for a screen hash runs headless, so there's nobody to answer the debugger
+	ADDRESS bkptPC = m_WaitForScreen ? 0xFFFF : 0x0070;
 	int bkptCount  = -1;
-	int mode       = STEP;
+	int mode       = m_WaitForScreen ? RUN : STEP;
 	int update     = 0;
 	bool done      = false;
 
 	cConsoleTMS9918A *vdp = dynamic_cast<cConsoleTMS9918A*>( m_VDP.get( ));
 
-	m_CPU->SetBreakpoint( 0x0070, MEMFLG_FETCH );
+	if( m_WaitForScreen == false )
+	{
+		m_CPU->SetBreakpoint( 0x0070, MEMFLG_FETCH );
+	}
 
 	do
 	{
+		// Stop as soon as the expected screen shows up (or we give up waiting)
+		if( m_WaitForScreen && ( m_ScreenMatched || (( m_FrameLimit != 0 ) && ( m_ScreenFrames >= m_FrameLimit ))))
+		{
+			break;
+		}
+
 		UINT16 PC = m_CPU->GetPC( );
 
 		bool refresh = false;
@@ -287,6 +302,10 @@ void cConsoleTI994A::Run( )
 			int ch = GetKey( );
 			if( ch == KEY_ESCAPE )
 			{
+				if( m_WaitForScreen )
+				{
+					break;
+				}
 				mode = STEP;
 			}
 			else
@@ -300,6 +319,32 @@ void cConsoleTI994A::Run( )
 	m_CPU->DeRegisterDebugHandler( );
 }
 
+void cConsoleTI994A::WaitForScreenHash( UINT64 hash, int frames )
+{
+	m_WaitForScreen = true;
+	m_ScreenMatched = false;
+	m_ScreenHash    = hash;
+	m_ScreenFrames  = 0;
+	m_FrameLimit    = frames;
+}
+
+bool cConsoleTI994A::VideoRetrace( )
+{
+	bool retVal = cTI994A::VideoRetrace( );
+
+	if( m_WaitForScreen )
+	{
+		m_ScreenFrames++;
+
+		if( dynamic_cast<cTMS9918A *>( m_VDP.get( ))->GetScreenHash( ) == m_ScreenHash )
+		{
+			m_ScreenMatched = true;
+		}
+	}
+
+	return retVal;
+}
+
 bool cConsoleTI994A::Step( )
 {
 	m_CPU->Step( );
@@ -28,7 +28,9 @@
 
 #include <cctype>
 #include <cstdio>
+#include <cstring>
 #include "common.hpp"
+#include "frame-capture.hpp"
 #include "tms9918a-console.hpp"
 #include "screenio.hpp"
 
@@ -36,12 +38,16 @@ cConsoleTMS9918A::cConsoleTMS9918A( int refresh ) :
 	cBaseObject( "cConsoleTMS9918A" ),
 	cTMS9918A( refresh ),
 	m_Bias( 0 ),
-	m_Width( 32 )
+	m_Width( 32 ),
+	m_Capture( nullptr ),
+	m_Frame( )
 {
 }
 
 cConsoleTMS9918A::~cConsoleTMS9918A( )
 {
+	// Flush any frames still waiting to be written
+	delete m_Capture;
 }
 
 void cConsoleTMS9918A::Reset( )
@@ -97,15 +103,16 @@ void cConsoleTMS9918A::FlipAddressing( )
 	Render( );
 }
 
-void cConsoleTMS9918A::WriteData( UINT8 data )
+// Show a character about to be written to the screen image table
+void cConsoleTMS9918A::MarkMemoryChange( unsigned address, UINT8 data )
 {
-	UINT8 old = m_Memory[ m_Address & 0x3FFF ];
+	UINT8 old = m_Memory[ address ];
 	if( data != old )
 	{
-		if((( m_Address & 0x3FFFu ) >= m_ImageTableIndex ) &&
-		   (( m_Address & 0x3FFFu ) < ( m_ImageTableIndex + sizeof( sScreenImage ))))
+		if(( address >= m_ImageTableIndex ) &&
+		   ( address < ( m_ImageTableIndex + sizeof( sScreenImage ))))
 		{
-			int loc = ( m_Address & 0x3FFF ) - m_ImageTableIndex;
+			int loc = address - m_ImageTableIndex;
 			if( loc / m_Width < 24 )
 			{
 				UINT8 temp = ( UINT8 ) ( data - m_Bias );
@@ -117,10 +124,25 @@ void cConsoleTMS9918A::WriteData( UINT8 data )
 			}
 		}
 	}
+}
+
+void cConsoleTMS9918A::WriteData( UINT8 data )
+{
+	MarkMemoryChange( m_Address & 0x3FFF, data );
 
 	cTMS9918A::WriteData( data );
 }
 
+void cConsoleTMS9918A::WriteMemory( UINT16 address, const UINT8 *data, size_t length )
+{
+	for( size_t i = 0; i < length; i++ )
+	{
+		MarkMemoryChange(( address + i ) & 0x3FFF, data[ i ] );
+	}
+
+	cTMS9918A::WriteMemory( address, data, length );
+}
+
 void cConsoleTMS9918A::WriteRegister( size_t reg, UINT8 value )
 {
 	int x = 48 + ( reg % 4 ) * 9;
@@ -131,6 +153,33 @@ void cConsoleTMS9918A::WriteRegister( size_t reg, UINT8 value )
 	cTMS9918A::WriteRegister( reg, value );
 }
 
+bool cConsoleTMS9918A::Retrace( )
+{
+	bool updated = cTMS9918A::Retrace( );
+
+	if( m_Capture != nullptr )
+	{
+		// Pixels are stored as R, G, B, A bytes in memory - the same layout as sRGBQUAD
+		UINT32 palette[ 16 ];
+		memcpy( palette, ColorTable[ 0 ], sizeof( palette ));
+
+		m_Frame.resize( VDP_WIDTH * VDP_HEIGHT );
+
+		RenderFrame( m_Frame.data( ));
+
+		m_Capture->AddFrame( VDP_WIDTH, VDP_HEIGHT, m_Frame.data( ), palette );
+	}
+
+	return updated;
+}
+
+void cConsoleTMS9918A::SetCapture( cFrameCapture *capture )
+{
+	delete m_Capture;
+
+	m_Capture = capture;
+}
+
 void cConsoleTMS9918A::Render( )
 {
 	for( unsigned i = 0; i < sizeof( sScreenImage ); i++ )
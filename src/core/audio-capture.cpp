@@ -0,0 +1,117 @@
+//----------------------------------------------------------------------------
+//
+// File:        audio-capture.cpp
+// Date:        18-Oct-2026
+//
+// Description: Write multi-channel audio to a .wav file on a background thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include "common.hpp"
+#include "logger.hpp"
+#include "option.hpp"
+#include "audio-capture.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+#define MAX_QUEUED_BLOCKS	32
+
+cAudioCapture::cAudioCapture( const std::string &filename, int sampleRate, int channels ) :
+	m_FileName( filename ),
+	m_Channels( channels ),
+	m_FramesWritten( 0 ),
+	m_File( ),
+	m_Failed( false ),
+	m_Writer( [ this ]( const std::vector<INT16> &block ){ WriteBlock( block ); }, MAX_QUEUED_BLOCKS )
+{
+	FUNCTION_ENTRY( this, "cAudioCapture ctor", true );
+
+	if( m_File.Open( filename, sampleRate, channels ) == false )
+	{
+		fprintf( stderr, "Unable to create audio file \"%s\"\n", filename.c_str( ));
+		m_Failed = true;
+	}
+}
+
+cAudioCapture::~cAudioCapture( )
+{
+	FUNCTION_ENTRY( this, "cAudioCapture dtor", true );
+
+	// Let the writer drain whatever is still queued
+	m_Writer.Stop( );
+
+	if( m_File.IsOpen( ) == false )
+	{
+		return;
+	}
+
+	if(( m_File.Close( ) == false ) || ( m_Failed == true ))
+	{
+		fprintf( stderr, "Error writing audio file \"%s\"\n", m_FileName.c_str( ));
+	}
+	else if( verbose >= 1 )
+	{
+		fprintf( stdout, "Captured %zu audio frames to \"%s\"\n", m_FramesWritten, m_FileName.c_str( ));
+	}
+}
+
+bool cAudioCapture::IsActive( ) const
+{
+	FUNCTION_ENTRY( this, "cAudioCapture::IsActive", false );
+
+	return !m_Failed;
+}
+
+void cAudioCapture::AddSamples( const INT16 *samples, size_t frames )
+{
+	FUNCTION_ENTRY( this, "cAudioCapture::AddSamples", false );
+
+	if( m_Failed == true )
+	{
+		return;
+	}
+
+	std::vector<INT16> block;
+	m_Writer.Reuse( &block );
+
+	block.assign( samples, samples + frames * m_Channels );
+
+	m_Writer.Queue( std::move( block ));
+}
+
+void cAudioCapture::WriteBlock( const std::vector<INT16> &block )
+{
+	FUNCTION_ENTRY( this, "cAudioCapture::WriteBlock", false );
+
+	// Blocks queued after a failure are dropped
+	if( m_Failed == true )
+	{
+		return;
+	}
+
+	size_t frames = block.size( ) / m_Channels;
+
+	if( m_File.Write( block.data( ), frames ) == false )
+	{
+		m_Failed = true;
+		return;
+	}
+
+	m_FramesWritten += frames;
+}
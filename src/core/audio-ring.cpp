@@ -0,0 +1,119 @@
+//----------------------------------------------------------------------------
+//
+// File:        audio-ring.cpp
+// Date:        18-Oct-2026
+//
+// Description: Lock-free single producer/single consumer sample buffer
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include "common.hpp"
+#include "logger.hpp"
+#include "audio-ring.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+cAudioRing::cAudioRing( ) :
+	m_Buffer( ),
+	m_Mask( 0 ),
+	m_Head( 0 ),
+	m_Tail( 0 )
+{
+	FUNCTION_ENTRY( this, "cAudioRing ctor", true );
+}
+
+cAudioRing::~cAudioRing( )
+{
+	FUNCTION_ENTRY( this, "cAudioRing dtor", true );
+}
+
+void cAudioRing::Resize( size_t samples )
+{
+	FUNCTION_ENTRY( this, "cAudioRing::Resize", true );
+
+	// Round up to a power of 2 so indices can be masked instead of divided
+	size_t size = 1;
+	while( size < samples )
+	{
+		size <<= 1;
+	}
+
+	m_Buffer.assign( size, 0 );
+	m_Mask = size - 1;
+
+	m_Head.store( 0, std::memory_order_relaxed );
+	m_Tail.store( 0, std::memory_order_relaxed );
+}
+
+size_t cAudioRing::Available( ) const
+{
+	FUNCTION_ENTRY( this, "cAudioRing::Available", false );
+
+	return m_Head.load( std::memory_order_acquire ) - m_Tail.load( std::memory_order_acquire );
+}
+
+size_t cAudioRing::Space( ) const
+{
+	FUNCTION_ENTRY( this, "cAudioRing::Space", false );
+
+	return m_Buffer.size( ) - Available( );
+}
+
+size_t cAudioRing::Write( const INT16 *data, size_t count )
+{
+	FUNCTION_ENTRY( this, "cAudioRing::Write", false );
+
+	size_t head = m_Head.load( std::memory_order_relaxed );
+	size_t tail = m_Tail.load( std::memory_order_acquire );
+
+	count = std::min( count, m_Buffer.size( ) - ( head - tail ));
+
+	// Copy in (at most) two pieces - up to the end of the buffer and then from the start
+	size_t offset = head & m_Mask;
+	size_t first  = std::min( count, m_Buffer.size( ) - offset );
+
+	memcpy( m_Buffer.data( ) + offset, data, first * sizeof( INT16 ));
+	memcpy( m_Buffer.data( ), data + first, ( count - first ) * sizeof( INT16 ));
+
+	m_Head.store( head + count, std::memory_order_release );
+
+	return count;
+}
+
+size_t cAudioRing::Read( INT16 *data, size_t count )
+{
+	FUNCTION_ENTRY( this, "cAudioRing::Read", false );
+
+	size_t tail = m_Tail.load( std::memory_order_relaxed );
+	size_t head = m_Head.load( std::memory_order_acquire );
+
+	count = std::min( count, head - tail );
+
+	size_t offset = tail & m_Mask;
+	size_t first  = std::min( count, m_Buffer.size( ) - offset );
+
+	memcpy( data, m_Buffer.data( ) + offset, first * sizeof( INT16 ));
+	memcpy( data + first, m_Buffer.data( ), ( count - first ) * sizeof( INT16 ));
+
+	m_Tail.store( tail + count, std::memory_order_release );
+
+	return count;
+}
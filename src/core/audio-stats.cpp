@@ -0,0 +1,158 @@
+//----------------------------------------------------------------------------
+//
+// File:        audio-stats.cpp
+// Date:        18-Oct-2026
+//
+// Description: Audio latency, under-run & callback timing statistics
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include "common.hpp"
+#include "logger.hpp"
+#include "audio-stats.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+cAudioStats::cAudioStats( ) :
+	m_SampleRate( 0 ),
+	m_DeviceSamples( 0 ),
+	m_Underruns( 0 ),
+	m_Overruns( 0 ),
+	m_SpeechUnderruns( 0 ),
+	m_SpeechOverruns( 0 ),
+	m_Callbacks( 0 ),
+	m_CallbackTime( 0 ),
+	m_CallbackMax( 0 ),
+	m_ProbeActive( false ),
+	m_ProbeFrame( 0 ),
+	m_ProbeTime( 0 ),
+	m_Latencies( 0 ),
+	m_LatencyTotal( 0 ),
+	m_LatencyLast( 0 ),
+	m_LatencyMax( 0 )
+{
+	FUNCTION_ENTRY( this, "cAudioStats ctor", true );
+}
+
+cAudioStats::~cAudioStats( )
+{
+	FUNCTION_ENTRY( this, "cAudioStats dtor", true );
+}
+
+INT64 cAudioStats::Now( )
+{
+	auto now = std::chrono::steady_clock::now( ).time_since_epoch( );
+
+	return std::chrono::duration_cast<std::chrono::microseconds>( now ).count( );
+}
+
+void cAudioStats::StoreMax( std::atomic<UINT32> &max, UINT32 value )
+{
+	UINT32 current = max.load( std::memory_order_relaxed );
+	while(( value > current ) && ( max.compare_exchange_weak( current, value ) == false ))
+	{
+	}
+}
+
+void cAudioStats::SetDevice( int sampleRate, int samples )
+{
+	FUNCTION_ENTRY( this, "cAudioStats::SetDevice", true );
+
+	m_SampleRate    = sampleRate;
+	m_DeviceSamples = samples;
+}
+
+void cAudioStats::AddCallback( INT64 duration )
+{
+	FUNCTION_ENTRY( this, "cAudioStats::AddCallback", false );
+
+	m_Callbacks++;
+	m_CallbackTime += ( UINT64 ) duration;
+
+	StoreMax( m_CallbackMax, ( UINT32 ) duration );
+}
+
+void cAudioStats::StartProbe( UINT64 frame, INT64 time )
+{
+	FUNCTION_ENTRY( this, "cAudioStats::StartProbe", false );
+
+	m_ProbeFrame.store( frame, std::memory_order_relaxed );
+	m_ProbeTime.store( time, std::memory_order_relaxed );
+	m_ProbeActive.store( true, std::memory_order_release );
+}
+
+void cAudioStats::CancelProbe( )
+{
+	FUNCTION_ENTRY( this, "cAudioStats::CancelProbe", false );
+
+	m_ProbeActive.store( false, std::memory_order_release );
+}
+
+void cAudioStats::CheckProbe( UINT64 first, size_t count )
+{
+	FUNCTION_ENTRY( this, "cAudioStats::CheckProbe", false );
+
+	if(( IsProbeActive( ) == false ) || ( m_SampleRate == 0 ))
+	{
+		return;
+	}
+
+	UINT64 frame = m_ProbeFrame.load( std::memory_order_relaxed );
+	if( frame >= first + count )
+	{
+		return;
+	}
+
+	// The device is still playing the previous buffer, so this one starts after it
+	UINT64 offset   = ( frame > first ) ? frame - first : 0;
+	INT64  queued   = ( INT64 ) (( offset + m_DeviceSamples ) * 1000000 / m_SampleRate );
+	INT64  latency  = Now( ) - m_ProbeTime.load( std::memory_order_relaxed ) + queued;
+
+	m_Latencies++;
+	m_LatencyTotal += ( UINT64 ) latency;
+	m_LatencyLast   = ( UINT32 ) latency;
+
+	StoreMax( m_LatencyMax, ( UINT32 ) latency );
+
+	m_ProbeActive.store( false, std::memory_order_release );
+}
+
+std::string cAudioStats::Format( ) const
+{
+	FUNCTION_ENTRY( this, "cAudioStats::Format", false );
+
+	UINT32 latencies = m_Latencies;
+	UINT32 callbacks = m_Callbacks;
+
+	double latencyAvg  = ( latencies != 0 ) ? m_LatencyTotal / ( 1000.0 * latencies ) : 0.0;
+	double callbackAvg = ( callbacks != 0 ) ? m_CallbackTime / ( 1000.0 * callbacks ) : 0.0;
+
+	char buffer[ 256 ];
+	snprintf( buffer, sizeof( buffer ),
+		"%d Hz/%d samples - latency %.1f ms (avg %.1f max %.1f) - under/over-runs %u/%u - speech %u/%u - callback %.3f ms (max %.3f)",
+		m_SampleRate, m_DeviceSamples,
+		m_LatencyLast / 1000.0, latencyAvg, m_LatencyMax / 1000.0,
+		( unsigned ) m_Underruns, ( unsigned ) m_Overruns,
+		( unsigned ) m_SpeechUnderruns, ( unsigned ) m_SpeechOverruns,
+		callbackAvg, m_CallbackMax / 1000.0 );
+
+	return buffer;
+}
@@ -26,6 +26,7 @@
 //
 //----------------------------------------------------------------------------
 
+#include <algorithm>
 #include "bitstream.hpp"
 
 cBitStream::cBitStream( const std::vector<UINT8> &data_, size_t size_, bool skip_ ) :
@@ -135,3 +136,69 @@ int cBitStreamMSB::next( )
 
 	return ( byte & ( mask >> index )) ? 1 : 0;
 }
+
+static UINT8 reverseTable[ 256 ];			// Bits in reverse order
+static UINT8 pairsLSB[ 256 ];				// OR of each bit pair (LSB first) packed into a nibble
+static UINT8 pairsMSB[ 256 ];				// OR of each bit pair (MSB first) packed into a nibble
+
+static bool InitTables( )
+{
+	for( int i = 0; i < 256; i++ )
+	{
+		int reverse = 0;
+		int lsb = 0;
+		int msb = 0;
+
+		for( int bit = 0; bit < 8; bit++ )
+		{
+			reverse = ( reverse << 1 ) | (( i >> bit ) & 1 );
+		}
+
+		for( int pair = 0; pair < 4; pair++ )
+		{
+			lsb = ( lsb << 1 ) | (( i & ( 0x03 << ( pair * 2 ))) ? 1 : 0 );
+			msb = ( msb << 1 ) | (( i & ( 0xC0 >> ( pair * 2 ))) ? 1 : 0 );
+		}
+
+		reverseTable[ i ] = reverse;
+		pairsLSB[ i ]     = lsb;
+		pairsMSB[ i ]     = msb;
+	}
+
+	return true;
+}
+
+static bool initialized = InitTables( );
+
+cBitReader::cBitReader( const std::vector<UINT8> &data, size_t size, bool skip, bool lsb ) :
+	bits( ),
+	totalBits( skip ? ( size + 1 ) / 2 : size )
+{
+	size_t inBytes = std::min(( size + 7 ) / 8, data.size( ));
+
+	// Leave room for peek( ) to read a full 24-bit window at the end
+	bits.resize(( totalBits + 7 ) / 8 + 3, 0 );
+
+	UINT8 *out = bits.data( );
+
+	if( skip )
+	{
+		const UINT8 *pairs = lsb ? pairsLSB : pairsMSB;
+
+		for( size_t i = 0; i < inBytes; i++ )
+		{
+			out[ i / 2 ] |= pairs[ data[ i ]] << (( i & 1 ) ? 0 : 4 );
+		}
+	}
+	else if( lsb )
+	{
+		for( size_t i = 0; i < inBytes; i++ )
+		{
+			out[ i ] = reverseTable[ data[ i ]];
+		}
+	}
+	else
+	{
+		std::copy( data.begin( ), data.begin( ) + inBytes, out );
+	}
+}
@@ -27,7 +27,6 @@
 //----------------------------------------------------------------------------
 
 #include <list>
-#include <stdexcept>
 #include "bitstream.hpp"
 #include "idisk-sector.hpp"
 #include "disk-util.hpp"
@@ -55,89 +54,173 @@ constexpr int SYNC_TEST        = SYNC_TEST_CLOCK | SYNC_TEST_DATA;
 
 constexpr int SYNC_SWITCH_MASK = ( expand( 0xC7 ^ 0xD7 ) << 1 ) | expand( 0xFF ^ 0xF8 );
 
-static int Collapse( int x )
+static UINT8 evenBits[ 256 ];				// Bits 0, 2, 4 & 6 packed into a nibble
+static UINT8 lostClock[ 256 ];				// Bits up to & including the first cell without a clock (0 if none)
+static UINT8 syncMark[ 0x10000 ];			// Non-zero if the last 16 bits hold an address mark
+
+static bool IsSyncMark( int reg )
+{
+	if(( reg & SYNC_MASK ) != SYNC_TEST )
+	{
+		return false;
+	}
+
+	switch( reg & SYNC_SWITCH_MASK )
+	{
+		case expand( 0xF8 ^ MARK_DAM ) :	// Marker: 0xF8  Clock: 0xC7  DAM
+		case expand( 0xF8 ^ MARK_DAMx ) :	// Marker: 0xF9  Clock: 0xC7  DAMx
+		case expand( 0xF8 ^ MARK_DAMy ) :	// Marker: 0xFA  Clock: 0xC7  DAMx
+		case expand( 0xF8 ^ MARK_DDAM ) :	// Marker: 0xFB  Clock: 0xC7  DDAM
+		case expand( 0xF8 ^ MARK_IDAM ) :	// Marker: 0xFE  Clock: 0xC7  IDAM
+		case expand( 0xF8 ^ MARK_IAM ) | ( expand( 0xC7 ^ 0xD7 ) << 1 ) :	// Marker: 0xFC  Clock: 0xD7  IAM
+			break;
+		default :
+			return false;
+	}
+
+	return true;
+}
+
+static bool InitTables( )
 {
-	x &= 0x5555;
+	for( int i = 0; i < 256; i++ )
+	{
+		evenBits[ i ] = ( i & 0x01 ) | (( i >> 1 ) & 0x02 ) | (( i >> 2 ) & 0x04 ) | (( i >> 3 ) & 0x08 );
+
+		lostClock[ i ] = 0;
+
+		for( int cell = 0; cell < 4; cell++ )
+		{
+			if(( i & ( 0x80 >> ( cell * 2 ))) == 0 )
+			{
+				lostClock[ i ] = ( cell + 1 ) * 2;
+				break;
+			}
+		}
+	}
 
-	x = ( x | ( x >> 1 )) & 0x3333;
-	x = ( x | ( x >> 2 )) & 0x0F0F;
-	x = ( x | ( x >> 4 )) & 0x00FF;
+	for( int i = 0; i < 0x10000; i++ )
+	{
+		syncMark[ i ] = IsSyncMark( i ) ? 1 : 0;
+	}
 
-	return x;
+	return true;
 }
 
-static int GetClock( int reg )
+static bool initialized = InitTables( );
+
+static int Collapse( UINT32 x )
+{
+	return evenBits[ x & 0xFF ] | ( evenBits[ ( x >> 8 ) & 0xFF ] << 4 );
+}
+
+static int GetClock( UINT32 reg )
 {
 	return Collapse( reg >> 1 );
 }
 
-static int GetData( int reg )
+static int GetData( UINT32 reg )
 {
 	return Collapse( reg );
 }
 
-std::list<sDataFragment> DecodeDataFM( cBitStream &stream )
+std::list<sDataFragment> DecodeDataFM( const cBitReader &stream )
 {
-	int reg				{ 0 };
+	UINT32 reg			{ 0 };
+	size_t offset		{ 0 };
+	size_t size			{ stream.size( ) };
 
-	auto GetBit = [ & ]( )
+	auto IsSync = [ & ]( )
 	{
-		auto bit = stream.next( );
-
-		if( bit == -1 )
-		{
-			throw std::underflow_error( "cBitStream empty" );
-		}
-
-		reg = ( reg << 1 ) | bit;
+		return syncMark[ reg & 0xFFFF ] != 0;
+	};
 
-		return bit;
+	auto LostClock = [ & ]( )
+	{
+		// Make sure the last clock looks correct
+		return ( reg & 0x02 ) != 0x02;
 	};
 
-	auto IsSync = [ & ]( )
+	// Shifts in a whole byte (16 bits) if all 8 clocks are present, otherwise stops
+	// after the first cell with a missing clock.  Returns false if the clock was lost
+	// or the stream ran out.
+	auto GetByte = [ & ]( )
 	{
-		if(( reg & SYNC_MASK ) != SYNC_TEST )
+		if( offset + 16 > size )
 		{
-			return false;
-		}
+			for( int i = 0; i < 8; i++ )
+			{
+				if( offset + 2 > size )
+				{
+					offset = size;
+					return false;
+				}
 
-		switch( reg & SYNC_SWITCH_MASK )
-		{
-			case expand( 0xF8 ^ MARK_DAM ) :	// Marker: 0xF8  Clock: 0xC7  DAM
-			case expand( 0xF8 ^ MARK_DAMx ) :	// Marker: 0xF9  Clock: 0xC7  DAMx
-			case expand( 0xF8 ^ MARK_DAMy ) :	// Marker: 0xFA  Clock: 0xC7  DAMx
-			case expand( 0xF8 ^ MARK_DDAM ) :	// Marker: 0xFB  Clock: 0xC7  DDAM
-			case expand( 0xF8 ^ MARK_IDAM ) :	// Marker: 0xFE  Clock: 0xC7  IDAM
-			case expand( 0xF8 ^ MARK_IAM ) | ( expand( 0xC7 ^ 0xD7 ) << 1 ) :	// Marker: 0xFC  Clock: 0xD7  IAM
-				break;
-			default :
-				return false;
+				reg = ( reg << 2 ) | stream.peek( offset, 2 );
+				offset += 2;
+
+				if( LostClock( ))
+				{
+					return false;
+				}
+			}
+
+			return true;
 		}
 
-		return true;
-	};
+		UINT32 bits = stream.peek( offset, 16 );
 
-	auto LostClock = [ & ]( )
-	{
-		// Make sure the last clock looks correct
-		if(( reg & 0x02 ) != 0x02 )
+		int count = lostClock[ bits >> 8 ];
+
+		if( count == 0 )
 		{
-			return true;
+			count = lostClock[ bits & 0xFF ];
+
+			if( count == 0 )
+			{
+				reg = ( reg << 16 ) | bits;
+				offset += 16;
+
+				return true;
+			}
+
+			count += 8;
 		}
 
+		reg = ( reg << count ) | ( bits >> ( 16 - count ));
+		offset += count;
+
 		return false;
 	};
 
-	auto GetByte = [ & ]( )
+	// Slides forward until the last 16 bits hold an address mark - returns false at the end of the stream
+	auto FindSync = [ & ]( )
 	{
-		for( int i = 0; i < 8; i++ )
+		while( IsSync( ) == false )
 		{
-			GetBit( );
-			GetBit( );
+			if( offset + 16 <= size )
+			{
+				UINT32 window = ( reg << 16 ) | stream.peek( offset, 16 );
+
+				int shift = 15;
+
+				while(( shift > 0 ) && ( syncMark[ ( window >> shift ) & 0xFFFF ] == 0 ))
+				{
+					shift--;
+				}
 
-			if( LostClock( ))
+				reg = window >> shift;
+				offset += 16 - shift;
+			}
+			else
 			{
-				return false;
+				if( offset >= size )
+				{
+					return false;
+				}
+
+				reg = ( reg << 1 ) | stream.peek( offset, 1 );
+				offset += 1;
 			}
 		}
 
@@ -150,25 +233,25 @@ std::list<sDataFragment> DecodeDataFM( cBitStream &stream )
 
 		if( from < to )
 		{
-			size_t offset = stream.offset( );
+			size_t savedOffset = offset;
 
 			size_t bytes = ( to - from ) / 16;
-			stream.seek( to - bytes * 16 );
+			offset = to - bytes * 16;
 
 			fragment.byteData.reserve( bytes );
 
-			fragment.bitOffsetStart = stream.offset( );
+			fragment.bitOffsetStart = offset;
 			fragment.clock = -1;
 
 			for( size_t i = 0; ( i < bytes ) && GetByte( ); i++ )
 			{
 				int byte = GetData( reg );
 
-				fragment.bitOffsetEnd = stream.offset( );
+				fragment.bitOffsetEnd = offset;
 				fragment.byteData.push_back( byte );
 			}
 
-			stream.seek( offset );
+			offset = savedOffset;
 		}
 
 		return fragment;
@@ -180,52 +263,46 @@ std::list<sDataFragment> DecodeDataFM( cBitStream &stream )
 
 	GetByte( );
 
-	while( stream.remaining( ) > 0 )
+	while( offset < size )
 	{
 		sDataFragment fragment{ };
 
-		fragment.byteData.reserve( stream.remaining( ) / 16 );
+		fragment.byteData.reserve(( size - offset ) / 16 );
 
-		try
+		if( LostClock( ))
 		{
-			if( LostClock( ))
+			// Searching for clock...
+			if( FindSync( ) == false )
 			{
-				// Searching for clock...
-				while( IsSync( ) == false )
-				{
-					GetBit( );
-				}
+				break;
 			}
+		}
 
-			fragment.bitOffsetStart = stream.offset( ) - 16;
-			fragment.bitOffsetEnd = stream.offset( );
-			fragment.clock = IsSync( ) ? GetClock( reg ) : -1;
-			fragment.byteData.push_back( GetData( reg ));
-
-			// Make sure we didn't capture part of the clock byte in the last fragment
-			if( list.back( ).bitOffsetEnd > fragment.bitOffsetStart )
-			{
-				list.back( ).bitOffsetEnd -= 16;
-				list.back( ).byteData.resize( list.back( ).byteData.size( ) - 1 );
-			}
+		fragment.bitOffsetStart = offset - 16;
+		fragment.bitOffsetEnd = offset;
+		fragment.clock = IsSync( ) ? GetClock( reg ) : -1;
+		fragment.byteData.push_back( GetData( reg ));
 
-			// See if we can recover any bits after the last fragment using the new clock alignment
-			auto recovered = RecoverFragment( list.back( ).bitOffsetEnd, fragment.bitOffsetStart );
-			if( !recovered.byteData.empty( ))
-			{
-				list.push_back( recovered );
-			}
-
-			while( GetByte( ))
-			{
-				int byte = GetData( reg );
+		// Make sure we didn't capture part of the clock byte in the last fragment
+		if( list.back( ).bitOffsetEnd > fragment.bitOffsetStart )
+		{
+			list.back( ).bitOffsetEnd -= 16;
+			list.back( ).byteData.resize( list.back( ).byteData.size( ) - 1 );
+		}
 
-				fragment.bitOffsetEnd = stream.offset( );
-				fragment.byteData.push_back( byte );
-			}
+		// See if we can recover any bits after the last fragment using the new clock alignment
+		auto recovered = RecoverFragment( list.back( ).bitOffsetEnd, fragment.bitOffsetStart );
+		if( !recovered.byteData.empty( ))
+		{
+			list.push_back( recovered );
 		}
-		catch( ... )
+
+		while( GetByte( ))
 		{
+			int byte = GetData( reg );
+
+			fragment.bitOffsetEnd = offset;
+			fragment.byteData.push_back( byte );
 		}
 
 		if( !fragment.byteData.empty( ))
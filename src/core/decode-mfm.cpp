@@ -26,61 +26,84 @@
 //
 //----------------------------------------------------------------------------
 #include <list>
-#include <stdexcept>
 #include "bitstream.hpp"
 #include "idisk-sector.hpp"
 #include "disk-util.hpp"
 
-static int Collapse( int x )
+static UINT8 evenBits[ 256 ];				// Bits 0, 2, 4 & 6 packed into a nibble
+static UINT8 lostClock[ 512 ];				// Bits up to & including the first bad clock (0 if none) - bit 8 is the previous data bit
+
+static bool InitTables( )
 {
-	x &= 0x5555;
+	for( int i = 0; i < 256; i++ )
+	{
+		evenBits[ i ] = ( i & 0x01 ) | (( i >> 1 ) & 0x02 ) | (( i >> 2 ) & 0x04 ) | (( i >> 3 ) & 0x08 );
+	}
+
+	for( int i = 0; i < 512; i++ )
+	{
+		lostClock[ i ] = 0;
+
+		int last = i >> 8;
+
+		for( int cell = 0; cell < 4; cell++ )
+		{
+			int clock = ( i >> ( 7 - cell * 2 )) & 1;
+			int data  = ( i >> ( 6 - cell * 2 )) & 1;
+
+			// A clock is only written between two 0 data bits
+			if( clock != ((( last | data ) == 0 ) ? 1 : 0 ))
+			{
+				lostClock[ i ] = ( cell + 1 ) * 2;
+				break;
+			}
 
-	x = ( x | ( x >> 1 )) & 0x3333;
-	x = ( x | ( x >> 2 )) & 0x0F0F;
-	x = ( x | ( x >> 4 )) & 0x00FF;
+			last = data;
+		}
+	}
 
-	return x;
+	return true;
 }
 
-static int GetClock( int reg )
+static bool initialized = InitTables( );
+
+static int Collapse( UINT32 x )
+{
+	return evenBits[ x & 0xFF ] | ( evenBits[ ( x >> 8 ) & 0xFF ] << 4 );
+}
+
+static int GetClock( UINT32 reg )
 {
 	return Collapse( reg >> 1 );
 }
 
-static int GetData( int reg )
+static int GetData( UINT32 reg )
 {
 	return Collapse( reg );
 }
 
-std::list<sDataFragment> DecodeDataMFM( cBitStream &stream )
+static bool IsSyncMark( UINT32 reg )
 {
-	int reg				{ 0 };
-
-	auto GetBit = [ & ]( )
+	// Look for the clock pattern:
+	switch( reg & 0x7FFF )
 	{
-		auto bit = stream.next( );
-
-		if( bit == -1 )
-		{
-			throw std::underflow_error( "cBitStream empty" );
-		}
+		case 0x4489 : // x100 0100 1000 1001 => 0xA1 with missing clock
+		case 0x5224 : // x101 0010 0010 0100 => 0xC2 with missing clock
+			return true;
+	}
 
-		reg = ( reg << 1 ) | bit;
+	return false;
+}
 
-		return bit;
-	};
+std::list<sDataFragment> DecodeDataMFM( const cBitReader &stream )
+{
+	UINT32 reg			{ 0 };
+	size_t offset		{ 0 };
+	size_t size			{ stream.size( ) };
 
 	auto IsSync = [ & ]( )
 	{
-		// Look for the clock pattern:
-		switch( reg & 0x7FFF )
-		{
-			case 0x4489 : // x100 0100 1000 1001 => 0xA1 with missing clock
-			case 0x5224 : // x101 0010 0010 0100 => 0xC2 with missing clock
-				return true;
-		}
-
-		return false;
+		return IsSyncMark( reg );
 	};
 
 	auto LostClock = [ & ]( )
@@ -100,16 +123,86 @@ std::list<sDataFragment> DecodeDataMFM( cBitStream &stream )
 		return false;
 	};
 
+	// Shifts in a whole byte (16 bits) if all 8 clocks are present, otherwise stops
+	// after the first cell with a missing clock.  Returns false if the clock was lost
+	// or the stream ran out.
 	auto GetByte = [ & ]( )
 	{
-		for( int i = 0; i < 8; i++ )
+		if( offset + 16 > size )
 		{
-			GetBit( );
-			GetBit( );
+			for( int i = 0; i < 8; i++ )
+			{
+				if( offset + 2 > size )
+				{
+					offset = size;
+					return false;
+				}
+
+				reg = ( reg << 2 ) | stream.peek( offset, 2 );
+				offset += 2;
+
+				if( LostClock( ))
+				{
+					return false;
+				}
+			}
 
-			if( LostClock( ))
+			return true;
+		}
+
+		UINT32 bits = stream.peek( offset, 16 );
+
+		int count = lostClock[ (( reg & 1 ) << 8 ) | ( bits >> 8 )];
+
+		if( count == 0 )
+		{
+			count = lostClock[ bits & 0x1FF ];
+
+			if( count == 0 )
 			{
-				return false;
+				reg = ( reg << 16 ) | bits;
+				offset += 16;
+
+				return true;
+			}
+
+			count += 8;
+		}
+
+		reg = ( reg << count ) | ( bits >> ( 16 - count ));
+		offset += count;
+
+		return false;
+	};
+
+	// Slides forward until the last 15 bits hold an address mark - returns false at the end of the stream
+	auto FindSync = [ & ]( )
+	{
+		while( IsSync( ) == false )
+		{
+			if( offset + 16 <= size )
+			{
+				UINT32 window = ( reg << 16 ) | stream.peek( offset, 16 );
+
+				int shift = 15;
+
+				while(( shift > 0 ) && ( IsSyncMark( window >> shift ) == false ))
+				{
+					shift--;
+				}
+
+				reg = window >> shift;
+				offset += 16 - shift;
+			}
+			else
+			{
+				if( offset >= size )
+				{
+					return false;
+				}
+
+				reg = ( reg << 1 ) | stream.peek( offset, 1 );
+				offset += 1;
 			}
 		}
 
@@ -122,25 +215,25 @@ std::list<sDataFragment> DecodeDataMFM( cBitStream &stream )
 
 		if( from < to )
 		{
-			size_t offset = stream.offset( );
+			size_t savedOffset = offset;
 
 			size_t bytes = ( to - from ) / 16;
-			stream.seek( to - bytes * 16 );
+			offset = to - bytes * 16;
 
 			fragment.byteData.reserve( bytes );
 
-			fragment.bitOffsetStart = stream.offset( );
+			fragment.bitOffsetStart = offset;
 			fragment.clock = -1;
 
 			for( size_t i = 0; ( i < bytes ) && GetByte( ); i++ )
 			{
 				int byte = GetData( reg );
 
-				fragment.bitOffsetEnd = stream.offset( );
+				fragment.bitOffsetEnd = offset;
 				fragment.byteData.push_back( byte );
 			}
 
-			stream.seek( offset );
+			offset = savedOffset;
 		}
 
 		return fragment;
@@ -152,52 +245,46 @@ std::list<sDataFragment> DecodeDataMFM( cBitStream &stream )
 
 	GetByte( );
 
-	while( stream.remaining( ) > 0 )
+	while( offset < size )
 	{
 		sDataFragment fragment{ };
 
-		fragment.byteData.reserve( stream.remaining( ) / 16 );
+		fragment.byteData.reserve(( size - offset ) / 16 );
 
-		try
+		if( LostClock( ))
 		{
-			if( LostClock( ))
+			// Searching for clock...
+			if( FindSync( ) == false )
 			{
-				// Searching for clock...
-				while( IsSync( ) == false )
-				{
-					GetBit( );
-				}
+				break;
 			}
+		}
 
-			fragment.bitOffsetStart = stream.offset( ) - 16;
-			fragment.bitOffsetEnd = stream.offset( );
-			fragment.clock = IsSync( ) ? GetClock( reg ) : -1;
-			fragment.byteData.push_back( GetData( reg ));
-
-			// Make sure we didn't capture part of the clock byte in the last fragment
-			if( list.back( ).bitOffsetEnd > fragment.bitOffsetStart )
-			{
-				list.back( ).bitOffsetEnd -= 16;
-				list.back( ).byteData.resize( list.back( ).byteData.size( ) - 1 );
-			}
+		fragment.bitOffsetStart = offset - 16;
+		fragment.bitOffsetEnd = offset;
+		fragment.clock = IsSync( ) ? GetClock( reg ) : -1;
+		fragment.byteData.push_back( GetData( reg ));
 
-			// See if we can recover any bits after the last fragment using the new clock alignment
-			auto recovered = RecoverFragment( list.back( ).bitOffsetEnd, fragment.bitOffsetStart );
-			if( !recovered.byteData.empty( ))
-			{
-				list.push_back( recovered );
-			}
-
-			while( GetByte( ))
-			{
-				int byte = GetData( reg );
+		// Make sure we didn't capture part of the clock byte in the last fragment
+		if( list.back( ).bitOffsetEnd > fragment.bitOffsetStart )
+		{
+			list.back( ).bitOffsetEnd -= 16;
+			list.back( ).byteData.resize( list.back( ).byteData.size( ) - 1 );
+		}
 
-				fragment.bitOffsetEnd = stream.offset( );
-				fragment.byteData.push_back( byte );
-			}
+		// See if we can recover any bits after the last fragment using the new clock alignment
+		auto recovered = RecoverFragment( list.back( ).bitOffsetEnd, fragment.bitOffsetStart );
+		if( !recovered.byteData.empty( ))
+		{
+			list.push_back( recovered );
 		}
-		catch( ... )
+
+		while( GetByte( ))
 		{
+			int byte = GetData( reg );
+
+			fragment.bitOffsetEnd = offset;
+			fragment.byteData.push_back( byte );
 		}
 
 		if( !fragment.byteData.empty( ))
@@ -26,6 +26,9 @@
 //
 //----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include "common.hpp"
 #include "logger.hpp"
 #include "disk-image.hpp"
@@ -102,6 +105,18 @@ const sDiskGap GAP_MFM[ 5 ] =
 //  cDiskImage
 //----------------------------------------------------------------------------
 
+cDiskImage::cDiskImage( ) :
+	NumTracks( 0 ),
+	NumHeads( 0 ),
+	Serializer( ),
+	Track( ),
+	IndexSectors( 0 ),
+	LogicalIndex( ),
+	StreamLimit( 0 ),
+	StreamedTracks( )
+{
+}
+
 //
 // Create a buffer to simulate a WriteTrack buffer from a WD1771 controller
 //
@@ -215,6 +230,11 @@ bool cDiskImage::AllocateTracks( size_t numTracks, size_t numHeads )
 
 	Track.clear( );
 
+	IndexSectors = 0;
+	LogicalIndex.clear( );
+
+	StreamedTracks.clear( );
+
 	Track.resize( NumHeads, { } );
 
 	for( auto &track : Track )
@@ -303,9 +323,66 @@ const iDiskTrack *cDiskImage::GetTrack( size_t tIndex, size_t hIndex ) const
 		return nullptr;
 	}
 
+	if(( StreamLimit > 0 ) && ( Track[ hIndex ][ tIndex ].IsEmpty( )) && ( Serializer != nullptr ))
+	{
+		StreamTrack( tIndex, hIndex );
+	}
+
 	return &Track[ hIndex ][ tIndex ];
 }
 
+//----------------------------------------------------------------------------
+//
+// Find a sector using the TI file system's numbering: side 0 from the outside
+// in followed by side 1 from the inside out.  Lookups are cached and only
+// repeated once the track has been rewritten.
+//
+//----------------------------------------------------------------------------
+
+iDiskSector *cDiskImage::GetLogicalSector( size_t index, size_t sectorsPerTrack )
+{
+	FUNCTION_ENTRY( this, "cDiskImage::GetLogicalSector", true );
+
+	if( sectorsPerTrack == 0 )
+	{
+		return nullptr;
+	}
+
+	size_t t = index / sectorsPerTrack;
+	size_t s = index % sectorsPerTrack;
+	size_t h = 0;
+
+	if( t >= NumTracks )
+	{
+		t = 2 * NumTracks - t - 1;
+		h = 1;
+	}
+
+	if(( t >= NumTracks ) || ( h >= NumHeads ))
+	{
+		return nullptr;
+	}
+
+	if( IndexSectors != sectorsPerTrack )
+	{
+		IndexSectors = sectorsPerTrack;
+		LogicalIndex.assign( NumTracks * NumHeads * sectorsPerTrack, { 0, nullptr } );
+	}
+
+	sLogicalSector &entry = LogicalIndex[ index ];
+
+	const cDiskTrack &track = Track[ h ][ t ];
+
+	if( entry.generation != track.GetGeneration( ))
+	{
+		// Note: this will load the track if it hasn't been used yet
+		entry.sector     = GetTrack( t, h )->GetSector( t, h, s );
+		entry.generation = track.GetGeneration( );
+	}
+
+	return entry.sector;
+}
+
 bool cDiskImage::HasChanged( ) const
 {
 	for( size_t h = 0; h < NumHeads; h++ )
@@ -333,14 +410,69 @@ void cDiskImage::ClearChanged( )
 	}
 }
 
+// Returns the (track, head) of each changed track
+std::vector<std::pair<size_t,size_t>> cDiskImage::GetChangedTracks( ) const
+{
+	std::vector<std::pair<size_t,size_t>> tracks;
+
+	for( size_t h = 0; h < NumHeads; h++ )
+	{
+		for( size_t t = 0; t < NumTracks; t++ )
+		{
+			if( Track[ h ][ t ].HasChanged( ))
+			{
+				tracks.emplace_back( t, h );
+			}
+		}
+	}
+
+	return tracks;
+}
+
+// Copy the changed tracks so they can be written out on another thread
+cDiskSnapshot cDiskImage::GetSnapshot( ) const
+{
+	FUNCTION_ENTRY( this, "cDiskImage::GetSnapshot", true );
+
+	cDiskSnapshot snapshot( NumTracks, NumHeads );
+
+	for( size_t h = 0; h < NumHeads; h++ )
+	{
+		for( size_t t = 0; t < NumTracks; t++ )
+		{
+			if( Track[ h ][ t ].HasChanged( ))
+			{
+				snapshot.AddTrack( t, h, Track[ h ][ t ] );
+			}
+		}
+	}
+
+	return snapshot;
+}
+
+void cDiskImage::MarkChanged( size_t tIndex, size_t hIndex )
+{
+	if(( hIndex < NumHeads ) && ( tIndex < NumTracks ))
+	{
+		Track[ hIndex ][ tIndex ].MarkChanged( );
+	}
+}
+
 void cDiskImage::SetLoadOnDemand( iDiskSerializer *serializer )
 {
 	Serializer = serializer;
 }
 
+// The serializer tracks that haven't been used yet are read from
+iDiskSerializer *cDiskImage::GetLoadSerializer( ) const
+{
+	return Serializer;
+}
+
 void cDiskImage::CompleteLoad( ) const
 {
-	if( Serializer != nullptr )
+	// Streamed tracks are read as they're needed, so the serializer has to stay open
+	if(( Serializer != nullptr ) && ( StreamLimit == 0 ))
 	{
 		for( size_t h = 0; h < NumHeads; h++ )
 		{
@@ -358,3 +490,182 @@ void cDiskImage::CompleteLoad( ) const
 		const_cast<cRefPtr<iDiskSerializer>&>( Serializer )->LoadComplete( );
 	}
 }
+
+//----------------------------------------------------------------------------
+//
+// Load every track that hasn't been used yet.  If the serializer allows it,
+// the tracks are decoded on a pool of threads - each one writes straight
+// into its own slot in Track, so no locking is needed.
+//
+//----------------------------------------------------------------------------
+
+void cDiskImage::LoadTracks( size_t threads )
+{
+	FUNCTION_ENTRY( this, "cDiskImage::LoadTracks", true );
+
+	if( Serializer == nullptr )
+	{
+		return;
+	}
+
+	std::vector<std::pair<size_t, size_t>> pending;
+
+	for( size_t h = 0; h < NumHeads; h++ )
+	{
+		for( size_t t = 0; t < NumTracks; t++ )
+		{
+			if( Track[ h ][ t ].IsEmpty( ))
+			{
+				pending.push_back( { t, h } );
+			}
+		}
+	}
+
+	auto LoadTrack = [ & ]( size_t index )
+	{
+		size_t t = pending[ index ].first;
+		size_t h = pending[ index ].second;
+
+		if( !Serializer->LoadTrack( t, h, &Track[ h ][ t ] ))
+		{
+			Track[ h ][ t ].Erase( );
+		}
+		Track[ h ][ t ].ClearChanged( );
+	};
+
+	threads = std::min( threads, pending.size( ));
+
+	if(( threads > 1 ) && Serializer->SupportsParallelLoad( ))
+	{
+		std::atomic<size_t> next( 0 );
+
+		std::vector<std::thread> workers;
+
+		for( size_t i = 0; i < threads; i++ )
+		{
+			workers.emplace_back( [ & ]( )
+			{
+				for( size_t index = next++; index < pending.size( ); index = next++ )
+				{
+					LoadTrack( index );
+				}
+			});
+		}
+
+		for( auto &worker : workers )
+		{
+			worker.join( );
+		}
+	}
+	else
+	{
+		for( size_t i = 0; i < pending.size( ); i++ )
+		{
+			LoadTrack( i );
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+//
+// Converting an image to another format only needs each track long enough to
+// write it out again.  While streaming, the read-only GetTrack loads tracks
+// on demand and the oldest unchanged ones are released again, so only a
+// handful of decoded tracks are held in memory at any time.
+//
+//----------------------------------------------------------------------------
+
+void cDiskImage::SetStreaming( size_t tracks )
+{
+	FUNCTION_ENTRY( this, "cDiskImage::SetStreaming", true );
+
+	StreamLimit = tracks;
+
+	StreamedTracks.clear( );
+
+	if( Serializer != nullptr )
+	{
+		Serializer->SetStreaming( tracks > 0 );
+	}
+}
+
+void cDiskImage::StreamTrack( size_t tIndex, size_t hIndex ) const
+{
+	FUNCTION_ENTRY( this, "cDiskImage::StreamTrack", true );
+
+	auto &track = const_cast<std::vector<std::vector<cDiskTrack>>&>( Track );
+
+	if( !Serializer->LoadTrack( tIndex, hIndex, &track[ hIndex ][ tIndex ] ))
+	{
+		track[ hIndex ][ tIndex ].Erase( );
+	}
+	track[ hIndex ][ tIndex ].ClearChanged( );
+
+	StreamedTracks.emplace_back( tIndex, hIndex );
+
+	while( StreamedTracks.size( ) > StreamLimit )
+	{
+		auto &oldest = track[ StreamedTracks.front( ).second ][ StreamedTracks.front( ).first ];
+
+		// Tracks that have been changed since they were loaded can't be read back from the file
+		if( oldest.HasChanged( ) == false )
+		{
+			oldest.Release( );
+		}
+
+		StreamedTracks.pop_front( );
+	}
+}
+
+//----------------------------------------------------------------------------
+// cDiskSnapshot
+//----------------------------------------------------------------------------
+
+cDiskSnapshot::cDiskSnapshot( size_t numTracks, size_t numHeads ) :
+	NumTracks( numTracks ),
+	NumHeads( numHeads ),
+	Tracks( )
+{
+}
+
+void cDiskSnapshot::AddTrack( size_t tIndex, size_t hIndex, const cDiskTrack &track )
+{
+	Tracks.insert_or_assign( std::make_pair( tIndex, hIndex ), track );
+}
+
+const iDiskTrack *cDiskSnapshot::GetTrack( size_t tIndex, size_t hIndex ) const
+{
+	auto it = Tracks.find( std::make_pair( tIndex, hIndex ));
+
+	return ( it != Tracks.end( )) ? &it->second : nullptr;
+}
+
+// The later copy of a track replaces the earlier one, but keeps a note of what the earlier one changed
+bool cDiskSnapshot::Merge( cDiskSnapshot &&later )
+{
+	FUNCTION_ENTRY( this, "cDiskSnapshot::Merge", true );
+
+	if(( later.NumTracks != NumTracks ) || ( later.NumHeads != NumHeads ))
+	{
+		return false;
+	}
+
+	for( auto &entry : later.Tracks )
+	{
+		auto it = Tracks.find( entry.first );
+
+		if( it != Tracks.end( ))
+		{
+			entry.second.MergeChanges( it->second );
+			it->second = std::move( entry.second );
+		}
+		else
+		{
+			Tracks.insert( std::move( entry ));
+		}
+	}
+
+	later.Tracks.clear( );
+
+	return true;
+}
@@ -27,10 +27,12 @@
 //----------------------------------------------------------------------------
 
 #include <cstring>
+#include <filesystem>
 #include "common.hpp"
 #include "logger.hpp"
 #include "support.hpp"
 #include "disk-media.hpp"
+#include "disk-writer.hpp"
 #include "file-system-disk.hpp"
 #include "idisk-serializer.hpp"
 #include "disk-serializer-anadisk.hpp"
@@ -41,12 +43,39 @@
 
 DBG_REGISTER( __FILE__ );
 
+// Decoded tracks kept in memory while converting an image to a new file
+const size_t STREAM_TRACKS = 4;
+
+size_t cDiskMedia::LoadThreads = 1;
+
+// Two names (as given by the user) that resolve to the same file on disk
+static bool IsSameFile( const std::string &first, const std::string &second )
+{
+	std::filesystem::path firstPath  = LocateFile( "disks", first );
+	std::filesystem::path secondPath = LocateFile( "disks", second );
+
+	// A file that doesn't exist yet can't be the one we're reading from
+	if( firstPath.empty( ) || secondPath.empty( ))
+	{
+		return false;
+	}
+
+	std::error_code error;
+
+	bool same = std::filesystem::equivalent( firstPath, secondPath, error );
+
+	// If we can't tell, assume the worst
+	return same || error;
+}
+
 cDiskMedia::cDiskMedia( cDiskImage *image ) :
 	cBaseObject( "cDiskMedia" ),
 	m_IsWriteProtected( false ),
 	m_FileName( ),
 	m_Serializer( nullptr ),
-	m_Image( image )
+	m_Image( image ),
+	m_WriteName( ),
+	m_WriteTracks( )
 {
 	FUNCTION_ENTRY( this, "cDiskMedia ctor", true );
 }
@@ -102,20 +131,30 @@ iDiskSerializer *cDiskMedia::CreateSerializer( eDiskFormat format )
 	return nullptr;
 }
 
-iDiskSerializer *cDiskMedia::FindSerializer( const char *fileName )
+// The file on the host that holds the named image (a CF7+ volume lives in the card's file)
+std::string cDiskMedia::LocateImage( const char *fileName )
 {
-	FUNCTION_ENTRY( nullptr, "cDiskMedia::FindSerializer", true );
+	FUNCTION_ENTRY( nullptr, "cDiskMedia::LocateImage", true );
 
 	std::string validName = LocateFile( "disks", fileName );
 
 	if( validName.empty( ))
 	{
 		validName = LocateFile( "disks", cDiskSerializerCF7::GetRawFileName( fileName ));
+	}
 
-		if( validName.empty( ))
-		{
-			return nullptr;
-		}
+	return validName;
+}
+
+iDiskSerializer *cDiskMedia::FindSerializer( const char *fileName )
+{
+	FUNCTION_ENTRY( nullptr, "cDiskMedia::FindSerializer", true );
+
+	std::string validName = LocateImage( fileName );
+
+	if( validName.empty( ))
+	{
+		return nullptr;
 	}
 
 	iDiskSerializer* serializer = nullptr;
@@ -192,6 +231,9 @@ void cDiskMedia::ClearDisk( )
 	m_Image->AllocateTracks( m_Image->GetNumTracks( ), m_Image->GetNumHeads( ));
 
 	m_Image->ClearChanged( );
+
+	m_WriteName.clear( );
+	m_WriteTracks.clear( );
 }
 
 bool cDiskMedia::LoadFile( const char *name, eDiskFormat format )
@@ -227,6 +269,14 @@ bool cDiskMedia::LoadFile( const char *name, eDiskFormat format )
 
 	m_Serializer = serializer;
 
+	m_WriteName.clear( );
+	m_WriteTracks.clear( );
+
+	if(( LoadThreads > 1 ) && serializer->SupportsParallelLoad( ))
+	{
+		LoadFile( );
+	}
+
 	return true;
 }
 
@@ -253,6 +303,109 @@ bool cDiskMedia::SaveFile( bool force )
 	return false;
 }
 
+//----------------------------------------------------------------------------
+//
+// Hand the changes to the writer thread so the caller doesn't wait for the
+// file to be updated.  Returns false if the file can't be updated in place
+// (or an earlier update was lost) - those are left for the next SaveFile.
+// Changes the format turns out not to be able to make in place are reported
+// by the writer as a failed update.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::QueueUpdate( cDiskWriter *writer )
+{
+	FUNCTION_ENTRY( this, "cDiskMedia::QueueUpdate", true );
+
+	// Once an update has been lost, save here until the file can be written again
+	if( CheckWrites( writer, false ) == false )
+	{
+		return false;
+	}
+
+	if( m_Image->HasChanged( ) == false )
+	{
+		return true;
+	}
+
+	if(( m_Serializer == nullptr ) || ( m_IsWriteProtected == true ))
+	{
+		return false;
+	}
+
+	std::string name = m_Serializer->GetUpdateName( m_FileName.c_str( ));
+
+	if( name.empty( ))
+	{
+		return false;
+	}
+
+	// Only the changed tracks are copied here - the file is worked out and written on the writer's thread
+	writer->Write( name, m_Serializer, m_Image->GetSnapshot( ));
+
+	// Remember what went into the update in case the writer can't commit it
+	auto tracks = m_Image->GetChangedTracks( );
+
+	m_WriteName = name;
+	m_WriteTracks.insert( tracks.begin( ), tracks.end( ));
+
+	m_Image->ClearChanged( );
+
+	return true;
+}
+
+// Write the changes back - in the background if they can be made in place
+bool cDiskMedia::SaveFile( cDiskWriter *writer )
+{
+	FUNCTION_ENTRY( this, "cDiskMedia::SaveFile", true );
+
+	if( QueueUpdate( writer ))
+	{
+		return true;
+	}
+
+	// Don't let a full rewrite race with updates that are still queued for the file
+	writer->Barrier( );
+
+	CheckWrites( writer, true );
+
+	return SaveFile( );
+}
+
+//----------------------------------------------------------------------------
+//
+// Look for updates to this image that the writer couldn't commit.  The tracks
+// they covered are marked as changed again so the next save includes them.
+// Once the writer is known to be idle (after a Barrier) the queued tracks are
+// forgotten.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::CheckWrites( cDiskWriter *writer, bool finished )
+{
+	FUNCTION_ENTRY( this, "cDiskMedia::CheckWrites", true );
+
+	bool status = m_WriteName.empty( ) || ( writer->HasFailed( m_WriteName ) == false );
+
+	if( status == false )
+	{
+		DBG_WARNING( "Update to '" << m_WriteName << "' failed" );
+
+		for( auto &track : m_WriteTracks )
+		{
+			m_Image->MarkChanged( track.first, track.second );
+		}
+	}
+
+	if( finished )
+	{
+		m_WriteName.clear( );
+		m_WriteTracks.clear( );
+	}
+
+	return status;
+}
+
 bool cDiskMedia::SaveFileAs( const char *filename, eDiskFormat format )
 {
 	FUNCTION_ENTRY( this, "cDiskMedia::SaveFileAs", true );
@@ -302,9 +455,46 @@ bool cDiskMedia::SaveFileAs( const char *filename, eDiskFormat format )
 		}
 	}
 
-	LoadFile( );
+	// Writing to a different file in a new format can stream the tracks across instead of
+	// decoding the whole disk first (a shared serializer would be re-targeted at the new file).
+	// Streamed tracks are read from wherever the image was loaded, so that's the file to compare.
+	iDiskSerializer *source = m_Image->GetLoadSerializer( );
+
+	bool streaming = ( source != nullptr ) && ( source != serializer ) && ! IsSameFile( source->RawFileName( m_FileName.c_str( )), serializer->RawFileName( filename ));
+
+	if( streaming )
+	{
+		m_Image->SetStreaming( STREAM_TRACKS );
+	}
+	else
+	{
+		LoadFile( );
+	}
+
+	bool saved = serializer->SaveFile( *m_Image, filename );
+
+	if( streaming )
+	{
+		m_Image->SetStreaming( 0 );
+
+		// Tracks released while streaming would still be read back from the old file, so re-open
+		// the image from the new one (or, failing that, finish loading it from the old one)
+		if( saved == true )
+		{
+			auto image = std::make_unique<cDiskImage>( );
+
+			if( serializer->LoadFile( filename, image.get( )))
+			{
+				m_Image = std::move( image );
+			}
+			else
+			{
+				m_Image->CompleteLoad( );
+			}
+		}
+	}
 
-	if( serializer->SaveFile( *m_Image, filename ) != true )
+	if( saved != true )
 	{
 		DBG_ERROR( "Serializer reported failure saving file" );
 		return false;
@@ -342,11 +532,17 @@ iSector *cDiskMedia::GetSector( int logicalCylinder, int logicalHead, int logica
 
 void cDiskMedia::LoadFile( )
 {
-	for( size_t h = 0; h < m_Image->GetNumHeads( ); h++ )
+	m_Image->LoadTracks( LoadThreads );
+}
+
+iDiskSector *cDiskMedia::GetLogicalSector( int index, int sectorsPerTrack )
+{
+	FUNCTION_ENTRY( this, "cDiskMedia::GetLogicalSector", true );
+
+	if(( index < 0 ) || ( sectorsPerTrack <= 0 ))
 	{
-		for( size_t t = 0; t < m_Image->GetNumTracks( ); t++ )
-		{
-			m_Image->GetTrack( t, h );
-		}
+		return nullptr;
 	}
+
+	return m_Image->GetLogicalSector( index, sectorsPerTrack );
 }
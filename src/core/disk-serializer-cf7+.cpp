@@ -64,6 +64,45 @@ static inline UINT16 GetUINT16( const void *_ptr )
 	return ( UINT16 ) (( ptr[ 0 ] << 8 ) | ptr[ 1 ] );
 }
 
+// Each byte of a CF7+ sector is followed by a filler byte
+static void ReadCF7Sector( const UINT8 *src, UINT8 *dest )
+{
+	for( size_t i = 0; i < DEFAULT_SECTOR_SIZE; i++ )
+	{
+		dest[ i ] = src[ 2 * i ];
+	}
+}
+
+static void WriteCF7Sector( const UINT8 *src, UINT8 *dest )
+{
+	for( size_t i = 0; i < DEFAULT_SECTOR_SIZE; i++ )
+	{
+		dest[ 2 * i ]     = src[ i ];
+		dest[ 2 * i + 1 ] = 0xE5;
+	}
+}
+
+// Expand a smaller disk's VIB to cover a full CF7+ volume
+static bool ExpandVIB( VIB *vib )
+{
+	UINT16 offset = GetUINT16( &vib->FormattedSectors );
+	if( offset >= CF7_SECTOR_COUNT )
+	{
+		return false;
+	}
+
+	vib->TracksPerSide   = 40;
+	vib->Sides           = 2;
+	vib->SectorsPerTrack = 20;
+	vib->Density         = DENSITY_DOUBLE;
+
+	SetUINT16( &vib->FormattedSectors, CF7_SECTOR_COUNT );
+
+	memset( &vib->AllocationMap[ offset / 8 ], 0, ( CF7_SECTOR_COUNT - offset ) / 8 );
+
+	return true;
+}
+
 static size_t freadcf7( void *restrict ptr, size_t size, size_t nitems, FILE *restrict file )
 {
 	char *buffer = new char[ size * nitems * 2 ];
@@ -228,23 +267,39 @@ bool cDiskSerializerCF7::LoadTrack( size_t tIndex, size_t hIndex, iDiskTrack *tr
 
 	size_t noSectors = 20;
 
+	if(( m_MappedFile == nullptr ) && ( m_DemandLoadFile == nullptr ))
+	{
+		return false;
+	}
+
 	auto trackImage = cDiskImage::FormatTrack( track::Format::MFM, tIndex, hIndex, noSectors, 1 );
 
 	track->Write( track::Format::MFM, trackImage );
 
-	long fstart = m_VolumeIndex ? static_cast<long>(( m_VolumeIndex - 1 ) * CF7_DISK_SIZE ) : 0;
+	size_t fstart = VolumeOffset( );
 
-	tIndex = ( hIndex == 0 ) ? tIndex : 40 - ( tIndex + 1 );
+	size_t t = ( hIndex == 0 ) ? tIndex : 40 - ( tIndex + 1 );
 
-	fstart += ( tIndex * noSectors + hIndex * ( CF7_SECTOR_COUNT / 2 )) * 512;
+	fstart += ( t * noSectors + hIndex * ( CF7_SECTOR_COUNT / 2 )) * 512;
 
-	fseek( m_DemandLoadFile, fstart, SEEK_SET );
+	if( m_MappedFile == nullptr )
+	{
+		fseek( m_DemandLoadFile, static_cast<long>( fstart ), SEEK_SET );
+	}
+	else if( fstart + noSectors * 512 > m_MappedFile->GetSize( ))
+	{
+		return false;
+	}
 
-	char buffer[ DEFAULT_SECTOR_SIZE ];
+	UINT8 buffer[ DEFAULT_SECTOR_SIZE ];
 
 	for( size_t s = 0; s < noSectors; s++ )
 	{
-		if( freadcf7( buffer, sizeof( buffer ), 1, m_DemandLoadFile ) != 1 )
+		if( m_MappedFile != nullptr )
+		{
+			ReadCF7Sector( m_MappedFile->GetData( ) + fstart + s * 512, buffer );
+		}
+		else if( freadcf7( buffer, sizeof( buffer ), 1, m_DemandLoadFile ) != 1 )
 		{
 			DBG_ERROR( "Error reading from file" );
 			return false;
@@ -270,20 +325,34 @@ FILE *cDiskSerializerCF7::OpenForWrite( const std::string &name )
 	return cDiskSerializer::OpenForWrite( name );
 }
 
+// Each volume is written into its slot on the card - the rest of the file is left alone
+bool cDiskSerializerCF7::ReplacesFile( ) const
+{
+	return false;
+}
+
 bool cDiskSerializerCF7::ReadFile( FILE *file, cDiskImage *image )
 {
 	FUNCTION_ENTRY( this, "cDiskSerializerCF7::ReadFile", true );
 
+	m_DemandLoadFile = file;
+
+	return PrepareImage( image );
+}
+
+bool cDiskSerializerCF7::PrepareImage( cDiskImage *image )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerCF7::PrepareImage", true );
+
 	// Force the disk configuration
 	size_t noTracks        = 40;
 	size_t noSides         = 2;
 	size_t noSectors       = 20;
 
-	// Clear any old data & prepare for a new image
+	// Clear any old data & prepare for a new image - tracks are loaded on demand
 
 	image->AllocateTracks( noTracks, noSides );
 	image->SetLoadOnDemand( this );
-	m_DemandLoadFile = file;
 
 	// Update the disk configuration in the VIB
 	if( iSector *sector = image->GetTrack( 0, 0 )->GetSector( 0, 0, 0 ))
@@ -310,7 +379,7 @@ bool cDiskSerializerCF7::WriteFile( const cDiskImage &image, FILE *file )
 {
 	FUNCTION_ENTRY( this, "cDiskSerializerCF7::WriteFile", true );
 
-	long fstart = m_VolumeIndex ? static_cast<long>(( m_VolumeIndex - 1 ) * CF7_DISK_SIZE ) : 0;
+	long fstart = static_cast<long>( VolumeOffset( ));
 
 	fseek( file, fstart, SEEK_SET );
 
@@ -365,18 +434,8 @@ bool cDiskSerializerCF7::WriteFile( const cDiskImage &image, FILE *file )
 	VIB vib;
 	memcpy( &vib, sector->GetData( ), sizeof( vib ));
 
-	UINT16 offset = GetUINT16( &vib.FormattedSectors );
-	if( offset < CF7_SECTOR_COUNT )
+	if( ExpandVIB( &vib ))
 	{
-		vib.TracksPerSide   = 40;
-		vib.Sides           = 2;
-		vib.SectorsPerTrack = 20;
-		vib.Density         = DENSITY_DOUBLE;
-
-		SetUINT16( &vib.FormattedSectors, CF7_SECTOR_COUNT );
-
-		memset( &vib.AllocationMap[ offset / 8 ], 0, ( CF7_SECTOR_COUNT - offset ) / 8 );
-
 		fseek( file, fstart, SEEK_SET );
 		if( fwritecf7( &vib, DEFAULT_SECTOR_SIZE, 1, file ) != 1 )
 		{
@@ -410,3 +469,110 @@ size_t cDiskSerializerCF7::GetMaxVolume( const char *filename )
 
 	return maxVolume;
 }
+
+size_t cDiskSerializerCF7::VolumeOffset( ) const
+{
+	return m_VolumeIndex ? ( m_VolumeIndex - 1 ) * CF7_DISK_SIZE : 0;
+}
+
+//----------------------------------------------------------------------------
+//
+// Memory mapped access.  A CF7+ card holds hundreds of volumes, so only the
+// tracks that are used are ever read and only changed sectors are written back.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskSerializerCF7::SupportsMapping( ) const
+{
+	return true;
+}
+
+bool cDiskSerializerCF7::ReadMapping( cDiskImage *image )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerCF7::ReadMapping", true );
+
+	if( VolumeOffset( ) + CF7_DISK_SIZE > m_MappedFile->GetSize( ))
+	{
+		return false;
+	}
+
+	return PrepareImage( image );
+}
+
+bool cDiskSerializerCF7::GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerCF7::GetChangedRegions", true );
+
+	const size_t noTracks  = 40;
+	const size_t noSectors = 20;
+
+	if(( snapshot.GetNumTracks( ) != noTracks ) || ( snapshot.GetNumHeads( ) != 2 ))
+	{
+		return false;
+	}
+
+	for( size_t h = 0; h < 2; h++ )
+	{
+		for( size_t t = 0; t < noTracks; t++ )
+		{
+			size_t c = ( h == 0 ) ? t : noTracks - ( t + 1 );
+
+			const iDiskTrack *track = snapshot.GetTrack( c, h );
+			if( track == nullptr )
+			{
+				continue;
+			}
+
+			size_t offset = VolumeOffset( ) + ( t * noSectors + h * ( CF7_SECTOR_COUNT / 2 )) * 512;
+
+			// A reformatted track is written in full, otherwise just the sectors that were modified
+			std::vector<const iDiskSector *> sectors;
+
+			if( track->HasLayoutChanged( ))
+			{
+				for( size_t s = 0; s < noSectors; s++ )
+				{
+					sectors.push_back( track->GetSector( -1, -1, s ));
+				}
+			}
+			else
+			{
+				for( auto sector : track->GetChangedSectors( ))
+				{
+					sectors.push_back( sector );
+				}
+			}
+
+			for( auto sector : sectors )
+			{
+				if(( sector == nullptr ) || ( sector->GetData( ) == nullptr ) || ( sector->Size( ) != DEFAULT_SECTOR_SIZE ))
+				{
+					return false;
+				}
+
+				size_t s = static_cast<size_t>( sector->LogicalSector( ));
+				if( s >= noSectors )
+				{
+					return false;
+				}
+
+				UINT8 buffer[ DEFAULT_SECTOR_SIZE ];
+				memcpy( buffer, sector->GetData( ), DEFAULT_SECTOR_SIZE );
+
+				// The VIB always describes a full CF7+ volume
+				if(( c == 0 ) && ( h == 0 ) && ( s == 0 ))
+				{
+					ExpandVIB( reinterpret_cast<VIB *>( buffer ));
+				}
+
+				sDiskRegion region = { offset + s * 512, sDataBuffer( 512 ) };
+
+				WriteCF7Sector( buffer, region.data.data( ));
+
+				regions->push_back( region );
+			}
+		}
+	}
+
+	return true;
+}
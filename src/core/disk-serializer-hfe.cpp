@@ -80,7 +80,7 @@ static bool BuildTrack( const std::list<sDataFragment> &fragments, std::vector<s
 
 static bool DecodeFM( const std::vector<UINT8> &encodedData, std::vector<size_t> *clock, std::vector<UINT8> *data )
 {
-	cBitStreamLSB bitstream{ encodedData, encodedData.size( ) * 8, true };
+	cBitReader bitstream{ encodedData, encodedData.size( ) * 8, true, true };
 
 	auto fragments = DecodeDataFM( bitstream );
 
@@ -89,7 +89,7 @@ static bool DecodeFM( const std::vector<UINT8> &encodedData, std::vector<size_t>
 
 static bool DecodeMFM( const std::vector<UINT8> &encodedData, std::vector<size_t> *clock, std::vector<UINT8> *data )
 {
-	cBitStreamLSB bitstream{ encodedData, encodedData.size( ) * 8, false };
+	cBitReader bitstream{ encodedData, encodedData.size( ) * 8, false, true };
 
 	auto fragments = DecodeDataMFM( bitstream );
 
@@ -158,7 +158,10 @@ static std::vector<UINT8> EncodeMFM( const std::vector<size_t> &clock, const std
 cDiskSerializerHFE::cDiskSerializerHFE( ) :
 	cBaseObject( "cDiskSerializerHFE" ),
 	cDiskSerializer( ),
-	FileBuffer( )
+	FileBuffer( ),
+	TrackLUT( ),
+	TrackSides( 0 ),
+	TrackFormat( track::Format::Unknown )
 {
 }
 
@@ -255,6 +258,14 @@ void cDiskSerializerHFE::LoadComplete( )
 	FileBuffer.clear( );
 }
 
+bool cDiskSerializerHFE::SupportsParallelLoad( ) const
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerHFE::SupportsParallelLoad", true );
+
+	// Tracks are decoded from the file buffer, which isn't touched until LoadComplete
+	return true;
+}
+
 bool cDiskSerializerHFE::ReadFile( FILE *file, cDiskImage *image )
 {
 	FUNCTION_ENTRY( this, "cDiskSerializerHFE::ReadFile", true );
@@ -278,8 +289,14 @@ bool cDiskSerializerHFE::ReadFile( FILE *file, cDiskImage *image )
 	auto header = reinterpret_cast<const HxC::FileHeader *>( FileBuffer.data( ));
 
 	// Double check the signature
-	if( memcmp( header->signature, HxC::HEADER_SIGNATURE, 8 ) == 0 )
+	if(( memcmp( header->signature, HxC::HEADER_SIGNATURE, 8 ) == 0 ) && ( FileBuffer.size( ) >= 0x200 + header->numTracks * sizeof( HxC::pictrack )))
 	{
+		auto trackLUT = reinterpret_cast<const HxC::pictrack *>( FileBuffer.data( ) + 0x200 );
+
+		TrackLUT.assign( trackLUT, trackLUT + header->numTracks );
+		TrackSides  = header->numSides;
+		TrackFormat = ( static_cast<HxC::ENCODING>( header->trackEncoding ) != HxC::ENCODING::ISOIBM_MFM ) ? track::Format::FM : track::Format::MFM;
+
 		// Clear any old data & prepare for a new image
 		image->AllocateTracks( header->numTracks, header->numSides );
 		image->SetLoadOnDemand( this );
@@ -314,15 +331,16 @@ bool cDiskSerializerHFE::WriteFile( const cDiskImage &image, FILE *file )
 
 	auto trackLUT = reinterpret_cast<HxC::pictrack *>( buffer.data( ) + 0x200 );
 
-	auto track0 = image.GetTrack( 0, 0 );
+	// Track 0 may have been dropped by the time the tracks have been written
+	auto format = image.GetTrack( 0, 0 )->GetFormat( );
 
 	memcpy( header->signature, HxC::HEADER_SIGNATURE, 8 );
 	header->revision			= 0;
 	header->numTracks			= image.GetNumTracks( );
 	header->numSides			= image.GetNumHeads( );
-	header->trackEncoding		= static_cast<UINT8>(( track0->GetFormat( ) == track::Format::MFM ) ? HxC::ENCODING::ISOIBM_MFM : HxC::ENCODING::ISOIBM_FM );
-	header->bitRate				= ( track0->GetFormat( ) == track::Format::MFM ) ? 250 : 300;
-	header->floppyRPM			= ( track0->GetFormat( ) == track::Format::MFM ) ? 300 : 360;
+	header->trackEncoding		= static_cast<UINT8>(( format == track::Format::MFM ) ? HxC::ENCODING::ISOIBM_MFM : HxC::ENCODING::ISOIBM_FM );
+	header->bitRate				= ( format == track::Format::MFM ) ? 250 : 300;
+	header->floppyRPM			= ( format == track::Format::MFM ) ? 300 : 360;
 	header->floppyInterfaceMode	= static_cast<UINT8>(( image.GetNumTracks( ) == 80 ) ? HxC::FLOPPYMODE::IBMPC_HD : HxC::FLOPPYMODE::GENERIC_SHUGGART_DD );
 	header->trackListOffset		= RoundToMultiple( sizeof( HxC::FileHeader ), 512 ) / 512;
 	header->writeAllowed		= true;
@@ -342,20 +360,88 @@ bool cDiskSerializerHFE::WriteFile( const cDiskImage &image, FILE *file )
 
 		size = RoundToMultiple( size, 256 );
 
-		side0.insert( side0.end( ), size - side0.size( ), 0xFF );
-		side1.insert( side1.end( ), size - side1.size( ), 0xFF );
-
 		size_t chunks = size / 256;
 
+		// Interleave the two sides in 256 byte chunks and write the whole track at once
+		std::vector<UINT8> block( chunks * 512, 0xFF );
+
 		for( size_t i = 0; i < chunks; i++ )
 		{
-			fwrite( side0.data( ) + ( i * 256 ), 1, 256, file );
-			fwrite( side1.data( ) + ( i * 256 ), 1, 256, file );
+			for( size_t side = 0; side < 2; side++ )
+			{
+				const auto &source = side ? side1 : side0;
+
+				size_t start = std::min( i * 256, source.size( ));
+				size_t end   = std::min( start + 256, source.size( ));
+
+				std::copy( source.begin( ) + start, source.begin( ) + end, block.begin( ) + i * 512 + side * 256 );
+			}
 		}
+
+		fwrite( block.data( ), 1, block.size( ), file );
 	}
 
 	fseek( file, 0, SEEK_SET );
 	fwrite( buffer.data( ), 1, buffer.size( ), file );
 
+	TrackLUT.assign( trackLUT, trackLUT + image.GetNumTracks( ));
+	TrackSides  = image.GetNumHeads( );
+	TrackFormat = format;
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+//
+// Each side of a track is re-encoded on its own and written to the 256 byte
+// halves of the track's blocks.  This only works if the new bitstream still
+// fits in the space allocated to the track, otherwise the file is rebuilt.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskSerializerHFE::GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerHFE::GetChangedRegions", true );
+
+	if(( TrackLUT.size( ) != snapshot.GetNumTracks( )) || ( snapshot.GetNumHeads( ) > TrackSides ))
+	{
+		return false;
+	}
+
+	for( size_t cylinder = 0; cylinder < snapshot.GetNumTracks( ); cylinder++ )
+	{
+		for( size_t head = 0; head < snapshot.GetNumHeads( ); head++ )
+		{
+			auto track = snapshot.GetTrack( cylinder, head );
+			if( track == nullptr )
+			{
+				continue;
+			}
+
+			if( track->GetFormat( ) != TrackFormat )
+			{
+				return false;
+			}
+
+			auto encoded = GetTrackData( track );
+
+			if( encoded.size( ) > TrackLUT[ cylinder ].trackLength / 2u )
+			{
+				return false;
+			}
+
+			size_t chunks = ( TrackLUT[ cylinder ].trackLength + 511 ) / 512;
+
+			encoded.resize( chunks * 256, 0xFF );
+
+			for( size_t i = 0; i < chunks; i++ )
+			{
+				auto start = encoded.begin( ) + i * 256;
+
+				regions->push_back( { ( TrackLUT[ cylinder ].offset + i ) * 512 + head * 256, { start, start + 256 } } );
+			}
+		}
+	}
+
 	return true;
 }
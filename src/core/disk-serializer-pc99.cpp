@@ -77,7 +77,11 @@ static void ZapCRC( sDataBuffer &buffer, std::vector<size_t> clocks, track::Form
 }
 
 cDiskSerializerPC99::cDiskSerializerPC99( ) :
-	cBaseObject( "cDiskSerializerPC99" )
+	cBaseObject( "cDiskSerializerPC99" ),
+	m_NumTracks( 0 ),
+	m_TrackOffset( ),
+	m_Format( track::Format::Unknown ),
+	m_TrackData( )
 {
 }
 
@@ -139,6 +143,59 @@ eDiskFormat cDiskSerializerPC99::GetFormat( ) const
 	return FORMAT_RAW_TRACK;
 }
 
+bool cDiskSerializerPC99::LoadTrack( size_t cylinder, size_t head, iDiskTrack *track )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerPC99::LoadTrack", true );
+
+	size_t index = head * m_NumTracks + cylinder;
+
+	if(( cylinder >= m_NumTracks ) || ( index >= m_TrackData.size( )) || m_TrackData[ index ].data.empty( ))
+	{
+		return false;
+	}
+
+	sTrackInfo &info = m_TrackData[ index ];
+
+	auto diskTrack = dynamic_cast<cDiskTrack*>( track );
+
+	// A streamed track can be released and asked for again, so keep the file's copy
+	if( m_Streaming )
+	{
+		diskTrack->RawWrite( m_Format, info.clock, info.data );
+	}
+	else
+	{
+		diskTrack->RawWrite( m_Format, std::move( info.clock ), std::move( info.data ));
+	}
+
+	// Update the CRC values read in (PC99 stores them as F7F7)
+	for( auto &sector : diskTrack->GetSectors( ))
+	{
+		diskTrack->DataModified( sector->GetID( ) - 1, 4 );
+		diskTrack->DataModified( sector->GetData( ) - 1, sector->Size( ));
+	}
+
+	return true;
+}
+
+void cDiskSerializerPC99::LoadComplete( )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerPC99::LoadComplete", true );
+
+	m_TrackData.clear( );
+	m_TrackData.shrink_to_fit( );
+
+	cDiskSerializer::LoadComplete( );
+}
+
+bool cDiskSerializerPC99::SupportsParallelLoad( ) const
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerPC99::SupportsParallelLoad", true );
+
+	// Each call only touches its own entry in m_TrackData
+	return true;
+}
+
 //----------------------------------------------------------------------------
 //
 // Read disk files that contain raw track data.  This is the format used by
@@ -179,6 +236,13 @@ bool cDiskSerializerPC99::ReadFile( FILE *file, cDiskImage *image )
 	// Clear any old data & prepare for a new image
 	image->AllocateTracks( maxTrack + 1, maxHeads + 1 );
 
+	m_Format    = format;
+	m_NumTracks = maxTrack + 1;
+
+	m_TrackData.clear( );
+	m_TrackData.resize(( maxHeads + 1 ) * m_NumTracks );
+
+	// Tracks are only parsed into sectors when they're first used
 	size_t index = 0;
 	for( size_t h = 0; h <= maxHeads; h++ )
 	{
@@ -186,22 +250,24 @@ bool cDiskSerializerPC99::ReadFile( FILE *file, cDiskImage *image )
 		{
 			if(( index < trackData.size( )) && ( trackData[ index ].data.size( ) > 0 ))
 			{
-				auto track = dynamic_cast<cDiskTrack*>( image->GetTrack( t, h ));
-
-				track->RawWrite( format, trackData[ index ].clock, trackData[ index ].data );
-
-				// Update the CRC values read in (PC99 stores them as F7F7)
-				for( auto &sector : track->GetSectors( ))
-				{
-					track->DataModified( sector->GetID( ) - 1, 4 );
-					track->DataModified( sector->GetData( ) - 1, sector->Size( ));
-				}
+				m_TrackData[ h * m_NumTracks + t ] = std::move( trackData[ index ] );
 
 				index++;
 			}
 		}
 	}
 
+	std::vector<size_t> sizes;
+
+	for( auto &info : m_TrackData )
+	{
+		sizes.push_back( info.data.size( ));
+	}
+
+	RecordLayout( m_NumTracks, sizes );
+
+	image->SetLoadOnDemand( this );
+
 	DBG_EVENT( "Disk loaded" );
 
 	return true;
@@ -211,6 +277,8 @@ bool cDiskSerializerPC99::WriteFile( const cDiskImage &image, FILE *file )
 {
 	FUNCTION_ENTRY( this, "cDiskSerializerPC99::WriteFile", true );
 
+	std::vector<size_t> sizes;
+
 	for( size_t h = 0; h < image.GetNumHeads( ); h++ )
 	{
 		for( size_t t = 0; t < image.GetNumTracks( ); t++ )
@@ -229,6 +297,74 @@ bool cDiskSerializerPC99::WriteFile( const cDiskImage &image, FILE *file )
 					return false;
 				}
 			}
+
+			sizes.push_back( buffer.size( ));
+		}
+	}
+
+	RecordLayout( image.GetNumTracks( ), sizes );
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+//
+// Tracks are stored back to back, so a changed track can only be written in
+// place if it is still the same size as the copy in the file.
+//
+//----------------------------------------------------------------------------
+
+void cDiskSerializerPC99::RecordLayout( size_t numTracks, const std::vector<size_t> &sizes )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerPC99::RecordLayout", true );
+
+	m_NumTracks = numTracks;
+
+	m_TrackOffset.clear( );
+
+	size_t offset = 0;
+
+	for( auto size : sizes )
+	{
+		m_TrackOffset.push_back( offset );
+
+		offset += size;
+	}
+
+	m_TrackOffset.push_back( offset );
+}
+
+bool cDiskSerializerPC99::GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerPC99::GetChangedRegions", true );
+
+	if(( snapshot.GetNumTracks( ) != m_NumTracks ) || ( m_TrackOffset.size( ) != snapshot.GetNumHeads( ) * m_NumTracks + 1 ))
+	{
+		return false;
+	}
+
+	for( size_t h = 0; h < snapshot.GetNumHeads( ); h++ )
+	{
+		for( size_t t = 0; t < snapshot.GetNumTracks( ); t++ )
+		{
+			auto track = snapshot.GetTrack( t, h );
+			if( track == nullptr )
+			{
+				continue;
+			}
+
+			size_t index = h * m_NumTracks + t;
+
+			auto buffer = track->Read( );
+
+			if( buffer.size( ) != m_TrackOffset[ index + 1 ] - m_TrackOffset[ index ] )
+			{
+				return false;
+			}
+
+			ZapCRC( buffer, track->GetClockLocations( ), track->GetFormat( ));
+
+			regions->push_back( { m_TrackOffset[ index ], std::move( buffer ) } );
 		}
 	}
 
@@ -37,7 +37,11 @@
 DBG_REGISTER( __FILE__ );
 
 cDiskSerializerV9T9::cDiskSerializerV9T9( ) :
-	cBaseObject( "cDiskSerializerV9T9" )
+	cBaseObject( "cDiskSerializerV9T9" ),
+	m_NumTracks( 0 ),
+	m_NumSides( 0 ),
+	m_NumSectors( 0 ),
+	m_Format( track::Format::Unknown )
 {
 }
 
@@ -128,6 +132,27 @@ eDiskFormat cDiskSerializerV9T9::GetFormat( ) const
 	return FORMAT_RAW_SECTOR;
 }
 
+void cDiskSerializerV9T9::GetGeometry( const UINT8 *data, size_t size, size_t *tracks, size_t *sides, size_t *sectors, track::Format *format )
+{
+	FUNCTION_ENTRY( nullptr, "cDiskSerializerV9T9::GetGeometry", true );
+
+	const VIB *vib = reinterpret_cast<const VIB *>( data );
+
+	size_t totalSectors = size / DEFAULT_SECTOR_SIZE;
+
+	size_t noSectors = ( vib->SectorsPerTrack != 0 ) ? vib->SectorsPerTrack : 9;
+	size_t noTracks  = totalSectors / noSectors;
+
+	// Some TI disks don't have accurate # sides & format
+	size_t noSides = ( noTracks > MAX_TRACKS_LO ) ? 2 : 1;
+
+	*format  = ( noSectors == 9 ) ? track::Format::FM : track::Format::MFM;
+	*sectors = noSectors;
+	*sides   = noSides;
+	// Correct the number of tracks
+	*tracks  = noTracks / noSides;
+}
+
 //----------------------------------------------------------------------------
 //
 // Read disk files that contain raw sector data.  This is the format used by
@@ -145,8 +170,6 @@ bool cDiskSerializerV9T9::ReadFile( FILE *file, cDiskImage *image )
 	UINT32 size = ftell( file );
 	fseek( file, 0L, SEEK_SET );
 
-	size_t totalSectors = size / DEFAULT_SECTOR_SIZE;
-
 	char buffer[ DEFAULT_SECTOR_SIZE ];
 
 	// Read the 1st sector from the disk to get the VIB
@@ -156,32 +179,22 @@ bool cDiskSerializerV9T9::ReadFile( FILE *file, cDiskImage *image )
 		return false;
 	}
 
-	VIB *vib = reinterpret_cast<VIB *>( buffer );
-
-	size_t noSectors = ( vib->SectorsPerTrack != 0 ) ? vib->SectorsPerTrack : 9;
-	size_t noTracks  = totalSectors / noSectors;
-
-	// Some TI disks don't have accurate # sides & format
-	size_t noSides       = ( noTracks > MAX_TRACKS_LO ) ? 2 : 1;
-	track::Format format = ( noSectors == 9 ) ? track::Format::FM : track::Format::MFM;
-
-	// Correct the number of tracks
-	noTracks /= noSides;
+	GetGeometry( reinterpret_cast<UINT8 *>( buffer ), size, &m_NumTracks, &m_NumSides, &m_NumSectors, &m_Format );
 
 	// Clear any old data & prepare for a new image
-	image->FormatDisk( noTracks, noSides, noSectors, format );
+	image->FormatDisk( m_NumTracks, m_NumSides, m_NumSectors, m_Format );
 
 	fseek( file, 0L, SEEK_SET );
 
-	for( size_t h = 0; h < noSides; h++ )
+	for( size_t h = 0; h < m_NumSides; h++ )
 	{
-		for( size_t t = 0; t < noTracks; t++ )
+		for( size_t t = 0; t < m_NumTracks; t++ )
 		{
-			size_t c = ( h == 0 ) ? t : noTracks - ( t + 1 );
+			size_t c = ( h == 0 ) ? t : m_NumTracks - ( t + 1 );
 
 			iDiskTrack *track = image->GetTrack( c, h );
 
-			for( size_t s = 0; s < noSectors; s++ )
+			for( size_t s = 0; s < m_NumSectors; s++ )
 			{
 				if( fread( buffer, sizeof( buffer ), 1, file ) != 1 )
 				{
@@ -205,6 +218,10 @@ bool cDiskSerializerV9T9::WriteFile( const cDiskImage &image, FILE *file )
 {
 	FUNCTION_ENTRY( this, "cDiskSerializerV9T9::WriteFile", true );
 
+	// Only a file with the same number of standard sectors on every track can be updated in place later
+	size_t trackSectors = 0;
+	bool uniform = true;
+
 	for( size_t h = 0; h < image.GetNumHeads( ); h++ )
 	{
 		for( size_t t = 0; t < image.GetNumTracks( ); t++ )
@@ -213,11 +230,14 @@ bool cDiskSerializerV9T9::WriteFile( const cDiskImage &image, FILE *file )
 
 			auto track = image.GetTrack( c, h );
 
+			size_t sectors = 0;
+
 			for( size_t s = 0; s < MAX_SECTORS; s++ )
 			{
 				const iSector *sector = track->GetSector( -1, -1, s );
 				if( sector == nullptr )
 				{
+					uniform = false;
 					continue;
 				}
 				if( sector->GetData( ) == nullptr )
@@ -229,6 +249,153 @@ bool cDiskSerializerV9T9::WriteFile( const cDiskImage &image, FILE *file )
 					DBG_ERROR( "Error writing to file" );
 					return false;
 				}
+				if( sector->Size( ) != DEFAULT_SECTOR_SIZE )
+				{
+					uniform = false;
+				}
+				sectors++;
+			}
+
+			if(( h == 0 ) && ( t == 0 ))
+			{
+				trackSectors = sectors;
+			}
+			else if( sectors != trackSectors )
+			{
+				uniform = false;
+			}
+		}
+	}
+
+	m_NumTracks  = image.GetNumTracks( );
+	m_NumSides   = image.GetNumHeads( );
+	m_NumSectors = uniform ? trackSectors : 0;
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+//
+// Memory mapped access.  Only the geometry is read when the file is opened,
+// each track is built from the mapping the first time it is used, and only
+// sectors that have been changed are copied back when the disk is saved.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskSerializerV9T9::SupportsMapping( ) const
+{
+	return true;
+}
+
+bool cDiskSerializerV9T9::ReadMapping( cDiskImage *image )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerV9T9::ReadMapping", true );
+
+	if( m_MappedFile->GetSize( ) < DEFAULT_SECTOR_SIZE )
+	{
+		return false;
+	}
+
+	GetGeometry( m_MappedFile->GetData( ), m_MappedFile->GetSize( ), &m_NumTracks, &m_NumSides, &m_NumSectors, &m_Format );
+
+	if(( m_NumTracks == 0 ) || ( m_NumSectors > MAX_SECTORS ))
+	{
+		return false;
+	}
+
+	image->AllocateTracks( m_NumTracks, m_NumSides );
+	image->SetLoadOnDemand( this );
+
+	DBG_EVENT( "Disk mapped" );
+
+	return true;
+}
+
+bool cDiskSerializerV9T9::LoadTrack( size_t cylinder, size_t head, iDiskTrack *track )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerV9T9::LoadTrack", true );
+
+	if( m_MappedFile == nullptr )
+	{
+		return false;
+	}
+
+	size_t t      = ( head == 0 ) ? cylinder : m_NumTracks - ( cylinder + 1 );
+	size_t offset = ( head * m_NumTracks + t ) * m_NumSectors * DEFAULT_SECTOR_SIZE;
+
+	if( offset + m_NumSectors * DEFAULT_SECTOR_SIZE > m_MappedFile->GetSize( ))
+	{
+		return false;
+	}
+
+	track->Write( m_Format, cDiskImage::FormatTrack( m_Format, cylinder, head, m_NumSectors, 1 ));
+
+	const UINT8 *data = m_MappedFile->GetData( ) + offset;
+
+	for( size_t s = 0; s < m_NumSectors; s++, data += DEFAULT_SECTOR_SIZE )
+	{
+		track->GetSector( cylinder, head, s )->Write( { data, data + DEFAULT_SECTOR_SIZE } );
+	}
+
+	return true;
+}
+
+bool cDiskSerializerV9T9::GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializerV9T9::GetChangedRegions", true );
+
+	if(( m_NumSectors == 0 ) || ( snapshot.GetNumTracks( ) != m_NumTracks ) || ( snapshot.GetNumHeads( ) != m_NumSides ))
+	{
+		return false;
+	}
+
+	for( size_t h = 0; h < m_NumSides; h++ )
+	{
+		for( size_t t = 0; t < m_NumTracks; t++ )
+		{
+			size_t c = ( h == 0 ) ? t : m_NumTracks - ( t + 1 );
+
+			const iDiskTrack *track = snapshot.GetTrack( c, h );
+			if( track == nullptr )
+			{
+				continue;
+			}
+
+			size_t offset = ( h * m_NumTracks + t ) * m_NumSectors * DEFAULT_SECTOR_SIZE;
+
+			// A reformatted track is written in full, otherwise just the sectors that were modified
+			std::vector<const iDiskSector *> sectors;
+
+			if( track->HasLayoutChanged( ))
+			{
+				for( size_t s = 0; s < m_NumSectors; s++ )
+				{
+					sectors.push_back( track->GetSector( -1, -1, s ));
+				}
+			}
+			else
+			{
+				for( auto sector : track->GetChangedSectors( ))
+				{
+					sectors.push_back( sector );
+				}
+			}
+
+			// Anything other than a standard layout needs a full rewrite of the file
+			for( auto sector : sectors )
+			{
+				if(( sector == nullptr ) || ( sector->GetData( ) == nullptr ) || ( sector->Size( ) != DEFAULT_SECTOR_SIZE ))
+				{
+					return false;
+				}
+
+				size_t s = static_cast<size_t>( sector->LogicalSector( ));
+				if( s >= m_NumSectors )
+				{
+					return false;
+				}
+
+				regions->push_back( { offset + s * DEFAULT_SECTOR_SIZE, { sector->GetData( ), sector->GetData( ) + DEFAULT_SECTOR_SIZE } } );
 			}
 		}
 	}
@@ -26,16 +26,126 @@
 //
 //----------------------------------------------------------------------------
 
+#include <cstring>
+#include <filesystem>
 #include "common.hpp"
 #include "logger.hpp"
 #include "support.hpp"
 #include "disk-media.hpp"
 #include "disk-serializer.hpp"
 
+#if defined( OS_WINDOWS )
+	#include <io.h>
+#elif defined( OS_LINUX ) || defined( OS_MACOSX ) || defined( OS_AMIGAOS )
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
 DBG_REGISTER( __FILE__ );
 
+//----------------------------------------------------------------------------
+//
+// Journal file layout (all values little endian):
+//
+//   "TI99JRNL"  UINT32 count
+//   count x { UINT64 offset, UINT32 size, UINT8 data[ size ] }
+//   UINT32 checksum  "TI99DONE"
+//
+// The journal is flushed to disk before the image is touched, so a crash
+// while the image is being updated leaves either a complete journal that is
+// replayed the next time the image is loaded (or before the next update
+// replaces it) or a partial one that is ignored.
+//
+//----------------------------------------------------------------------------
+
+static const char JOURNAL_HEADER[ ]  = "TI99JRNL";
+static const char JOURNAL_TRAILER[ ] = "TI99DONE";
+
+static UINT32 Checksum( const UINT8 *data, size_t size )
+{
+	UINT32 hash = 2166136261u;
+
+	for( size_t i = 0; i < size; i++ )
+	{
+		hash = ( hash ^ data[ i ] ) * 16777619u;
+	}
+
+	return hash;
+}
+
+static void PutValue( sDataBuffer &buffer, UINT64 value, size_t size )
+{
+	for( size_t i = 0; i < size; i++ )
+	{
+		buffer.push_back( static_cast<UINT8>( value >> ( 8 * i )));
+	}
+}
+
+static UINT64 GetValue( const UINT8 *ptr, size_t size )
+{
+	UINT64 value = 0;
+
+	for( size_t i = 0; i < size; i++ )
+	{
+		value |= static_cast<UINT64>( ptr[ i ] ) << ( 8 * i );
+	}
+
+	return value;
+}
+
+// Make sure everything written so far has reached the disk
+static bool SyncFile( FILE *file )
+{
+	if( fflush( file ) != 0 )
+	{
+		return false;
+	}
+
+#if defined( OS_WINDOWS )
+	return _commit( _fileno( file )) == 0;
+#elif defined( OS_LINUX ) || defined( OS_MACOSX ) || defined( OS_AMIGAOS )
+	return fsync( fileno( file )) == 0;
+#else
+	return true;
+#endif
+}
+
+// Make sure files created, renamed or removed in the directory holding 'name' stay that way
+// (the file's own data is synced separately). Windows and AmigaOS can't sync a directory.
+static bool SyncDirectory( const std::string &name )
+{
+#if defined( OS_WINDOWS ) || defined( OS_AMIGAOS )
+	return true;
+#elif defined( OS_LINUX ) || defined( OS_MACOSX )
+	std::filesystem::path directory = std::filesystem::path( name ).parent_path( );
+
+	if( directory.empty( ))
+	{
+		directory = ".";
+	}
+
+	int fd = open( directory.c_str( ), O_RDONLY );
+	if( fd < 0 )
+	{
+		return false;
+	}
+
+	bool status = fsync( fd ) == 0;
+
+	close( fd );
+
+	return status;
+#else
+	return true;
+#endif
+}
+
 cDiskSerializer::cDiskSerializer( ) :
-	m_DemandLoadFile( nullptr )
+	m_DemandLoadFile( nullptr ),
+	m_MappedFile( ),
+	m_FileName( ),
+	m_ValidName( ),
+	m_Streaming( false )
 {
 }
 
@@ -81,8 +191,32 @@ bool cDiskSerializer::LoadFile( const char *filename, cDiskImage *image )
 
 	std::string validName = LocateFile( "disks", RawFileName( filename ));
 
+	m_FileName.clear( );
+	m_ValidName.clear( );
+
 	if( ! validName.empty( ))
 	{
+		// Finish any update that was interrupted the last time this image was saved
+		ReplayJournal( validName );
+
+		// Tracks are synthesized from the mapping as they are used, so opening a large image is cheap
+		if( SupportsMapping( ))
+		{
+			m_MappedFile = std::make_unique<cMappedFile>( );
+
+			if( m_MappedFile->Open( validName ) && ReadMapping( image ))
+			{
+				image->ClearChanged( );
+
+				m_FileName  = filename;
+				m_ValidName = validName;
+
+				return true;
+			}
+
+			m_MappedFile.reset( );
+		}
+
 		if( FILE *file = OpenForRead( validName ))
 		{
 			bool status = ReadFile( file, image );
@@ -94,6 +228,12 @@ bool cDiskSerializer::LoadFile( const char *filename, cDiskImage *image )
 				fclose( file );
 			}
 
+			if( status )
+			{
+				m_FileName  = filename;
+				m_ValidName = validName;
+			}
+
 			return status;
 		}
 	}
@@ -105,27 +245,87 @@ bool cDiskSerializer::SaveFile( const cDiskImage &image, const char *filename )
 {
 	FUNCTION_ENTRY( this, "cDiskSerializer::SaveFile", true );
 
-	std::string validName = LocateFile( "disks", RawFileName( filename ));
+	// If we're saving back to the file we loaded, only the parts that changed need to be written
+	std::string validName = GetUpdateName( filename );
+	std::vector<sDiskRegion> regions;
+
+	if( ! validName.empty( ) && GetChangedRegions( image.GetSnapshot( ), &regions ) && UpdateFile( validName, regions ))
+	{
+		return true;
+	}
+
+	m_FileName.clear( );
+	m_ValidName.clear( );
+
+	validName = LocateFile( "disks", RawFileName( filename ));
 
 	if( validName.empty( ))
 	{
 		validName = RawFileName( filename );
 	}
 
+	// Note: this pulls in any tracks still in the mapping and then releases it
 	image.CompleteLoad( );
 
-	if( FILE *file = OpenForWrite( validName ))
+	// The old file may still be mapped (by us or by the serializer a conversion is reading
+	// from), so never truncate it - write a new file and rename it over the old one instead
+	std::error_code error;
+
+	bool replace = ReplacesFile( ) && std::filesystem::exists( validName, error );
+
+	std::string writeName = replace ? validName + ".new" : validName;
+
+	if( FILE *file = OpenForWrite( writeName ))
 	{
 		bool status = WriteFile( image, file );
 
 		fclose( file );
 
+		if( replace )
+		{
+			if( status )
+			{
+				std::filesystem::permissions( writeName, std::filesystem::status( validName, error ).permissions( ), error );
+				std::filesystem::rename( writeName, validName, error );
+
+				status = ! error;
+
+				if( status && ( SyncDirectory( validName ) == false ))
+				{
+					DBG_WARNING( "Unable to sync the directory of '" << validName << '\'' );
+				}
+			}
+
+			if( status == false )
+			{
+				DBG_ERROR( "Unable to replace '" << validName << "'" );
+				remove( writeName.c_str( ));
+			}
+		}
+
+		if( status )
+		{
+			// Any journal left by a failed in place update is now out of date
+			RemoveJournal( validName );
+
+			m_FileName  = filename;
+			m_ValidName = validName;
+		}
+
 		return status;
 	}
 
 	return false;
 }
 
+// The host file was found when the image was loaded - there's no need to search for it again
+std::string cDiskSerializer::GetUpdateName( const char *filename ) const
+{
+	FUNCTION_ENTRY( this, "cDiskSerializer::GetUpdateName", true );
+
+	return ( m_FileName == filename ) ? m_ValidName : std::string( );
+}
+
 bool cDiskSerializer::LoadTrack( size_t cylinder, size_t head, iDiskTrack *track )
 {
 	return false;
@@ -152,4 +352,314 @@ void cDiskSerializer::LoadComplete( )
 		fclose( m_DemandLoadFile );
 		m_DemandLoadFile = nullptr;
 	}
+
+	m_MappedFile.reset( );
+}
+
+bool cDiskSerializer::SupportsParallelLoad( ) const
+{
+	return false;
+}
+
+void cDiskSerializer::SetStreaming( bool streaming )
+{
+	m_Streaming = streaming;
+}
+
+bool cDiskSerializer::ReplacesFile( ) const
+{
+	return true;
+}
+
+bool cDiskSerializer::SupportsMapping( ) const
+{
+	return false;
+}
+
+bool cDiskSerializer::ReadMapping( cDiskImage *image )
+{
+	return false;
+}
+
+// Only formats with a fixed layout can update the changed parts of the file in place
+bool cDiskSerializer::GetChangedRegions( const cDiskSnapshot &snapshot, std::vector<sDiskRegion> *regions )
+{
+	return false;
+}
+
+//----------------------------------------------------------------------------
+//
+// Write the given regions to the image.  The regions are written to a journal
+// first so that an interrupted update can be completed the next time the
+// image is loaded.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskSerializer::UpdateFile( const std::string &name, const std::vector<sDiskRegion> &regions )
+{
+	FUNCTION_ENTRY( this, "cDiskSerializer::UpdateFile", true );
+
+	if( regions.empty( ))
+	{
+		return true;
+	}
+
+	if(( m_MappedFile == nullptr ) || ( m_MappedFile->IsWritable( ) == false ) || ( m_MappedFile->GetName( ) != name ))
+	{
+		return CommitRegions( name, regions );
+	}
+
+	if( WriteJournal( name, regions ) == false )
+	{
+		DBG_WARNING( "Unable to write journal for '" << name << '\'' );
+		return false;
+	}
+
+	for( auto &region : regions )
+	{
+		if( region.offset + region.data.size( ) > m_MappedFile->GetSize( ))
+		{
+			DBG_ERROR( "Error writing to file" );
+			return false;
+		}
+
+		memcpy( m_MappedFile->GetData( ) + region.offset, region.data.data( ), region.data.size( ));
+
+		if( m_MappedFile->Flush( region.offset, region.data.size( )) == false )
+		{
+			// Leave the journal so the update is completed when the image is next loaded
+			DBG_ERROR( "Error writing to file" );
+			return false;
+		}
+	}
+
+	RemoveJournal( name );
+
+	DBG_EVENT( "Updated " << regions.size( ) << " regions in '" << name << '\'' );
+
+	return true;
+}
+
+bool cDiskSerializer::CommitRegions( const std::string &name, const std::vector<sDiskRegion> &regions )
+{
+	FUNCTION_ENTRY( nullptr, "cDiskSerializer::CommitRegions", true );
+
+	if( regions.empty( ))
+	{
+		return true;
+	}
+
+	if( WriteJournal( name, regions ) == false )
+	{
+		DBG_WARNING( "Unable to write journal for '" << name << '\'' );
+		return false;
+	}
+
+	if( WriteRegions( name, regions ) == false )
+	{
+		// Leave the journal so the update is completed when the image is next loaded
+		DBG_ERROR( "Error writing to file" );
+		return false;
+	}
+
+	RemoveJournal( name );
+
+	DBG_EVENT( "Updated " << regions.size( ) << " regions in '" << name << '\'' );
+
+	return true;
+}
+
+std::string cDiskSerializer::JournalName( const std::string &name )
+{
+	return name + ".journal";
+}
+
+// Once the image has been updated the journal has to go for good, or it would be replayed over later updates
+void cDiskSerializer::RemoveJournal( const std::string &name )
+{
+	FUNCTION_ENTRY( nullptr, "cDiskSerializer::RemoveJournal", true );
+
+	std::string journalName = JournalName( name );
+
+	if(( remove( journalName.c_str( )) == 0 ) && ( SyncDirectory( journalName ) == false ))
+	{
+		DBG_WARNING( "Unable to sync the directory of '" << journalName << '\'' );
+	}
+}
+
+// Write the journal for an update of the image 'name'
+bool cDiskSerializer::WriteJournal( const std::string &name, const std::vector<sDiskRegion> &regions )
+{
+	FUNCTION_ENTRY( nullptr, "cDiskSerializer::WriteJournal", true );
+
+	// A journal left by an earlier update that failed has to be applied before it's replaced
+	if( ReplayJournal( name ) == false )
+	{
+		DBG_ERROR( "Outstanding journal for '" << name << "' could not be replayed" );
+		return false;
+	}
+
+	std::string journalName = JournalName( name );
+
+	sDataBuffer buffer( JOURNAL_HEADER, JOURNAL_HEADER + 8 );
+
+	PutValue( buffer, regions.size( ), 4 );
+
+	for( auto &region : regions )
+	{
+		PutValue( buffer, region.offset, 8 );
+		PutValue( buffer, region.data.size( ), 4 );
+		buffer.insert( buffer.end( ), region.data.begin( ), region.data.end( ));
+	}
+
+	PutValue( buffer, Checksum( buffer.data( ), buffer.size( )), 4 );
+	buffer.insert( buffer.end( ), JOURNAL_TRAILER, JOURNAL_TRAILER + 8 );
+
+	FILE *file = fopen( journalName.c_str( ), "wb" );
+	if( file == nullptr )
+	{
+		return false;
+	}
+
+	bool status = ( fwrite( buffer.data( ), buffer.size( ), 1, file ) == 1 ) && SyncFile( file );
+
+	fclose( file );
+
+	// The journal is no use after a crash unless its directory entry made it to the disk too
+	status = status && SyncDirectory( journalName );
+
+	if( status == false )
+	{
+		remove( journalName.c_str( ));
+	}
+
+	return status;
+}
+
+// Apply any journal left for the image 'name' - returns false if one is still outstanding
+bool cDiskSerializer::ReplayJournal( const std::string &name )
+{
+	FUNCTION_ENTRY( nullptr, "cDiskSerializer::ReplayJournal", true );
+
+	std::string journalName = JournalName( name );
+
+	std::error_code error;
+	auto status = std::filesystem::status( journalName, error );
+
+	if( std::filesystem::exists( status ) == false )
+	{
+		return true;
+	}
+
+	if( std::filesystem::is_regular_file( status ) == false )
+	{
+		DBG_ERROR( "Journal '" << journalName << "' is not a file" );
+		return false;
+	}
+
+	FILE *file = fopen( journalName.c_str( ), "rb" );
+	if( file == nullptr )
+	{
+		return false;
+	}
+
+	fseek( file, 0, SEEK_END );
+	long size = ftell( file );
+	fseek( file, 0, SEEK_SET );
+
+	sDataBuffer buffer(( size > 0 ) ? static_cast<size_t>( size ) : 0 );
+
+	bool valid = ( size >= 24 ) && ( fread( buffer.data( ), buffer.size( ), 1, file ) == 1 );
+
+	fclose( file );
+
+	std::vector<sDiskRegion> regions;
+
+	// Only a journal that was completely written can be trusted
+	if( valid )
+	{
+		const UINT8 *end = buffer.data( ) + buffer.size( ) - 12;
+
+		valid = ( memcmp( buffer.data( ), JOURNAL_HEADER, 8 ) == 0 ) &&
+		        ( memcmp( end + 4, JOURNAL_TRAILER, 8 ) == 0 ) &&
+		        ( GetValue( end, 4 ) == Checksum( buffer.data( ), end - buffer.data( )));
+
+		const UINT8 *ptr = buffer.data( ) + 12;
+
+		for( size_t count = GetValue( buffer.data( ) + 8, 4 ); valid && ( count > 0 ); count-- )
+		{
+			if( end - ptr < 12 )
+			{
+				valid = false;
+				break;
+			}
+
+			size_t offset = GetValue( ptr, 8 );
+			size_t length = GetValue( ptr + 8, 4 );
+
+			ptr += 12;
+
+			if( static_cast<size_t>( end - ptr ) < length )
+			{
+				valid = false;
+				break;
+			}
+
+			regions.push_back( { offset, { ptr, ptr + length } } );
+
+			ptr += length;
+		}
+	}
+
+	if( valid == false )
+	{
+		// The image itself wasn't touched, so an incomplete journal can simply be discarded
+		DBG_WARNING( "Discarding incomplete journal '" << journalName << '\'' );
+		RemoveJournal( name );
+		return true;
+	}
+
+	if( WriteRegions( name, regions ) == false )
+	{
+		DBG_ERROR( "Unable to replay journal '" << journalName << '\'' );
+		return false;
+	}
+
+	RemoveJournal( name );
+
+	DBG_WARNING( "Completed interrupted update of '" << name << '\'' );
+
+	return true;
+}
+
+bool cDiskSerializer::WriteRegions( const std::string &name, const std::vector<sDiskRegion> &regions )
+{
+	FUNCTION_ENTRY( nullptr, "cDiskSerializer::WriteRegions", true );
+
+	FILE *file = fopen( name.c_str( ), "r+b" );
+	if( file == nullptr )
+	{
+		return false;
+	}
+
+	bool status = true;
+
+	for( auto &region : regions )
+	{
+		if(( fseek( file, static_cast<long>( region.offset ), SEEK_SET ) != 0 ) ||
+		   ( fwrite( region.data.data( ), region.data.size( ), 1, file ) != 1 ))
+		{
+			status = false;
+			break;
+		}
+	}
+
+	if( status )
+	{
+		status = SyncFile( file );
+	}
+
+	fclose( file );
+
+	return status;
 }
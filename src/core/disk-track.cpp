@@ -26,6 +26,8 @@
 //
 //----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <utility>
 #include "common.hpp"
 #include "logger.hpp"
 #include "disk-track.hpp"
@@ -33,9 +35,8 @@
 
 DBG_REGISTER( __FILE__ );
 
-extern UINT16 crctable[ 256 ];
-
-UINT16 crctable[ 256 ];					// TODO
+// Slicing-by-8 tables: crctable[ n ][ x ] is the CRC of byte x followed by n 0 bytes
+static UINT16 crctable[ 8 ][ 256 ];
 
 static UINT16 GenerateCRC( UINT16 data, UINT16 generator )
 {
@@ -61,7 +62,16 @@ static bool Generate( UINT16 generator )
 {
 	for( int i = 0; i < 256; i++ )
 	{
-		crctable[ i ] = GenerateCRC(( UINT16 ) i << 8, generator );
+		crctable[ 0 ][ i ] = GenerateCRC(( UINT16 ) i << 8, generator );
+	}
+
+	for( int n = 1; n < 8; n++ )
+	{
+		for( int i = 0; i < 256; i++ )
+		{
+			UINT16 crc = crctable[ n - 1 ][ i ];
+			crctable[ n ][ i ] = ( crc << 8 ) ^ crctable[ 0 ][ crc >> 8 ];
+		}
 	}
 
 	return true;
@@ -69,17 +79,122 @@ static bool Generate( UINT16 generator )
 
 static bool init = Generate( 0x1021 );
 
+// CRC-CCITT of 'size' bytes starting with 'crc' - 8 bytes per step
+static UINT16 UpdateCRC( UINT16 crc, const UINT8 *ptr, size_t size )
+{
+	while( size >= 8 )
+	{
+		crc = crctable[ 7 ][ ptr[ 0 ] ^ ( crc >> 8 )] ^
+			  crctable[ 6 ][ ptr[ 1 ] ^ ( crc & 0xFF )] ^
+			  crctable[ 5 ][ ptr[ 2 ]] ^
+			  crctable[ 4 ][ ptr[ 3 ]] ^
+			  crctable[ 3 ][ ptr[ 4 ]] ^
+			  crctable[ 2 ][ ptr[ 5 ]] ^
+			  crctable[ 1 ][ ptr[ 6 ]] ^
+			  crctable[ 0 ][ ptr[ 7 ]];
+
+		ptr  += 8;
+		size -= 8;
+	}
+
+	while( size-- > 0 )
+	{
+		crc = ( crc << 8 ) ^ crctable[ 0 ][ (( crc >> 8 ) ^ *ptr++ ) & 0xFF ];
+	}
+
+	return crc;
+}
+
+#define NO_SECTOR	0xFF
+
 //----------------------------------------------------------------------------
 // cDiskTrack
 //----------------------------------------------------------------------------
 
 cDiskTrack::cDiskTrack( ) :
 	Dirty( true ),
+	LayoutChanged( true ),
+	ChangedSectors( 0 ),
 	Format( track::Format::Unknown ),
 	Clock( ),
 	Data( ),
-	Sector( )
+	Sector( ),
+	SectorMap( ),
+	Generation( 1 )
+{
+	SectorMap.fill( NO_SECTOR );
+}
+
+// Copies get their own sectors, pointing into the copy's data
+cDiskTrack::cDiskTrack( const cDiskTrack &other ) :
+	iDiskTrack( other ),
+	Dirty( other.Dirty ),
+	LayoutChanged( other.LayoutChanged ),
+	ChangedSectors( other.ChangedSectors ),
+	Format( other.Format ),
+	Clock( other.Clock ),
+	Data( other.Data ),
+	Sector( other.Sector ),
+	SectorMap( other.SectorMap ),
+	Generation( other.Generation )
+{
+	AdoptSectors( other.Data.data( ));
+}
+
+// The data doesn't move, but the sectors have to refer to their new track
+cDiskTrack::cDiskTrack( cDiskTrack &&other ) noexcept :
+	iDiskTrack( other ),
+	Dirty( other.Dirty ),
+	LayoutChanged( other.LayoutChanged ),
+	ChangedSectors( other.ChangedSectors ),
+	Format( other.Format ),
+	Clock( std::move( other.Clock )),
+	Data( std::move( other.Data )),
+	Sector( std::move( other.Sector )),
+	SectorMap( other.SectorMap ),
+	Generation( other.Generation )
+{
+	AdoptSectors( Data.data( ));
+}
+
+cDiskTrack &cDiskTrack::operator =( const cDiskTrack &other )
+{
+	if( this != &other )
+	{
+		Dirty          = other.Dirty;
+		LayoutChanged  = other.LayoutChanged;
+		ChangedSectors = other.ChangedSectors;
+		Format         = other.Format;
+		Clock          = other.Clock;
+		Data           = other.Data;
+		Sector         = other.Sector;
+		SectorMap      = other.SectorMap;
+		Generation     = std::max( Generation, other.Generation ) + 1;
+
+		AdoptSectors( other.Data.data( ));
+	}
+
+	return *this;
+}
+
+cDiskTrack &cDiskTrack::operator =( cDiskTrack &&other ) noexcept
 {
+	if( this != &other )
+	{
+		Dirty          = other.Dirty;
+		LayoutChanged  = other.LayoutChanged;
+		ChangedSectors = other.ChangedSectors;
+		Format         = other.Format;
+		Clock          = std::move( other.Clock );
+		Data           = std::move( other.Data );
+		Sector         = std::move( other.Sector );
+		SectorMap      = other.SectorMap;
+		Generation     = std::max( Generation, other.Generation ) + 1;
+
+		AdoptSectors( Data.data( ));
+	}
+
+	return *this;
 }
 
 bool cDiskTrack::HasChanged( ) const
@@ -89,7 +204,36 @@ bool cDiskTrack::HasChanged( ) const
 
 void cDiskTrack::ClearChanged( )
 {
-	Dirty = false;
+	Dirty          = false;
+	LayoutChanged  = false;
+	ChangedSectors = 0;
+}
+
+// Treat the whole track as changed (used when an update that included it was lost)
+void cDiskTrack::MarkChanged( )
+{
+	Dirty         = true;
+	LayoutChanged = true;
+}
+
+bool cDiskTrack::HasLayoutChanged( ) const
+{
+	return LayoutChanged;
+}
+
+std::vector<iDiskSector*> cDiskTrack::GetChangedSectors( ) const
+{
+	std::vector<iDiskSector*> sectors;
+
+	for( size_t i = 0; i < Sector.size( ); i++ )
+	{
+		if( ChangedSectors & ( UINT64( 1 ) << i ))
+		{
+			sectors.push_back( const_cast<cDiskSector*>( &Sector[ i ] ));
+		}
+	}
+
+	return sectors;
 }
 
 track::Format cDiskTrack::GetFormat( ) const
@@ -113,12 +257,19 @@ bool cDiskTrack::Write( track::Format newFormat, std::vector<UINT8> newData )
 	Sector.clear( );
 	Data.reserve( newData.size( ) + 36 * 2 );
 
+	// The CRC is computed over Data[ crcStart... ] when it is needed
 	UINT16 crc = 0;
+	size_t crcStart = 0;
 
 	auto writeByte = [&]( UINT8 byte )
 	{
 		Data.push_back( byte );
-		crc = ( crc << 8 ) ^ crctable[ (( crc >> 8 ) ^ byte ) & 0xFF ];
+	};
+
+	auto resetCRC = [&]( UINT16 value )
+	{
+		crc = value;
+		crcStart = Data.size( );
 	};
 
 	for( size_t i = 0; i < newData.size( ); i++ )
@@ -129,6 +280,8 @@ bool cDiskTrack::Write( track::Format newFormat, std::vector<UINT8> newData )
 		{
 			if( byte == 0xF7 )
 			{
+				resetCRC( UpdateCRC( crc, Data.data( ) + crcStart, Data.size( ) - crcStart ));
+
 				int crcHi = ( crc >> 8 ) & 0xFF;
 				int crcLo = crc & 0xFF;
 				writeByte( crcHi );
@@ -149,7 +302,7 @@ bool cDiskTrack::Write( track::Format newFormat, std::vector<UINT8> newData )
 					case 0xFA :
 					case 0xFB :
 					case 0xFE :
-						crc = 0xFFFF;
+						resetCRC( 0xFFFF );
 						// Fall through
 					case 0xFC :
 						Clock.push_back( Data.size( ));
@@ -169,7 +322,7 @@ bool cDiskTrack::Write( track::Format newFormat, std::vector<UINT8> newData )
 					case 0xF5 :
 						Clock.push_back( Data.size( ));
 						writeByte( 0xA1 );
-						crc = 0xCDB4;
+						resetCRC( 0xCDB4 );
 						continue;
 					case 0xF6 :
 						Clock.push_back( Data.size( ));
@@ -186,7 +339,8 @@ bool cDiskTrack::Write( track::Format newFormat, std::vector<UINT8> newData )
 
 	LocateSectors( );
 
-	Dirty = true;
+	Dirty         = true;
+	LayoutChanged = true;
 
 	return true;
 }
@@ -197,12 +351,13 @@ bool cDiskTrack::RawWrite( track::Format newFormat, std::vector<size_t> newClock
 
 	Format = newFormat;
 
-	Clock = newClock;
-	Data  = newData;
+	Clock = std::move( newClock );
+	Data  = std::move( newData );
 
 	LocateSectors( );
 
-	Dirty = true;
+	Dirty         = true;
+	LayoutChanged = true;
 
 	return true;
 }
@@ -215,11 +370,28 @@ void cDiskTrack::Erase( )
 		Clock.clear( );
 		Data.clear( );
 		Sector.clear( );
+		SectorMap.fill( NO_SECTOR );
 
-		Dirty = true;
+		Generation++;
+
+		Dirty         = true;
+		LayoutChanged = true;
 	}
 }
 
+// Free the track's memory without marking it as changed - it is loaded again the next time it's used
+void cDiskTrack::Release( )
+{
+	Format = track::Format::Unknown;
+
+	std::vector<size_t>( ).swap( Clock );
+	sDataBuffer( ).swap( Data );
+	std::vector<cDiskSector>( ).swap( Sector );
+	SectorMap.fill( NO_SECTOR );
+
+	Generation++;
+}
+
 bool cDiskTrack::IsEmpty( ) const
 {
 	return Data.empty( );
@@ -230,20 +402,11 @@ bool cDiskTrack::VerifyID( const UINT8 *id ) const
 	FUNCTION_ENTRY( this, "cDiskTrack::VerifyID", true );
 
 	UINT16 crc = ( Format == track::Format::FM ) ? 0xFFFF : 0xCDB4;
-	const UINT8 *ptr = id;
 
-	auto readByte = [&]( )
-	{
-		UINT8 byte = *ptr++;
-		crc = ( crc << 8 ) ^ crctable[ (( crc >> 8 ) ^ byte ) & 0xFF ];
-		return byte;
-	};
+	// Address mark + 4 ID bytes
+	crc = UpdateCRC( crc, id, 1 + 4 );
 
-	readByte( );
-	for( int i = 4; i > 0; i-- )
-	{
-		readByte( );
-	}
+	const UINT8 *ptr = id + 1 + 4;
 
 	return crc == (( ptr[ 0 ] << 8 ) | ptr[ 1 ] );
 }
@@ -253,20 +416,11 @@ bool cDiskTrack::VerifyData( const UINT8 *data, size_t size ) const
 	FUNCTION_ENTRY( this, "cDiskTrack::VerifyData", true );
 
 	UINT16 crc = ( Format == track::Format::FM ) ? 0xFFFF : 0xCDB4;
-	const UINT8 *ptr = data;
 
-	auto readByte = [&]( )
-	{
-		UINT8 byte = *ptr++;
-		crc = ( crc << 8 ) ^ crctable[ (( crc >> 8 ) ^ byte ) & 0xFF ];
-		return byte;
-	};
+	// Address mark + data
+	crc = UpdateCRC( crc, data, 1 + size );
 
-	readByte( );
-	for( size_t i = 0; i < size; i++ )
-	{
-		readByte( );
-	}
+	const UINT8 *ptr = data + 1 + size;
 
 	return crc == (( ptr[ 0 ] << 8 ) | ptr[ 1 ] );
 }
@@ -277,27 +431,62 @@ void cDiskTrack::DataModified( const UINT8 *data, size_t size )
 
 	Dirty = true;
 
+	// Remember which sector was touched so it can be written back on its own
+	auto it = std::find_if( Sector.begin( ), Sector.end( ), [&]( const cDiskSector &sector ) { return sector.GetData( ) == data + 1; } );
+
+	size_t index = static_cast<size_t>( it - Sector.begin( ));
+
+	if(( it == Sector.end( )) || ( index >= 64 ))
+	{
+		// ID fields and anything we can't identify mean the whole track must be rewritten
+		LayoutChanged = true;
+	}
+	else
+	{
+		ChangedSectors |= UINT64( 1 ) << index;
+	}
+
 	UINT16 crc = ( Format == track::Format::FM ) ? 0xFFFF : 0xCDB4;
-	const UINT8 *ptr = data;
 
-	auto readByte = [&]( )
+	// Address mark + data
+	crc = UpdateCRC( crc, data, 1 + size );
+
+	UINT8 *updatePtr = const_cast<UINT8 *>( data + 1 + size );
+
+	*updatePtr++ = ( crc >> 8 );
+	*updatePtr++ = crc & 0xFF;
+}
+
+// Sectors that came from another track are re-pointed from its data (at base) to ours
+void cDiskTrack::AdoptSectors( const UINT8 *base )
+{
+	UINT8 *data = Data.data( );
+
+	for( auto &sector : Sector )
 	{
-		UINT8 byte = *ptr++;
-		crc = ( crc << 8 ) ^ crctable[ (( crc >> 8 ) ^ byte ) & 0xFF ];
-		return byte;
-	};
+		UINT8 *id   = data + ( sector.GetID( ) - 1 - base );
+		UINT8 *mark = data + ( sector.GetData( ) - 1 - base );
 
-	readByte( );
+		sector = cDiskSector( this, id, mark );
+	}
+}
 
-	for( size_t i = 0; i < size; i++ )
+// The sector bitmaps only line up while neither copy has been reformatted
+void cDiskTrack::MergeChanges( const cDiskTrack &earlier )
+{
+	if( earlier.Dirty == false )
 	{
-		readByte( );
+		return;
 	}
 
-	UINT8 *updatePtr = const_cast<UINT8 *>( ptr );
+	Dirty = true;
 
-	*updatePtr++ = ( crc >> 8 );
-	*updatePtr++ = crc & 0xFF;
+	if( earlier.LayoutChanged || ( earlier.Sector.size( ) != Sector.size( )))
+	{
+		LayoutChanged = true;
+	}
+
+	ChangedSectors |= earlier.ChangedSectors;
 }
 
 void cDiskTrack::LocateSectors( )
@@ -323,6 +512,9 @@ void cDiskTrack::LocateSectors( )
 	UINT8 *lastID = nullptr;
 
 	Sector.clear( );
+	SectorMap.fill( NO_SECTOR );
+
+	Generation++;
 
 	for( size_t i = 0; i < Clock.size( ); i++ )
 	{
@@ -336,6 +528,11 @@ void cDiskTrack::LocateSectors( )
 			case 0xFB :
 				if(( mark - lastID ) < (( Format == track::Format::FM ) ? 33 : 45 )) // TODO - ??? 30 : 43 ))
 				{
+					UINT8 &index = SectorMap[ lastID[ 3 ]];
+					if(( index == NO_SECTOR ) && ( Sector.size( ) < NO_SECTOR ))
+					{
+						index = static_cast<UINT8>( Sector.size( ));
+					}
 					Sector.push_back( { this, lastID, mark } );
 				}
 				break;
@@ -353,6 +550,17 @@ std::vector<size_t> cDiskTrack::GetClockLocations( ) const
 	return Clock;
 }
 
+size_t cDiskTrack::GetSize( ) const
+{
+	return Data.size( );
+}
+
+size_t cDiskTrack::GetOffset( const iDiskSector *sector ) const
+{
+	// Sector IDs point into Data just past the ID address mark
+	return static_cast<size_t>( sector->GetID( ) - 1 - Data.data( ));
+}
+
 std::vector<iDiskSector*> cDiskTrack::GetSectors( ) const
 {
 	std::vector<iDiskSector*> sectors;
@@ -369,21 +577,39 @@ iDiskSector *cDiskTrack::GetSector( int logicalCylinder, int logicalHead, int lo
 {
 	FUNCTION_ENTRY( this, "cDiskTrack::GetSector", true );
 
-	for( auto &sector : Sector )
-	{
-		if( sector.Matches( logicalCylinder, logicalHead, logicalSector ))
-		{
-			return &sector;
-		}
-	}
-
-	return nullptr;
+	return const_cast<cDiskSector *>( FindSector( logicalCylinder, logicalHead, logicalSector ));
 }
 
 const iDiskSector *cDiskTrack::GetSector( int logicalCylinder, int logicalHead, int logicalSector ) const
 {
 	FUNCTION_ENTRY( this, "cDiskTrack::GetSector", true );
 
+	return FindSector( logicalCylinder, logicalHead, logicalSector );
+}
+
+const cDiskSector *cDiskTrack::FindSector( int logicalCylinder, int logicalHead, int logicalSector ) const
+{
+	FUNCTION_ENTRY( this, "cDiskTrack::FindSector", true );
+
+	if(( logicalSector >= 0 ) && ( logicalSector < 256 ))
+	{
+		size_t index = SectorMap[ logicalSector ];
+
+		if( index == NO_SECTOR )
+		{
+			// Sectors past the end of the map aren't indexed
+			if( Sector.size( ) < NO_SECTOR )
+			{
+				return nullptr;
+			}
+		}
+		else if( Sector[ index ].Matches( logicalCylinder, logicalHead, logicalSector ))
+		{
+			return &Sector[ index ];
+		}
+	}
+
+	// Wildcard sector or duplicate sector numbers - fall back to a search
 	for( auto &sector : Sector )
 	{
 		if( sector.Matches( logicalCylinder, logicalHead, logicalSector ))
@@ -0,0 +1,127 @@
+//----------------------------------------------------------------------------
+//
+// File:        disk-writer.cpp
+// Date:        18-Oct-2026
+//
+// Description: Background thread that writes disk image updates
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <filesystem>
+#include "common.hpp"
+#include "logger.hpp"
+#include "disk-serializer.hpp"
+#include "disk-writer.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+cDiskWriter::cDiskWriter( ) :
+	m_Mutex( ),
+	m_Failed( ),
+	m_Writer( [ this ]( const sRequest &request ){ Commit( request ); })
+{
+	FUNCTION_ENTRY( this, "cDiskWriter ctor", true );
+}
+
+cDiskWriter::~cDiskWriter( )
+{
+	FUNCTION_ENTRY( this, "cDiskWriter dtor", true );
+
+	// Let the writer drain whatever is still queued
+	m_Writer.Stop( );
+}
+
+//----------------------------------------------------------------------------
+//
+// Queue a snapshot of the tracks that changed.  The serializer turns it into
+// regions of the file on the writer thread, so the caller never waits for the
+// host.  A snapshot for a file that already has one waiting is merged into it,
+// so a burst of sector writes becomes a single journaled update.
+//
+//----------------------------------------------------------------------------
+
+void cDiskWriter::Write( const std::string &name, iDiskSerializer *serializer, cDiskSnapshot snapshot )
+{
+	FUNCTION_ENTRY( this, "cDiskWriter::Write", true );
+
+	if( snapshot.IsEmpty( ))
+	{
+		return;
+	}
+
+	bool merged = m_Writer.Combine( [ & ]( sRequest &request )
+	{
+		return ( request.name == name ) && ( request.serializer == serializer ) && request.snapshot.Merge( std::move( snapshot ));
+	});
+
+	if( merged == false )
+	{
+		m_Writer.Queue( { name, serializer, std::move( snapshot ) } );
+	}
+}
+
+bool cDiskWriter::Barrier( )
+{
+	FUNCTION_ENTRY( this, "cDiskWriter::Barrier", true );
+
+	m_Writer.Wait( );
+
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	return m_Failed.empty( );
+}
+
+// Reports (once) whether an update to the named file has failed
+bool cDiskWriter::HasFailed( const std::string &name )
+{
+	FUNCTION_ENTRY( this, "cDiskWriter::HasFailed", true );
+
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	return m_Failed.erase( name ) != 0;
+}
+
+bool cDiskWriter::IsPending( const std::string &name )
+{
+	FUNCTION_ENTRY( this, "cDiskWriter::IsPending", true );
+
+	return m_Writer.Find( [ &name ]( const sRequest &request )
+	{
+		std::error_code error;
+		return ( request.name == name ) || std::filesystem::equivalent( request.name, name, error );
+	});
+}
+
+void cDiskWriter::Commit( const sRequest &request )
+{
+	FUNCTION_ENTRY( this, "cDiskWriter::Commit", true );
+
+	std::vector<sDiskRegion> regions;
+
+	// A failed update leaves its journal behind to be replayed when the image is next loaded (changes
+	// the format can't make in place are caught here too - the image is then saved in full)
+	if(( request.serializer->GetChangedRegions( request.snapshot, &regions ) == false ) ||
+	   ( cDiskSerializer::CommitRegions( request.name, regions ) == false ))
+	{
+		DBG_ERROR( "Unable to update '" << request.name << '\'' );
+
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		m_Failed.insert( request.name );
+	}
+}
@@ -2,47 +2,85 @@
 #include <vector>
 #include "disk-util.hpp"
 
+static UINT32 spreadTable[ 256 ];			// Bit 7-n of the index moved to bit 4*n
+
+static bool InitTables( )
+{
+	for( int i = 0; i < 256; i++ )
+	{
+		UINT32 value = 0;
+
+		for( int bit = 0; bit < 8; bit++ )
+		{
+			if( i & ( 0x80 >> bit ))
+			{
+				value |= 1 << ( bit * 4 );
+			}
+		}
+
+		spreadTable[ i ] = value;
+	}
+
+	return true;
+}
+
+static bool initialized = InitTables( );
+
 std::vector<UINT8> EncodeDataFM( const std::list<sDataFragment> &fragments, bool lsb )
 {
-	std::vector<UINT8> data;
+	// Each cell takes 2 bits in the stream (a 0 followed by the cell), so the size is known up front
+	size_t cells = 0;
+	size_t lastOffset = 0;
+
+	for( auto &fragment : fragments )
+	{
+		cells += ( fragment.bitOffsetStart - lastOffset ) + fragment.byteData.size( ) * 16;
+		lastOffset = fragment.bitOffsetEnd;
+	}
+
+	std::vector<UINT8> data( cells * 2 / 8 );
+
+	UINT8 *ptr = data.data( );
 
 	int bits = 0;
-	int accum = 0;
+	UINT64 accum = 0;
 
-	auto WriteBit = [ & ]( int bit )
+	// Append up to 32 bits - the first bit goes in the LSB
+	auto WriteBits = [ & ]( UINT32 value, int count )
 	{
-		accum >>= 2;
-		accum |= bit ? 0x80 : 0x00;
+		accum |= UINT64( value ) << bits;
 
-		bits += 2;
-		if( bits == 8 )
+		bits += count;
+		if( bits >= 32 )
 		{
-			data.push_back( accum );
-			bits = 0;
+			ptr[ 0 ] = accum;
+			ptr[ 1 ] = accum >> 8;
+			ptr[ 2 ] = accum >> 16;
+			ptr[ 3 ] = accum >> 24;
+			ptr += 4;
+
+			accum >>= 32;
+			bits -= 32;
 		}
 	};
 
+	// Clock and data cells are interleaved, MSB first
 	auto WriteByte = [ & ]( int byte, int clock )
 	{
-		int mask = 0x80;
-		for( size_t i = 0; i < 8; i++ )
-		{
-			WriteBit( clock & mask );
-			WriteBit( byte & mask );
-			mask >>= 1;
-		}
+		WriteBits(( spreadTable[ clock & 0xFF ] << 1 ) | ( spreadTable[ byte & 0xFF ] << 3 ), 32 );
 	};
 
-	size_t lastOffset = 0;
+	lastOffset = 0;
 
 	for( auto &fragment : fragments )
 	{
-		int bit = 1;
-		while( lastOffset != fragment.bitOffsetStart )
+		// Fill the gap with alternating 1/0 cells
+		size_t gap = fragment.bitOffsetStart - lastOffset;
+		while( gap > 0 )
 		{
-			WriteBit( bit );
-			bit = !bit;
-			lastOffset++;
+			int count = ( gap < 16 ) ? gap : 16;
+			WriteBits( 0x22222222 & ( UINT32 )(( UINT64( 1 ) << ( count * 2 )) - 1 ), count * 2 );
+			gap -= count;
 		}
 
 		int clock = fragment.clock;
@@ -55,5 +93,13 @@ std::vector<UINT8> EncodeDataFM( const std::list<sDataFragment> &fragments, bool
 		lastOffset = fragment.bitOffsetEnd;
 	}
 
+	// A partial byte at the end is dropped
+	while( bits >= 8 )
+	{
+		*ptr++ = accum;
+		accum >>= 8;
+		bits -= 8;
+	}
+
 	return data;
 }
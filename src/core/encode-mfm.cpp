@@ -2,50 +2,110 @@
 #include <vector>
 #include "disk-util.hpp"
 
+static UINT16 spreadTable[ 256 ];			// Bit 7-n of the index moved to bit 2*n
+static UINT16 clockTable[ 256 ];			// Clock cells for a byte that follows a 0 data bit
+
+static bool InitTables( )
+{
+	for( int i = 0; i < 256; i++ )
+	{
+		UINT16 value = 0;
+		UINT16 clock = 0;
+
+		int last = 0;
+
+		for( int bit = 0; bit < 8; bit++ )
+		{
+			int data = ( i & ( 0x80 >> bit )) ? 1 : 0;
+
+			if( data )
+			{
+				value |= 1 << ( bit * 2 );
+			}
+
+			// A clock is only written between two 0 data bits
+			if(( last | data ) == 0 )
+			{
+				clock |= 1 << ( bit * 2 );
+			}
+
+			last = data;
+		}
+
+		spreadTable[ i ] = value;
+		clockTable[ i ]  = clock;
+	}
+
+	return true;
+}
+
+static bool initialized = InitTables( );
+
 std::vector<UINT8> EncodeDataMFM( const std::list<sDataFragment> &fragments, bool lsb )
 {
-	std::vector<UINT8> data;
+	// Count the cells first so the output can be allocated once
+	size_t cells = 0;
+	size_t lastOffset = 0;
+
+	for( auto &fragment : fragments )
+	{
+		cells += ( fragment.bitOffsetStart - lastOffset ) + fragment.byteData.size( ) * 16;
+		lastOffset = fragment.bitOffsetEnd;
+	}
+
+	std::vector<UINT8> data( cells / 8 );
+
+	UINT8 *ptr = data.data( );
 
 	int bits = 0;
-	int accum = 0;
+	int last = 0;
+	UINT64 accum = 0;
 
-	auto WriteBit = [ & ]( int bit )
+	// Append up to 32 bits - the first bit goes in the LSB
+	auto WriteBits = [ & ]( UINT32 value, int count )
 	{
-		accum >>= 1;
-		accum |= bit ? 0x80 : 0x00;
+		accum |= UINT64( value ) << bits;
 
-		bits += 1;
-		if( bits == 8 )
+		bits += count;
+		if( bits >= 32 )
 		{
-			data.push_back( accum );
-			bits = 0;
+			ptr[ 0 ] = accum;
+			ptr[ 1 ] = accum >> 8;
+			ptr[ 2 ] = accum >> 16;
+			ptr[ 3 ] = accum >> 24;
+			ptr += 4;
+
+			accum >>= 32;
+			bits -= 32;
 		}
 	};
 
+	// Clock and data cells are interleaved, MSB first - missing clocks are generated from the data
 	auto WriteByte = [ & ]( int byte, int clock )
 	{
-		int mask = 0x80;
-		for( size_t i = 0; i < 8; i++ )
-		{
-			int l = ( accum & 0x80 ) ? 0 : 1;
-			int b = ( byte & mask ) ? 0 : 1;
-			int c = ( clock != -1 ) ? ( clock & mask ) : ( l & b );
-			WriteBit( c );
-			WriteBit( byte & mask );
-			mask >>= 1;
-		}
+		UINT32 clocks = ( clock != -1 ) ? spreadTable[ clock & 0xFF ] : ( clockTable[ byte ] & ~last );
+
+		WriteBits( clocks | ( spreadTable[ byte ] << 1 ), 16 );
+
+		last = byte & 0x01;
 	};
 
-	size_t lastOffset = 0;
+	lastOffset = 0;
 
 	for( auto &fragment : fragments )
 	{
-		int bit = 1;
-		while( lastOffset != fragment.bitOffsetStart )
+		// Fill the gap with alternating 1/0 cells
+		size_t gap = fragment.bitOffsetStart - lastOffset;
+		if( gap > 0 )
 		{
-			WriteBit( bit );
-			bit = !bit;
-			lastOffset++;
+			last = gap & 0x01;
+		}
+
+		while( gap > 0 )
+		{
+			int count = ( gap < 32 ) ? gap : 32;
+			WriteBits( 0x55555555 & ( UINT32 )(( UINT64( 1 ) << count ) - 1 ), count );
+			gap -= count;
 		}
 
 		for( size_t i = 0; i < fragment.byteData.size( ); i++ )
@@ -59,5 +119,13 @@ std::vector<UINT8> EncodeDataMFM( const std::list<sDataFragment> &fragments, boo
 		lastOffset = fragment.bitOffsetEnd;
 	}
 
+	// A partial byte at the end is dropped
+	while( bits >= 8 )
+	{
+		*ptr++ = accum;
+		accum >>= 8;
+		bits -= 8;
+	}
+
 	return data;
 }
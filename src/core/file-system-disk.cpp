@@ -168,23 +168,14 @@ iSector *cDiskFileSystem::FindSector( int index )
 
 	int trackSize = (( m_VIB != nullptr ) && ( m_VIB->SectorsPerTrack != 0 )) ? m_VIB->SectorsPerTrack : 9;
 
-	int t = index / trackSize;
-	int s = index % trackSize;
-	int h = 0;
+	iSector *sector = m_Media->GetLogicalSector( index, trackSize );
 
-	if( t >= m_Media->NumTracks( ))
-	{
-		t = 2 * m_Media->NumTracks( ) - t - 1;
-		h = 1;
-	}
-
-	if( t >= m_Media->NumTracks( ))
+	if( sector == nullptr )
 	{
 		DBG_WARNING( "Invalid sector index (" << index << ")" );
-		return nullptr;
 	}
 
-	return m_Media->GetSector( t, h, s );
+	return sector;
 }
 
 //------------------------------------------------------------------------------
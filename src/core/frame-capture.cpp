@@ -0,0 +1,556 @@
+//----------------------------------------------------------------------------
+//
+// File:        frame-capture.cpp
+// Date:        18-Oct-2026
+//
+// Description: Write rendered frames to PPM/PNG files or a YUV4MPEG2 stream
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "common.hpp"
+#include "logger.hpp"
+#include "option.hpp"
+#include "frame-capture.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+#define MAX_QUEUED_FRAMES	8
+
+#define MAX_STORED_BLOCK	0xFFFF
+
+#define MAX_NUMBER_WIDTH	32
+
+// Pixels are stored as R, G, B, A in increasing byte order whatever the host's
+// byte order, so the components are read from memory rather than shifted out
+static inline UINT8 PixelR( const UINT32 &pixel )	{ return reinterpret_cast<const UINT8 *>( &pixel )[ 0 ]; }
+static inline UINT8 PixelG( const UINT32 &pixel )	{ return reinterpret_cast<const UINT8 *>( &pixel )[ 1 ]; }
+static inline UINT8 PixelB( const UINT32 &pixel )	{ return reinterpret_cast<const UINT8 *>( &pixel )[ 2 ]; }
+
+static UINT32 Crc32( UINT32 crc, const UINT8 *data, size_t length )
+{
+	static UINT32 table[ 256 ];
+
+	if( table[ 1 ] == 0 )
+	{
+		for( UINT32 i = 0; i < 256; i++ )
+		{
+			UINT32 c = i;
+			for( int k = 0; k < 8; k++ )
+			{
+				c = ( c & 1 ) ? 0xEDB88320 ^ ( c >> 1 ) : c >> 1;
+			}
+			table[ i ] = c;
+		}
+	}
+
+	crc = ~crc;
+
+	for( size_t i = 0; i < length; i++ )
+	{
+		crc = table[ ( crc ^ data[ i ] ) & 0xFF ] ^ ( crc >> 8 );
+	}
+
+	return ~crc;
+}
+
+static UINT32 Adler32( const UINT8 *data, size_t length )
+{
+	UINT32 a = 1, b = 0;
+
+	while( length > 0 )
+	{
+		// Largest run that can't overflow 32 bits before reducing
+		size_t count = std::min<size_t>( length, 5552 );
+		length -= count;
+		while( count-- > 0 )
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return ( b << 16 ) | a;
+}
+
+static void PutBE32( std::vector<UINT8> &buffer, UINT32 value )
+{
+	buffer.push_back( static_cast<UINT8>( value >> 24 ));
+	buffer.push_back( static_cast<UINT8>( value >> 16 ));
+	buffer.push_back( static_cast<UINT8>( value >>  8 ));
+	buffer.push_back( static_cast<UINT8>( value >>  0 ));
+}
+
+static bool WriteChunk( FILE *file, const char *type, const UINT8 *data, size_t length )
+{
+	UINT8 header[ 8 ] =
+	{
+		static_cast<UINT8>( length >> 24 ), static_cast<UINT8>( length >> 16 ),
+		static_cast<UINT8>( length >>  8 ), static_cast<UINT8>( length >>  0 ),
+		static_cast<UINT8>( type[ 0 ] ), static_cast<UINT8>( type[ 1 ] ),
+		static_cast<UINT8>( type[ 2 ] ), static_cast<UINT8>( type[ 3 ] )
+	};
+
+	// The CRC covers the chunk type and data but not the length
+	UINT32 crc = Crc32( Crc32( 0, header + 4, 4 ), data, length );
+
+	UINT8 trailer[ 4 ] =
+	{
+		static_cast<UINT8>( crc >> 24 ), static_cast<UINT8>( crc >> 16 ),
+		static_cast<UINT8>( crc >>  8 ), static_cast<UINT8>( crc >>  0 )
+	};
+
+	return ( fwrite( header, sizeof( header ), 1, file ) == 1 ) &&
+		   (( length == 0 ) || ( fwrite( data, length, 1, file ) == 1 )) &&
+		   ( fwrite( trailer, sizeof( trailer ), 1, file ) == 1 );
+}
+
+// Find the frame number in a capture name - a single %d, %Nd, or %0Nd and no other conversions
+static bool FindFrameNumber( const std::string &name, size_t *start, size_t *end, int *width, bool *zeroFill )
+{
+	size_t percent = name.find( '%' );
+	if( percent == std::string::npos )
+	{
+		return false;
+	}
+
+	size_t i = percent + 1;
+
+	*zeroFill = ( i < name.size( )) && ( name[ i ] == '0' );
+	if( *zeroFill == true )
+	{
+		i++;
+	}
+
+	*width = 0;
+	while(( i < name.size( )) && isdigit( name[ i ] ))
+	{
+		*width = *width * 10 + ( name[ i++ ] - '0' );
+		if( *width > MAX_NUMBER_WIDTH )
+		{
+			return false;
+		}
+	}
+
+	if(( i >= name.size( )) || ( name[ i ] != 'd' ) || ( name.find( '%', i ) != std::string::npos ))
+	{
+		return false;
+	}
+
+	*start = percent;
+	*end   = i + 1;
+
+	return true;
+}
+
+cFrameCapture::cFrameCapture( const std::string &filename, int frameRate, size_t frameLimit ) :
+	m_FileName( filename ),
+	m_Format( CAPTURE_PPM ),
+	m_FrameRate( frameRate ),
+	m_FrameLimit( frameLimit ),
+	m_FramesQueued( 0 ),
+	m_FramesWritten( 0 ),
+	m_Stream( nullptr ),
+	m_HeaderWritten( false ),
+	m_Buffer( ),
+	m_Encoded( ),
+	m_Failed( false ),
+	m_Writer( [ this ]( const sFrame &frame ){ WriteQueuedFrame( frame ); }, MAX_QUEUED_FRAMES )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture ctor", true );
+
+	GetFormat( filename, &m_Format );
+
+	if( m_Format == CAPTURE_Y4M )
+	{
+		m_Stream = ( filename == "-" ) ? stdout : fopen( filename.c_str( ), "wb" );
+		if( m_Stream == nullptr )
+		{
+			fprintf( stderr, "Unable to create capture file \"%s\"\n", filename.c_str( ));
+			m_Failed = true;
+		}
+	}
+}
+
+cFrameCapture::~cFrameCapture( )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture dtor", true );
+
+	// Let the writer drain whatever is still queued
+	m_Writer.Stop( );
+
+	// Don't mix messages into a stream being piped to stdout
+	if( verbose >= 1 )
+	{
+		fprintf(( m_Stream == stdout ) ? stderr : stdout, "Captured %zu frames to \"%s\"\n", m_FramesWritten, m_FileName.c_str( ));
+	}
+
+	if( m_Stream != nullptr )
+	{
+		fflush( m_Stream );
+		if( m_Stream != stdout )
+		{
+			fclose( m_Stream );
+		}
+	}
+}
+
+bool cFrameCapture::GetFormat( const std::string &filename, CAPTURE_FORMAT_E *format )
+{
+	FUNCTION_ENTRY( nullptr, "cFrameCapture::GetFormat", true );
+
+	// A raw stream to stdout is meant to be piped into an encoder
+	if( filename == "-" )
+	{
+		*format = CAPTURE_Y4M;
+		return true;
+	}
+
+	size_t dot = filename.rfind( '.' );
+	if( dot == std::string::npos )
+	{
+		return false;
+	}
+
+	std::string ext = filename.substr( dot + 1 );
+	std::transform( ext.begin( ), ext.end( ), ext.begin( ), ::tolower );
+
+	if( ext == "ppm" )
+	{
+		*format = CAPTURE_PPM;
+	}
+	else if( ext == "png" )
+	{
+		*format = CAPTURE_PNG;
+	}
+	else if( ext == "y4m" )
+	{
+		*format = CAPTURE_Y4M;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool cFrameCapture::IsValidName( const std::string &filename )
+{
+	FUNCTION_ENTRY( nullptr, "cFrameCapture::IsValidName", true );
+
+	size_t start, end;
+	int width;
+	bool zeroFill;
+
+	return ( filename.find( '%' ) == std::string::npos ) || FindFrameNumber( filename, &start, &end, &width, &zeroFill );
+}
+
+bool cFrameCapture::IsActive( ) const
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::IsActive", false );
+
+	if(( m_FrameLimit != 0 ) && ( m_FramesQueued >= m_FrameLimit ))
+	{
+		return false;
+	}
+
+	return !m_Failed;
+}
+
+cFrameCapture::sFrame cFrameCapture::AllocateFrame( int width, int height )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::AllocateFrame", false );
+
+	sFrame frame;
+	m_Writer.Reuse( &frame );
+
+	frame.width  = width;
+	frame.height = height;
+	frame.pixels.resize( width * height );
+
+	return frame;
+}
+
+void cFrameCapture::QueueFrame( sFrame &&frame )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::QueueFrame", false );
+
+	m_Writer.Queue( std::move( frame ));
+
+	m_FramesQueued++;
+}
+
+void cFrameCapture::AddFrame( int width, int height, const UINT32 *pixels )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::AddFrame", false );
+
+	if( IsActive( ) == false )
+	{
+		return;
+	}
+
+	sFrame frame = AllocateFrame( width, height );
+
+	memcpy( frame.pixels.data( ), pixels, frame.pixels.size( ) * sizeof( UINT32 ));
+
+	QueueFrame( std::move( frame ));
+}
+
+// Add a frame of color indices (as produced by cTMS9918A::RenderFrame)
+void cFrameCapture::AddFrame( int width, int height, const UINT8 *indices, const UINT32 *palette )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::AddFrame", false );
+
+	if( IsActive( ) == false )
+	{
+		return;
+	}
+
+	sFrame frame = AllocateFrame( width, height );
+
+	for( auto &pixel : frame.pixels )
+	{
+		pixel = palette[ *indices++ ];
+	}
+
+	QueueFrame( std::move( frame ));
+}
+
+void cFrameCapture::AddFrame( int width, int height, UINT32 color )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::AddFrame", false );
+
+	if( IsActive( ) == false )
+	{
+		return;
+	}
+
+	sFrame frame = AllocateFrame( width, height );
+
+	std::fill( frame.pixels.begin( ), frame.pixels.end( ), color );
+
+	QueueFrame( std::move( frame ));
+}
+
+void cFrameCapture::WriteQueuedFrame( const sFrame &frame )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::WriteQueuedFrame", false );
+
+	// Frames queued after a failure are dropped
+	if(( m_Failed == false ) && ( WriteFrame( &frame ) == false ))
+	{
+		m_Failed = true;
+	}
+}
+
+std::string cFrameCapture::GetFrameName( size_t index ) const
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::GetFrameName", false );
+
+	char buffer[ 4096 ];
+
+	size_t start, end;
+	int width;
+	bool zeroFill;
+
+	// Put the frame number where the user asked for it, otherwise number the files
+	if( FindFrameNumber( m_FileName, &start, &end, &width, &zeroFill ) == true )
+	{
+		snprintf( buffer, sizeof( buffer ), zeroFill ? "%0*d" : "%*d", width, static_cast<int>( index ));
+		return m_FileName.substr( 0, start ) + buffer + m_FileName.substr( end );
+	}
+
+	size_t dot = m_FileName.rfind( '.' );
+
+	snprintf( buffer, sizeof( buffer ), "%s-%05d%s", m_FileName.substr( 0, dot ).c_str( ), static_cast<int>( index ), m_FileName.substr( dot ).c_str( ));
+
+	return buffer;
+}
+
+bool cFrameCapture::WriteFrame( const sFrame *frame )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::WriteFrame", false );
+
+	bool ok = false;
+
+	if( m_Format == CAPTURE_Y4M )
+	{
+		ok = WriteY4M( frame, m_Stream );
+	}
+	else
+	{
+		std::string filename = GetFrameName( m_FramesWritten );
+
+		FILE *file = fopen( filename.c_str( ), "wb" );
+		if( file == nullptr )
+		{
+			fprintf( stderr, "Unable to create capture file \"%s\"\n", filename.c_str( ));
+			return false;
+		}
+
+		ok = ( m_Format == CAPTURE_PNG ) ? WritePNG( frame, file ) : WritePPM( frame, file );
+
+		if( fclose( file ) != 0 )
+		{
+			ok = false;
+		}
+	}
+
+	if( ok == false )
+	{
+		fprintf( stderr, "Error writing frame %zu to \"%s\"\n", m_FramesWritten, m_FileName.c_str( ));
+		return false;
+	}
+
+	m_FramesWritten++;
+
+	return true;
+}
+
+bool cFrameCapture::WritePPM( const sFrame *frame, FILE *file )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::WritePPM", false );
+
+	m_Buffer.resize( frame->pixels.size( ) * 3 );
+
+	UINT8 *ptr = m_Buffer.data( );
+	for( UINT32 pixel : frame->pixels )
+	{
+		*ptr++ = PixelR( pixel );
+		*ptr++ = PixelG( pixel );
+		*ptr++ = PixelB( pixel );
+	}
+
+	if( fprintf( file, "P6\n%d %d\n255\n", frame->width, frame->height ) < 0 )
+	{
+		return false;
+	}
+
+	return fwrite( m_Buffer.data( ), m_Buffer.size( ), 1, file ) == 1;
+}
+
+bool cFrameCapture::WritePNG( const sFrame *frame, FILE *file )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::WritePNG", false );
+
+	static const UINT8 signature[ 8 ] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	// Raw image data - each scanline starts with filter type 0 (none)
+	m_Buffer.resize( frame->height * ( 1 + frame->width * 3 ));
+
+	UINT8 *ptr = m_Buffer.data( );
+	const UINT32 *pixel = frame->pixels.data( );
+	for( int y = 0; y < frame->height; y++ )
+	{
+		*ptr++ = 0;
+		for( int x = 0; x < frame->width; x++, pixel++ )
+		{
+			*ptr++ = PixelR( *pixel );
+			*ptr++ = PixelG( *pixel );
+			*ptr++ = PixelB( *pixel );
+		}
+	}
+
+	std::vector<UINT8> &idat = m_Encoded;
+	idat.clear( );
+
+	// zlib header followed by uncompressed (stored) deflate blocks
+	idat.push_back( 0x78 );
+	idat.push_back( 0x01 );
+
+	size_t offset = 0;
+	do
+	{
+		size_t count = std::min<size_t>( m_Buffer.size( ) - offset, MAX_STORED_BLOCK );
+		bool   final = ( offset + count == m_Buffer.size( ));
+
+		idat.push_back( final ? 1 : 0 );
+		idat.push_back( static_cast<UINT8>( count ));
+		idat.push_back( static_cast<UINT8>( count >> 8 ));
+		idat.push_back( static_cast<UINT8>( ~count ));
+		idat.push_back( static_cast<UINT8>( ~count >> 8 ));
+		idat.insert( idat.end( ), m_Buffer.begin( ) + offset, m_Buffer.begin( ) + offset + count );
+
+		offset += count;
+	}
+	while( offset < m_Buffer.size( ));
+
+	PutBE32( idat, Adler32( m_Buffer.data( ), m_Buffer.size( )));
+
+	std::vector<UINT8> ihdr;
+	PutBE32( ihdr, frame->width );
+	PutBE32( ihdr, frame->height );
+	ihdr.push_back( 8 );		// bit depth
+	ihdr.push_back( 2 );		// color type - RGB
+	ihdr.push_back( 0 );		// compression method
+	ihdr.push_back( 0 );		// filter method
+	ihdr.push_back( 0 );		// interlace method
+
+	return ( fwrite( signature, sizeof( signature ), 1, file ) == 1 ) &&
+		   WriteChunk( file, "IHDR", ihdr.data( ), ihdr.size( )) &&
+		   WriteChunk( file, "IDAT", idat.data( ), idat.size( )) &&
+		   WriteChunk( file, "IEND", nullptr, 0 );
+}
+
+bool cFrameCapture::WriteY4M( const sFrame *frame, FILE *file )
+{
+	FUNCTION_ENTRY( this, "cFrameCapture::WriteY4M", false );
+
+	if( m_HeaderWritten == false )
+	{
+		// 4:4:4 keeps single pixel wide text legible
+		if( fprintf( file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", frame->width, frame->height, m_FrameRate ) < 0 )
+		{
+			return false;
+		}
+		m_HeaderWritten = true;
+	}
+
+	size_t size = frame->pixels.size( );
+
+	m_Buffer.resize( size * 3 );
+
+	UINT8 *Y = m_Buffer.data( );
+	UINT8 *U = Y + size;
+	UINT8 *V = U + size;
+
+	// ITU-R BT.601 studio swing
+	for( UINT32 pixel : frame->pixels )
+	{
+		int r = PixelR( pixel );
+		int g = PixelG( pixel );
+		int b = PixelB( pixel );
+
+		*Y++ = static_cast<UINT8>(((   66 * r + 129 * g +  25 * b + 128 ) >> 8 ) +  16 );
+		*U++ = static_cast<UINT8>((( -38 * r -  74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+		*V++ = static_cast<UINT8>((( 112 * r -  94 * g -  18 * b + 128 ) >> 8 ) + 128 );
+	}
+
+	if( fputs( "FRAME\n", file ) < 0 )
+	{
+		return false;
+	}
+
+	return fwrite( m_Buffer.data( ), m_Buffer.size( ), 1, file ) == 1;
+}
@@ -0,0 +1,154 @@
+//----------------------------------------------------------------------------
+//
+// File:        mapped-file.cpp
+// Date:        18-Oct-2026
+//
+// Description: Memory-mapped view of a disk image file
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include "common.hpp"
+#include "logger.hpp"
+#include "mapped-file.hpp"
+
+#if defined( HAVE_MMAP )
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+DBG_REGISTER( __FILE__ );
+
+cMappedFile::cMappedFile( ) :
+	m_FileName( ),
+	m_Data( nullptr ),
+	m_Size( 0 ),
+	m_IsWritable( false )
+{
+	FUNCTION_ENTRY( this, "cMappedFile ctor", true );
+}
+
+cMappedFile::~cMappedFile( )
+{
+	FUNCTION_ENTRY( this, "cMappedFile dtor", true );
+
+	Close( );
+}
+
+bool cMappedFile::Open( const std::string &fileName )
+{
+	FUNCTION_ENTRY( this, "cMappedFile::Open", true );
+
+	Close( );
+
+#if defined( HAVE_MMAP )
+
+	bool writable = true;
+
+	int fd = open( fileName.c_str( ), O_RDWR );
+	if( fd == -1 )
+	{
+		writable = false;
+		fd = open( fileName.c_str( ), O_RDONLY );
+		if( fd == -1 )
+		{
+			return false;
+		}
+	}
+
+	struct stat info;
+	if(( fstat( fd, &info ) != 0 ) || ( info.st_size == 0 ))
+	{
+		close( fd );
+		return false;
+	}
+
+	void *data = mmap( nullptr, info.st_size, writable ? ( PROT_READ | PROT_WRITE ) : PROT_READ, MAP_SHARED, fd, 0 );
+
+	// The mapping keeps its own reference to the file
+	close( fd );
+
+	if( data == MAP_FAILED )
+	{
+		DBG_WARNING( "Unable to map '" << fileName << "'" );
+		return false;
+	}
+
+	m_FileName   = fileName;
+	m_Data       = static_cast<UINT8 *>( data );
+	m_Size       = info.st_size;
+	m_IsWritable = writable;
+
+	DBG_EVENT( "Mapped '" << fileName << "' (" << m_Size << " bytes)" );
+
+	return true;
+
+#else
+
+	return false;
+
+#endif
+}
+
+void cMappedFile::Close( )
+{
+	FUNCTION_ENTRY( this, "cMappedFile::Close", true );
+
+#if defined( HAVE_MMAP )
+
+	if( m_Data != nullptr )
+	{
+		munmap( m_Data, m_Size );
+	}
+
+#endif
+
+	m_FileName.clear( );
+	m_Data       = nullptr;
+	m_Size       = 0;
+	m_IsWritable = false;
+}
+
+bool cMappedFile::Flush( size_t offset, size_t length )
+{
+	FUNCTION_ENTRY( this, "cMappedFile::Flush", true );
+
+#if defined( HAVE_MMAP )
+
+	if(( m_Data == nullptr ) || ( offset >= m_Size ))
+	{
+		return false;
+	}
+
+	length = std::min( length, m_Size - offset );
+
+	// msync needs a page aligned start address
+	size_t page  = sysconf( _SC_PAGESIZE );
+	size_t start = offset - offset % page;
+
+	return msync( m_Data + start, length + ( offset - start ), MS_SYNC ) == 0;
+
+#else
+
+	return false;
+
+#endif
+}
@@ -0,0 +1,275 @@
+//----------------------------------------------------------------------------
+//
+// File:        sound-log.cpp
+// Date:        18-Oct-2026
+//
+// Description: Compact cycle-stamped log of sound & speech chip accesses
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <cstring>
+#include "common.hpp"
+#include "logger.hpp"
+#include "sound-log.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+#define LOG_MAGIC           "TISL"
+#define LOG_VERSION         1
+#define LOG_HEADER_SIZE     9
+
+// Writes are only a few bytes each, so collect them and hit the disk rarely
+#define LOG_BUFFER_SIZE     0x10000
+
+cSoundLog::cSoundLog( ) :
+	m_File( nullptr ),
+	m_Writing( false ),
+	m_Started( false ),
+	m_ClockSpeed( 0 ),
+	m_LastClock( 0 ),
+	m_Clock( 0 ),
+	m_Events( 0 ),
+	m_Buffer( )
+{
+	FUNCTION_ENTRY( this, "cSoundLog ctor", true );
+}
+
+cSoundLog::~cSoundLog( )
+{
+	FUNCTION_ENTRY( this, "cSoundLog dtor", true );
+
+	Close( );
+}
+
+bool cSoundLog::Create( const std::string &filename, UINT32 clockSpeed )
+{
+	FUNCTION_ENTRY( this, "cSoundLog::Create", true );
+
+	Close( );
+
+	m_File = fopen( filename.c_str( ), "wb" );
+	if( m_File == nullptr )
+	{
+		DBG_ERROR( "Unable to create file " << filename );
+		return false;
+	}
+
+	m_Writing    = true;
+	m_Started    = false;
+	m_ClockSpeed = clockSpeed;
+	m_Clock      = 0;
+	m_Events     = 0;
+
+	m_Buffer.reserve( LOG_BUFFER_SIZE + 16 );
+
+	UINT8 header[ LOG_HEADER_SIZE ] =
+	{
+		LOG_MAGIC[ 0 ], LOG_MAGIC[ 1 ], LOG_MAGIC[ 2 ], LOG_MAGIC[ 3 ], LOG_VERSION,
+		( UINT8 ) ( clockSpeed >>  0 ), ( UINT8 ) ( clockSpeed >>  8 ),
+		( UINT8 ) ( clockSpeed >> 16 ), ( UINT8 ) ( clockSpeed >> 24 )
+	};
+
+	m_Buffer.assign( header, header + sizeof( header ));
+
+	return true;
+}
+
+bool cSoundLog::Open( const std::string &filename )
+{
+	FUNCTION_ENTRY( this, "cSoundLog::Open", true );
+
+	Close( );
+
+	m_File = fopen( filename.c_str( ), "rb" );
+	if( m_File == nullptr )
+	{
+		DBG_ERROR( "Unable to open file " << filename );
+		return false;
+	}
+
+	UINT8 header[ LOG_HEADER_SIZE ];
+
+	if(( fread( header, sizeof( header ), 1, m_File ) != 1 ) || ( memcmp( header, LOG_MAGIC, 4 ) != 0 ) || ( header[ 4 ] != LOG_VERSION ))
+	{
+		DBG_ERROR( "File " << filename << " is not a sound log" );
+		fclose( m_File );
+		m_File = nullptr;
+		return false;
+	}
+
+	m_Writing    = false;
+	m_ClockSpeed = header[ 5 ] | ( header[ 6 ] << 8 ) | ( header[ 7 ] << 16 ) | ( header[ 8 ] << 24 );
+	m_Clock      = 0;
+	m_Events     = 0;
+
+	return true;
+}
+
+bool cSoundLog::Flush( )
+{
+	FUNCTION_ENTRY( this, "cSoundLog::Flush", false );
+
+	bool ok = m_Buffer.empty( ) || ( fwrite( m_Buffer.data( ), m_Buffer.size( ), 1, m_File ) == 1 );
+
+	m_Buffer.clear( );
+
+	return ok;
+}
+
+bool cSoundLog::Close( )
+{
+	FUNCTION_ENTRY( this, "cSoundLog::Close", true );
+
+	if( m_File == nullptr )
+	{
+		return true;
+	}
+
+	bool ok = true;
+
+	if( m_Writing == true )
+	{
+		m_Buffer.push_back( LOG_END );
+		ok = Flush( );
+	}
+
+	ok &= ( fclose( m_File ) == 0 );
+
+	m_File = nullptr;
+
+	return ok;
+}
+
+void cSoundLog::Write( UINT32 clock, SOUND_LOG_EVENT_E type, UINT8 data )
+{
+	FUNCTION_ENTRY( this, "cSoundLog::Write", false );
+
+	if(( m_File == nullptr ) || ( m_Writing == false ))
+	{
+		return;
+	}
+
+	// The log starts with the first event - there's no point in recording silence. The counter
+	// wraps, so any gap up to its full range is measured correctly.
+	UINT32 elapsed = m_Started ? clock - m_LastClock : 0;
+
+	m_Started   = true;
+	m_LastClock = clock;
+
+	if( elapsed != 0 )
+	{
+		m_Buffer.push_back( LOG_WAIT );
+		while( elapsed >= 0x80 )
+		{
+			m_Buffer.push_back(( UINT8 ) ( 0x80 | ( elapsed & 0x7F )));
+			elapsed >>= 7;
+		}
+		m_Buffer.push_back(( UINT8 ) elapsed );
+	}
+
+	m_Buffer.push_back(( UINT8 ) type );
+
+	if(( type == LOG_TMS9919_WRITE ) || ( type == LOG_TMS5220_WRITE ))
+	{
+		m_Buffer.push_back( data );
+	}
+
+	m_Events++;
+
+	if(( m_Buffer.size( ) >= LOG_BUFFER_SIZE ) && ( Flush( ) == false ))
+	{
+		DBG_ERROR( "Error writing sound log - recording stopped" );
+		fclose( m_File );
+		m_File = nullptr;
+	}
+}
+
+void cSoundLog::Resync( UINT32 clock )
+{
+	FUNCTION_ENTRY( this, "cSoundLog::Resync", true );
+
+	m_LastClock = clock;
+}
+
+bool cSoundLog::Read( sEvent *event )
+{
+	FUNCTION_ENTRY( this, "cSoundLog::Read", false );
+
+	if(( m_File == nullptr ) || ( m_Writing == true ))
+	{
+		return false;
+	}
+
+	for( EVER )
+	{
+		int type = getc( m_File );
+
+		event->data = 0;
+
+		switch( type )
+		{
+			case LOG_WAIT :
+				{
+					UINT64 elapsed = 0;
+					int shift = 0;
+					int byte;
+					do
+					{
+						if( shift >= 64 )
+						{
+							DBG_ERROR( "Invalid sound log wait" );
+							return false;
+						}
+						if(( byte = getc( m_File )) == EOF )
+						{
+							return false;
+						}
+						elapsed |= ( UINT64 ) ( byte & 0x7F ) << shift;
+						shift += 7;
+					}
+					while( byte & 0x80 );
+					m_Clock += elapsed;
+				}
+				break;
+			case LOG_TMS9919_WRITE :
+			case LOG_TMS5220_WRITE :
+				{
+					int data = getc( m_File );
+					if( data == EOF )
+					{
+						return false;
+					}
+					event->data = ( UINT8 ) data;
+				}
+				// fall through
+			case LOG_TMS5220_READ :
+			case LOG_TMS5220_RESET :
+				event->clock = m_Clock;
+				event->type  = ( SOUND_LOG_EVENT_E ) type;
+				m_Events++;
+				return true;
+			case LOG_END :
+			case EOF :
+				return false;
+			default :
+				DBG_ERROR( "Invalid sound log command " << hex << type );
+				return false;
+		}
+	}
+}
@@ -0,0 +1,334 @@
+//----------------------------------------------------------------------------
+//
+// File:        speech-index.cpp
+// Date:        18-Oct-2026
+//
+// Description: Sorted phrase index for TMS5220 speech ROMs
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "common.hpp"
+#include "logger.hpp"
+#include "speech-index.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+#define INDEX_MAGIC         "SPI2"
+#define INDEX_HEADER_SIZE   16
+
+// Cache files are always little-endian
+static UINT8 *Store16( UINT8 *ptr, UINT32 value )
+{
+	*ptr++ = ( UINT8 ) ( value >> 0 );
+	*ptr++ = ( UINT8 ) ( value >> 8 );
+
+	return ptr;
+}
+
+static UINT8 *Store32( UINT8 *ptr, UINT32 value )
+{
+	ptr = Store16( ptr, value & 0xFFFF );
+
+	return Store16( ptr, value >> 16 );
+}
+
+static UINT32 Load16( const UINT8 *ptr )
+{
+	return ( UINT32 ) ( ptr[ 0 ] | ( ptr[ 1 ] << 8 ));
+}
+
+static UINT32 Load32( const UINT8 *ptr )
+{
+	return Load16( ptr ) | ( Load16( ptr + 2 ) << 16 );
+}
+
+// Same ordering the chip uses when walking the tree: case is ignored and a
+// prefix sorts before any longer phrase
+static int ComparePhrase( const char *phrase1, size_t length1, const char *phrase2, size_t length2 )
+{
+	int delta = strnicmp( phrase1, phrase2, std::min( length1, length2 ));
+	if( delta != 0 )
+	{
+		return delta;
+	}
+
+	return ( length1 < length2 ) ? -1 : ( length1 > length2 ) ? 1 : 0;
+}
+
+cSpeechIndex::cSpeechIndex( ) :
+	m_Phrases( )
+{
+	FUNCTION_ENTRY( this, "cSpeechIndex ctor", true );
+}
+
+cSpeechIndex::~cSpeechIndex( )
+{
+	FUNCTION_ENTRY( this, "cSpeechIndex dtor", true );
+}
+
+UINT32 cSpeechIndex::Checksum( const UINT8 *rom, size_t size )
+{
+	FUNCTION_ENTRY( nullptr, "cSpeechIndex::Checksum", true );
+
+	// FNV-1a
+	UINT32 hash = 0x811C9DC5;
+
+	for( size_t i = 0; i < size; i++ )
+	{
+		hash = ( hash ^ rom[ i ] ) * 0x01000193;
+	}
+
+	return hash;
+}
+
+bool cSpeechIndex::ReadNode( const UINT8 *rom, size_t size, size_t offset, sPhrase *node )
+{
+	FUNCTION_ENTRY( nullptr, "cSpeechIndex::ReadNode", false );
+
+	// [ phrase length (1), phrase (n), previous (2), next (2), ? (1), offset (2), data length (1) ]
+	if(( offset == 0 ) || ( offset >= size ))
+	{
+		return false;
+	}
+
+	size_t length = rom[ offset ];
+
+	if( offset + 1 + length + 8 > size )
+	{
+		return false;
+	}
+
+	const UINT8 *ptr = &rom[ offset + length + 1 ];
+
+	node->phrase.assign(( const char * ) rom + offset + 1, length );
+	node->phraseOffset = ( UINT16 ) offset;
+	node->dataOffset   = ( UINT16 ) (( ptr[ 5 ] << 8 ) | ptr[ 6 ] );
+	node->dataLength   = ptr[ 7 ];
+
+	return ( size_t ) node->dataOffset + node->dataLength <= size;
+}
+
+std::string cSpeechIndex::GetCacheName( const std::string &romFile )
+{
+	FUNCTION_ENTRY( nullptr, "cSpeechIndex::GetCacheName", true );
+
+	if( romFile.empty( ))
+	{
+		return romFile;
+	}
+
+	std::string name = romFile;
+
+	size_t ext = name.rfind( '.' );
+	if(( ext != std::string::npos ) && ( stricmp( name.c_str( ) + ext, ".bin" ) == 0 ))
+	{
+		name.erase( ext );
+	}
+
+	return name + ".idx";
+}
+
+bool cSpeechIndex::Build( const UINT8 *rom, size_t size )
+{
+	FUNCTION_ENTRY( this, "cSpeechIndex::Build", true );
+
+	m_Phrases.clear( );
+
+	if(( size < 2 ) || ( rom[ 0 ] != 0xAA ))
+	{
+		DBG_WARNING( "Speech ROM is invalid" );
+		return false;
+	}
+
+	// Walk the tree without recursion - a damaged ROM could be arbitrarily deep (or circular)
+	std::vector<bool> visited( size, false );
+	std::vector<size_t> pending( 1, 1 );
+
+	while( pending.empty( ) == false )
+	{
+		size_t offset = pending.back( );
+		pending.pop_back( );
+
+		if(( offset == 0 ) || ( offset >= size ) || visited[ offset ] )
+		{
+			continue;
+		}
+		visited[ offset ] = true;
+
+		sPhrase node;
+		if( ReadNode( rom, size, offset, &node ) == false )
+		{
+			DBG_WARNING( "Invalid phrase node at offset " << hex << offset );
+			continue;
+		}
+
+		const UINT8 *ptr = &rom[ offset + node.phrase.size( ) + 1 ];
+		pending.push_back(( ptr[ 2 ] << 8 ) | ptr[ 3 ] );
+		pending.push_back(( ptr[ 0 ] << 8 ) | ptr[ 1 ] );
+
+		m_Phrases.push_back( std::move( node ));
+	}
+
+	std::stable_sort( m_Phrases.begin( ), m_Phrases.end( ), [ ]( const sPhrase &a, const sPhrase &b )
+	{
+		return ComparePhrase( a.phrase.data( ), a.phrase.size( ), b.phrase.data( ), b.phrase.size( )) < 0;
+	});
+
+	// Duplicate phrases are kept (dumpspch lists them) - the sort is stable and the walk visits a node
+	// before its children, so Find returns the one the chip would reach first
+
+	DBG_TRACE( "Indexed " << m_Phrases.size( ) << " phrases" );
+
+	return true;
+}
+
+bool cSpeechIndex::Load( const std::string &filename, const UINT8 *rom, size_t size )
+{
+	FUNCTION_ENTRY( this, "cSpeechIndex::Load", true );
+
+	m_Phrases.clear( );
+
+	FILE *file = fopen( filename.c_str( ), "rb" );
+	if( file == nullptr )
+	{
+		return false;
+	}
+
+	std::vector<UINT8> buffer;
+
+	UINT8 header[ INDEX_HEADER_SIZE ];
+	bool valid = ( fread( header, sizeof( header ), 1, file ) == 1 ) &&
+				 ( memcmp( header, INDEX_MAGIC, 4 ) == 0 ) &&
+				 ( Load32( header + 4 ) == size ) &&
+				 ( Load32( header + 8 ) == Checksum( rom, size ));
+
+	// Every node takes at least 9 bytes of the ROM, so a larger count can't be right
+	valid = valid && ( Load32( header + 12 ) <= size / 9 );
+
+	if( valid == true )
+	{
+		buffer.resize( Load32( header + 12 ) * 2 );
+		valid = buffer.empty( ) || ( fread( buffer.data( ), buffer.size( ), 1, file ) == 1 );
+	}
+
+	fclose( file );
+
+	if( valid == false )
+	{
+		DBG_WARNING( "Ignoring stale or invalid speech index " << filename );
+		return false;
+	}
+
+	m_Phrases.resize( buffer.size( ) / 2 );
+
+	for( size_t i = 0; i < m_Phrases.size( ); i++ )
+	{
+		if( ReadNode( rom, size, Load16( &buffer[ i * 2 ] ), &m_Phrases[ i ] ) == false )
+		{
+			DBG_WARNING( "Invalid phrase offset in speech index " << filename );
+			m_Phrases.clear( );
+			return false;
+		}
+
+		// Find relies on the phrases being in order
+		if(( i > 0 ) && ( ComparePhrase( m_Phrases[ i - 1 ].phrase.data( ), m_Phrases[ i - 1 ].phrase.size( ), m_Phrases[ i ].phrase.data( ), m_Phrases[ i ].phrase.size( )) > 0 ))
+		{
+			DBG_WARNING( "Speech index " << filename << " is not sorted" );
+			m_Phrases.clear( );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool cSpeechIndex::Save( const std::string &filename, const UINT8 *rom, size_t size ) const
+{
+	FUNCTION_ENTRY( this, "cSpeechIndex::Save", true );
+
+	std::vector<UINT8> buffer( INDEX_HEADER_SIZE + m_Phrases.size( ) * 2 );
+
+	UINT8 *ptr = buffer.data( );
+
+	memcpy( ptr, INDEX_MAGIC, 4 );                      ptr += 4;
+	ptr = Store32( ptr, ( UINT32 ) size );
+	ptr = Store32( ptr, Checksum( rom, size ));
+	ptr = Store32( ptr, ( UINT32 ) m_Phrases.size( ));
+
+	for( auto &node : m_Phrases )
+	{
+		ptr = Store16( ptr, node.phraseOffset );
+	}
+
+	FILE *file = fopen( filename.c_str( ), "wb" );
+	if( file == nullptr )
+	{
+		DBG_WARNING( "Unable to create speech index " << filename );
+		return false;
+	}
+
+	bool ok = fwrite( buffer.data( ), buffer.size( ), 1, file ) == 1;
+
+	fclose( file );
+
+	return ok;
+}
+
+bool cSpeechIndex::Open( const std::string &filename, const UINT8 *rom, size_t size )
+{
+	FUNCTION_ENTRY( this, "cSpeechIndex::Open", true );
+
+	if(( filename.empty( ) == false ) && ( Load( filename, rom, size ) == true ))
+	{
+		return true;
+	}
+
+	if( Build( rom, size ) == false )
+	{
+		return false;
+	}
+
+	// The cache is only an optimization - it doesn't matter if the ROM's directory is read-only
+	if( filename.empty( ) == false )
+	{
+		Save( filename, rom, size );
+	}
+
+	return true;
+}
+
+const cSpeechIndex::sPhrase *cSpeechIndex::Find( const char *phrase, size_t length ) const
+{
+	FUNCTION_ENTRY( this, "cSpeechIndex::Find", false );
+
+	auto it = std::lower_bound( m_Phrases.begin( ), m_Phrases.end( ), phrase, [ length ]( const sPhrase &node, const char *text )
+	{
+		return ComparePhrase( node.phrase.data( ), node.phrase.size( ), text, length ) < 0;
+	});
+
+	if(( it == m_Phrases.end( )) || ( ComparePhrase( it->phrase.data( ), it->phrase.size( ), phrase, length ) != 0 ))
+	{
+		return nullptr;
+	}
+
+	return &*it;
+}
@@ -32,9 +32,14 @@
 #include "common.hpp"
 #include "logger.hpp"
 #include "cartridge.hpp"
+#include "memory.hpp"
 #include "tms9900.hpp"
+#include "itms9918a.hpp"
+#include "icomputer.hpp"
 #include "device.hpp"
 #include "ti-disk.hpp"
+#include "file-system-disk.hpp"
+#include "fileio.hpp"
 #include "support.hpp"
 
 DBG_REGISTER( __FILE__ );
@@ -48,19 +53,34 @@ std::string cDiskDevice::DiskImage[ 3 ] =
 	"dsk3.dsk"
 };
 
+bool cDiskDevice::HighLevelDSR = false;
+
+// Step rates (ms) selected by bits 0-1 of the Type I commands
+static const UINT32 StepRate[ 4 ] = { 6, 6, 10, 20 };
+
 cDiskDevice::cDiskDevice( iCartridge *rom ) :
 	cBaseObject( "cDiskDevice" ),
 	cStateObject( ),
 	cDevice( rom ),
 	m_StepDirection( 0 ),
 	m_ClocksPerRev( 600000 ),
+	m_LastClocks( 0 ),
+	m_Clock( 0 ),
 	m_ClockStart( 0 ),
+	m_CommandEnd( 0 ),
+	m_DataOffset( 0 ),
+	m_TrackBytes( 0 ),
+	m_CommandID( 0 ),
+	m_IndexPulse( false ),
+	m_TypeIStatus( true ),
+	m_Events( ),
 	m_HardwareBits( 0 ),
 	m_DriveSelect( 0 ),
 	m_HeadSelect( 0 ),
 	m_TrackSelect( 0 ),
 	m_IsFD1771( true ),
 	m_TransferEnabled( false ),
+	m_DiskWriter( ),
 	m_CurDisk( nullptr ),
 	m_CurTrack( nullptr ),
 	m_CurSector( nullptr ),
@@ -72,7 +92,9 @@ cDiskDevice::cDiskDevice( iCartridge *rom ) :
 	m_BytesExpected( 0 ),
 	m_BytesLeft( 0 ),
 	m_ReadDataPtr( nullptr ),
-	m_CmdInProgress( CMD_NONE )
+	m_CmdInProgress( CMD_NONE ),
+	m_EntryPoints( ),
+	m_ReturnPending( false )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::cDiskDevice", true );
 
@@ -88,6 +110,10 @@ cDiskDevice::cDiskDevice( iCartridge *rom ) :
 	}
 
 	m_DataBuffer.reserve( MAX_TRACK_SIZE );
+
+	ScheduleEvent( 0, EVENT_INDEX_START );
+
+	FindEntryPoints( );
 }
 
 cDiskDevice::~cDiskDevice( )
@@ -98,6 +124,8 @@ cDiskDevice::~cDiskDevice( )
 	{
 		FlushDisk( m_DiskMedia[ i ]);
 	}
+
+	WaitForWrites( );
 }
 
 //----------------------------------------------------------------------------
@@ -143,6 +171,29 @@ bool cDiskDevice::ParseState( const sStateSection &state )
 	state.load( "ClocksPerRev", m_ClocksPerRev, SaveFormat::DECIMAL );
 	state.load( "ClockStart", m_ClockStart, SaveFormat::DECIMAL );
 
+	bool hasTiming = state.hasValue( "Clock" );
+
+	if( hasTiming )
+	{
+		state.load( "LastClocks", m_LastClocks, SaveFormat::DECIMAL );
+		state.load( "Clock", m_Clock, SaveFormat::DECIMAL );
+		state.load( "CommandEnd", m_CommandEnd, SaveFormat::DECIMAL );
+		state.load( "DataOffset", m_DataOffset, SaveFormat::DECIMAL );
+		state.load( "TrackBytes", m_TrackBytes, SaveFormat::DECIMAL );
+		state.load( "TypeIStatus", m_TypeIStatus );
+	}
+	else
+	{
+		// Older states don't have the rotational timing (ClockStart was a CPU clock) - start
+		// the disk turning again from here, a revolution in so a transfer can be rebuilt below
+		m_LastClocks = ( m_pCPU != nullptr ) ? m_pCPU->GetClocks( ) : 0;
+		m_Clock      = m_ClocksPerRev;
+		m_ClockStart = m_Clock;
+		m_CommandEnd = 0;
+		m_DataOffset = 0;
+		m_TrackBytes = 0;
+	}
+
 	state.load( "HardwareBits", m_HardwareBits, SaveFormat::DECIMAL );
 	state.load( "DriveSelect", m_DriveSelect, SaveFormat::DECIMAL );
 	state.load( "HeadSelect", m_HeadSelect, SaveFormat::DECIMAL );
@@ -157,6 +208,9 @@ bool cDiskDevice::ParseState( const sStateSection &state )
 	state.load( "TrackRegister", m_TrackRegister, SaveFormat::HEXADECIMAL );
 	state.load( "SectorRegister", m_SectorRegister, SaveFormat::HEXADECIMAL );
 
+	// Any updates still being written must land before the images are reloaded
+	WaitForWrites( );
+
 	for( size_t i = 0; i < SIZE( m_DiskMedia ); i++ )
 	{
 		auto disk = std::string( "DSK" ) + "123"[ i ];
@@ -211,6 +265,25 @@ bool cDiskDevice::ParseState( const sStateSection &state )
 
 	m_ReadDataPtr = state.hasValue( "ReadDataPtr" ) ? &m_DataBuffer[ m_BytesExpected - m_BytesLeft ] : nullptr;
 
+	// Time the rest of a transfer from an older state so the next byte is under the head now
+	if(( hasTiming == false ) && ( m_BytesLeft > 0 ))
+	{
+		size_t trackSize = ( m_CurTrack != nullptr ) ? m_CurTrack->GetSize( ) : 0;
+
+		m_TrackBytes = std::max<size_t>( std::max<size_t>( trackSize, m_BytesExpected ), TRACK_SIZE_FM );
+		m_ClockStart = m_Clock - ( m_BytesExpected - m_BytesLeft + 1 ) * m_ClocksPerRev / m_TrackBytes;
+	}
+
+	// Rebuild the event queue from the saved timing
+	m_Events = { };
+
+	ScheduleEvent( m_Clock - m_Clock % m_ClocksPerRev, EVENT_INDEX_START );
+
+	if( m_CommandEnd > m_Clock )
+	{
+		ScheduleEvent( m_CommandEnd, EVENT_COMMAND_DONE );
+	}
+
 	return true;
 }
 
@@ -231,6 +304,12 @@ std::optional<sStateSection> cDiskDevice::SaveState( )
 	save.store( "StepDirection", m_StepDirection, SaveFormat::DECIMAL );
 	save.store( "ClocksPerRev", m_ClocksPerRev, SaveFormat::DECIMAL );
 	save.store( "ClockStart", m_ClockStart, SaveFormat::DECIMAL );
+	save.store( "LastClocks", m_LastClocks, SaveFormat::DECIMAL );
+	save.store( "Clock", m_Clock, SaveFormat::DECIMAL );
+	save.store( "CommandEnd", m_CommandEnd, SaveFormat::DECIMAL );
+	save.store( "DataOffset", m_DataOffset, SaveFormat::DECIMAL );
+	save.store( "TrackBytes", m_TrackBytes, SaveFormat::DECIMAL );
+	save.store( "TypeIStatus", m_TypeIStatus );
 
 	save.store( "HardwareBits", m_HardwareBits, SaveFormat::DECIMAL );
 	save.store( "DriveSelect", m_DriveSelect, SaveFormat::DECIMAL );
@@ -255,6 +334,9 @@ std::optional<sStateSection> cDiskDevice::SaveState( )
 		}
 	}
 
+	// Make sure the images on disk match the saved state
+	WaitForWrites( );
+
 	save.store( "LastData", m_LastData, SaveFormat::HEXADECIMAL );
 	save.store( "BytesExpected", m_BytesExpected, SaveFormat::DECIMAL );
 	save.store( "BytesLeft", m_BytesLeft, SaveFormat::DECIMAL );
@@ -421,6 +503,15 @@ void cDiskDevice::LoadDisk( int index, const char *filename )
 
 	DBG_EVENT( "Loading file: " << filename );
 
+	FlushDisk( m_DiskMedia[ index ]);
+
+	// Updates to the old image have to land (or be saved in full) before it's replaced, and the
+	// new image may be one that is still being written
+	if( m_DiskMedia[ index ]->HasPendingWrites( ) || m_DiskWriter.IsPending( cDiskMedia::LocateImage( filename )))
+	{
+		WaitForWrites( );
+	}
+
 	if( m_DiskMedia[ index ]->LoadFile( filename, FORMAT_UNKNOWN ) == true )
 	{
 		DBG_EVENT( "Disk image loaded successfully" );
@@ -445,14 +536,29 @@ void cDiskDevice::UnLoadDisk( int index )
 
 	DBG_EVENT( "Removing disk: " << m_DiskMedia[ index ]->GetName( ));
 
+	// Anything that can't be written back in the background is saved before the image goes
+	FlushDisk( m_DiskMedia[ index ]);
+
+	if( m_DiskMedia[ index ]->HasPendingWrites( ))
+	{
+		WaitForWrites( );
+	}
+
 	m_DiskMedia[ index ]->ClearDisk( );
 }
 
-void cDiskDevice::FlushDisk( cRefPtr<cDiskMedia> &diskMedia )
+void cDiskDevice::FlushDisk( cRefPtr<cDiskMedia> &diskMedia, bool background )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::FlushDisk", true );
 
-	if( diskMedia->HasChanged( ) && ( diskMedia->SaveFile( ) == false ))
+	if( diskMedia->HasChanged( ) == false )
+	{
+		return;
+	}
+
+	bool saved = background ? diskMedia->SaveFile( &m_DiskWriter ) : diskMedia->SaveFile( );
+
+	if( saved == false )
 	{
 		std::string homePath = GetHomePath( "disks" );
 
@@ -464,6 +570,38 @@ void cDiskDevice::FlushDisk( cRefPtr<cDiskMedia> &diskMedia )
 	}
 }
 
+// Queue the changes a write just made so they reach the host while emulation carries on
+// (images that can't be updated in place are saved when they're flushed instead)
+void cDiskDevice::QueueWrites( cDiskMedia *diskMedia )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::QueueWrites", true );
+
+	if(( diskMedia != nullptr ) && diskMedia->HasChanged( ))
+	{
+		diskMedia->QueueUpdate( &m_DiskWriter );
+	}
+}
+
+// Wait for the writer to finish, then save any image whose update it couldn't commit
+void cDiskDevice::WaitForWrites( )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::WaitForWrites", true );
+
+	if( m_DiskWriter.Barrier( ) == false )
+	{
+		DBG_WARNING( "Unable to write back some disk changes" );
+	}
+
+	// This also lets each image forget the updates that were committed
+	for( size_t i = 0; i < SIZE( m_DiskMedia ); i++ )
+	{
+		if( m_DiskMedia[ i ]->CheckWrites( &m_DiskWriter, true ) == false )
+		{
+			FlushDisk( m_DiskMedia[ i ], false );
+		}
+	}
+}
+
 void cDiskDevice::FindSector( )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::FindSector", true );
@@ -486,12 +624,12 @@ void cDiskDevice::CompleteCommand( )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::CompleteCommand", true );
 
-	m_ClockStart = 0;
-
 	switch( m_CmdInProgress )
 	{
 		case CMD_NONE :
 			break;
+		case CMD_SEARCH :
+			break;
 		case CMD_READ_ADDRESS :
 			break;
 		case CMD_READ_TRACK :
@@ -503,6 +641,7 @@ void cDiskDevice::CompleteCommand( )
 			{
 				m_StatusRegister |= STATUS_LOST_DATA;
 				m_CurTrack->Write( track::Format::FM, m_DataBuffer );
+				QueueWrites( m_CurDisk );
 			}
 			break;
 		case CMD_WRITE_SECTOR :
@@ -510,6 +649,7 @@ void cDiskDevice::CompleteCommand( )
 			{
 				m_StatusRegister |= STATUS_LOST_DATA;
 				m_CurSector->Write( m_DataMark, m_DataBuffer );
+				QueueWrites( m_CurDisk );
 			}
 			break;
 	}
@@ -527,6 +667,9 @@ UINT8 cDiskDevice::ReadByte( )
 
 	if( m_ReadDataPtr != nullptr )
 	{
+		// Wait for the byte to pass under the head
+		HoldCPU( ByteTime( m_BytesExpected - m_BytesLeft + 1 ));
+
 		retVal = *m_ReadDataPtr++;
 
 		if( --m_BytesLeft == 0 )
@@ -535,9 +678,10 @@ UINT8 cDiskDevice::ReadByte( )
 			m_ReadDataPtr = nullptr;
 		}
 	}
-	else
+	else if( m_TransferEnabled && ( m_StatusRegister & STATUS_BUSY ))
 	{
-		// Set error?
+		// Nothing to read - READY is released when the command finishes
+		HoldCPU( m_CommandEnd );
 	}
 
 	return retVal;
@@ -551,6 +695,9 @@ void cDiskDevice::WriteByte( UINT8 val )
 
 	if( m_BytesLeft > 0 )
 	{
+		// Wait for the controller to ask for the byte
+		HoldCPU( ByteTime( m_BytesExpected - m_BytesLeft ));
+
 		m_DataBuffer.push_back( val );
 
 		if( --m_BytesLeft == 0 )
@@ -564,6 +711,7 @@ void cDiskDevice::WriteByte( UINT8 val )
 			{
 				m_CurSector->Write( m_DataMark, m_DataBuffer );
 			}
+			QueueWrites( m_CurDisk );
 		}
 	}
 	else
@@ -703,9 +851,11 @@ void cDiskDevice::ReadSector( UINT8 cmd )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::ReadSector", true );
 
-	FindSector( );
+	UINT64 start = SearchStart( cmd );
 
-	if(( m_CurSector != nullptr ) && ( m_CurSector->ValidID( )))
+	m_CurSector = NextSector( start, m_SectorRegister );
+
+	if( m_CurSector != nullptr )
 	{
 		DBG_EVENT( " C:" << m_CurSector->LogicalCylinder( )
 		        << " H:" << m_CurSector->LogicalHead( )
@@ -735,11 +885,12 @@ void cDiskDevice::ReadSector( UINT8 cmd )
 			m_StatusRegister |= STATUS_CRC_ERROR;
 		}
 		m_CmdInProgress = CMD_READ_SECTOR;
+
+		StartTransfer( m_CurSector, start );
 	}
 	else
 	{
-		// ?? set up a dummy buffer & error status ??
-		m_StatusRegister |= STATUS_NOT_FOUND;
+		RecordNotFound( start );
 	}
 
 	if( cmd & 0x10 )
@@ -758,7 +909,9 @@ void cDiskDevice::WriteSector( UINT8 cmd )
 		return;
 	}
 
-	FindSector( );
+	UINT64 start = SearchStart( cmd );
+
+	m_CurSector = NextSector( start, m_SectorRegister );
 
 	if( m_CurSector != nullptr )
 	{
@@ -783,10 +936,12 @@ void cDiskDevice::WriteSector( UINT8 cmd )
 			m_DataMark = ( cmd & 0x01 ) ? 0xF8 : 0xFB;
 		}
 		m_CmdInProgress = CMD_WRITE_SECTOR;
+
+		StartTransfer( m_CurSector, start );
 	}
 	else
 	{
-		m_StatusRegister |= STATUS_NOT_FOUND;
+		RecordNotFound( start );
 	}
 
 	if( cmd & 0x10 )
@@ -795,11 +950,14 @@ void cDiskDevice::WriteSector( UINT8 cmd )
 	}
 }
 
-void cDiskDevice::ReadAddress( UINT8 )
+void cDiskDevice::ReadAddress( UINT8 cmd )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::ReadAddress", true );
 
-	FindSector( );
+	UINT64 start = SearchStart( cmd );
+
+	// Return the first ID field that comes around under the head
+	m_CurSector = NextSector( start, -1 );
 
 	if( m_CurSector != nullptr )
 	{
@@ -809,21 +967,27 @@ void cDiskDevice::ReadAddress( UINT8 )
 		m_ReadDataPtr     = &m_DataBuffer[ 0 ];
 		m_StatusRegister |= STATUS_BUSY;
 		m_StatusRegister &= ~STATUS_NOT_FOUND;
+		if( !m_CurSector->ValidID( ))
+		{
+			m_StatusRegister |= STATUS_CRC_ERROR;
+		}
 
 		m_CmdInProgress   = CMD_READ_ADDRESS;
+
+		size_t offset = m_CurTrack->GetOffset( m_CurSector );
+
+		StartTransfer( offset, offset + 1, m_CurTrack->GetSize( ), start );
 	}
 	else
 	{
-		m_StatusRegister |= STATUS_NOT_FOUND;
+		RecordNotFound( start );
 	}
 }
 
-void cDiskDevice::ReadTrack( UINT8 )
+void cDiskDevice::ReadTrack( UINT8 cmd )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::ReadTrack", true );
 
-	m_ClockStart = m_pCPU->GetClocks( );
-
 	m_CurTrack = m_CurDisk ? m_CurDisk->GetTrack( m_TrackSelect, m_HeadSelect ) : nullptr;
 	m_CurSector = nullptr;
 
@@ -842,6 +1006,10 @@ void cDiskDevice::ReadTrack( UINT8 )
 		m_StatusRegister |= STATUS_BUSY;
 		m_StatusRegister &= ~STATUS_NOT_FOUND;
 		m_CmdInProgress   = CMD_READ_TRACK;
+
+		// The track is read from one index pulse to the next
+		StartTransfer( 0, 0, m_DataBuffer.size( ), SearchStart( cmd ));
+		ScheduleCompletion( m_ClockStart + m_ClocksPerRev );
 	}
 	else
 	{
@@ -852,7 +1020,7 @@ void cDiskDevice::ReadTrack( UINT8 )
 	}
 }
 
-void cDiskDevice::WriteTrack( UINT8 )
+void cDiskDevice::WriteTrack( UINT8 cmd )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::WriteTrack", true );
 
@@ -861,8 +1029,6 @@ void cDiskDevice::WriteTrack( UINT8 )
 		return;
 	}
 
-	m_ClockStart = m_pCPU->GetClocks( );
-
 	m_CurTrack = m_CurDisk ? m_CurDisk->GetTrack( m_TrackSelect, m_HeadSelect ) : nullptr;
 	m_CurSector = nullptr;
 
@@ -875,6 +1041,10 @@ void cDiskDevice::WriteTrack( UINT8 )
 		m_StatusRegister |= STATUS_BUSY;
 		m_StatusRegister &= ~STATUS_NOT_FOUND;
 		m_CmdInProgress   = CMD_WRITE_TRACK;
+
+		// The track is written from one index pulse to the next
+		StartTransfer( 0, 0, TRACK_SIZE_FM, SearchStart( cmd ));
+		ScheduleCompletion( m_ClockStart + m_ClocksPerRev );
 	}
 	else
 	{
@@ -898,6 +1068,13 @@ void cDiskDevice::HandleCommand( UINT8 cmd )
 	// Make sure the previous command has completed
 	CompleteCommand( );
 
+	// Anything still scheduled for the previous command no longer applies
+	m_CommandID++;
+	m_CommandEnd  = 0;
+	m_TypeIStatus = (( cmd & 0x80 ) == 0 ) || (( cmd & 0xF0 ) == 0xD0 );
+
+	int track = m_TrackSelect;
+
 	switch( cmd & 0xF0 )
 	{
 		// Type I commands
@@ -961,6 +1138,660 @@ void cDiskDevice::HandleCommand( UINT8 cmd )
 			DBG_ERROR( "PC: " << hex << m_pCPU->GetPC( ) << " Unknown command: " << hex << ( UINT8 ) ( cmd & 0xF0 ));
 			return;
 	}
+
+	// Type I commands stay busy while the head steps and settles
+	if(( cmd & 0x80 ) == 0 )
+	{
+		UINT32 steps = std::abs( m_TrackSelect - track );
+		UINT32 delay = steps * StepRate[ cmd & 0x03 ] + (( cmd & 0x04 ) ? HEAD_SETTLE_MS : 0 );
+
+		if( delay > 0 )
+		{
+			m_StatusRegister |= STATUS_BUSY;
+			ScheduleCompletion( m_Clock + delay * ( m_ClocksPerRev / MS_PER_REV ));
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Rotational timing
+//
+// The controller only runs when the CPU touches its registers.  Each access
+// first brings it up to the CPU's clock, handling the events (index pulses
+// and commands finishing) that have come due since the last one in order.
+// Data transfers are timed from where the field sits on the track, and the
+// CPU is held in wait states until each byte has reached the head.
+//----------------------------------------------------------------------------
+
+void cDiskDevice::UpdateClock( )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::UpdateClock", false );
+
+	UINT32 clocks = m_pCPU->GetClocks( );
+
+	m_Clock     += static_cast<UINT32>( clocks - m_LastClocks );
+	m_LastClocks = clocks;
+
+	while( !m_Events.empty( ) && ( m_Events.top( ).time <= m_Clock ))
+	{
+		sEvent event = m_Events.top( );
+		m_Events.pop( );
+
+		HandleEvent( event );
+	}
+}
+
+void cDiskDevice::HandleEvent( const sEvent &event )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::HandleEvent", false );
+
+	switch( event.type )
+	{
+		case EVENT_INDEX_START :
+			m_IndexPulse = true;
+			m_Events.push({ event.time + m_ClocksPerRev * INDEX_PULSE_DEGREES / 360, EVENT_INDEX_END, event.command });
+			m_Events.push({ event.time + m_ClocksPerRev, EVENT_INDEX_START, event.command });
+			break;
+		case EVENT_INDEX_END :
+			m_IndexPulse = false;
+			break;
+		case EVENT_COMMAND_DONE :
+			if( event.command == m_CommandID )
+			{
+				if( m_CmdInProgress == CMD_SEARCH )
+				{
+					DBG_WARNING( "Record not found - T:" << m_TrackRegister << " S:" << m_SectorRegister );
+					m_StatusRegister |= STATUS_NOT_FOUND;
+				}
+				CompleteCommand( );
+			}
+			break;
+	}
+}
+
+void cDiskDevice::ScheduleEvent( UINT64 time, EVENT_TYPE_E type )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::ScheduleEvent", false );
+
+	m_Events.push({ time, type, m_CommandID });
+}
+
+void cDiskDevice::ScheduleCompletion( UINT64 time )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::ScheduleCompletion", false );
+
+	m_CommandEnd = time;
+
+	ScheduleEvent( time, EVENT_COMMAND_DONE );
+}
+
+void cDiskDevice::HoldCPU( UINT64 time )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::HoldCPU", false );
+
+	// The controller holds READY low until it's ready, so charge the CPU for the wait
+	if( time > m_Clock )
+	{
+		m_pCPU->AddClocks( static_cast<int>( time - m_Clock ));
+		UpdateClock( );
+	}
+}
+
+UINT64 cDiskDevice::SearchStart( UINT8 cmd ) const
+{
+	// The 'E' flag delays the start of Type II/III commands while the head settles
+	return m_Clock + (( cmd & 0x04 ) ? HEAD_SETTLE_MS * ( m_ClocksPerRev / MS_PER_REV ) : 0 );
+}
+
+UINT64 cDiskDevice::NextRevolution( UINT64 time ) const
+{
+	return ( time + m_ClocksPerRev - 1 ) / m_ClocksPerRev * m_ClocksPerRev;
+}
+
+UINT64 cDiskDevice::ByteTime( size_t index ) const
+{
+	return m_ClockStart + ( m_DataOffset + index ) * m_ClocksPerRev / m_TrackBytes;
+}
+
+bool cDiskDevice::DataRequest( ) const
+{
+	switch( m_CmdInProgress )
+	{
+		case CMD_READ_ADDRESS :
+		case CMD_READ_TRACK :
+		case CMD_READ_SECTOR :
+			return ( m_BytesLeft > 0 ) && ( m_Clock >= ByteTime( m_BytesExpected - m_BytesLeft + 1 ));
+		case CMD_WRITE_TRACK :
+		case CMD_WRITE_SECTOR :
+			return ( m_BytesLeft > 0 ) && ( m_Clock >= ByteTime( m_BytesExpected - m_BytesLeft ));
+		default :
+			return false;
+	}
+}
+
+// Find the first matching sector (any sector if logicalSector is -1) to reach the head after the given time
+iDiskSector *cDiskDevice::NextSector( UINT64 time, int logicalSector ) const
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::NextSector", true );
+
+	if(( m_CurTrack == nullptr ) || ( m_CurTrack->GetSize( ) == 0 ))
+	{
+		return nullptr;
+	}
+
+	iDiskSector *next = nullptr;
+	UINT64 nextWait   = 0;
+
+	UINT64 position = time % m_ClocksPerRev;
+
+	for( auto sector : m_CurTrack->GetSectors( ))
+	{
+		if(( logicalSector != -1 ) && (( sector->Matches( m_TrackRegister, -1, logicalSector ) == false ) || ( sector->ValidID( ) == false )))
+		{
+			continue;
+		}
+
+		UINT64 offset = m_CurTrack->GetOffset( sector ) * m_ClocksPerRev / m_CurTrack->GetSize( );
+		UINT64 wait   = ( offset + m_ClocksPerRev - position ) % m_ClocksPerRev;
+
+		if(( next == nullptr ) || ( wait < nextWait ))
+		{
+			next     = sector;
+			nextWait = wait;
+		}
+	}
+
+	return next;
+}
+
+// Time the transfer from the first revolution after 'time' in which the ID at idOffset passes the head
+void cDiskDevice::StartTransfer( size_t idOffset, size_t dataOffset, size_t trackBytes, UINT64 time )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::StartTransfer", true );
+
+	UINT64 position = idOffset * m_ClocksPerRev / trackBytes;
+
+	m_ClockStart = ( time > position ) ? NextRevolution( time - position ) : 0;
+	m_DataOffset = dataOffset;
+	m_TrackBytes = trackBytes;
+}
+
+void cDiskDevice::StartTransfer( const iDiskSector *sector, UINT64 time )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::StartTransfer", true );
+
+	size_t offset = m_CurTrack->GetOffset( sector );
+
+	// A sector without a data field is timed as if the data followed the ID
+	size_t data = ( sector->GetData( ) != nullptr ) ? offset + 1 + ( sector->GetData( ) - sector->GetID( )) : offset + 7;
+
+	StartTransfer( offset, data, m_CurTrack->GetSize( ), time );
+}
+
+void cDiskDevice::RecordNotFound( UINT64 time )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::RecordNotFound", true );
+
+	// Without a disk there is nothing turning to search
+	if(( m_CurTrack == nullptr ) || ( m_CurDisk == nullptr ))
+	{
+		m_StatusRegister |= STATUS_NOT_FOUND;
+		return;
+	}
+
+	// Keep looking until the index hole has gone by RNF_REVOLUTIONS times
+	m_StatusRegister |= STATUS_BUSY;
+	m_StatusRegister &= ~STATUS_NOT_FOUND;
+	m_CmdInProgress   = CMD_SEARCH;
+
+	ScheduleCompletion( NextRevolution( time ) + ( RNF_REVOLUTIONS - 1 ) * m_ClocksPerRev );
+}
+
+//----------------------------------------------------------------------------
+// High-level DSR support
+//
+// When HighLevelDSR is set, the opcode fetch at the entry of the DSR's sector
+// I/O (>10), file input (>14) & file output (>15) subprograms and the DSKn
+// device routine is trapped.  If the request can be serviced directly from the disk image, the
+// data is copied to/from VDP RAM, the results are stored where the ROM would
+// leave them, and the fetched opcode is replaced with a B *R11 back to the
+// caller's 'handled' return.  Anything else (errors included) falls through
+// to the ROM and the register-level FD1771 emulation.
+//----------------------------------------------------------------------------
+
+void cDiskDevice::FindEntryPoints( )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::FindEntryPoints", true );
+
+	if( m_IsValid == false )
+	{
+		return;
+	}
+
+	auto readByte = [&]( ADDRESS address ) -> UINT8
+	{
+		const UINT8 *data = m_pROM->GetCpuMemory( address / ROM_BANK_SIZE )->Bank[ 0 ].Data;
+		return ( data != nullptr ) ? data[ address % ROM_BANK_SIZE ] : 0x00;
+	};
+
+	auto readWord = [&]( ADDRESS address ) -> ADDRESS
+	{
+		return ( ADDRESS ) (( readByte( address ) << 8 ) | readByte( address + 1 ));
+	};
+
+	if( readByte( 0x4000 ) != 0xAA )
+	{
+		DBG_WARNING( "DSR header not found" );
+		return;
+	}
+
+	// Each list entry is: link, entry address, name length, name
+	auto walkList = [&]( ADDRESS list, auto callback )
+	{
+		ADDRESS node = readWord( list );
+		for( int i = 0; ( i < 32 ) && ( node >= 0x4000 ) && ( node < REG_STATUS ); i++ )
+		{
+			ADDRESS entry = readWord( node + 2 );
+			std::string name;
+			for( int j = 0; j < readByte( node + 4 ); j++ )
+			{
+				name += ( char ) readByte( node + 5 + j );
+			}
+			if(( entry >= 0x4000 ) && ( entry < REG_STATUS ) && (( entry & 1 ) == 0 ))
+			{
+				callback( entry, name );
+			}
+			node = readWord( node );
+		}
+	};
+
+	walkList( 0x4008, [&]( ADDRESS entry, const std::string &name )
+	{
+		if(( name.size( ) == 4 ) && ( name.compare( 0, 3, "DSK" ) == 0 ) && ( name[ 3 ] >= '1' ) && ( name[ 3 ] <= '3' ))
+		{
+			m_EntryPoints[ entry ] = ENTRY_DEVICE;
+		}
+	});
+
+	walkList( 0x400A, [&]( ADDRESS entry, const std::string &name )
+	{
+		if( name == "\x10" )
+		{
+			m_EntryPoints[ entry ] = ENTRY_SECTOR_IO;
+		}
+		else if( name == "\x14" )
+		{
+			m_EntryPoints[ entry ] = ENTRY_FILE_INPUT;
+		}
+		else if( name == "\x15" )
+		{
+			m_EntryPoints[ entry ] = ENTRY_FILE_OUTPUT;
+		}
+	});
+
+	DBG_EVENT( "Found " << m_EntryPoints.size( ) << " DSR entry points" );
+}
+
+iDiskSector *cDiskDevice::FindLogicalSector( int drive, int index )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::FindLogicalSector", true );
+
+	cDiskMedia *disk = m_DiskMedia[ drive ];
+
+	// Use the same sectors per track as cDiskFileSystem::FindSector
+	int trackSize = 9;
+	if( iSector *vib = disk->GetSector( 0, 0, 0 ))
+	{
+		const UINT8 *data = vib->GetData( );
+		if(( data != nullptr ) && ( data[ offsetof( VIB, SectorsPerTrack ) ] != 0 ))
+		{
+			trackSize = data[ offsetof( VIB, SectorsPerTrack ) ];
+		}
+	}
+
+	return disk->GetLogicalSector( index, trackSize );
+}
+
+cRefPtr<cFile> cDiskDevice::OpenFile( int drive, const std::string &name )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::OpenFile", true );
+
+	cRefPtr<cDiskFileSystem> disk = new cDiskFileSystem( m_DiskMedia[ drive ]);
+
+	if(( disk->IsValid( ) == false ) || name.empty( ))
+	{
+		return nullptr;
+	}
+
+	return disk->OpenFile( name.c_str( ), -1 );
+}
+
+// Open the file named by the space padded name at namePtr in VDP RAM
+cRefPtr<cFile> cDiskDevice::OpenFile( int drive, ADDRESS namePtr )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::OpenFile", true );
+
+	const UINT8 *vdp = m_pComputer->GetVideoMemory( );
+
+	std::string name;
+	for( int i = 0; i < MAX_FILENAME; i++ )
+	{
+		name += ( char ) vdp[ ( namePtr + i ) & 0x3FFF ];
+	}
+	name.erase( name.find_last_not_of( ' ' ) + 1 );
+
+	return OpenFile( drive, name );
+}
+
+// Subprogram >10 - Sector read/write
+//   >834C drive, >834D read (0=write), >834E VDP buffer, >8350 sector
+bool cDiskDevice::SectorIO( )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::SectorIO", true );
+
+	int drive      = cpuMemory.ReadByte( 0x834C );
+	bool isRead    = cpuMemory.ReadByte( 0x834D ) != 0;
+	ADDRESS buffer = cpuMemory.ReadWord( 0x834E );
+	int index      = cpuMemory.ReadWord( 0x8350 );
+
+	if(( drive < 1 ) || ( drive > 3 ))
+	{
+		return false;
+	}
+
+	iDiskSector *sector = FindLogicalSector( drive - 1, index );
+	if(( sector == nullptr ) || ( sector->Size( ) != DEFAULT_SECTOR_SIZE ) || ( sector->GetData( ) == nullptr ))
+	{
+		return false;
+	}
+
+	if( isRead )
+	{
+		if( !sector->ValidData( ))
+		{
+			return false;
+		}
+		m_pComputer->GetVDP( )->WriteMemory( buffer, sector->GetData( ), DEFAULT_SECTOR_SIZE );
+	}
+	else
+	{
+		if( m_DiskMedia[ drive - 1 ]->IsWriteProtected( ))
+		{
+			return false;
+		}
+		const UINT8 *vdp = m_pComputer->GetVideoMemory( );
+		sDataBuffer data( DEFAULT_SECTOR_SIZE );
+		for( int i = 0; i < DEFAULT_SECTOR_SIZE; i++ )
+		{
+			data[ i ] = vdp[ ( buffer + i ) & 0x3FFF ];
+		}
+		sector->Write( data );
+		QueueWrites( m_DiskMedia[ drive - 1 ]);
+	}
+
+	DBG_EVENT( "DSK" << drive << ( isRead ? " read" : " write" ) << " sector " << index );
+
+	cpuMemory.WriteWord( 0x834A, ( UINT16 ) index );
+	cpuMemory.WriteByte( 0x8350, 0 );
+
+	m_pCPU->AddClocks( DSR_CLOCKS_PER_CALL + DSR_CLOCKS_PER_SECTOR );
+
+	return true;
+}
+
+// Subprogram >14 - File input
+//   >834C drive, >834D # sectors (0=get file info), >834E VDP pointer to name,
+//   >8350 scratch pad offset of the info block (VDP buffer, first sector, ...)
+bool cDiskDevice::FileInput( )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::FileInput", true );
+
+	int drive       = cpuMemory.ReadByte( 0x834C );
+	int count       = cpuMemory.ReadByte( 0x834D );
+	ADDRESS namePtr = cpuMemory.ReadWord( 0x834E );
+	ADDRESS info    = 0x8300 + cpuMemory.ReadByte( 0x8350 );
+
+	if(( drive < 1 ) || ( drive > 3 ))
+	{
+		return false;
+	}
+
+	cRefPtr<cFile> file = OpenFile( drive - 1, namePtr );
+	if( file == nullptr )
+	{
+		return false;
+	}
+
+	const UINT8 *fdr = reinterpret_cast<const UINT8 *>( file->GetFDR( ));
+
+	if( count == 0 )
+	{
+		// # sectors, flags, records/sector, EOF offset, record length, # records
+		cpuMemory.WriteByte( info + 2, fdr[ 14 ] );
+		cpuMemory.WriteByte( info + 3, fdr[ 15 ] );
+		cpuMemory.WriteByte( info + 4, fdr[ 12 ] );
+		cpuMemory.WriteByte( info + 5, fdr[ 13 ] );
+		for( int i = 0; i < 4; i++ )
+		{
+			cpuMemory.WriteByte( info + 6 + i, fdr[ 16 + i ] );
+		}
+	}
+	else
+	{
+		ADDRESS buffer = cpuMemory.ReadWord( info );
+		int first      = cpuMemory.ReadWord( info + 2 );
+
+		if( first + count > file->TotalSectors( ))
+		{
+			return false;
+		}
+
+		UINT8 data[ DEFAULT_SECTOR_SIZE ];
+		for( int i = 0; i < count; i++ )
+		{
+			if( file->ReadSector( first + i, data ) < 0 )
+			{
+				return false;
+			}
+			m_pComputer->GetVDP( )->WriteMemory( buffer + i * DEFAULT_SECTOR_SIZE, data, DEFAULT_SECTOR_SIZE );
+		}
+	}
+
+	DBG_EVENT( "DSK" << drive << " file input '" << file->GetName( ) << "' " << count << " sectors" );
+
+	cpuMemory.WriteByte( 0x834D, ( UINT8 ) count );
+	cpuMemory.WriteByte( 0x8350, 0 );
+
+	m_pCPU->AddClocks( DSR_CLOCKS_PER_CALL + count * DSR_CLOCKS_PER_SECTOR );
+
+	return true;
+}
+
+// Subprogram >15 - File output
+//   Same parameters as >14.  Creating the file (# sectors = 0) and anything that
+//   needs sectors the file doesn't already have is left to the ROM.
+bool cDiskDevice::FileOutput( )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::FileOutput", true );
+
+	int drive       = cpuMemory.ReadByte( 0x834C );
+	int count       = cpuMemory.ReadByte( 0x834D );
+	ADDRESS namePtr = cpuMemory.ReadWord( 0x834E );
+	ADDRESS info    = 0x8300 + cpuMemory.ReadByte( 0x8350 );
+
+	if(( drive < 1 ) || ( drive > 3 ) || ( count == 0 ))
+	{
+		return false;
+	}
+
+	if( m_DiskMedia[ drive - 1 ]->IsWriteProtected( ))
+	{
+		return false;
+	}
+
+	cRefPtr<cFile> file = OpenFile( drive - 1, namePtr );
+	if( file == nullptr )
+	{
+		return false;
+	}
+
+	ADDRESS buffer = cpuMemory.ReadWord( info );
+	int first      = cpuMemory.ReadWord( info + 2 );
+
+	if( first + count > file->TotalSectors( ))
+	{
+		return false;
+	}
+
+	const UINT8 *vdp = m_pComputer->GetVideoMemory( );
+
+	UINT8 data[ DEFAULT_SECTOR_SIZE ];
+	for( int i = 0; i < count; i++ )
+	{
+		for( int j = 0; j < DEFAULT_SECTOR_SIZE; j++ )
+		{
+			data[ j ] = vdp[ ( buffer + i * DEFAULT_SECTOR_SIZE + j ) & 0x3FFF ];
+		}
+		if( file->WriteSector( first + i, data ) < 0 )
+		{
+			return false;
+		}
+	}
+
+	QueueWrites( m_DiskMedia[ drive - 1 ]);
+
+	DBG_EVENT( "DSK" << drive << " file output '" << file->GetName( ) << "' " << count << " sectors" );
+
+	cpuMemory.WriteByte( 0x834D, ( UINT8 ) count );
+	cpuMemory.WriteByte( 0x8350, 0 );
+
+	m_pCPU->AddClocks( DSR_CLOCKS_PER_CALL + count * DSR_CLOCKS_PER_SECTOR );
+
+	return true;
+}
+
+// DSKn device - only the LOAD opcode is handled, everything else goes to the ROM
+//   >8354 length of the device name, >8356 VDP pointer to the end of the device name
+bool cDiskDevice::LoadProgram( )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::LoadProgram", true );
+
+	const UINT8 *vdp = m_pComputer->GetVideoMemory( );
+
+	auto vdpByte = [&]( ADDRESS address ) -> UINT8 { return vdp[ address & 0x3FFF ]; };
+	auto vdpWord = [&]( ADDRESS address ) -> UINT16 { return ( UINT16 ) (( vdpByte( address ) << 8 ) | vdpByte( address + 1 )); };
+
+	ADDRESS pab = cpuMemory.ReadWord( 0x8356 ) - cpuMemory.ReadWord( 0x8354 ) - 10;
+
+	if( vdpByte( pab ) != 0x05 )
+	{
+		return false;
+	}
+
+	std::string name;
+	for( int i = 0; i < vdpByte( pab + 9 ); i++ )
+	{
+		name += ( char ) vdpByte( pab + 10 + i );
+	}
+
+	if(( name.size( ) < 6 ) || ( name.compare( 0, 3, "DSK" ) != 0 ) || ( name[ 4 ] != '.' ))
+	{
+		return false;
+	}
+
+	int drive = name[ 3 ] - '1';
+	if(( drive < 0 ) || ( drive > 2 ))
+	{
+		return false;
+	}
+
+	cRefPtr<cFile> file = OpenFile( drive, name.substr( 5 ));
+	if(( file == nullptr ) || ( file->IsProgram( ) == false ))
+	{
+		return false;
+	}
+
+	ADDRESS buffer = vdpWord( pab + 2 );
+	int size       = file->FileSize( );
+
+	if( size > vdpWord( pab + 6 ))
+	{
+		return false;
+	}
+
+	UINT8 data[ DEFAULT_SECTOR_SIZE ];
+	for( int offset = 0; offset < size; offset += DEFAULT_SECTOR_SIZE )
+	{
+		if( file->ReadSector( offset / DEFAULT_SECTOR_SIZE, data ) < 0 )
+		{
+			return false;
+		}
+		m_pComputer->GetVDP( )->WriteMemory( buffer + offset, data, std::min( size - offset, DEFAULT_SECTOR_SIZE ));
+	}
+
+	DBG_EVENT( "LOAD '" << name << "' " << size << " bytes" );
+
+	// Clear the error bits in the PAB
+	UINT8 status = vdpByte( pab + 1 ) & 0x1F;
+	m_pComputer->GetVDP( )->WriteMemory( pab + 1, &status, 1 );
+
+	m_pCPU->AddClocks( DSR_CLOCKS_PER_CALL + file->TotalSectors( ) * DSR_CLOCKS_PER_SECTOR );
+
+	return true;
+}
+
+UINT8 cDiskDevice::ReadEntryPoint( ADDRESS address, UINT8 value )
+{
+	FUNCTION_ENTRY( this, "cDiskDevice::ReadEntryPoint", false );
+
+	// Second half of the opcode fetch - finish replacing it with B *R11
+	if( address & 1 )
+	{
+		if( m_ReturnPending == true )
+		{
+			m_ReturnPending = false;
+			return 0x5B;
+		}
+		return value;
+	}
+
+	// Only intercept the fetch that enters the routine
+	auto entry = m_EntryPoints.find( address );
+	if(( entry == m_EntryPoints.end( )) || ( m_pCPU->GetPC( ) != address ))
+	{
+		return value;
+	}
+
+	bool handled = false;
+
+	switch( entry->second )
+	{
+		case ENTRY_SECTOR_IO :
+			handled = SectorIO( );
+			break;
+		case ENTRY_FILE_INPUT :
+			handled = FileInput( );
+			break;
+		case ENTRY_FILE_OUTPUT :
+			handled = FileOutput( );
+			break;
+		case ENTRY_DEVICE :
+			handled = LoadProgram( );
+			break;
+	}
+
+	if( handled == false )
+	{
+		return value;
+	}
+
+	// Return past the caller's 'not handled' instruction
+	ADDRESS r11 = m_pCPU->GetWP( ) + 2 * 11;
+	cpuMemory.WriteWord( r11, cpuMemory.ReadWord( r11 ) + 2 );
+
+	m_ReturnPending = true;
+
+	return 0x04;
 }
 
 //----------------------------------------------------------------------------
@@ -979,12 +1810,22 @@ void cDiskDevice::ActivateInternal( )
 	m_pCPU->SetTrap( 0x5FFA, ( UINT8 ) MEMFLG_TRAP_WRITE, m_TrapIndex );
 	m_pCPU->SetTrap( 0x5FFC, ( UINT8 ) MEMFLG_TRAP_WRITE, m_TrapIndex );
 	m_pCPU->SetTrap( 0x5FFE, ( UINT8 ) MEMFLG_TRAP_WRITE, m_TrapIndex );
+
+	if( HighLevelDSR == true )
+	{
+		for( auto &entry : m_EntryPoints )
+		{
+			m_pCPU->SetTrap( entry.first, ( UINT8 ) MEMFLG_TRAP_READ, m_TrapIndex );
+		}
+	}
 }
 
 UINT8 cDiskDevice::WriteMemory( ADDRESS address, UINT8 val )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::WriteMemory", true );
 
+	UpdateClock( );
+
 	val ^= 0xFF;
 
 	switch( address )
@@ -1010,27 +1851,32 @@ UINT8 cDiskDevice::WriteMemory( ADDRESS address, UINT8 val )
 	return ( UINT8 ) ( val ^ 0xFF );
 }
 
-UINT8 cDiskDevice::ReadMemory( ADDRESS address, UINT8 )
+UINT8 cDiskDevice::ReadMemory( ADDRESS address, UINT8 value )
 {
 	FUNCTION_ENTRY( this, "cDiskDevice::ReadMemory", true );
 
+	if( address < REG_STATUS )
+	{
+		return ReadEntryPoint( address, value );
+	}
+
+	UpdateClock( );
+
 	UINT8 retVal = 0xFF;
 
 	switch( address )
 	{
 		case REG_STATUS :
-			if(( m_ClockStart != 0 ) && ( m_pCPU->GetClocks( ) - m_ClockStart > m_ClocksPerRev ))
-			{
-				CompleteCommand( );
-			}
 			retVal = m_StatusRegister;
 			if(( m_CurDisk != nullptr ) && ( m_CurDisk->IsWriteProtected( )))
 			{
 				retVal |= STATUS_WRITE_PROTECTED;
 			}
-			if(( m_pCPU->GetClocks( ) % m_ClocksPerRev ) < 10 * m_ClocksPerRev / 360 )
+			// Bit 1 is shared by the index pulse (Type I status) and DRQ (Type II/III) - with no media in
+			// the selected drive there is no index hole to see
+			if( m_TypeIStatus ? ( m_IndexPulse && ( m_CurDisk != nullptr )) : DataRequest( ))
 			{
-				retVal |= STATUS_INDEX_PULSE;
+				retVal |= m_TypeIStatus ? STATUS_INDEX_PULSE : STATUS_DATA_REQUEST;
 			}
 //			DBG_TRACE ( "Left: " << m_BytesLeft << " Expected: " << m_BytesExpected );
 			DBG_EVENT( "PC: " << hex << m_pCPU->GetPC( ) << " Get Status = " << hex << ( UINT8 ) retVal );
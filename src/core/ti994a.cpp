@@ -44,6 +44,7 @@
 #include "tms9919.hpp"
 #include "tms5220.hpp"
 #include "support.hpp"
+#include "sound-log.hpp"
 
 DBG_REGISTER( __FILE__ );
 
@@ -74,7 +75,8 @@ cTI994A::cTI994A( iCartridge *console, iTMS9918A *vdp, iTMS9919 *sound, iTMS5220
 	m_DefaultBank( ),
 	m_CpuMemoryInfo( ),
 	m_GromMemoryInfo( ),
-	m_VideoMemory( new UINT8[ 0x4000 ] )
+	m_VideoMemory( new UINT8[ 0x4000 ] ),
+	m_SoundLog( nullptr )
 {
 	FUNCTION_ENTRY( this, "cTI994A ctor", true );
 
@@ -156,7 +158,10 @@ cTI994A::cTI994A( iCartridge *console, iTMS9918A *vdp, iTMS9919 *sound, iTMS5220
 		Reset( );
 	}
 
-	m_RetraceInterval = m_ClockSpeed / dynamic_cast<cTMS9918A *>( m_VDP.get( ))->GetRefreshRate( );
+	ApplyClockSpeed( );
+
+	// The retrace timer starts its first frame along with the VDP
+	m_LastRetrace = m_CPU->GetClocks( );
 
 	// Mark the scratchpad RAM area so that we alias it correctly
 	cpuMemory.SetMemory( 0x8000, 0x0100, m_Scratchpad, false );
@@ -204,6 +209,8 @@ cTI994A::~cTI994A( )
 	FUNCTION_ENTRY( this, "cTI994A dtor", true );
 
 	delete [] m_VideoMemory;
+
+	StopSoundLog( );
 }
 
 //----------------------------------------------------------------------------
@@ -306,6 +313,22 @@ iDevice *cTI994A::GetDevice( ADDRESS address ) const
 	return m_Device[( address < 0x1000 ) ? 0 : ( address >> 8 ) & 0x1F ];
 }
 
+// Time the retrace and the chips from the CPU's clock speed
+void cTI994A::ApplyClockSpeed( )
+{
+	FUNCTION_ENTRY( this, "cTI994A::ApplyClockSpeed", true );
+
+	m_RetraceInterval = m_ClockSpeed / dynamic_cast<cTMS9918A *>( m_VDP.get( ))->GetRefreshRate( );
+
+	m_VDP->SetCPU( m_CPU, m_ClockSpeed );
+	m_SoundGenerator->SetCPU( m_CPU, m_ClockSpeed );
+
+	if( m_SpeechSynthesizer != nullptr )
+	{
+		m_SpeechSynthesizer->SetCPU( m_CPU, m_ClockSpeed );
+	}
+}
+
 void cTI994A::_TimerHookProc( )
 {
 	FUNCTION_ENTRY( nullptr, "cTI994A::_TimerHookProc", false );
@@ -325,6 +348,9 @@ void cTI994A::TimerHookProc( UINT32 clockCycles )
 		m_LastRetrace += m_RetraceInterval;
 		VideoRetrace( );
 	}
+
+	// Generate audio up to the current CPU time
+	m_SoundGenerator->Update( clockCycles );
 }
 
 bool cTI994A::VideoRetrace( )
@@ -420,6 +446,11 @@ UINT8 cTI994A::SoundBreakPoint( ADDRESS, UINT8 data )
 {
 	FUNCTION_ENTRY( this, "cTI994A::SoundBreakPoint", false );
 
+	if( m_SoundLog != nullptr )
+	{
+		m_SoundLog->Write( m_CPU->GetClocks( ), LOG_TMS9919_WRITE, data );
+	}
+
 	m_SoundGenerator->WriteData( data );
 
 	return data;
@@ -431,6 +462,11 @@ UINT8 cTI994A::SpeechWriteBreakPoint( ADDRESS, UINT8 data )
 
 	if( m_SpeechSynthesizer != nullptr )
 	{
+		if( m_SoundLog != nullptr )
+		{
+			m_SoundLog->Write( m_CPU->GetClocks( ), LOG_TMS5220_WRITE, data );
+		}
+
 		m_SpeechSynthesizer->WriteData( data );
 	}
 
@@ -443,6 +479,11 @@ UINT8 cTI994A::SpeechReadBreakPoint( ADDRESS, UINT8 data )
 
 	if( m_SpeechSynthesizer != nullptr )
 	{
+		if( m_SoundLog != nullptr )
+		{
+			m_SoundLog->Write( m_CPU->GetClocks( ), LOG_TMS5220_READ );
+		}
+
 		data = m_SpeechSynthesizer->ReadData( data );
 	}
 
@@ -739,6 +780,12 @@ bool cTI994A::ParseState( const sStateSection &save )
 	save.load( "LastRetrace", lastRetrace, SaveFormat::DECIMAL );
 	m_LastRetrace = m_CPU->GetClocks( ) - lastRetrace;
 
+	// The CPU's clock has jumped - don't record the jump as a gap in the sound log
+	if( m_SoundLog != nullptr )
+	{
+		m_SoundLog->Resync( m_CPU->GetClocks( ));
+	}
+
 	if( save.hasValue( "Console" ))
 	{
 		auto consoleRef = save.getValue( "Console" );
@@ -754,6 +801,12 @@ bool cTI994A::ParseState( const sStateSection &save )
 		}
 	}
 
+	// The console may have changed the clock speed - re-time everything from it, and start
+	// the VDP's frame at the restored retrace so its scanline agrees with the next interrupt
+	ApplyClockSpeed( );
+
+	m_VDP->SetFrameClock( m_LastRetrace );
+
 	if( save.hasValue( "Cartridge" ))
 	{
 		auto cartridgeRef = save.getValue( "Cartridge" );
@@ -821,10 +874,54 @@ void cTI994A::Reset( )
 	}
 	if( m_SpeechSynthesizer != nullptr )
 	{
+		if( m_SoundLog != nullptr )
+		{
+			m_SoundLog->Write( m_CPU->GetClocks( ), LOG_TMS5220_RESET );
+		}
+
 		m_SpeechSynthesizer->Reset( );
 	}
 }
 
+bool cTI994A::StartSoundLog( const std::string &filename )
+{
+	FUNCTION_ENTRY( this, "cTI994A::StartSoundLog", true );
+
+	StopSoundLog( );
+
+	cSoundLog *log = new cSoundLog;
+
+	if( log->Create( filename, m_ClockSpeed ) == false )
+	{
+		delete log;
+		return false;
+	}
+
+	m_SoundLog = log;
+
+	return true;
+}
+
+void cTI994A::StopSoundLog( )
+{
+	FUNCTION_ENTRY( this, "cTI994A::StopSoundLog", true );
+
+	if( m_SoundLog == nullptr )
+	{
+		return;
+	}
+
+	if( m_SoundLog->Close( ) == false )
+	{
+		DBG_ERROR( "Error writing sound log" );
+	}
+
+	DBG_TRACE( "Logged " << m_SoundLog->GetEvents( ) << " sound & speech events" );
+
+	delete m_SoundLog;
+	m_SoundLog = nullptr;
+}
+
 bool cTI994A::Sleep( int cycles, UINT32 timeout )
 {
 	FUNCTION_ENTRY( this, "cTI994A::Sleep", false );
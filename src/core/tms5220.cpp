@@ -37,11 +37,14 @@
 #include "tms5220.hpp"
 #include "itms9919.hpp"
 #include "icomputer.hpp"
+#include "itms9900.hpp"
+#include "audio-stats.hpp"
 
 DBG_REGISTER( __FILE__ );
 
 const int SINC_WINDOW_SIZE	= 5;
-const int LOOKUP_SCALE		= 1024;
+const int SINC_TAPS			= 2 * SINC_WINDOW_SIZE;
+const int FILTER_PHASES		= 1024;		// Same 40K as the old lookup table, and closer to the exact window
 
 extern int verbose;
 
@@ -136,34 +139,43 @@ static double sinc( double x )
 	return sin( x ) / x;
 }
 
+static double lanczos( double x )
+{
+	if(( x <= -SINC_WINDOW_SIZE ) || ( x >= SINC_WINDOW_SIZE )) return 0.0;
+
+	return sinc( x ) * sinc( x / SINC_WINDOW_SIZE );
+}
+
+// Polyphase bank for the Lanczos re-sampling filter - an output sample that falls
+// 'phase' of the way between two input samples only needs the SINC_TAPS weights
+// for that phase (the 11th tap of the window is always 0)
 class filter
 {
-	static double lookup[ SINC_WINDOW_SIZE * LOOKUP_SCALE ];
+	static float bank[ FILTER_PHASES + 1 ][ SINC_TAPS ];
 
 public:
 
 	filter( )
 	{
-		lookup[ 0 ] = 1.0;
-
-		for( int i = 1; i < SINC_WINDOW_SIZE * LOOKUP_SCALE; i ++ )
+		for( int phase = 0; phase <= FILTER_PHASES; phase++ )
 		{
-			double x = ( double ) i / ( double ) LOOKUP_SCALE;
+			double offset = ( double ) phase / ( double ) FILTER_PHASES;
 
-			lookup[ i ] = sinc( x ) * sinc( x / SINC_WINDOW_SIZE );
+			for( int i = 0; i < SINC_TAPS; i++ )
+			{
+				bank[ phase ][ i ] = ( float ) lanczos( offset + SINC_WINDOW_SIZE - 1 - i );
+			}
 		}
 	}
 
-	static double lanczos( double x )
+	static const float *weights( double offset )
 	{
-		if(( x <= -SINC_WINDOW_SIZE ) || ( x >= SINC_WINDOW_SIZE )) return 0.0;
-
-		return lookup[ ( int ) floor( fabs( x ) * LOOKUP_SCALE ) ];
+		return bank[ ( int ) ( offset * FILTER_PHASES + 0.5 ) ];
 	}
 
 };
 
-double filter::lookup[ SINC_WINDOW_SIZE * LOOKUP_SCALE ];
+float filter::bank[ FILTER_PHASES + 1 ][ SINC_TAPS ];
 
 static filter sinc_lookup;
 
@@ -177,13 +189,27 @@ cTMS5220::cTMS5220( ) :
 	m_TargetParams( ),
 	m_InterpolationStage( 0 ),
 	m_Computer( nullptr ),
+	m_CPU( nullptr ),
+	m_ClockSpeed( 0 ),
+	m_LastClock( 0 ),
+	m_StepTime( 0 ),
 	m_PitchIndex( 0 ),
 	m_FilterHistory( ),
 	m_RawDataBuffer( ),
 	m_PlaybackInterval( 0 ),
 	m_PlaybackBuffer( nullptr ),
 	m_PlaybackSamplesLeft( 0 ),
-	m_PlaybackDataPtr( nullptr )
+	m_PlaybackDataPtr( nullptr ),
+	m_Backlog( ),
+	m_BacklogPos( 0.0 ),
+	m_BacklogStep( 1.0 ),
+	m_LastSample( 0.0 ),
+	m_Stats( nullptr ),
+	m_Random( 0x1FFF ),
+	m_FixedPoint( false ),
+	m_PreviousEnergy( 0 ),
+	m_LatticeU( ),
+	m_LatticeX( )
 {
 	FUNCTION_ENTRY( this, "cTMS5220 ctor", true );
 
@@ -287,64 +313,56 @@ bool cTMS5220::WaitForBitsFIFO( int bits )
 {
 	FUNCTION_ENTRY( this, "cTMS5220::WaitForBitsFIFO", true );
 
-	if( m_Computer != nullptr )
+	// Speech is generated in step with the CPU, so there's nobody to wait for - the
+	// data is either here already or the program didn't supply it in time
+	if( m_State.fifo.BitsLeft < bits )
 	{
-		if( m_State.fifo.BitsLeft < bits )
-		{
-			for( int retry = 0; retry < 10; retry++ )
-			{
-				DBG_WARNING( "waiting for bits..." );
-				m_Computer->WakeCPU( 1 );
-				if( m_State.fifo.BitsLeft >= bits )
-				{
-					break;
-				}
-			}
-		}
+		DBG_WARNING( "FIFO under-run (" << m_State.fifo.BitsLeft << "/" << bits << " bits)" );
+		return false;
 	}
 
-	return ( m_State.fifo.BitsLeft >= bits ) ? true : false;
+	return true;
 }
 
 void cTMS5220::StoreDataFIFO( UINT8 data )
 {
 	FUNCTION_ENTRY( this, "cTMS5220::StoreDataFIFO", true );
 
-	// TBD - Acquire MUTEX
 	m_FIFO[ m_State.fifo.PutIndex ] = data;
 
 	m_State.fifo.BitsLeft += 8;
 
 	int nextIndex = ( m_State.fifo.PutIndex + 1 ) % FIFO_BYTES;
 
-	if(( m_PlaybackBuffer != nullptr ) && ( nextIndex == m_State.fifo.GetIndex ))
+	if(( nextIndex == m_State.fifo.GetIndex ) && (( m_ClockSpeed != 0 ) || ( m_PlaybackBuffer != nullptr )))
 	{
-		if( m_Computer != nullptr )
+		if( m_Stats != nullptr )
 		{
-			DBG_WARNING( "FIFO full - stalling CPU... (" << m_State.fifo.PutIndex << "/" << m_State.fifo.GetIndex << ")" );
+			m_Stats->AddSpeechOverrun( );
+		}
 
-			for( int retry = 0; retry < 10; retry++ )
-			{
-				// TBD - calculate a good approximation for the # of CPU cycles to stall
-				m_Computer->Sleep( 100, TMS5220_FRAME_PERIOD / 1000 );
+		if( m_ClockSpeed != 0 )
+		{
+			DBG_TRACE( "FIFO full - holding the CPU... (" << m_State.fifo.PutIndex << "/" << m_State.fifo.GetIndex << ")" );
 
-				// Check TalkStatus in case we stalled
-				if(( m_TalkStatus == false ) || ( nextIndex != m_State.fifo.GetIndex ))
-				{
-					break;
-				}
-			}
+			HoldCPU( nextIndex );
+		}
+		else
+		{
+			// The real chip holds the CPU until there's room - instead, synthesize ahead
+			// until a byte has been consumed and play the result back later
+			DBG_TRACE( "FIFO full - rendering ahead... (" << m_State.fifo.PutIndex << "/" << m_State.fifo.GetIndex << ")" );
 
-			if( nextIndex == m_State.fifo.GetIndex )
-			{
-				DBG_ERROR( "Audio callback failed to read bits from FIFO" );
+			RenderAhead( nextIndex );
+		}
 
-				// Remove 1 speech frame to make room (minimizes audio corruption compared to dropping a byte from the FIFO)
-				sSpeechParams temp;
-				ReadFrame( &temp, true );
-			}
+		if(( m_TalkStatus == true ) && ( nextIndex == m_State.fifo.GetIndex ))
+		{
+			DBG_ERROR( "Unable to make room in the FIFO" );
 
-			DBG_TRACE( "CPU stall complete... (" << m_State.fifo.PutIndex << "/" << m_State.fifo.GetIndex << ")" );
+			// Remove 1 speech frame to make room (minimizes audio corruption compared to dropping a byte from the FIFO)
+			sSpeechParams temp;
+			ReadFrame( &temp, true );
 		}
 	}
 
@@ -355,27 +373,89 @@ void cTMS5220::StoreDataFIFO( UINT8 data )
 		m_TalkStatus = true;
 	}
 
-	// TBD - Release MUTEX
-
-	// If we aren't getting audio callbacks, try to empty the buffer
-	if(( m_PlaybackBuffer == nullptr ) && ( m_TalkStatus == true ))
+	// If we aren't generating audio or keeping time, try to empty the buffer
+	if(( m_ClockSpeed == 0 ) && ( m_PlaybackBuffer == nullptr ) && ( m_TalkStatus == true ))
 	{
 		sSpeechParams temp;
 		ReadFrame( &temp, true );
 	}
 }
 
+void cTMS5220::RenderAhead( int nextIndex )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::RenderAhead", true );
+
+	while(( m_TalkStatus == true ) && ( nextIndex == m_State.fifo.GetIndex ))
+	{
+		if(( m_PlaybackSamplesLeft == 0 ) && ( GetNextBuffer( ) == false ))
+		{
+			break;
+		}
+
+		m_Backlog.insert( m_Backlog.end( ), m_PlaybackDataPtr, m_PlaybackDataPtr + m_PlaybackSamplesLeft );
+
+		m_PlaybackDataPtr    += m_PlaybackSamplesLeft;
+		m_PlaybackSamplesLeft = 0;
+	}
+}
+
+void cTMS5220::HoldCPU( int nextIndex )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::HoldCPU", true );
+
+	// The real chip holds READY low until a byte has been consumed, so charge the
+	// CPU for the wait and run the synthesizer up to the point the FIFO has room
+	while(( m_TalkStatus == true ) && ( nextIndex == m_State.fifo.GetIndex ))
+	{
+		if( m_CPU != nullptr )
+		{
+			INT64 clocks = std::max<INT64>( 1, ( SAMPLE_RATE - 1 - m_StepTime ) / SAMPLE_RATE );
+			m_CPU->AddClocks(( int ) clocks );
+			Update( m_CPU->GetClocks( ));
+		}
+		else
+		{
+			// Nobody to hold - run the next step early and let the clock catch up to it
+			RenderStep( );
+			m_StepTime -= ( INT64 ) INTERPOLATION_SAMPLES * m_ClockSpeed;
+		}
+	}
+}
+
+void cTMS5220::RenderStep( )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::RenderStep", false );
+
+	if( m_PlaybackBuffer != nullptr )
+	{
+		if( GetNextBuffer( ) == true )
+		{
+			m_Backlog.insert( m_Backlog.end( ), m_PlaybackDataPtr, m_PlaybackDataPtr + m_PlaybackSamplesLeft );
+
+			m_PlaybackDataPtr    += m_PlaybackSamplesLeft;
+			m_PlaybackSamplesLeft = 0;
+		}
+	}
+	else
+	{
+		// No audio output - the frames still have to be consumed on schedule
+		CreateNextBuffer( );
+	}
+
+	if( m_TalkStatus == false )
+	{
+		Reset( );
+	}
+}
+
 UINT8 cTMS5220::ReadBitsFIFO( int count )
 {
 	FUNCTION_ENTRY( this, "cTMS5220::ReadBitsFIFO", true );
 
 	DBG_TRACE( "Reading " << count << "/" << m_State.fifo.BitsLeft << " bits" );
 
-	// TBD - Acquire MUTEX
-
 	if( WaitForBitsFIFO( count ) == false )
 	{
-		// TBD - Release MUTEX
 		throw std::underflow_error( "FIFO empty" );
 	}
 
@@ -396,11 +476,7 @@ UINT8 cTMS5220::ReadBitsFIFO( int count )
 	// See if we drained the bit pool but didn't finish with a STOP code
 	if(( m_State.fifo.BitsLeft == 0 ) && (( m_State.ReadingEnergy == false ) || ( data != 0x0F )))
 	{
-		// Wait for at least 1 bit before clearing talk status & speak external flags
-		if( WaitForBitsFIFO( 1 ) == false )
-		{
-			DBG_WARNING( "FIFO drained before STOP code" );
-		}
+		DBG_WARNING( "FIFO drained before STOP code" );
 	}
 
 	if( m_State.fifo.BitsLeft == 0 )
@@ -409,8 +485,6 @@ UINT8 cTMS5220::ReadBitsFIFO( int count )
 		m_TalkStatus = false;
 	}
 
-	// TBD - Release MUTEX
-
 	return data;
 }
 
@@ -457,6 +531,10 @@ bool cTMS5220::CreateNextBuffer( )
 		if( ReadFrame( &newFrame, false ) == false )
 		{
 			DBG_ERROR( "** UNDER-RUN **" );
+			if( m_Stats != nullptr )
+			{
+				m_Stats->AddSpeechUnderrun( );
+			}
 			return false;
 		}
 
@@ -464,7 +542,7 @@ bool cTMS5220::CreateNextBuffer( )
 	}
 
 	sSpeechParams param;
-	InterpolateParameters( m_InterpolationStage, m_StartParams, m_TargetParams, &param );
+	InterpolateParameters( m_InterpolationStage, m_StartParams, m_TargetParams, &param, m_FixedPoint );
 	m_InterpolationStage = ( m_InterpolationStage + 1 ) % 8;
 
 	memcpy( &m_StartParams, &param, sizeof( sSpeechParams ));
@@ -474,13 +552,49 @@ bool cTMS5220::CreateNextBuffer( )
 		m_PitchIndex = 0;
 	}
 
+	if( m_FixedPoint == true )
+	{
+		SynthesizeFixed( param );
+	}
+	else
+	{
+		SynthesizeFloat( param );
+	}
+
+	if(( m_InterpolationStage == 0 ) && ( m_TargetParams.Stop == true ))
+	{
+		m_TalkStatus = false;
+	}
+
+	return true;
+}
+
+// 13-bit LFSR - clocked 20 times per sample.  Each chip has its own so the
+// output doesn't depend on anything else that is running.
+bool cTMS5220::NoiseBit( )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::NoiseBit", false );
+
+	for( int j = 0; j < 20; j++ )
+	{
+		int bit = (( m_Random >> 12 ) ^ ( m_Random >> 3 ) ^ ( m_Random >> 2 ) ^ m_Random ) & 1;
+		m_Random = (( m_Random << 1 ) | bit ) & 0x1FFF;
+	}
+
+	return ( m_Random & 1 ) ? true : false;
+}
+
+void cTMS5220::SynthesizeFloat( const sSpeechParams &param )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::SynthesizeFloat", true );
+
 	for( int i = 0; i < INTERPOLATION_SAMPLES; i++ )
 	{
 		double sample = 0.0;
 
 		if( param.Pitch == 0 )
 		{
-			sample = ( rand( ) & 1 ) ? 64 : -64;
+			sample = NoiseBit( ) ? -64 : 64;
 		}
 		else
 		{
@@ -510,13 +624,74 @@ bool cTMS5220::CreateNextBuffer( )
 
 		m_RawDataBuffer[ i ] = std::min( 32767.0, std::max( -32768.0, cliptemp ));
 	}
+}
 
-	if(( m_InterpolationStage == 0 ) && ( m_TargetParams.Stop == true ))
+// Keep a value within a signed 'bits' wide register (the chip's adders simply overflow)
+static inline int Wrap( int value, int bits )
+{
+	int range = 1 << bits;
+
+	return (( value + ( range >> 1 )) & ( range - 1 )) - ( range >> 1 );
+}
+
+// 10-bit (coefficient) x 15-bit (sample) multiplier used by the lattice filter
+static inline int Multiply( int coeff, int sample )
+{
+	return ( Wrap( coeff, 10 ) * Wrap( sample, 15 )) >> 9;
+}
+
+// The analog output only sees 8 bits of the 14-bit result - larger values are clipped
+static inline INT16 ClipAnalog( int sample )
+{
+	sample = std::min( 2047, std::max( -2048, sample )) & ~0x0F;
+
+	return ( INT16 ) (( sample << 4 ) | (( sample & 0x7F0 ) >> 3 ) | (( sample & 0x400 ) >> 10 ));
+}
+
+void cTMS5220::SynthesizeFixed( const sSpeechParams &param )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::SynthesizeFixed", true );
+
+	for( int i = 0; i < INTERPOLATION_SAMPLES; i++ )
 	{
-		m_TalkStatus = false;
-	}
+		int excitation = 0;
 
-	return true;
+		if( param.Pitch == 0 )
+		{
+			excitation = NoiseBit( ) ? ~0x3F : 0x40;
+		}
+		else
+		{
+			if( m_PitchIndex < ( int ) SIZE( chirpTable ))
+			{
+				excitation = ( INT8 ) chirpTable[ m_PitchIndex ];
+			}
+			m_PitchIndex = ( m_PitchIndex + 1 ) % param.Pitch;
+		}
+
+		// Forward path (the energy multiplier lags one sample behind the excitation)
+		int *u = m_LatticeU;
+		int *x = m_LatticeX;
+
+		u[ RC_ORDER ] = Multiply( m_PreviousEnergy, excitation << 6 );
+
+		for( int j = RC_ORDER - 1; j >= 0; j-- )
+		{
+			u[ j ] = u[ j + 1 ] - Multiply( param.Coefficient[ j ], x[ j ] );
+		}
+
+		// Backward path
+		for( int j = RC_ORDER - 1; j >= 1; j-- )
+		{
+			x[ j ] = x[ j - 1 ] + Multiply( param.Coefficient[ j - 1 ], u[ j - 1 ] );
+		}
+
+		x[ 0 ] = u[ 0 ];
+
+		m_PreviousEnergy = param.Energy;
+
+		m_RawDataBuffer[ i ] = ClipAnalog( Wrap( u[ 0 ], 15 ));
+	}
 }
 
 bool cTMS5220::ConvertBuffer( )
@@ -529,20 +704,31 @@ bool cTMS5220::ConvertBuffer( )
 	memcpy( m_PlaybackBuffer, m_PlaybackBuffer + m_PlaybackInterval, overlap * sizeof( double ));
 	memset( m_PlaybackBuffer + overlap, 0, m_PlaybackInterval * sizeof( double ));
 
+	// Pad the input with silence on both sides so the filter never needs to check its bounds
+	float input[ SINC_TAPS + INTERPOLATION_SAMPLES + 2 * SINC_TAPS ] = { };
+
+	for( int i = 0; i < INTERPOLATION_SAMPLES; i++ )
+	{
+		input[ SINC_TAPS + i ] = ( float ) m_RawDataBuffer[ i ];
+	}
+
 	// Run the re-sampling filter
 
 	for( int i = 0; i < m_PlaybackBufferSize; i++ )
 	{
-		double x = m_PlaybackOffset + ( double ) i / m_PlaybackRatio;
-		for( int j = -SINC_WINDOW_SIZE; j <= SINC_WINDOW_SIZE; j++ )
+		double x    = m_PlaybackOffset + ( double ) i / m_PlaybackRatio;
+		int    base = ( int ) x;
+
+		const float *weight = filter::weights( x - base );
+		const float *data   = input + base + 1;
+
+		float sum = 0.0f;
+		for( int j = 0; j < SINC_TAPS; j++ )
 		{
-			int y = ( int ) floor( x ) + j - SINC_WINDOW_SIZE;
-			if(( y >= 0 ) && ( y < INTERPOLATION_SAMPLES ))
-			{
-				double index = x - y - SINC_WINDOW_SIZE;
-				m_PlaybackBuffer[ i ] += m_RawDataBuffer[ y ] * filter::lanczos( index );
-			}
+			sum += data[ j ] * weight[ j ];
 		}
+
+		m_PlaybackBuffer[ i ] += sum;
 	}
 
 	m_PlaybackOffset = fmod( m_PlaybackOffset + m_PlaybackBufferSize / m_PlaybackRatio, 1.0 );
@@ -593,7 +779,7 @@ char *cTMS5220::FormatParameters( const sSpeechParams &param, bool showAll )
 	return buffer;
 }
 
-void cTMS5220::InterpolateParameters( int stage, const sSpeechParams &start, const sSpeechParams &end, sSpeechParams *param )
+void cTMS5220::InterpolateParameters( int stage, const sSpeechParams &start, const sSpeechParams &end, sSpeechParams *param, bool fixed )
 {
 	FUNCTION_ENTRY( nullptr, "cTMS5220::InterpolateParameters", true );
 
@@ -613,12 +799,31 @@ void cTMS5220::InterpolateParameters( int stage, const sSpeechParams &start, con
 			8, 8, 8, 4, 4, 2, 2, 1
 		};
 
-		param->Energy += ( end.Energy - param->Energy ) / X[ stage ];
-		param->Pitch  += ( end.Pitch - param->Pitch ) / X[ stage ];
+		if( fixed == true )
+		{
+			// The chip shifts rather than divides, so negative steps round down
+			constexpr int SHIFT[ 8 ] =
+			{
+				3, 3, 3, 2, 2, 1, 1, 0
+			};
+
+			param->Energy += ( end.Energy - param->Energy ) >> SHIFT[ stage ];
+			param->Pitch  += ( end.Pitch - param->Pitch ) >> SHIFT[ stage ];
 
-		for( int i = 0; i < RC_ORDER; i++ )
+			for( int i = 0; i < RC_ORDER; i++ )
+			{
+				param->Coefficient[ i ] += ( end.Coefficient[ i ] - param->Coefficient[ i ] ) >> SHIFT[ stage ];
+			}
+		}
+		else
 		{
-			param->Reflection[ i ] += ( end.Reflection[ i ] - param->Reflection[ i ] ) / X[ stage ];
+			param->Energy += ( end.Energy - param->Energy ) / X[ stage ];
+			param->Pitch  += ( end.Pitch - param->Pitch ) / X[ stage ];
+
+			for( int i = 0; i < RC_ORDER; i++ )
+			{
+				param->Reflection[ i ] += ( end.Reflection[ i ] - param->Reflection[ i ] ) / X[ stage ];
+			}
 		}
 	}
 
@@ -669,6 +874,12 @@ bool cTMS5220::ReadFrame( sSpeechParams *frame, bool restore )
 					frame->Reflection[ REFLECTION_K8 ] = ( frame->Pitch != 0 ) ? COEFF_K8[ ReadBits( 3 ) ] : 0.0;
 					frame->Reflection[ REFLECTION_K9 ] = ( frame->Pitch != 0 ) ? COEFF_K9[ ReadBits( 3 ) ] : 0.0;
 					frame->Reflection[ REFLECTION_K10 ] = ( frame->Pitch != 0 ) ? COEFF_K10[ ReadBits( 3 ) ] : 0.0;
+
+					// The tables hold the chip's 10-bit values / 512, so this is exact
+					for( int i = 0; i < RC_ORDER; i++ )
+					{
+						frame->Coefficient[ i ] = ( int ) ( frame->Reflection[ i ] * 512.0 );
+					}
 				}
 
 				DBG_TRACE( FormatParameters( *frame, false ));
@@ -708,7 +919,8 @@ void cTMS5220::SetSoundChip( iTMS9919 *pSound )
 	delete [] m_PlaybackBuffer;
 	m_PlaybackBuffer = nullptr;
 
-	if( pSound != nullptr )
+	// A sound chip without an audio device still gets the chip's timing, but nothing to render
+	if(( pSound != nullptr ) && ( pSound->GetPlaybackFrequency( ) > 0 ))
 	{
 		m_PlaybackRatio      = ( double ) pSound->GetPlaybackFrequency( ) / ( double ) SAMPLE_RATE;
 		m_PlaybackInterval   = ( int ) ceil( INTERPOLATION_SAMPLES * m_PlaybackRatio );
@@ -720,6 +932,20 @@ void cTMS5220::SetSoundChip( iTMS9919 *pSound )
 	}
 }
 
+void cTMS5220::SetFixedPoint( bool fixed )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::SetFixedPoint", true );
+
+	m_FixedPoint = fixed;
+}
+
+void cTMS5220::SetAudioStats( cAudioStats *stats )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::SetAudioStats", true );
+
+	m_Stats = stats;
+}
+
 void cTMS5220::SetComputer( iComputer *computer )
 {
 	FUNCTION_ENTRY( this, "cTMS5220::SetComputer", true );
@@ -727,16 +953,128 @@ void cTMS5220::SetComputer( iComputer *computer )
 	m_Computer = computer;
 }
 
+void cTMS5220::SetCPU( iTMS9900 *cpu, UINT32 clockSpeed )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::SetCPU", true );
+
+	m_CPU        = cpu;
+	m_ClockSpeed = clockSpeed;
+	m_LastClock  = ( cpu != nullptr ) ? cpu->GetClocks( ) : 0;
+	m_StepTime   = 0;
+}
+
+void cTMS5220::Update( UINT32 clockCycles )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::Update", false );
+
+	if( m_ClockSpeed == 0 )
+	{
+		return;
+	}
+
+	UINT32 elapsed = clockCycles - m_LastClock;
+
+	m_LastClock = clockCycles;
+
+	// Don't try to catch up after a reset or a restored image - just start over from here
+	if( elapsed > m_ClockSpeed / 4 )
+	{
+		elapsed = 0;
+	}
+
+	// The first step of a phrase starts as soon as the chip starts talking
+	if( m_TalkStatus == false )
+	{
+		m_StepTime = 0;
+		return;
+	}
+
+	m_StepTime += ( INT64 ) elapsed * SAMPLE_RATE;
+
+	// Each step is rendered as soon as it starts so the audio output never has to wait for it
+	while(( m_TalkStatus == true ) && ( m_StepTime >= 0 ))
+	{
+		RenderStep( );
+		m_StepTime -= ( INT64 ) INTERPOLATION_SAMPLES * m_ClockSpeed;
+	}
+}
+
+void cTMS5220::SetRateAdjust( double rate )
+{
+	FUNCTION_ENTRY( this, "cTMS5220::SetRateAdjust", false );
+
+	m_BacklogStep = ( rate > 0.0 ) ? 1.0 / rate : 1.0;
+}
+
 bool cTMS5220::AudioCallback( INT16 *buffer, int count )
 {
 	FUNCTION_ENTRY( this, "cTMS5220::AudioCallback", false );
 
+	bool modified = false;
+
+	// Play anything that was rendered ahead of time first.  The sound chip stretches or
+	// squeezes its output to keep the audio device's buffer level, so the backlog is read
+	// at the same adjusted rate (interpolating between samples) to stay in step with it.
+	size_t last = m_Backlog.size( );
+
+	if(( last > 0 ) && ( m_BacklogPos < last - 1 ))
+	{
+		modified = true;
+
+		while(( count > 0 ) && ( m_BacklogPos < last - 1 ))
+		{
+			size_t index = ( size_t ) m_BacklogPos;
+			double frac  = m_BacklogPos - index;
+
+			m_LastSample = m_Backlog[ index ] + ( m_Backlog[ index + 1 ] - m_Backlog[ index ] ) * frac;
+
+			int sample = ( int ) ( *buffer + m_LastSample );
+			*buffer++ = std::min( 32767, std::max( -32768, sample ));
+
+			m_BacklogPos += m_BacklogStep;
+			count--;
+		}
+
+		// Keep the sample we're reading from (and the fraction past it) for the next call
+		size_t used = std::min(( size_t ) m_BacklogPos, last - 1 );
+
+		m_Backlog.erase( m_Backlog.begin( ), m_Backlog.begin( ) + used );
+		m_BacklogPos -= used;
+	}
+
 	if( m_TalkStatus == false )
 	{
-		return false;
+		// The phrase is over, so there's nothing left to interpolate towards
+		if(( count > 0 ) && !m_Backlog.empty( ))
+		{
+			int sample = ( int ) ( *buffer + m_Backlog.back( ));
+			*buffer = std::min( 32767, std::max( -32768, sample ));
+
+			m_Backlog.clear( );
+			m_BacklogPos = 0.0;
+
+			modified = true;
+		}
+
+		return modified;
 	}
 
-	bool modified = false;
+	// Speech is synthesized on the CPU's clock - just hold the last sample if the output runs a bit fast
+	if( m_ClockSpeed != 0 )
+	{
+		if(( count > 0 ) && ( m_Stats != nullptr ))
+		{
+			m_Stats->AddSpeechUnderrun( );
+		}
+
+		for( int i = 0; i < count; i++ )
+		{
+			int sample = ( int ) ( *buffer + m_LastSample );
+			*buffer++ = std::min( 32767, std::max( -32768, sample ));
+		}
+
+		return true;
+	}
 
 	while(( count > 0 ) && ( m_TalkStatus == true ))
 	{
@@ -784,6 +1122,22 @@ void cTMS5220::Reset( )
 	memset( m_FilterHistory, 0, sizeof( m_FilterHistory ));
 	memset( m_RawDataBuffer, 0, sizeof( m_RawDataBuffer ));
 
+	m_PitchIndex = 0;
+
+	// Drop the resampler's tail so the next phrase doesn't depend on the last one
+	if( m_PlaybackBuffer != nullptr )
+	{
+		memset( m_PlaybackBuffer, 0, m_PlaybackBufferSize * sizeof( double ));
+	}
+	m_PlaybackOffset = 0.0;
+	m_LastSample     = 0.0;
+
+	m_Random         = 0x1FFF;
+	m_PreviousEnergy = 0;
+
+	memset( m_LatticeU, 0, sizeof( m_LatticeU ));
+	memset( m_LatticeX, 0, sizeof( m_LatticeX ));
+
 	m_InterpolationStage  = 0;
 	m_PlaybackSamplesLeft = 0;
 }
@@ -792,6 +1146,11 @@ UINT8 cTMS5220::WriteData( UINT8 data )
 {
 	FUNCTION_ENTRY( this, "cTMS5220::WriteData", false );
 
+	if( m_CPU != nullptr )
+	{
+		Update( m_CPU->GetClocks( ));
+	}
+
 	if( m_State.SpeakExternal == true )
 	{
 		DBG_TRACE( "External data: " << hex << data );
@@ -833,6 +1192,8 @@ UINT8 cTMS5220::WriteData( UINT8 data )
 				m_State.fifo.BitsLeft = 0;
 				break;
 			case 0x70 : // Reset
+				m_Backlog.clear( );
+				m_BacklogPos = 0.0;
 				Reset( );
 				break;
 			default :
@@ -848,6 +1209,11 @@ UINT8 cTMS5220::ReadData( UINT8 data )
 {
 	FUNCTION_ENTRY( this, "cTMS5220::ReadData", false );
 
+	if( m_CPU != nullptr )
+	{
+		Update( m_CPU->GetClocks( ));
+	}
+
 	if( m_State.ReadByte == true )
 	{
 		m_State.ReadByte = false;
@@ -897,6 +1263,9 @@ bool cTMS5220::ParseState( const sStateSection &state )
 
 	state.load( "TalkStatus", m_TalkStatus );
 
+	m_LastClock = ( m_CPU != nullptr ) ? m_CPU->GetClocks( ) : 0;
+	m_StepTime  = 0;
+
 	// TODO - Restore internal filter state
 
 	return true;
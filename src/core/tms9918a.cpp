@@ -27,12 +27,14 @@
 //----------------------------------------------------------------------------
 
 #include <algorithm>
+#include <bit>
 #include <cstring>
 #include "common.hpp"
 #include "logger.hpp"
 #include "compress.hpp"
 #include "tms9918a.hpp"
 #include "idevice.hpp"
+#include "itms9900.hpp"
 #include "itms9901.hpp"
 #include "support.hpp"
 
@@ -40,6 +42,65 @@ DBG_REGISTER( __FILE__ );
 
 extern void Panic( char * );
 
+const sRGBQUAD ColorTable[ COLOR_TABLES ][ 17 ] =
+{
+	{
+		{ 0x00, 0x00, 0x00, 0xFF },             // 0x00 TI_TRANSPARENT - Background
+		{ 0x00, 0x00, 0x00, 0xFF },             // 0x01 TI_BLACK
+		{ 0x48, 0x9C, 0x08, 0xFF },             // 0x02 TI_MEDIUM_GREEN *
+		{ 0x70, 0xBF, 0x88, 0xFF },             // 0x03 TI_LIGHT_GREEN *
+		{ 0x28, 0x3C, 0x8A, 0xFF },             // 0x04 TI_DARK_BLUE *
+		{ 0x50, 0x6C, 0xCF, 0xFF },             // 0x05 TI_LIGHT_BLUE *
+		{ 0xD0, 0x48, 0x00, 0xFF },             // 0x06 TI_DARK_RED *
+		{ 0x00, 0xCC, 0xFF, 0xFF },             // 0x07 TI_CYAN *
+		{ 0xD0, 0x58, 0x28, 0xFF },             // 0x08 TI_MEDIUM_RED *
+		{ 0xFF, 0xA0, 0x40, 0xFF },             // 0x09 TI_LIGHT_RED *
+		{ 0xFC, 0xF0, 0x50, 0xFF },             // 0x0A TI_DARK_YELLOW *
+		{ 0xFF, 0xFF, 0x80, 0xFF },             // 0x0B TI_LIGHT_YELLOW *
+		{ 0x00, 0x80, 0x00, 0xFF },             // 0x0C TI_DARK_GREEN
+		{ 0xCD, 0x58, 0xCD, 0xFF },             // 0x0D TI_MAGENTA *
+		{ 0xE0, 0xE0, 0xE0, 0xFF },             // 0x0E TI_GRAY *
+		{ 0xFF, 0xFF, 0xFF, 0xFF },             // 0x0F TI_WHITE
+		{ 0xFF, 0xFF, 0xFF, 0xFF }              // 0x10 - Text Mode Foreground
+	}, {
+		{ 0x00, 0x00, 0x00, 0xFF },             // 0x00 TI_TRANSPARENT - Background
+		{ 0x00, 0x00, 0x00, 0xFF },             // 0x01 TI_BLACK
+		{   33,  200,   66, 0xFF },             // 0x02 TI_MEDIUM_GREEN *
+		{   94,  220,  120, 0xFF },             // 0x03 TI_LIGHT_GREEN *
+		{   84,   85,  237, 0xFF },             // 0x04 TI_DARK_BLUE *
+		{  125,  118,  252, 0xFF },             // 0x05 TI_LIGHT_BLUE *
+		{  212,   82,   77, 0xFF },             // 0x06 TI_DARK_RED *
+		{   66,  235,  245, 0xFF },             // 0x07 TI_CYAN *
+		{  252,   85,   84, 0xFF },             // 0x08 TI_MEDIUM_RED *
+		{  255,  121,  120, 0xFF },             // 0x09 TI_LIGHT_RED *
+		{  212,  193,   84, 0xFF },             // 0x0A TI_DARK_YELLOW *
+		{  230,  206,  128, 0xFF },             // 0x0B TI_LIGHT_YELLOW *
+		{   33,  176,   59, 0xFF },             // 0x0C TI_DARK_GREEN
+		{  201,   91,  186, 0xFF },             // 0x0D TI_MAGENTA *
+		{  204,  204,  204, 0xFF },             // 0x0E TI_GRAY *
+		{ 0xFF, 0xFF, 0xFF, 0xFF },             // 0x0F TI_WHITE
+		{ 0xFF, 0xFF, 0xFF, 0xFF }              // 0x10 - Text Mode Foreground
+	}, {
+		{ 0x00, 0x00, 0x00, 0xFF },             // 0x00 TI_TRANSPARENT - Background
+		{ 0x00, 0x00, 0x00, 0xFF },             // 0x01 TI_BLACK
+		{ 0x00, 0xCC, 0x00, 0xFF },             // 0x02 TI_MEDIUM_GREEN
+		{ 0x00, 0xFF, 0x00, 0xFF },             // 0x03 TI_LIGHT_GREEN
+		{ 0x00, 0x00, 0x80, 0xFF },             // 0x04 TI_DARK_BLUE
+		{ 0x00, 0x00, 0xFF, 0xFF },             // 0x05 TI_LIGHT_BLUE
+		{ 0x80, 0x00, 0x00, 0xFF },             // 0x06 TI_DARK_RED
+		{ 0x00, 0xFF, 0xFF, 0xFF },             // 0x07 TI_CYAN
+		{ 0xCC, 0x00, 0x00, 0xFF },             // 0x08 TI_MEDIUM_RED
+		{ 0xFF, 0x00, 0x00, 0xFF },             // 0x09 TI_LIGHT_RED
+		{ 0xB0, 0xB0, 0x00, 0xFF },             // 0x0A TI_DARK_YELLOW
+		{ 0xFF, 0xFF, 0x00, 0xFF },             // 0x0B TI_LIGHT_YELLOW
+		{ 0x00, 0x80, 0x00, 0xFF },             // 0x0C TI_DARK_GREEN
+		{ 0xB0, 0x00, 0xB0, 0xFF },             // 0x0D TI_MAGENTA
+		{ 0xCC, 0xCC, 0xCC, 0xFF },             // 0x0E TI_GRAY
+		{ 0xFF, 0xFF, 0xFF, 0xFF },             // 0x0F TI_WHITE
+		{ 0xFF, 0xFF, 0xFF, 0xFF }              // 0x10 - Text Mode Foreground
+	}
+};
+
 cTMS9918A::cTMS9918A( int refreshRate ) :
 	cBaseObject( "cTMS9918A" ),
 	cStateObject( ),
@@ -56,6 +117,10 @@ cTMS9918A::cTMS9918A( int refreshRate ) :
 	m_PatternTableMask( 0 ),
 	m_InterruptLevel( 0 ),
 	m_PIC( nullptr ),
+	m_CPU( nullptr ),
+	m_LineClocks( 0 ),
+	m_FrameClock( 0 ),
+	m_LinesPerFrame(( refreshRate == 50 ) ? VDP_LINES_50HZ : VDP_LINES_60HZ ),
 	m_Address( 0 ),
 	m_Transfer( 0 ),
 	m_Shift( 0 ),
@@ -63,8 +128,18 @@ cTMS9918A::cTMS9918A( int refreshRate ) :
 	m_Register( ),
 	m_Mode( 0 ),
 	m_ReadAhead( 0 ),
+	m_LineRegister( ),
+	m_FrameRegister( ),
+	m_RegisterEvents( ),
+	m_FrameEvents( ),
 	m_MemoryType( ),
 	m_MaxSprite( ),
+	m_SpriteChanged( 0xFFFFFFFF ),
+	m_LineSprites( ),
+	m_SpriteLine( ),
+	m_SpriteRange( ),
+	m_SpriteLeft( ),
+	m_SpriteMask( ),
 	m_SpritesDirty( false ),
 	m_SpritesRefreshed( false ),
 	m_CoincidenceFlag( false ),
@@ -112,6 +187,27 @@ void cTMS9918A::SetPIC( iTMS9901 *pic, int level )
 	m_PIC            = pic;
 }
 
+void cTMS9918A::SetCPU( iTMS9900 *cpu, UINT32 clockSpeed )
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::SetCPU", true );
+
+	m_CPU = cpu;
+
+	// Each frame is m_LinesPerFrame scanlines - deriving the line from the frame rate keeps
+	// GetScanline in step with the retrace instead of drifting against it
+	m_LineClocks = static_cast<UINT32>(( static_cast<UINT64>( clockSpeed ) << 16 ) / ( m_RefreshRate * m_LinesPerFrame ));
+
+	m_FrameClock = ( m_CPU != nullptr ) ? m_CPU->GetClocks( ) : 0;
+}
+
+// Start the current frame at 'clock' - used when the computer restores the time of the last retrace
+void cTMS9918A::SetFrameClock( UINT32 clock )
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::SetFrameClock", true );
+
+	m_FrameClock = clock;
+}
+
 void cTMS9918A::Reset( )
 {
 	FUNCTION_ENTRY( this, "cTMS9918A::Reset", true );
@@ -129,6 +225,15 @@ void cTMS9918A::Reset( )
 	{
 		WriteRegister( i, 0 );
 	}
+
+	memcpy( m_LineRegister, m_Register, sizeof( m_LineRegister ));
+	memcpy( m_FrameRegister, m_Register, sizeof( m_FrameRegister ));
+
+	m_RegisterEvents.clear( );
+	m_FrameEvents.clear( );
+
+	m_SpriteChanged = 0xFFFFFFFF;
+	m_SpritesDirty  = true;
 }
 
 extern int HistoryIndex;
@@ -185,9 +290,16 @@ void cTMS9918A::WriteData( UINT8 data )
 
 	if( *MemPtr != data )
 	{
-		int type = m_MemoryType[ m_Address & 0x3FFF ];
-		if( type & ( MEM_SPRITE_ATTR_TABLE | MEM_SPRITE_DESC_TABLE ))
+		size_t address = m_Address & 0x3FFF;
+		int type = m_MemoryType[ address ];
+		if( type & MEM_SPRITE_ATTR_TABLE )
 		{
+			m_SpriteChanged |= 1u << (( address - m_SpriteAttrTableIndex ) / sizeof( sSpriteAttributeEntry ));
+			m_SpritesDirty = true;
+		}
+		if( type & MEM_SPRITE_DESC_TABLE )
+		{
+			SpritePatternChanged( address - m_SpriteDescTableIndex );
 			m_SpritesDirty = true;
 		}
 		*MemPtr = data;
@@ -196,6 +308,48 @@ void cTMS9918A::WriteData( UINT8 data )
 	m_Address += 1;
 }
 
+// Copy a block straight into VRAM without disturbing the address register (used by device DSRs)
+void cTMS9918A::WriteMemory( UINT16 address, const UINT8 *data, size_t length )
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::WriteMemory", false );
+
+	for( size_t i = 0; i < length; )
+	{
+		size_t offset = ( address + i ) & 0x3FFF;
+		size_t count  = std::min( length - i, 0x4000 - offset );
+
+		// Only the sprite tables have cached state - check them a byte at a time
+		if( std::any_of( m_MemoryType + offset, m_MemoryType + offset + count, []( UINT8 type ) { return ( type & ( MEM_SPRITE_ATTR_TABLE | MEM_SPRITE_DESC_TABLE )) != 0; } ))
+		{
+			for( size_t j = 0; j < count; j++ )
+			{
+				UINT8 *MemPtr = &m_Memory[ offset + j ];
+				if( *MemPtr != data[ i + j ] )
+				{
+					int type = m_MemoryType[ offset + j ];
+					if( type & MEM_SPRITE_ATTR_TABLE )
+					{
+						m_SpriteChanged |= 1u << (( offset + j - m_SpriteAttrTableIndex ) / sizeof( sSpriteAttributeEntry ));
+						m_SpritesDirty = true;
+					}
+					if( type & MEM_SPRITE_DESC_TABLE )
+					{
+						SpritePatternChanged( offset + j - m_SpriteDescTableIndex );
+						m_SpritesDirty = true;
+					}
+					*MemPtr = data[ i + j ];
+				}
+			}
+		}
+		else
+		{
+			memcpy( m_Memory + offset, data + i, count );
+		}
+
+		i += count;
+	}
+}
+
 UINT8 cTMS9918A::ReadData( )
 {
 	FUNCTION_ENTRY( this, "cTMS9918A::ReadData", false );
@@ -218,11 +372,33 @@ void cTMS9918A::WriteRegister( size_t reg, UINT8 value )
 		0xFF, 0xFF, 0x0F, 0xFF, 0x07, 0x7F, 0x07, 0xFF
 	};
 
+	// Bits that change what's drawn - the ROM toggles the interrupt enable all the time
+	static UINT8 display[ 8 ] =
+	{
+		VDP_MODE_3_BIT, VDP_BLANK_MASK | VDP_MODE_1_BIT | VDP_MODE_2_BIT | VDP_SPRITE_MASK, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+	};
+
 	DBG_ASSERT( reg < 8 );
 
 	// Mask off unused bits - TI-99/4A ROM sets these bits to 1s
 	value &= mask[ reg ];
 
+	if(( m_CPU != nullptr ) && (( m_Register[ reg ] ^ value ) & display[ reg ] ))
+	{
+		int line = GetScanline( );
+
+		if( line < VDP_HEIGHT - 1 )
+		{
+			// The beam is in the active display - the change shows up on the next line
+			m_RegisterEvents.push_back( { line + 1, static_cast<UINT8>( reg ), value } );
+		}
+		else if( line >= VDP_HEIGHT )
+		{
+			// Vertical blank - the whole of the next frame sees this value
+			m_LineRegister[ reg ] = value;
+		}
+	}
+
 	UINT8 changes = m_Register[ reg ] ^ value;
 
 	m_Register[ reg ] = value;
@@ -263,7 +439,8 @@ void cTMS9918A::WriteRegister( size_t reg, UINT8 value )
 			}
 			if( changes & VDP_SPRITE_MASK )
 			{
-				m_SpritesDirty = true;
+				m_SpriteChanged = 0xFFFFFFFF;
+				m_SpritesDirty  = true;
 			}
 			SetMode( newMode );
 			if(( value & VDP_INTERRUPT_MASK ) && ( m_Status & VDP_INTERRUPT_FLAG ) && ( m_PIC != nullptr ))
@@ -289,10 +466,20 @@ void cTMS9918A::WriteRegister( size_t reg, UINT8 value )
 		case 5 :
 			m_SpriteAttrTableIndex = value * sizeof( sSpriteAttribute );
 			DBG_ASSERT( m_SpriteAttrTableIndex <= 0x4000 - sizeof( sSpriteAttribute ));
+			if( changes )
+			{
+				m_SpriteChanged = 0xFFFFFFFF;
+				m_SpritesDirty  = true;
+			}
 			break;
 		case 6 :
 			m_SpriteDescTableIndex = value * sizeof( sSpriteDescriptor );
 			DBG_ASSERT( m_SpriteDescTableIndex <= 0x4000 - sizeof( sSpriteDescriptor ) );
+			if( changes )
+			{
+				m_SpriteChanged = 0xFFFFFFFF;
+				m_SpritesDirty  = true;
+			}
 			break;
 	}
 
@@ -390,6 +577,9 @@ void cTMS9918A::FlipAddressing( )
 		}
 
 		memcpy( m_Memory, newMemory, 0x4000 );
+
+		m_SpriteChanged = 0xFFFFFFFF;
+		m_SpritesDirty  = true;
 	}
 }
 
@@ -408,135 +598,144 @@ void cTMS9918A::FillTable( size_t start, size_t length, UINT8 type )
 	}
 }
 
-void cTMS9918A::GetSpritePattern( int index, int loX, int hiX, int loY, int hiY, int data[ 32 ] )
+void cTMS9918A::SpritePatternChanged( size_t offset )
 {
-	FUNCTION_ENTRY( this, "cTMS9918A::GetSpritePattern", false );
+	FUNCTION_ENTRY( this, "cTMS9918A::SpritePatternChanged", false );
 
-	sSpriteAttributeEntry *sprite = &reinterpret_cast<sSpriteAttribute *>( m_Memory + m_SpriteAttrTableIndex )->data[ index ];
+	const sSpriteAttributeEntry *sprite = reinterpret_cast<sSpriteAttribute *>( m_Memory + m_SpriteAttrTableIndex )->data;
 
-	UINT8 *pattern = reinterpret_cast<sSpriteDescriptor *>( m_Memory + m_SpriteDescTableIndex )->data[ sprite->patternIndex ];
+	unsigned int pattern = offset / 8;
+	unsigned int count   = ( m_Register[ 1 ] & VDP_SPRITE_SIZE ) ? 4 : 1;
 
-	int count = ( m_Register[ 1 ] & VDP_SPRITE_SIZE ) ? 2 : 1;
-
-	if( m_Register[ 1 ] & VDP_SPRITE_MAGNIFY )
+	// Mark every sprite that uses this pattern
+	for( int i = 0; i < 32; i++ )
 	{
-		int col = loX / count;
-		for( int i = 0, y = loY; y < hiY; y++ )
+		if((( pattern - sprite[ i ].patternIndex ) & 0xFF ) < count )
 		{
-			int row = y / count;
-			int srcBits = (( pattern[ row ] << 8 ) | pattern[ row+16 ] ) << col;
-			int dstBits = 0;
-			if( srcBits != 0 )
-			{
-				for( int x = loX; x < hiX; x++ )
-				{
-					dstBits <<= 1;
-					if( srcBits & 0x8000 )
-					{
-						dstBits |= 1;
-					}
-					if( x & 1 )
-					{
-						srcBits <<= 1;
-					}
-				}
-			}
-			data[ i++ ] = dstBits;
-			if(( y & 1 ) == 0 )
-			{
-				data[ i++ ] = dstBits;
-				y++;
-			}
-		}
-	}
-	else
-	{
-		int mask = ( 0xFFFF >> ( loX / count )) ^ ( 0xFFFF >> ( hiX / count ));
-		for( int i = 0, y = loY; y < hiY; y++ )
-		{
-			int row = y / count;
-			data[ i++ ] = (( pattern[ row ] << 8 ) | pattern[ row+16 ] ) & mask;
+			m_SpriteChanged |= 1u << i;
 		}
 	}
 }
 
-bool cTMS9918A::SpritesCoincident( int index1, int index2 )
+void cTMS9918A::UpdateSpriteMasks( int index )
 {
-	FUNCTION_ENTRY( this, "cTMS9918A::SpriteCoincident", false );
+	FUNCTION_ENTRY( this, "cTMS9918A::UpdateSpriteMasks", false );
 
-	sSpriteAttributeEntry *sprite1 = &reinterpret_cast<sSpriteAttribute *>( m_Memory + m_SpriteAttrTableIndex )->data[ index1 ];
-	sSpriteAttributeEntry *sprite2 = &reinterpret_cast<sSpriteAttribute *>( m_Memory + m_SpriteAttrTableIndex )->data[ index2 ];
-
-	int size  = ( m_Register[ 1 ] & VDP_SPRITE_MAGNIFY ) ? 16 : 8;
-	int range = ( m_Register[ 1 ] & VDP_SPRITE_SIZE ) ? 2 * size : size;
-
-	// First see if they overlap at all
-	int posY1 = (( sprite1->posY < 0xF0 ) ? sprite1->posY : ( INT8 ) sprite1->posY ) + 1;
-	int posY2 = (( sprite2->posY < 0xF0 ) ? sprite2->posY : ( INT8 ) sprite2->posY ) + 1;
+	sSpriteAttributeEntry *sprite = &reinterpret_cast<sSpriteAttribute *>( m_Memory + m_SpriteAttrTableIndex )->data[ index ];
 
-	int deltaY = posY2 - posY1;
-	if(( deltaY >= range ) || ( deltaY <= -range ))
+	// Remove the sprite from the lines it used to cover
+	for( int j = 0; j < m_SpriteRange[ index ]; j++ )
 	{
-		return false;
+		m_LineSprites[( m_SpriteLine[ index ] + j ) & 0xFF ] &= ~( 1u << index );
 	}
 
-	int posX1 = ( int ) sprite1->posX;
-	if( sprite1->earlyClock & 0x80 )
+	m_SpriteRange[ index ] = 0;
+
+	unsigned int y = sprite->posY;
+
+	// Offscreen sprites (and the terminator) aren't displayed or checked
+	if(( y >= 0xC0 ) && ( y < 0xE0 ))
 	{
-		posX1 -= 32;
+		return;
 	}
 
-	int posX2 = ( int ) sprite2->posX;
-	if( sprite2->earlyClock & 0x80 )
+	bool magnify = ( m_Register[ 1 ] & VDP_SPRITE_MAGNIFY ) ? true : false;
+	int  count   = ( m_Register[ 1 ] & VDP_SPRITE_SIZE ) ? 2 : 1;
+	int  range   = 8 * count * ( magnify ? 2 : 1 );
+	int  left    = ( sprite->earlyClock & 0x80 ) ? sprite->posX - 32 : sprite->posX;
+
+	m_SpriteLine[ index ]  = static_cast<UINT8>( y + 1 );
+	m_SpriteRange[ index ] = range;
+	m_SpriteLeft[ index ]  = left;
+
+	// Pixels that fall off either side of the screen never collide
+	UINT32 clip = 0xFFFFFFFF;
+	if( left < 0 )
 	{
-		posX2 -= 32;
+		clip = ( left > -32 ) ? clip >> -left : 0;
 	}
-
-	int deltaX = posX2 - posX1;
-	if(( deltaX >= range ) || ( deltaX <= -range ))
+	if( left + 32 > VDP_WIDTH )
 	{
-		return false;
+		clip &= 0xFFFFFFFF << ( left + 32 - VDP_WIDTH );
 	}
 
-	int loX = std::max( posX1, posX2 );
-	int hiX = std::min( posX1, posX2 ) + range;
+	const UINT8 *pattern = reinterpret_cast<sSpriteDescriptor *>( m_Memory + m_SpriteDescTableIndex )->data[ 0 ];
 
-	if( loX < 0 )
-	{
-		loX = 0;
-	}
-	if( hiX > VDP_WIDTH )
+	for( int j = 0; j < range; j++ )
 	{
-		hiX = VDP_WIDTH;
+		int row = magnify ? j / 2 : j;
+
+		UINT8 ch = static_cast<UINT8>( sprite->patternIndex + row / 8 );
+
+		UINT32 bits = pattern[ ch * 8 + row % 8 ] << 8;
+		if( count == 2 )
+		{
+			bits |= pattern[ static_cast<UINT8>( ch + 2 ) * 8 + row % 8 ];
+		}
+
+		UINT32 mask = bits << 16;
+		if( magnify )
+		{
+			mask = 0;
+			for( int b = 0; b < 16; b++ )
+			{
+				if( bits & ( 0x8000 >> b ))
+				{
+					mask |= 0xC0000000 >> ( 2 * b );
+				}
+			}
+		}
+
+		m_SpriteMask[ index ][ j ] = mask & clip;
+
+		m_LineSprites[( m_SpriteLine[ index ] + j ) & 0xFF ] |= 1u << index;
 	}
+}
 
-	int loY = std::max( posY1, posY2 );
-	int hiY = std::min( posY1, posY2 ) + range;
+bool cTMS9918A::SpritesCoincident( int index1, int index2 ) const
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::SpriteCoincident", false );
+
+	int range = m_SpriteRange[ index1 ];
 
-	if( loY < 0 )
+	// Sprites with Y >= 0xE0 wrap around to the top of the screen
+	int posY1 = ( m_SpriteLine[ index1 ] > 0xE0 ) ? m_SpriteLine[ index1 ] - 256 : m_SpriteLine[ index1 ];
+	int posY2 = ( m_SpriteLine[ index2 ] > 0xE0 ) ? m_SpriteLine[ index2 ] - 256 : m_SpriteLine[ index2 ];
+
+	// First see if they overlap at all
+	int deltaY = posY2 - posY1;
+	if(( deltaY >= range ) || ( deltaY <= -range ))
 	{
-		loY = 0;
+		return false;
 	}
-	if( hiY > VDP_HEIGHT )
+
+	int deltaX = m_SpriteLeft[ index2 ] - m_SpriteLeft[ index1 ];
+	if(( deltaX >= range ) || ( deltaX <= -range ))
 	{
-		hiY = VDP_HEIGHT;
+		return false;
 	}
 
-	int pattern1[ 32 ], pattern2[ 32 ];
-	GetSpritePattern( index1, loX - posX1, hiX - posX1, loY - posY1, hiY - posY1, pattern1 );
-	GetSpritePattern( index2, loX - posX2, hiX - posX2, loY - posY2, hiY - posY2, pattern2 );
+	// Line both masks up in a 64-bit window that starts at the leftmost sprite
+	int shift1 = ( deltaX < 0 ) ? 32 + deltaX : 32;
+	int shift2 = ( deltaX < 0 ) ? 32 : 32 - deltaX;
 
-	int maxIndex = ( index1 > index2 ) ? index1 : index2;
-	UINT8 *maxSprite = &m_MaxSprite[ loY ];
+	int loY = std::max( std::max( posY1, posY2 ), 0 );
+	int hiY = std::min( std::min( posY1, posY2 ) + range, VDP_HEIGHT );
 
-	for( int i = 0; i < hiY - loY; i++ )
+	int maxIndex = std::max( index1, index2 );
+
+	for( int y = loY; y < hiY; y++ )
 	{
 		// Make sure both sprites are being displayed on this row
-		if( maxIndex > maxSprite[ i ] )
+		if( maxIndex > m_MaxSprite[ y ] )
 		{
 			continue;
 		}
-		if( pattern1[ i ] & pattern2[ i ] )
+
+		UINT64 row1 = static_cast<UINT64>( m_SpriteMask[ index1 ][ y - posY1 ] ) << shift1;
+		UINT64 row2 = static_cast<UINT64>( m_SpriteMask[ index2 ][ y - posY2 ] ) << shift2;
+
+		if( row1 & row2 )
 		{
 			return true;
 		}
@@ -545,21 +744,20 @@ bool cTMS9918A::SpritesCoincident( int index1, int index2 )
 	return false;
 }
 
-bool cTMS9918A::CheckCoincidence( const bool check[ 32 ] )
+bool cTMS9918A::CheckCoincidence( UINT32 check ) const
 {
 	FUNCTION_ENTRY( this, "cTMS9918A::CheckCoincidence", false );
 
-	// NOTE: m_FifthSpriteIndex is still the highest valid sprite
-	for( int i = m_FifthSpriteIndex; i >= 0; i-- )
+	for( int i = 31; i > 0; i-- )
 	{
 		// Only check sprites that were marked
-		if( check[ i ] == false )
+		if(( check & ( 1u << i )) == 0 )
 		{
 			continue;
 		}
 		for( int j = i - 1; j >= 0; j-- )
 		{
-			if( check[ j ] == false )
+			if(( check & ( 1u << j )) == 0 )
 			{
 				continue;
 			}
@@ -577,74 +775,380 @@ void cTMS9918A::CheckSprites( )
 {
 	FUNCTION_ENTRY( this, "cTMS9918A::CheckSprites", false );
 
-	bool check[ 32 ];
-	memset( check, false, sizeof( check ));
+	// Only rebuild the masks of sprites that have changed
+	for( int i = 0; m_SpriteChanged != 0; i++, m_SpriteChanged >>= 1 )
+	{
+		if( m_SpriteChanged & 1 )
+		{
+			UpdateSpriteMasks( i );
+		}
+	}
 
 	sSpriteAttributeEntry *sprite = &reinterpret_cast<sSpriteAttribute *>( m_Memory + m_SpriteAttrTableIndex )->data[ 0 ];
 
-	size_t count[ 256 ][ 2 ];
-	memset( count, 0, sizeof( count ));
+	// Sprites after the terminator aren't displayed
+	int active = 0;
+	while(( active < 32 ) && ( sprite[ active ].posY != 0xD0 ))
+	{
+		active++;
+	}
 
-	memset( m_MaxSprite, 0xFF, sizeof( m_MaxSprite ));
+	UINT32 activeMask = ( active < 32 ) ? ( 1u << active ) - 1 : 0xFFFFFFFF;
 
-	int size  = ( m_Register[ 1 ] & VDP_SPRITE_MAGNIFY ) ? 16 : 8;
-	int range = ( m_Register[ 1 ] & VDP_SPRITE_SIZE ) ? 2 * size : size;
+	m_FifthSpriteFlag  = false;
+	m_FifthSpriteIndex = ( active < 32 ) ? active : 31;
 
-	// Count the # of sprites on a line and find the last one to display
-	for( size_t i = 0; i < 32; i++ )
+	// Find the last sprite to display on each line and look for 5 or more sprites on a line
+	for( int y = 0; y < VDP_HEIGHT; y++ )
 	{
-		m_FifthSpriteIndex = i;
+		UINT32 bits = m_LineSprites[ y ] & activeMask;
 
-		unsigned int y = sprite[ i ].posY;
+		m_MaxSprite[ y ] = 0xFF;
 
-		if( y == 0xD0 )
+		for( int count = 0; ( bits != 0 ) && ( count < 4 ); count++ )
+		{
+			m_MaxSprite[ y ] = std::countr_zero( bits );
+			bits &= bits - 1;
+		}
+
+		if(( bits != 0 ) && ( m_FifthSpriteFlag == false ))
+		{
+			m_FifthSpriteFlag  = true;
+			m_FifthSpriteIndex = std::countr_zero( bits );
+		}
+	}
+
+	UINT32 check = 0;
+	for( int i = 0; i < active; i++ )
+	{
+		if( m_SpriteRange[ i ] != 0 )
+		{
+			check |= 1u << i;
+		}
+	}
+
+	m_CoincidenceFlag = CheckCoincidence( check );
+}
+
+int cTMS9918A::GetScanline( ) const
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::GetScanline", false );
+
+	if(( m_CPU == nullptr ) || ( m_LineClocks == 0 ))
+	{
+		return VDP_HEIGHT;
+	}
+
+	// Retrace happens as the beam leaves the last line of the active display
+	UINT64 lines = ( static_cast<UINT64>( m_CPU->GetClocks( ) - m_FrameClock ) << 16 ) / m_LineClocks;
+
+	return static_cast<int>(( VDP_HEIGHT + lines ) % m_LinesPerFrame );
+}
+
+void cTMS9918A::RenderScanline( const UINT8 reg[ 8 ], int line, UINT8 *pixels ) const
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::RenderScanline", false );
+
+	UINT8 backdrop = ( reg[ 7 ] & 0x0F ) ? ( reg[ 7 ] & 0x0F ) : TI_BLACK;
+
+	if(( reg[ 1 ] & VDP_BLANK_MASK ) == 0 )
+	{
+		memset( pixels, backdrop, VDP_WIDTH );
+		return;
+	}
+
+	int mode = (( reg[ 0 ] & VDP_MODE_3_BIT ) ? VDP_M3 : 0 ) |
+			   (( reg[ 1 ] & VDP_MODE_2_BIT ) ? VDP_M2 : 0 ) |
+			   (( reg[ 1 ] & VDP_MODE_1_BIT ) ? VDP_M1 : 0 );
+
+	UINT8 fore = reg[ 7 ] >> 4;
+	UINT8 back = reg[ 7 ] & 0x0F;
+
+	int row = line / 8;
+	int y   = line % 8;
+
+	const UINT8 *image = m_Memory + reg[ 2 ] * 0x0400;
+
+	auto color = [backdrop]( UINT8 index ) { return index ? index : backdrop; };
+
+	if(( mode & VDP_MODE_ILLEGAL ) == VDP_MODE_ILLEGAL )
+	{
+		memset( pixels, backdrop, VDP_WIDTH );
+		for( int x = 0; x < 40 * 6; x++ )
+		{
+			pixels[ 8 + x ] = color(( x % 6 < 4 ) ? fore : back );
+		}
+		return;
+	}
+
+	if( mode & VDP_M1 )
+	{
+		// Text modes have a border on both sides and no sprites
+		const UINT8 *pattern = m_Memory + (( mode & VDP_M3 ) ? (( reg[ 4 ] & 0x04 ) ? 0x2000 : 0 ) : reg[ 4 ] * sizeof( sPatternDescriptor ));
+		unsigned int patternMask = ( mode & VDP_M3 ) ? (( reg[ 4 ] & 0x03u ) << 8 ) | 0x00FF : 0x00FF;
+		unsigned int third = ( mode & VDP_M3 ) ? ( row / 8 ) * 256 : 0;
+
+		memset( pixels, backdrop, VDP_WIDTH );
+		UINT8 *pDst = pixels + 8;
+		for( int x = 0; x < 40; x++ )
+		{
+			UINT8 bits = pattern[ (( third + image[ row * 40 + x ] ) & patternMask ) * 8 + y ];
+			for( int i = 0; i < 6; i++, bits <<= 1 )
+			{
+				*pDst++ = color(( bits & 0x80 ) ? fore : back );
+			}
+		}
+		return;
+	}
+
+	if( mode & VDP_M3 )
+	{
+		const UINT8 *pattern = m_Memory + (( reg[ 4 ] & 0x04 ) ? 0x2000 : 0 );
+		const UINT8 *colors  = m_Memory + (( reg[ 3 ] & 0x80 ) ? 0x2000 : 0 );
+
+		unsigned int colorMask   = (( reg[ 3 ] & 0x7Fu ) << 3 ) | 0x0007u;
+		unsigned int patternMask = (( reg[ 4 ] & 0x03u ) << 8 ) | ( colorMask & 0x00FF );
+		unsigned int third       = ( row / 8 ) * 256;
+
+		for( int x = 0; x < 32; x++ )
+		{
+			unsigned int ch = third + image[ row * 32 + x ];
+			UINT8 bits = pattern[ ( ch & patternMask ) * 8 + y ];
+			UINT8 attr = colors[ ( ch & colorMask ) * 8 + y ];
+			for( int i = 0; i < 8; i++, bits <<= 1 )
+			{
+				*pixels++ = color(( bits & 0x80 ) ? attr >> 4 : attr & 0x0F );
+			}
+		}
+	}
+	else if( mode & VDP_M2 )
+	{
+		const UINT8 *pattern = m_Memory + reg[ 4 ] * sizeof( sPatternDescriptor );
+
+		for( int x = 0; x < 32; x++ )
+		{
+			UINT8 attr = pattern[ image[ row * 32 + x ] * 8 + ( row & 0x03 ) * 2 + y / 4 ];
+			memset( pixels, color( attr >> 4 ), 4 );
+			memset( pixels + 4, color( attr & 0x0F ), 4 );
+			pixels += 8;
+		}
+	}
+	else
+	{
+		const UINT8 *pattern = m_Memory + reg[ 4 ] * sizeof( sPatternDescriptor );
+		const UINT8 *colors  = m_Memory + reg[ 3 ] * sizeof( sColorTable );
+
+		for( int x = 0; x < 32; x++ )
+		{
+			UINT8 ch   = image[ row * 32 + x ];
+			UINT8 bits = pattern[ ch * 8 + y ];
+			UINT8 attr = colors[ ch / 8 ];
+			for( int i = 0; i < 8; i++, bits <<= 1 )
+			{
+				*pixels++ = color(( bits & 0x80 ) ? attr >> 4 : attr & 0x0F );
+			}
+		}
+	}
+
+	RenderSprites( reg, line, pixels - VDP_WIDTH );
+}
+
+void cTMS9918A::RenderSprites( const UINT8 reg[ 8 ], int line, UINT8 *pixels ) const
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::RenderSprites", false );
+
+	const sSpriteAttributeEntry *sprite = reinterpret_cast<const sSpriteAttribute *>( m_Memory + reg[ 5 ] * sizeof( sSpriteAttribute ))->data;
+	const sSpriteDescriptor *desc = reinterpret_cast<const sSpriteDescriptor *>( m_Memory + reg[ 6 ] * sizeof( sSpriteDescriptor ));
+
+	bool magnify = ( reg[ 1 ] & VDP_SPRITE_MAGNIFY ) ? true : false;
+	int  count   = ( reg[ 1 ] & VDP_SPRITE_SIZE ) ? 2 : 1;
+	int  range   = 8 * count * ( magnify ? 2 : 1 );
+
+	bool drawn[ VDP_WIDTH ] = { };
+	int visible = 0;
+
+	// Lower numbered sprites are on top, and only the first 4 on a line are displayed
+	for( int i = 0; i < 32; i++ )
+	{
+		if( sprite[ i ].posY == 0xD0 )
+		{
+			break;
+		}
+
+		int dy = static_cast<UINT8>( line - sprite[ i ].posY - 1 );
+		if( dy >= range )
+		{
+			continue;
+		}
+
+		if( ++visible > 4 )
 		{
 			break;
 		}
 
-		// Offscreen sprites aren't checked
-		if(( y >= 0xC0 ) && ( y < 0xE0 ))
+		UINT8 colorIndex = sprite[ i ].earlyClock & 0x0F;
+		if( colorIndex == 0 )
 		{
 			continue;
 		}
 
-		for( unsigned int j = y + 1; j <= y + range; j++ )
+		int row  = magnify ? dy / 2 : dy;
+		int posX = ( sprite[ i ].earlyClock & 0x80 ) ? sprite[ i ].posX - 32 : sprite[ i ].posX;
+
+		UINT8 index = sprite[ i ].patternIndex + row / 8;
+		int bits = desc->data[ index ][ row % 8 ] << 8;
+		if( count == 2 )
 		{
-			int x = count[ j & 0xFF ][ 0 ]++;
-			if( x < 4 )
+			bits |= desc->data[( index + 2 ) % 256 ][ row % 8 ];
+		}
+
+		for( int x = 0; x < range; x++ )
+		{
+			int col = posX + x;
+			if(( col < 0 ) || ( col >= VDP_WIDTH ))
 			{
-				m_MaxSprite[ j & 0xFF ] = i;
+				continue;
 			}
-			else if( x == 4 )
+			if(( bits & ( 0x8000 >> ( magnify ? x / 2 : x ))) && !drawn[ col ] )
 			{
-				count[ j & 0xFF ][ 1 ] = i;
+				pixels[ col ] = colorIndex;
+				drawn[ col ]  = true;
 			}
 		}
+	}
+}
+
+void cTMS9918A::RenderFrame( UINT8 *pixels ) const
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::RenderFrame", false );
+
+	UINT8 reg[ 8 ];
+	memcpy( reg, m_FrameRegister, sizeof( reg ));
+
+	auto event = m_FrameEvents.begin( );
+
+	for( int line = 0; line < VDP_HEIGHT; line++ )
+	{
+		while(( event != m_FrameEvents.end( )) && ( event->line <= line ))
+		{
+			reg[ event->reg ] = event->value;
+			event++;
+		}
+
+		RenderScanline( reg, line, pixels );
 
-		// This sprite should be checked for coincidence
-		check[ i ] = true;
+		pixels += VDP_WIDTH;
 	}
+}
 
-	m_CoincidenceFlag = CheckCoincidence( check );
+static UINT64 HashBytes( UINT64 hash, const UINT8 *data, size_t length )
+{
+	// 64-bit FNV-1a
+	while( length-- > 0 )
+	{
+		hash ^= *data++;
+		hash *= 0x00000100000001B3ull;
+	}
+
+	return hash;
+}
+
+UINT64 cTMS9918A::GetScreenHash( ) const
+{
+	FUNCTION_ENTRY( this, "cTMS9918A::GetScreenHash", false );
 
-	m_FifthSpriteFlag = false;
+	UINT64 hash = 0xCBF29CE484222325ull;
 
-	// Look for 5 or more sprites on a row starting at the top of the screen
-	for( size_t i = 0; i < VDP_HEIGHT; i++ )
+	UINT8 reg[ 8 ];
+	memcpy( reg, m_Register, sizeof( reg ));
+
+	// These bits don't change what's on the screen
+	reg[ 1 ] &= ~( VDP_16K_MASK | VDP_INTERRUPT_MASK );
+
+	// A blanked screen only shows the backdrop color
+	if(( reg[ 1 ] & VDP_BLANK_MASK ) == 0 )
+	{
+		UINT8 backdrop[ 2 ] = { reg[ 1 ], static_cast<UINT8>( reg[ 7 ] & 0x0F ) };
+		return HashBytes( hash, backdrop, sizeof( backdrop ));
+	}
+
+	hash = HashBytes( hash, reg, sizeof( reg ));
+
+	// Mid-frame register changes are part of the picture too
+	for( auto &event : m_FrameEvents )
 	{
-		if( count[ i ][ 0 ] >= 5 )
+		UINT8 data[ 3 ] = { static_cast<UINT8>( event.line ), event.reg, event.value };
+		hash = HashBytes( hash, data, sizeof( data ));
+	}
+
+	// Hash each run of VRAM used by the image, pattern, and color tables
+	const UINT8 tables = MEM_IMAGE_TABLE | MEM_PATTERN_TABLE | MEM_COLOR_TABLE;
+
+	for( size_t i = 0; i < 0x4000; )
+	{
+		if(( m_MemoryType[ i ] & tables ) == 0 )
 		{
-			m_FifthSpriteFlag  = true;
-			m_FifthSpriteIndex = count[ i ][ 1 ];
-			break;
+			i++;
+			continue;
+		}
+
+		size_t start = i;
+		while(( i < 0x4000 ) && ( m_MemoryType[ i ] & tables ))
+		{
+			i++;
+		}
+
+		hash = HashBytes( hash, m_Memory + start, i - start );
+	}
+
+	// Sprites aren't displayed in text modes
+	if( m_Mode & VDP_M1 )
+	{
+		return hash;
+	}
+
+	const sSpriteAttributeEntry *sprite = reinterpret_cast<sSpriteAttribute *>( m_Memory + m_SpriteAttrTableIndex )->data;
+	const UINT8 *pattern = reinterpret_cast<sSpriteDescriptor *>( m_Memory + m_SpriteDescTableIndex )->data[ 0 ];
+
+	size_t count = ( m_Register[ 1 ] & VDP_SPRITE_SIZE ) ? 4 : 1;
+
+	// Only sprites that are displayed, and the patterns they use, matter
+	for( int i = 0; ( i < 32 ) && ( sprite[ i ].posY != 0xD0 ); i++ )
+	{
+		if(( sprite[ i ].posY >= 0xC0 ) && ( sprite[ i ].posY < 0xE0 ))
+		{
+			continue;
+		}
+
+		UINT8 index = static_cast<UINT8>( i );
+		hash = HashBytes( hash, &index, 1 );
+		hash = HashBytes( hash, reinterpret_cast<const UINT8 *>( &sprite[ i ] ), sizeof( sSpriteAttributeEntry ));
+
+		for( size_t j = 0; j < count; j++ )
+		{
+			hash = HashBytes( hash, pattern + static_cast<UINT8>( sprite[ i ].patternIndex + j ) * 8, 8 );
 		}
 	}
+
+	return hash;
 }
 
 bool cTMS9918A::Retrace( )
 {
 	FUNCTION_ENTRY( this, "cTMS9918A::Retrace", false );
 
+	if( m_CPU != nullptr )
+	{
+		m_FrameClock = m_CPU->GetClocks( );
+	}
+
+	// Hand the completed frame's register history to the renderer and start a new one
+	memcpy( m_FrameRegister, m_LineRegister, sizeof( m_FrameRegister ));
+	memcpy( m_LineRegister, m_Register, sizeof( m_LineRegister ));
+
+	m_FrameEvents.swap( m_RegisterEvents );
+	m_RegisterEvents.clear( );
+
 	m_SpritesRefreshed = true;
 
 	// Only check if something has changed
@@ -700,6 +1204,18 @@ bool cTMS9918A::ParseState( const sStateSection &state )
 		WriteRegister( i, NewRegister[ i ] );
 	}
 
+	memcpy( m_LineRegister, m_Register, sizeof( m_LineRegister ));
+	memcpy( m_FrameRegister, m_Register, sizeof( m_FrameRegister ));
+
+	m_RegisterEvents.clear( );
+	m_FrameEvents.clear( );
+
+	// The CPU's clock has been restored already - restart the frame from it so GetScanline isn't stale
+	m_FrameClock = ( m_CPU != nullptr ) ? m_CPU->GetClocks( ) : 0;
+
+	m_SpriteChanged = 0xFFFFFFFF;
+	m_SpritesDirty  = true;
+
 	return true;
 }
 
@@ -26,22 +26,124 @@
 //
 //----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
 #include "common.hpp"
 #include "logger.hpp"
 #include "tms9919.hpp"
 #include "itms5220.hpp"
+#include "itms9900.hpp"
 #include "support.hpp"
+#include "audio-capture.hpp"
+#include "audio-stats.hpp"
 
 DBG_REGISTER( __FILE__ );
 
+// NOTE: These numbers were taken from the MESS source code
+#define NOISE_RESET              0x00F35
+#define NOISE_WHITE_GENERATOR    0x12000
+#define NOISE_PERIODIC_GENERATOR 0x08000
+
+#define CLOCK_FREQUENCY         3579545
+
+// Band-limited step - each transition is spread over BLEP_WIDTH samples
+#define BLEP_PHASES             64
+#define BLEP_WIDTH              16
+
+// Largest change made to the output rate to keep the audio buffer level
+#define MAX_RATE_ADJUST         0.005
+
+// No register write is being followed for the latency statistics
+#define NO_PROBE                ( ~( size_t ) 0 )
+
+static float BlepKernel[ BLEP_PHASES + 1 ][ BLEP_WIDTH ];
+
+static void BuildBlepKernel( )
+{
+	FUNCTION_ENTRY( nullptr, "BuildBlepKernel", true );
+
+	const double cutoff = 0.90;			// Fraction of the Nyquist frequency
+
+	for( int phase = 0; phase <= BLEP_PHASES; phase++ )
+	{
+		double offset = ( double ) phase / BLEP_PHASES;
+		double sum    = 0.0;
+		double kernel[ BLEP_WIDTH ];
+
+		// Blackman windowed sinc impulse centered between taps BLEP_WIDTH/2-1 and BLEP_WIDTH/2
+		for( int i = 0; i < BLEP_WIDTH; i++ )
+		{
+			double x = i - ( BLEP_WIDTH / 2 - 1 ) - offset;
+			double w = 2.0 * M_PI * ( x + BLEP_WIDTH / 2 ) / BLEP_WIDTH;
+			double window = 0.42 - 0.5 * cos( w ) + 0.08 * cos( 2.0 * w );
+			double sinc   = ( x == 0.0 ) ? 1.0 : sin( M_PI * cutoff * x ) / ( M_PI * cutoff * x );
+			kernel[ i ] = sinc * (( fabs( x ) < BLEP_WIDTH / 2 ) ? window : 0.0 );
+			sum += kernel[ i ];
+		}
+
+		// Each step must add exactly its full height once integrated
+		for( int i = 0; i < BLEP_WIDTH; i++ )
+		{
+			BlepKernel[ phase ][ i ] = ( float ) ( kernel[ i ] / sum );
+		}
+	}
+}
+
+static inline INT16 ClipSample( double value )
+{
+	long sample = lrint( value );
+
+	return ( INT16 ) (( sample > 32767 ) ? 32767 : ( sample < -32768 ) ? -32768 : sample );
+}
+
+static void InitializeBlep( )
+{
+	FUNCTION_ENTRY( nullptr, "InitializeBlep", true );
+
+	// Sound chips may be created on several threads at once (i.e. batch rendering)
+	static std::once_flag initialized;
+
+	std::call_once( initialized, BuildBlepKernel );
+}
+
 cTMS9919::cTMS9919( ) :
 	cBaseObject( "cTMS9919" ),
 	m_pSpeechSynthesizer( nullptr ),
+	m_CPU( nullptr ),
 	m_LastData( 0 ),
 	m_Frequency( ),
 	m_Attenuation( ),
 	m_NoiseColor( NOISE_WHITE ),
-	m_NoiseType( 0 )
+	m_NoiseType( 0 ),
+	m_ClockSpeed( 0 ),
+	m_SampleRate( 0 ),
+	m_SamplesPerClock( 0.0 ),
+	m_LastClock( 0 ),
+	m_Time( 0.0 ),
+	m_Accumulator( ),
+	m_RateAdjust( 1.0 ),
+	m_RateDrift( 0.0 ),
+	m_TargetFill( 0 ),
+	m_FillAverage( 0.0 ),
+	m_VolumeTable( ),
+	m_Info( ),
+	m_ShiftRegister( NOISE_RESET ),
+	m_NoiseGenerator( NOISE_WHITE_GENERATOR ),
+	m_DeltaBuffers( 1 ),
+	m_OutputChannels( 1 ),
+	m_Pan( ),
+	m_StemCapture( nullptr ),
+	m_Stats( nullptr ),
+	m_ProbeEvent( NO_PROBE ),
+	m_ProbeTime( 0 ),
+	m_Events( ),
+	m_Deltas( ),
+	m_Samples( ),
+	m_Stems( ),
+	m_Speech( ),
+	m_Output( )
 {
 	FUNCTION_ENTRY( this, "cTMS9919 ctor", true );
 
@@ -49,11 +151,31 @@ cTMS9919::cTMS9919( ) :
 	m_Attenuation[ 1 ] = 0x0F;
 	m_Attenuation[ 2 ] = 0x0F;
 	m_Attenuation[ 3 ] = 0x0F;
+
+	// Set loudest volume to max possible level / 4 (so 4 audio channels won't clip)
+	float volume = 32768.0f / 4.0f;
+	for( unsigned int i = 0; i < SIZE( m_VolumeTable ) - 1; i++ )
+	{
+		m_VolumeTable[ i ] = ( int ) volume;
+		volume = ( float ) ( volume / 1.258925412f );    // Reduce volume by 2dB
+	}
+	m_VolumeTable[ 15 ] = 0;
+
+	for( auto &info : m_Info )
+	{
+		info.sign = 1;
+	}
+
+	// Spread the tones out a little when playing in stereo
+	m_Pan[ 0 ] = -0.5f;
+	m_Pan[ 2 ] =  0.5f;
 }
 
 cTMS9919::~cTMS9919( )
 {
 	FUNCTION_ENTRY( this, "cTMS9919 dtor", true );
+
+	delete m_StemCapture;
 }
 
 //----------------------------------------------------------------------------
@@ -81,8 +203,15 @@ void cTMS9919::SetNoise( uint8_t color, uint8_t type )
 {
 	FUNCTION_ENTRY( this, "cTMS9919::SetNoise", true );
 
-	m_NoiseColor = color;
-	m_NoiseType  = type;
+	// The shift register is reset when the color is changed
+	if( color != m_NoiseColor )
+	{
+		m_ShiftRegister = NOISE_RESET;
+	}
+
+	m_NoiseColor     = color;
+	m_NoiseType      = type;
+	m_NoiseGenerator = ( color == NOISE_WHITE ) ? NOISE_WHITE_GENERATOR : NOISE_PERIODIC_GENERATOR;
 
 	switch( type )
 	{
@@ -102,6 +231,8 @@ void cTMS9919::SetNoise( uint8_t color, uint8_t type )
 			DBG_ERROR( "Invalid noise type selected: " << type );
 			break;
 	}
+
+	UpdateVoice( 3 );
 }
 
 void cTMS9919::SetFrequency( uint8_t tone, uint16_t freq )
@@ -110,6 +241,8 @@ void cTMS9919::SetFrequency( uint8_t tone, uint16_t freq )
 
 	m_Frequency[ tone ] = freq;
 
+	UpdateVoice( tone );
+
 	if(( tone == 2 ) && ( m_NoiseType == 3 ))
 	{
 		SetNoise( m_NoiseColor, m_NoiseType );
@@ -121,6 +254,8 @@ void cTMS9919::SetAttenuation( uint8_t tone, uint8_t atten )
 	FUNCTION_ENTRY( this, "cTMS9919::SetAttenuation", true );
 
 	m_Attenuation[ tone ] = atten;
+
+	UpdateVoice( tone );
 }
 
 void cTMS9919::SetSpeechSynthesizer( iTMS5220 *speech )
@@ -128,11 +263,160 @@ void cTMS9919::SetSpeechSynthesizer( iTMS5220 *speech )
 	FUNCTION_ENTRY( this, "cTMS9919::SetSpeechSynthesizer", true );
 
 	m_pSpeechSynthesizer = speech;
+
+	if( m_pSpeechSynthesizer != nullptr )
+	{
+		m_pSpeechSynthesizer->SetRateAdjust( m_RateAdjust );
+	}
 }
 
-void cTMS9919::WriteData( UINT8 data )
+void cTMS9919::SetCPU( iTMS9900 *cpu, UINT32 clockSpeed )
 {
-	FUNCTION_ENTRY( this, "cTMS9919::WriteData", true );
+	FUNCTION_ENTRY( this, "cTMS9919::SetCPU", true );
+
+	m_CPU        = cpu;
+	m_ClockSpeed = clockSpeed;
+	m_LastClock  = ( cpu != nullptr ) ? cpu->GetClocks( ) : 0;
+
+	m_SamplesPerClock = ( clockSpeed != 0 ) ? ( double ) m_SampleRate / clockSpeed : 0.0;
+}
+
+void cTMS9919::SetSampleRate( int sampleRate )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::SetSampleRate", true );
+
+	InitializeBlep( );
+
+	m_SampleRate = sampleRate;
+
+	m_SamplesPerClock = ( m_ClockSpeed != 0 ) ? ( double ) sampleRate / m_ClockSpeed : 0.0;
+
+	// Leave room for 1/4 second of audio
+	m_Output.Resize( sampleRate / 4 * m_OutputChannels );
+
+	m_Time = 0.0;
+
+	for( int i = 0; i < 4; i++ )
+	{
+		m_Accumulator[ i ] = 0.0;
+		m_Deltas[ i ].assign(( i < m_DeltaBuffers ) ? BLEP_WIDTH + 1 : 0, 0.0f );
+	}
+
+	for( int i = 0; i < 4; i++ )
+	{
+		m_Info[ i ].period = 0.0;
+		m_Info[ i ].level  = 0;
+		UpdateVoice( i );
+	}
+}
+
+void cTMS9919::UpdateVoice( int tone )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::UpdateVoice", false );
+
+	if( m_SampleRate == 0 )
+	{
+		return;
+	}
+
+	sVoiceInfo *info = &m_Info[ tone ];
+
+	// Tones above the Nyquist frequency are inaudible - treat them as silence
+	double period = ( double ) m_SampleRate * m_Frequency[ tone ] / CLOCK_FREQUENCY / 2.0;
+	if( period < 1.0 )
+	{
+		period = 0.0;
+	}
+
+	// The current half cycle always completes before a new period takes effect
+	if(( info->period == 0.0 ) && ( period != 0.0 ))
+	{
+		info->next = m_Time + period;
+	}
+
+	info->period = period;
+
+	int level = ( period != 0.0 ) ? info->sign * m_VolumeTable[ m_Attenuation[ tone ]] : 0;
+
+	AddStep( tone, m_Time, level - info->level );
+
+	info->level = level;
+}
+
+void cTMS9919::AddStep( int tone, double time, int delta )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::AddStep", false );
+
+	if( delta == 0 )
+	{
+		return;
+	}
+
+	int index = ( int ) time;
+	int phase = ( int ) (( time - index ) * BLEP_PHASES );
+
+	const float *kernel = BlepKernel[ phase ];
+	float *delta_ptr = &m_Deltas[ ( m_DeltaBuffers > 1 ) ? tone : 0 ][ index ];
+
+	for( int i = 0; i < BLEP_WIDTH; i++ )
+	{
+		delta_ptr[ i ] += delta * kernel[ i ];
+	}
+}
+
+void cTMS9919::RunVoices( double endTime )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::RunVoices", false );
+
+	for( int i = 0; i < 4; i++ )
+	{
+		sVoiceInfo *info = &m_Info[ i ];
+
+		if( info->period == 0.0 )
+		{
+			continue;
+		}
+
+		int volume = m_VolumeTable[ m_Attenuation[ i ]];
+
+		while( info->next < endTime )
+		{
+			if( i < 3 )
+			{
+				// Tone
+				info->sign = -info->sign;
+			}
+			else
+			{
+				// Noise
+				if( m_ShiftRegister & 1 )
+				{
+					m_ShiftRegister ^= m_NoiseGenerator;
+					// Protect against 0
+					if( m_ShiftRegister == 0 )
+					{
+						m_ShiftRegister = NOISE_RESET;
+					}
+					info->sign = -info->sign;
+				}
+				m_ShiftRegister >>= 1;
+			}
+
+			int level = info->sign * volume;
+
+			AddStep( i, info->next, level - info->level );
+
+			info->level = level;
+			info->next += info->period;
+		}
+	}
+
+	m_Time = endTime;
+}
+
+void cTMS9919::ProcessData( UINT8 data )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::ProcessData", false );
 
 	if( data & 0x80 )
 	{
@@ -167,11 +451,401 @@ void cTMS9919::WriteData( UINT8 data )
 	}
 }
 
+void cTMS9919::WriteData( UINT8 data )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::WriteData", true );
+
+	// Without a sample clock there's nothing to keep in step with
+	if(( m_SampleRate == 0 ) || ( m_CPU == nullptr ))
+	{
+		ProcessData( data );
+		return;
+	}
+
+	m_Events.push_back( { m_CPU->GetClocks( ), data } );
+
+	// Follow one write at a time through to the audio device
+	if(( m_Stats != nullptr ) && ( m_ProbeEvent == NO_PROBE ) && ( m_Stats->IsProbeActive( ) == false ))
+	{
+		m_ProbeEvent = m_Events.size( ) - 1;
+		m_ProbeTime  = cAudioStats::Now( );
+	}
+}
+
+void cTMS9919::Update( UINT32 clockCycles )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::Update", false );
+
+	// Speech is synthesized on the same clock so it's ready before the samples are mixed
+	if( m_pSpeechSynthesizer != nullptr )
+	{
+		m_pSpeechSynthesizer->Update( clockCycles );
+	}
+
+	if(( m_SampleRate == 0 ) || ( m_SamplesPerClock == 0.0 ))
+	{
+		for( auto &event : m_Events )
+		{
+			ProcessData( event.data );
+		}
+		m_Events.clear( );
+		m_ProbeEvent = NO_PROBE;
+		return;
+	}
+
+	UINT32 elapsed = clockCycles - m_LastClock;
+
+	// Don't try to catch up after a reset or a restored image - just start over from here
+	if( elapsed > m_ClockSpeed / 4 )
+	{
+		elapsed = 0;
+		for( auto &event : m_Events )
+		{
+			event.clock = m_LastClock;
+		}
+	}
+
+	double samplesPerClock = m_SamplesPerClock * m_RateAdjust;
+
+	double endTime = m_Time + elapsed * samplesPerClock;
+
+	ReserveDeltas( endTime );
+
+	// Apply each register write at the sample position it occurred
+	for( size_t i = 0; i < m_Events.size( ); i++ )
+	{
+		UINT32 offset = std::min( m_Events[ i ].clock - m_LastClock, elapsed );
+		double time = std::max( m_Time, endTime - ( elapsed - offset ) * samplesPerClock );
+		RunVoices( time );
+		ProcessData( m_Events[ i ].data );
+
+		if( i == m_ProbeEvent )
+		{
+			// m_Time is relative to the first sample that hasn't been written to the output yet
+			m_Stats->StartProbe( m_Output.GetWritten( ) / m_OutputChannels + ( UINT64 ) time, m_ProbeTime );
+		}
+	}
+
+	m_Events.clear( );
+	m_ProbeEvent = NO_PROBE;
+
+	RunVoices( endTime );
+
+	m_LastClock = clockCycles;
+
+	FlushSamples( );
+}
+
+void cTMS9919::GenerateSamples( size_t count )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::GenerateSamples", false );
+
+	if( m_SampleRate == 0 )
+	{
+		return;
+	}
+
+	double endTime = m_Time + count;
+
+	ReserveDeltas( endTime );
+
+	RunVoices( endTime );
+
+	FlushSamples( );
+}
+
+void cTMS9919::ReserveDeltas( double endTime )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::ReserveDeltas", false );
+
+	size_t needed = ( size_t ) endTime + BLEP_WIDTH + 1;
+
+	for( int i = 0; i < m_DeltaBuffers; i++ )
+	{
+		if( m_Deltas[ i ].size( ) < needed )
+		{
+			m_Deltas[ i ].resize( needed, 0.0f );
+		}
+	}
+}
+
+void cTMS9919::UpdateDeltaBuffers( )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::UpdateDeltaBuffers", true );
+
+	int buffers = (( m_StemCapture != nullptr ) || ( m_OutputChannels > 1 )) ? 4 : 1;
+
+	if( buffers == m_DeltaBuffers )
+	{
+		return;
+	}
+
+	// Fold any pending steps back into the shared buffer so nothing is lost
+	for( int i = 1; i < m_DeltaBuffers; i++ )
+	{
+		for( size_t j = 0; j < m_Deltas[ i ].size( ); j++ )
+		{
+			m_Deltas[ 0 ][ j ] += m_Deltas[ i ][ j ];
+		}
+		m_Accumulator[ 0 ] += m_Accumulator[ i ];
+	}
+
+	for( int i = 1; i < 4; i++ )
+	{
+		m_Accumulator[ i ] = 0.0;
+		m_Deltas[ i ].assign(( i < buffers ) ? m_Deltas[ 0 ].size( ) : 0, 0.0f );
+	}
+
+	m_DeltaBuffers = buffers;
+}
+
+void cTMS9919::FlushSamples( )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::FlushSamples", false );
+
+	size_t count = ( size_t ) m_Time;
+	if( count == 0 )
+	{
+		return;
+	}
+
+	if( m_DeltaBuffers > 1 )
+	{
+		MixVoices( count );
+	}
+	else
+	{
+		m_Samples.resize( count );
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			// The slight leak keeps rounding errors in the deltas from accumulating into a DC offset
+			m_Accumulator[ 0 ] += m_Deltas[ 0 ][ i ] - m_Accumulator[ 0 ] * ( 1.0 / 8192 );
+			m_Samples[ i ] = ClipSample( m_Accumulator[ 0 ] );
+		}
+
+		// Speech is generated at the same pace as the tones
+		if( m_pSpeechSynthesizer != nullptr )
+		{
+			m_pSpeechSynthesizer->AudioCallback( m_Samples.data( ), ( int ) count );
+		}
+
+		WriteOutput( m_Samples.data( ), count );
+	}
+
+	// Move the tails of the last steps to the start of the buffer
+	for( int i = 0; i < m_DeltaBuffers; i++ )
+	{
+		std::vector<float> &deltas = m_Deltas[ i ];
+		std::copy( deltas.begin( ) + count, deltas.begin( ) + count + BLEP_WIDTH + 1, deltas.begin( ));
+		std::fill( deltas.begin( ) + BLEP_WIDTH + 1, deltas.end( ), 0.0f );
+	}
+
+	m_Time -= count;
+
+	for( auto &info : m_Info )
+	{
+		if( info.period != 0.0 )
+		{
+			info.next -= count;
+		}
+	}
+
+	AdjustRate( );
+}
+
+void cTMS9919::MixVoices( size_t count )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::MixVoices", false );
+
+	m_Stems.resize( count * SOUND_STEMS );
+
+	for( int voice = 0; voice < 4; voice++ )
+	{
+		const float *deltas = m_Deltas[ voice ].data( );
+		INT16 *stem = &m_Stems[ voice ];
+		double accumulator = m_Accumulator[ voice ];
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			accumulator += deltas[ i ] - accumulator * ( 1.0 / 8192 );
+			stem[ i * SOUND_STEMS ] = ClipSample( accumulator );
+		}
+
+		m_Accumulator[ voice ] = accumulator;
+	}
+
+	// Speech gets a channel of its own
+	m_Speech.assign( count, 0 );
+
+	if( m_pSpeechSynthesizer != nullptr )
+	{
+		m_pSpeechSynthesizer->AudioCallback( m_Speech.data( ), ( int ) count );
+	}
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		m_Stems[ i * SOUND_STEMS + 4 ] = m_Speech[ i ];
+	}
+
+	if( m_StemCapture != nullptr )
+	{
+		m_StemCapture->AddSamples( m_Stems.data( ), count );
+	}
+
+	// Equal power panning, scaled so a centered stem is as loud as it is in mono
+	float gain[ SOUND_STEMS ][ 2 ];
+	for( int i = 0; i < SOUND_STEMS; i++ )
+	{
+		double angle = ( m_Pan[ i ] + 1.0 ) * M_PI / 4.0;
+		gain[ i ][ 0 ] = ( m_OutputChannels > 1 ) ? ( float ) ( M_SQRT2 * cos( angle )) : 1.0f;
+		gain[ i ][ 1 ] = ( m_OutputChannels > 1 ) ? ( float ) ( M_SQRT2 * sin( angle )) : 1.0f;
+	}
+
+	int channels = m_OutputChannels;
+
+	m_Samples.resize( count * channels );
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		const INT16 *stem = &m_Stems[ i * SOUND_STEMS ];
+		for( int j = 0; j < channels; j++ )
+		{
+			float sum = 0.0f;
+			for( int k = 0; k < SOUND_STEMS; k++ )
+			{
+				sum += stem[ k ] * gain[ k ][ j ];
+			}
+			m_Samples[ i * channels + j ] = ClipSample( sum );
+		}
+	}
+
+	WriteOutput( m_Samples.data( ), count * channels );
+}
+
+void cTMS9919::WriteOutput( const INT16 *samples, size_t count )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::WriteOutput", false );
+
+	// Samples that don't fit are dropped - the emulator is running ahead of the audio device
+	if(( m_Output.Write( samples, count ) < count ) && ( m_Stats != nullptr ))
+	{
+		m_Stats->AddOverrun( );
+		m_Stats->CancelProbe( );
+	}
+}
+
+void cTMS9919::AdjustRate( )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::AdjustRate", false );
+
+	if( m_TargetFill == 0 )
+	{
+		return;
+	}
+
+	// The fill level drops by a whole device buffer on every callback, so smooth it over ~100ms
+	double fill = ( double ) ( m_Output.Available( ) / m_OutputChannels );
+	m_FillAverage += ( fill - m_FillAverage ) * ( 1.0 / 256 );
+
+	// Nudge the output rate (at most +/-0.5%) to keep the buffer near the target - the
+	// integral term takes care of any steady drift between the host and audio clocks
+	double error = ( m_TargetFill - m_FillAverage ) / m_TargetFill;
+	error = std::min( 1.0, std::max( -1.0, error ));
+
+	m_RateDrift = std::min( MAX_RATE_ADJUST, std::max( -MAX_RATE_ADJUST, m_RateDrift + error * ( MAX_RATE_ADJUST / 4096 )));
+
+	m_RateAdjust = 1.0 + std::min( MAX_RATE_ADJUST, std::max( -MAX_RATE_ADJUST, m_RateDrift + error * MAX_RATE_ADJUST ));
+
+	// Speech is mixed into the same samples, so it has to follow the same rate
+	if( m_pSpeechSynthesizer != nullptr )
+	{
+		m_pSpeechSynthesizer->SetRateAdjust( m_RateAdjust );
+	}
+}
+
+void cTMS9919::SetTargetLatency( size_t samples )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::SetTargetLatency", true );
+
+	m_TargetFill  = samples;
+	m_FillAverage = ( double ) samples;
+	m_RateAdjust  = 1.0;
+	m_RateDrift   = 0.0;
+
+	if( m_pSpeechSynthesizer != nullptr )
+	{
+		m_pSpeechSynthesizer->SetRateAdjust( m_RateAdjust );
+	}
+}
+
+void cTMS9919::SetOutputChannels( int channels )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::SetOutputChannels", true );
+
+	m_OutputChannels = ( channels > 1 ) ? 2 : 1;
+
+	if( m_SampleRate != 0 )
+	{
+		m_Output.Resize( m_SampleRate / 4 * m_OutputChannels );
+	}
+
+	UpdateDeltaBuffers( );
+}
+
+void cTMS9919::SetPanning( int stem, double pan )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::SetPanning", true );
+
+	if(( stem >= 0 ) && ( stem < SOUND_STEMS ))
+	{
+		m_Pan[ stem ] = ( float ) std::min( 1.0, std::max( -1.0, pan ));
+	}
+}
+
+void cTMS9919::SetStemCapture( cAudioCapture *capture )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::SetStemCapture", true );
+
+	delete m_StemCapture;
+
+	m_StemCapture = capture;
+
+	UpdateDeltaBuffers( );
+}
+
+void cTMS9919::SetAudioStats( cAudioStats *stats )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::SetAudioStats", true );
+
+	m_Stats      = stats;
+	m_ProbeEvent = NO_PROBE;
+
+	if( stats != nullptr )
+	{
+		stats->SetDevice( m_SampleRate, 0 );
+	}
+}
+
+size_t cTMS9919::ReadSamples( INT16 *buffer, size_t count )
+{
+	FUNCTION_ENTRY( this, "cTMS9919::ReadSamples", false );
+
+	return m_Output.Read( buffer, count );
+}
+
+size_t cTMS9919::GetBufferedSamples( ) const
+{
+	FUNCTION_ENTRY( this, "cTMS9919::GetBufferedSamples", false );
+
+	return m_Output.Available( );
+}
+
 int cTMS9919::GetPlaybackFrequency( )
 {
 	FUNCTION_ENTRY( this, "cTMS9919::GetPlaybackFrequency", true );
 
-	return -1;
+	return ( m_SampleRate != 0 ) ? m_SampleRate : -1;
 }
 
 //----------------------------------------------------------------------------
@@ -189,12 +863,21 @@ bool cTMS9919::ParseState( const sStateSection &state )
 {
 	FUNCTION_ENTRY( this, "cTMS9919::ParseState", true );
 
+	m_Events.clear( );
+
 	state.load( "LastData", m_LastData, SaveFormat::HEXADECIMAL );
 	state.load( "Frequency", m_Frequency, SIZE( m_Frequency ));
 	state.load( "Attenuation", m_Attenuation, SIZE( m_Attenuation ));
 	state.load( "NoiseColor", m_NoiseColor, SaveFormat::HEXADECIMAL );
 	state.load( "NoiseType", m_NoiseType, SaveFormat::HEXADECIMAL );
 
+	m_NoiseGenerator = ( m_NoiseColor == NOISE_WHITE ) ? NOISE_WHITE_GENERATOR : NOISE_PERIODIC_GENERATOR;
+
+	for( int i = 0; i < 4; i++ )
+	{
+		UpdateVoice( i );
+	}
+
 	return false;
 }
 
@@ -202,6 +885,12 @@ std::optional<sStateSection> cTMS9919::SaveState( )
 {
 	FUNCTION_ENTRY( this, "cTMS9919::SaveState", true );
 
+	// Make sure any pending writes are reflected in the registers
+	if( m_CPU != nullptr )
+	{
+		Update( m_CPU->GetClocks( ));
+	}
+
 	sStateSection save;
 
 	save.name = "TMS9919";
@@ -0,0 +1,184 @@
+//----------------------------------------------------------------------------
+//
+// File:        wave-file.cpp
+// Date:        18-Oct-2026
+//
+// Description: Simple 16-bit PCM .wav file writer
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <cstring>
+#include "common.hpp"
+#include "logger.hpp"
+#include "wave-file.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+#define WAVE_FORMAT_PCM     1
+#define WAVE_HEADER_SIZE    44
+
+// .wav files are always little-endian
+static UINT8 *Store16( UINT8 *ptr, UINT32 value )
+{
+	*ptr++ = ( UINT8 ) ( value >> 0 );
+	*ptr++ = ( UINT8 ) ( value >> 8 );
+
+	return ptr;
+}
+
+static UINT8 *Store32( UINT8 *ptr, UINT32 value )
+{
+	ptr = Store16( ptr, value & 0xFFFF );
+
+	return Store16( ptr, value >> 16 );
+}
+
+cWaveFile::cWaveFile( ) :
+	m_File( nullptr ),
+	m_SampleRate( 0 ),
+	m_Channels( 0 ),
+	m_Frames( 0 ),
+	m_Buffer( )
+{
+	FUNCTION_ENTRY( this, "cWaveFile ctor", true );
+}
+
+cWaveFile::~cWaveFile( )
+{
+	FUNCTION_ENTRY( this, "cWaveFile dtor", true );
+
+	Close( );
+}
+
+bool cWaveFile::WriteHeader( )
+{
+	FUNCTION_ENTRY( this, "cWaveFile::WriteHeader", true );
+
+	UINT32 dataSize = ( UINT32 ) ( m_Frames * m_Channels * sizeof( INT16 ));
+
+	UINT8 header[ WAVE_HEADER_SIZE ];
+	UINT8 *ptr = header;
+
+	memcpy( ptr, "RIFF", 4 );                           ptr += 4;
+	ptr = Store32( ptr, WAVE_HEADER_SIZE - 8 + dataSize );
+	memcpy( ptr, "WAVE", 4 );                           ptr += 4;
+	memcpy( ptr, "fmt ", 4 );                           ptr += 4;
+	ptr = Store32( ptr, 16 );
+	ptr = Store16( ptr, WAVE_FORMAT_PCM );
+	ptr = Store16( ptr, m_Channels );
+	ptr = Store32( ptr, m_SampleRate );
+	ptr = Store32( ptr, m_SampleRate * m_Channels * sizeof( INT16 ));
+	ptr = Store16( ptr, m_Channels * sizeof( INT16 ));
+	ptr = Store16( ptr, 16 );
+	memcpy( ptr, "data", 4 );                           ptr += 4;
+	ptr = Store32( ptr, dataSize );
+
+	return fwrite( header, sizeof( header ), 1, m_File ) == 1;
+}
+
+bool cWaveFile::Open( const std::string &filename, int sampleRate, int channels )
+{
+	FUNCTION_ENTRY( this, "cWaveFile::Open", true );
+
+	Close( );
+
+	m_File = fopen( filename.c_str( ), "wb" );
+	if( m_File == nullptr )
+	{
+		DBG_ERROR( "Unable to create file " << filename );
+		return false;
+	}
+
+	m_SampleRate = sampleRate;
+	m_Channels   = channels;
+	m_Frames     = 0;
+
+	if( WriteHeader( ) == false )
+	{
+		fclose( m_File );
+		m_File = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+bool cWaveFile::Write( const INT16 *samples, size_t frames )
+{
+	FUNCTION_ENTRY( this, "cWaveFile::Write", false );
+
+	if( m_File == nullptr )
+	{
+		return false;
+	}
+
+	size_t count = frames * m_Channels;
+
+	m_Buffer.resize( count * sizeof( INT16 ));
+
+	UINT8 *ptr = m_Buffer.data( );
+	for( size_t i = 0; i < count; i++ )
+	{
+		ptr = Store16( ptr, ( UINT16 ) samples[ i ] );
+	}
+
+	if( fwrite( m_Buffer.data( ), sizeof( INT16 ), count, m_File ) != count )
+	{
+		return false;
+	}
+
+	m_Frames += frames;
+
+	return true;
+}
+
+bool cWaveFile::Close( )
+{
+	FUNCTION_ENTRY( this, "cWaveFile::Close", true );
+
+	if( m_File == nullptr )
+	{
+		return true;
+	}
+
+	// Go back and fill in the real lengths
+	bool ok = ( fseek( m_File, 0, SEEK_SET ) == 0 ) && WriteHeader( );
+
+	ok &= ( fclose( m_File ) == 0 );
+
+	m_File = nullptr;
+
+	return ok;
+}
+
+bool cWaveFile::Save( const std::string &filename, int sampleRate, int channels, const INT16 *samples, size_t frames )
+{
+	FUNCTION_ENTRY( nullptr, "cWaveFile::Save", true );
+
+	cWaveFile file;
+
+	if( file.Open( filename, sampleRate, channels ) == false )
+	{
+		return false;
+	}
+
+	bool ok = file.Write( samples, frames );
+
+	return file.Close( ) && ok;
+}
@@ -43,6 +43,9 @@
 #include "cf7+.hpp"
 #include "support.hpp"
 #include "option.hpp"
+#include "frame-capture.hpp"
+#include "audio-capture.hpp"
+#include "audio-stats.hpp"
 
 #ifdef __AMIGAOS4__
 #define AMIGA_VERSION_SIGN "ti99sim 0.16.0 compiling for AOS4 smarkusg (29.10.2024)"
@@ -52,70 +55,14 @@ static const char *__attribute__((used)) version_tag = "$VER: " AMIGA_VERSION_SI
 
 DBG_REGISTER( __FILE__ );
 
-static sRGBQUAD ColorTable[ 3 ][ 17 ] =
-{
-	{
-		{ 0x00, 0x00, 0x00, 0xFF },             // 0x00 TI_TRANSPARENT - Background
-		{ 0x00, 0x00, 0x00, 0xFF },             // 0x01 TI_BLACK
-		{ 0x48, 0x9C, 0x08, 0xFF },             // 0x02 TI_MEDIUM_GREEN *
-		{ 0x70, 0xBF, 0x88, 0xFF },             // 0x03 TI_LIGHT_GREEN *
-		{ 0x28, 0x3C, 0x8A, 0xFF },             // 0x04 TI_DARK_BLUE *
-		{ 0x50, 0x6C, 0xCF, 0xFF },             // 0x05 TI_LIGHT_BLUE *
-		{ 0xD0, 0x48, 0x00, 0xFF },             // 0x06 TI_DARK_RED *
-		{ 0x00, 0xCC, 0xFF, 0xFF },             // 0x07 TI_CYAN *
-		{ 0xD0, 0x58, 0x28, 0xFF },             // 0x08 TI_MEDIUM_RED *
-		{ 0xFF, 0xA0, 0x40, 0xFF },             // 0x09 TI_LIGHT_RED *
-		{ 0xFC, 0xF0, 0x50, 0xFF },             // 0x0A TI_DARK_YELLOW *
-		{ 0xFF, 0xFF, 0x80, 0xFF },             // 0x0B TI_LIGHT_YELLOW *
-		{ 0x00, 0x80, 0x00, 0xFF },             // 0x0C TI_DARK_GREEN
-		{ 0xCD, 0x58, 0xCD, 0xFF },             // 0x0D TI_MAGENTA *
-		{ 0xE0, 0xE0, 0xE0, 0xFF },             // 0x0E TI_GRAY *
-		{ 0xFF, 0xFF, 0xFF, 0xFF },             // 0x0F TI_WHITE
-		{ 0xFF, 0xFF, 0xFF, 0xFF }              // 0x10 - Text Mode Foreground
-	}, {
-		{ 0x00, 0x00, 0x00, 0xFF },             // 0x00 TI_TRANSPARENT - Background
-		{ 0x00, 0x00, 0x00, 0xFF },             // 0x01 TI_BLACK
-		{   33,  200,   66, 0xFF },             // 0x02 TI_MEDIUM_GREEN *
-		{   94,  220,  120, 0xFF },             // 0x03 TI_LIGHT_GREEN *
-		{   84,   85,  237, 0xFF },             // 0x04 TI_DARK_BLUE *
-		{  125,  118,  252, 0xFF },             // 0x05 TI_LIGHT_BLUE *
-		{  212,   82,   77, 0xFF },             // 0x06 TI_DARK_RED *
-		{   66,  235,  245, 0xFF },             // 0x07 TI_CYAN *
-		{  252,   85,   84, 0xFF },             // 0x08 TI_MEDIUM_RED *
-		{  255,  121,  120, 0xFF },             // 0x09 TI_LIGHT_RED *
-		{  212,  193,   84, 0xFF },             // 0x0A TI_DARK_YELLOW *
-		{  230,  206,  128, 0xFF },             // 0x0B TI_LIGHT_YELLOW *
-		{   33,  176,   59, 0xFF },             // 0x0C TI_DARK_GREEN
-		{  201,   91,  186, 0xFF },             // 0x0D TI_MAGENTA *
-		{  204,  204,  204, 0xFF },             // 0x0E TI_GRAY *
-		{ 0xFF, 0xFF, 0xFF, 0xFF },             // 0x0F TI_WHITE
-		{ 0xFF, 0xFF, 0xFF, 0xFF }              // 0x10 - Text Mode Foreground
-	}, {
-		{ 0x00, 0x00, 0x00, 0xFF },             // 0x00 TI_TRANSPARENT - Background
-		{ 0x00, 0x00, 0x00, 0xFF },             // 0x01 TI_BLACK
-		{ 0x00, 0xCC, 0x00, 0xFF },             // 0x02 TI_MEDIUM_GREEN
-		{ 0x00, 0xFF, 0x00, 0xFF },             // 0x03 TI_LIGHT_GREEN
-		{ 0x00, 0x00, 0x80, 0xFF },             // 0x04 TI_DARK_BLUE
-		{ 0x00, 0x00, 0xFF, 0xFF },             // 0x05 TI_LIGHT_BLUE
-		{ 0x80, 0x00, 0x00, 0xFF },             // 0x06 TI_DARK_RED
-		{ 0x00, 0xFF, 0xFF, 0xFF },             // 0x07 TI_CYAN
-		{ 0xCC, 0x00, 0x00, 0xFF },             // 0x08 TI_MEDIUM_RED
-		{ 0xFF, 0x00, 0x00, 0xFF },             // 0x09 TI_LIGHT_RED
-		{ 0xB0, 0xB0, 0x00, 0xFF },             // 0x0A TI_DARK_YELLOW
-		{ 0xFF, 0xFF, 0x00, 0xFF },             // 0x0B TI_LIGHT_YELLOW
-		{ 0x00, 0x80, 0x00, 0xFF },             // 0x0C TI_DARK_GREEN
-		{ 0xB0, 0x00, 0xB0, 0xFF },             // 0x0D TI_MAGENTA
-		{ 0xCC, 0xCC, 0xCC, 0xFF },             // 0x0E TI_GRAY
-		{ 0xFF, 0xFF, 0xFF, 0xFF },             // 0x0F TI_WHITE
-		{ 0xFF, 0xFF, 0xFF, 0xFF }              // 0x10 - Text Mode Foreground
-	}
-};
-
 static bool        joystickInitialized  = false;
 static int         joystickIndex[ 2 ]   = { 0, 1 };
 static int         framesOn             = 1;
 static int         framesOff            = 0;
 static std::string consoleFile { };
+static std::string captureFile { };
+static std::string stemFile { };
+static std::string soundLogFile { };
 
 bool ListJoysticks( const char *, void * )
 {
@@ -206,6 +153,48 @@ bool ParseConsole( const char *arg, void * )
 	return true;
 }
 
+bool ParseCapture( const char *arg, void * )
+{
+	FUNCTION_ENTRY( nullptr, "ParseCapture", true );
+
+	arg = strchr( arg, '=' ) + 1;
+
+	CAPTURE_FORMAT_E format;
+	if( cFrameCapture::GetFormat( arg, &format ) == false )
+	{
+		fprintf( stderr, "Capture file '%s' must end in .ppm, .png, or .y4m\n", arg );
+		return false;
+	}
+
+	if( cFrameCapture::IsValidName( arg ) == false )
+	{
+		fprintf( stderr, "Capture file '%s' may only contain a single %%d or %%0Nd frame number\n", arg );
+		return false;
+	}
+
+	captureFile = arg;
+
+	return true;
+}
+
+bool ParseAudioStems( const char *arg, void * )
+{
+	FUNCTION_ENTRY( nullptr, "ParseAudioStems", true );
+
+	stemFile = strchr( arg, '=' ) + 1;
+
+	return true;
+}
+
+bool ParseSoundLog( const char *arg, void * )
+{
+	FUNCTION_ENTRY( nullptr, "ParseSoundLog", true );
+
+	soundLogFile = strchr( arg, '=' ) + 1;
+
+	return true;
+}
+
 bool ParseDisk( const char *arg, void * )
 {
 	FUNCTION_ENTRY( nullptr, "ParseDisk", true );
@@ -315,13 +304,22 @@ int main( int argc, char *argv[] )
 	bool useUCSD        = false;
 	bool useScale2x     = false;
 	int volume          = 50;
+	int captureFrames   = 0;
+	bool speechExact    = false;
+	bool stereo         = false;
+	bool flagAudioStats = false;
 
 	sOption optList[ ] =
 	{
 		{ '4', nullptr,              OPT_VALUE_SET | OPT_SIZE_INT,  2,     &flagScale,       nullptr,         "Double width/height window" },
+		{  0,  "audio-stats",        OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &flagAudioStats,  nullptr,         "Show audio latency, under-run & callback statistics" },
+		{  0,  "audio-stems=*<file>", OPT_NONE,                     0,     nullptr,          ParseAudioStems, "Save each voice (tones, noise & speech) to a multi-channel .wav file" },
+		{  0,  "capture=*<filename>", OPT_NONE,                     0,     nullptr,          ParseCapture,    "Save frames to <filename> (.ppm/.png files or a .y4m stream, - for stdout)" },
+		{  0,  "capture-frames=*n",  OPT_VALUE_PARSE_INT,           0,     &captureFrames,   nullptr,         "Stop capturing after n frames" },
 		{  0,  "cf7=*<filename>",    OPT_NONE,                      0,     nullptr,          ParseCF7,        "Use <filename> for CF7+ disk image" },
 		{  0,  "console=*<filename>", OPT_NONE,                     0,     nullptr,          ParseConsole,    "Use <filename> for system ROM image" },
 		{  0,  "dsk*n=<filename>",   OPT_NONE,                      0,     nullptr,          ParseDisk,       "Use <filename> disk image for DSKn" },
+		{  0,  "fast-disk",          OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &cDiskDevice::HighLevelDSR, nullptr, "Service DSR sector & file loads directly (skips FD1771 emulation)" },
 		{  0,  "framerate=*{n/d|p}", OPT_NONE,                      0,     nullptr,          ParseFrameRate,  "Reduce frame rate to fraction n/d or percentage p" },
 		{ 'f', "fullscreen",         OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &fullScreenMode,  nullptr,         "Fullscreen" },
 		{  0,  "joystick*n=i",       OPT_NONE,                      0,     nullptr,          ParseJoystick,   "Use system joystick i as TI joystick n" },
@@ -337,6 +335,9 @@ int main( int argc, char *argv[] )
 		{ 's', "sample=*<freq>",     OPT_NONE,                      0,     &samplingRate,    ParseSampleRate, "Select sampling frequency for audio playback" },
 		{  0,  "scale=*n",           OPT_VALUE_PARSE_INT,           2,     &flagScale,       nullptr,         "Scale the window width & height by scale" },
 		{  0,  "scale2x",            OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &useScale2x,      nullptr,         "Use the Scale2x algorithm to scale display" },
+		{  0,  "sound-log=*<file>",  OPT_NONE,                      0,     nullptr,          ParseSoundLog,   "Log sound & speech chip accesses to <file> (see sndlog)" },
+		{  0,  "speech-exact",       OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &speechExact,     nullptr,         "Use the chip's integer speech synthesis model" },
+		{  0,  "stereo",             OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &stereo,          nullptr,         "Pan the tones across stereo output" },
 		{  0,  "ucsd",               OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &useUCSD,         nullptr,         "Enable the UCSD p-System device if present" },
 		{ 'v', "verbose*=n",         OPT_VALUE_PARSE_INT,           1,     &verbose,         nullptr,         "Display extra information" },
 		{  0,  "volume=*n",          OPT_VALUE_PARSE_INT,           50,    &volume,          nullptr,         "Set the audio volume" }
@@ -413,7 +414,7 @@ int main( int argc, char *argv[] )
 
 	if( colorTableIndex > 0 )
 	{
-		if( colorTableIndex > 3 )
+		if( colorTableIndex > COLOR_TABLES )
 		{
 			fprintf( stderr, "Invalid palette selected - must be 1 or 2\n" );
 			return -1;
@@ -421,7 +422,7 @@ int main( int argc, char *argv[] )
 		colorTableIndex--;
 	}
 
-	sRGBQUAD *colorTable = ColorTable[ colorTableIndex ];
+	const sRGBQUAD *colorTable = ColorTable[ colorTableIndex ];
 
 	if( flagMonochrome == true )
 	{
@@ -460,23 +461,42 @@ int main( int argc, char *argv[] )
 
 	cRefPtr<cSdlTMS9918A> vdp = new cSdlTMS9918A( colorTable, refreshRate, useScale2x, fullScreenMode, flagScale );
 
+	// Outlives the sound & speech chips below
+	cAudioStats audioStats;
+
 	cRefPtr<iTMS9919> sound = nullptr;
 	cRefPtr<iTMS5220> speech = nullptr;
 
 	if( flagSound )
 	{
 		SDL_InitSubSystem( SDL_INIT_AUDIO );
-		cSdlTMS9919 *sdlSound = new cSdlTMS9919( samplingRate );
+		cSdlTMS9919 *sdlSound = new cSdlTMS9919( samplingRate, stereo );
 		sdlSound->SetMasterVolume( volume );
+		if( !stemFile.empty( ) && ( sdlSound->GetPlaybackFrequency( ) > 0 ))
+		{
+			sdlSound->SetStemCapture( new cAudioCapture( stemFile, sdlSound->GetPlaybackFrequency( ), SOUND_STEMS ));
+		}
+		if( flagAudioStats )
+		{
+			sdlSound->SetAudioStats( &audioStats );
+		}
 		sound = sdlSound;
 		if( flagSpeech )
 		{
-			speech = new cTMS5220;
+			cTMS5220 *tms5220 = new cTMS5220;
+			tms5220->SetFixedPoint( speechExact );
+			tms5220->SetAudioStats( flagAudioStats ? &audioStats : nullptr );
+			speech = tms5220;
 		}
 	}
 
 	vdp->SetFrameRate( framesOn, framesOff );
 
+	if( !captureFile.empty( ))
+	{
+		vdp->SetCapture( new cFrameCapture( captureFile, refreshRate, ( captureFrames > 0 ) ? captureFrames : 0 ));
+	}
+
 	cRefPtr<cSdlTI994A> computer = new cSdlTI994A( consoleROM, vdp, sound, speech );
 
 	if( auto console = computer->GetConsole( ))
@@ -499,6 +519,11 @@ int main( int argc, char *argv[] )
 		return true;
 	});
 
+	if( !soundLogFile.empty( ) && ( computer->StartSoundLog( soundLogFile ) == false ))
+	{
+		fprintf( stderr, "Unable to create sound log \"%s\"\n", soundLogFile.c_str( ));
+	}
+
 	if( joy1 != nullptr )
 	{
 		computer->SetJoystick( 0, joy1 );
@@ -538,6 +563,11 @@ int main( int argc, char *argv[] )
 
 	computer->Run( );
 
+	if( flagAudioStats && flagSound )
+	{
+		fprintf( stdout, "Audio: %s\n", audioStats.Format( ).c_str( ));
+	}
+
 	if( joy1 != nullptr )
 	{
 		SDL_JoystickClose( joy1 );
@@ -34,6 +34,8 @@
 #include "logger.hpp"
 #include "memory.hpp"
 #include "tms9918a-sdl.hpp"
+#include "tms9919.hpp"
+#include "audio-stats.hpp"
 #include "ti994a-sdl.hpp"
 #include "tms9901.hpp"
 #include "support.hpp"
@@ -50,6 +52,7 @@ cSdlTI994A::cSdlTI994A( iCartridge *ctg, iTMS9918A *vdp, iTMS9919 *sound, iTMS52
 	m_StartTime{ 0 },
 	m_StartClock{ 0 },
 	m_VideoUpdateEvent( SDL_RegisterEvents( 1 )),
+	m_StatsTime{ 0 },
 	m_RefreshCount{ 0 },
 	m_pThread{ nullptr },
 	m_SleepSem{ nullptr },
@@ -202,7 +205,7 @@ void cSdlTI994A::Run( )
 						vdp->ResizeWindow( event.window.data1, event.window.data2 );
 						break;
 					case SDL_WINDOWEVENT_EXPOSED :
-						vdp->Render( );
+						vdp->Redraw( );
 						break;
 				}
 				break;
@@ -339,6 +342,7 @@ void cSdlTI994A::Run( )
 				{
 					m_RefreshCount--;
 					vdp->Render( );
+					ShowAudioStats( );
 				}
 				break;
 		}
@@ -349,6 +353,35 @@ done:
 	StopThread( );
 }
 
+void cSdlTI994A::ShowAudioStats( )
+{
+	FUNCTION_ENTRY( this, "cSdlTI994A::ShowAudioStats", false );
+
+	cTMS9919 *sound = dynamic_cast<cTMS9919 *>( m_SoundGenerator.get( ));
+	if(( sound == nullptr ) || ( sound->GetAudioStats( ) == nullptr ))
+	{
+		return;
+	}
+
+	// Once a second is plenty for the title bar
+	UINT32 now = SDL_GetTicks( );
+	if( now - m_StatsTime < 1000 )
+	{
+		return;
+	}
+
+	m_StatsTime = now;
+
+	std::string stats = sound->GetAudioStats( )->Format( );
+
+	dynamic_cast<cSdlTMS9918A *>( m_VDP.get( ))->SetCaption( stats.c_str( ));
+
+	if( verbose >= 2 )
+	{
+		fprintf( stdout, "%s\n", stats.c_str( ));
+	}
+}
+
 bool cSdlTI994A::SaveImage( const char *filename )
 {
 	FUNCTION_ENTRY( this, "cSdlTI994A::SaveImage", true );
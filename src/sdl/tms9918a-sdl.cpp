@@ -33,11 +33,12 @@
 #include "common.hpp"
 #include "logger.hpp"
 #include "bitmap.hpp"
+#include "frame-capture.hpp"
 #include "tms9918a-sdl.hpp"
 
 DBG_REGISTER( __FILE__ );
 
-cSdlTMS9918A::cSdlTMS9918A( sRGBQUAD colorTable[ 17 ], int refreshRate, bool useScale2x, bool fullScreen, int scale ) :
+cSdlTMS9918A::cSdlTMS9918A( const sRGBQUAD colorTable[ 17 ], int refreshRate, bool useScale2x, bool fullScreen, int scale ) :
 	cBaseObject( "cSdlTMS9918A" ),
 	cTMS9918A( refreshRate ),
 	m_TextMode( false ),
@@ -46,6 +47,10 @@ cSdlTMS9918A::cSdlTMS9918A( sRGBQUAD colorTable[ 17 ], int refreshRate, bool use
 	m_ColorsChanged( false ),
 	m_SpritesChanged( false ),
 	m_ScreenChanged( ),
+	m_RowsChanged( 0 ),
+	m_SpriteRows( 0 ),
+	m_TextureRows( 0 ),
+	m_PresentNeeded( false ),
 	m_PatternChanged( ),
 	m_CharUse( ),
 	m_SpriteCharUse( ),
@@ -58,6 +63,10 @@ cSdlTMS9918A::cSdlTMS9918A( sRGBQUAD colorTable[ 17 ], int refreshRate, bool use
 	m_BitmapScreen( nullptr ),
 	m_BitmapSpriteScreen( nullptr ),
 	m_CharacterPattern( ),
+	m_RasterScreen( ),
+	m_RasterFrame( false ),
+	m_Capture( nullptr ),
+	m_CaptureSource( nullptr ),
 	m_Mutex( nullptr ),
 	m_FullScreen( false ),
 	m_OnFrames( 1 ),
@@ -116,6 +125,9 @@ cSdlTMS9918A::~cSdlTMS9918A( )
 
 	SDL_DestroyMutex( m_Mutex );
 
+	// Flush any frames still waiting to be written
+	delete m_Capture;
+
 	delete m_BitmapSpriteScreen;
 	delete m_BitmapScreen;
 	delete m_ScaledScreen;
@@ -133,6 +145,7 @@ bool cSdlTMS9918A::ParseState( const sStateSection &state )
 	{
 		m_ChangesMade    = true;
 		m_SpritesChanged = true;
+		m_RowsChanged    = ALL_ROWS;
 
 		memset( m_ScreenChanged, true, sizeof( m_ScreenChanged ));
 		memset( m_PatternChanged, true, sizeof( m_PatternChanged ));
@@ -178,11 +191,10 @@ void cSdlTMS9918A::Reset( )
 	m_SpriteCharUse[ 0 ] = 32;
 }
 
-void cSdlTMS9918A::WriteData( UINT8 data )
+// Update the dirty flags and usage counts for a VRAM byte about to be written
+void cSdlTMS9918A::MarkMemoryChange( unsigned address, UINT8 data )
 {
-	FUNCTION_ENTRY( this, "cSdlTMS9918A::WriteData", false );
-
-	unsigned address = m_Address & 0x3FFF;
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::MarkMemoryChange", false );
 
 	UINT8 *MemPtr = &m_Memory[ address ];
 
@@ -266,10 +278,29 @@ void cSdlTMS9918A::WriteData( UINT8 data )
 			}
 		}
 	}
+}
+
+void cSdlTMS9918A::WriteData( UINT8 data )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::WriteData", false );
+
+	MarkMemoryChange( m_Address & 0x3FFF, data );
 
 	cTMS9918A::WriteData( data );
 }
 
+void cSdlTMS9918A::WriteMemory( UINT16 address, const UINT8 *data, size_t length )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::WriteMemory", false );
+
+	for( size_t i = 0; i < length; i++ )
+	{
+		MarkMemoryChange(( address + i ) & 0x3FFF, data[ i ] );
+	}
+
+	cTMS9918A::WriteMemory( address, data, length );
+}
+
 void cSdlTMS9918A::WriteRegister( size_t reg, UINT8 value )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9918A::WriteRegister", true );
@@ -361,6 +392,20 @@ bool cSdlTMS9918A::Retrace( )
 
 	cTMS9918A::Retrace( );
 
+	bool updated = RefreshScreen( );
+
+	if( m_Capture != nullptr )
+	{
+		CaptureFrame( );
+	}
+
+	return updated;
+}
+
+bool cSdlTMS9918A::RefreshScreen( )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::RefreshScreen", false );
+
 	// See if we should skip a frame
 	if( m_FrameCycle <= 0 )
 	{
@@ -374,15 +419,22 @@ bool cSdlTMS9918A::Retrace( )
 	{
 		if( m_BlankChanged )
 		{
-			m_BlankChanged = false;
-			m_ScreenSource = nullptr;
+			SDL_LockMutex( m_Mutex );
+
+			m_BlankChanged  = false;
+			m_ScreenSource  = nullptr;
+			m_CaptureSource = nullptr;
+			m_PresentNeeded = true;
+
+			SDL_UnlockMutex( m_Mutex );
+
 			return true;
 		}
 
 		return false;
 	}
 
-	if( !m_ChangesMade && !m_SpritesChanged && !m_BlankChanged )
+	if( !m_ChangesMade && !m_SpritesChanged && !m_BlankChanged && !HasRasterEffects( ))
 	{
 		return false;
 	}
@@ -391,7 +443,11 @@ bool cSdlTMS9918A::Retrace( )
 
 	bool bNeedsUpdate = false;
 
-	if(( m_Mode & VDP_MODE_ILLEGAL ) == VDP_MODE_ILLEGAL )
+	if( HasRasterEffects( ))
+	{
+		bNeedsUpdate = RefreshRaster( );
+	}
+	else if(( m_Mode & VDP_MODE_ILLEGAL ) == VDP_MODE_ILLEGAL )
 	{
 		bNeedsUpdate = RefreshInvalid( );
 	}
@@ -410,14 +466,19 @@ bool cSdlTMS9918A::Retrace( )
 
 	SDL_UnlockMutex( m_Mutex );
 
-	m_ChangesMade   = false;
-	m_ColorsChanged = false;
+	m_ChangesMade   = m_RasterFrame;
+	m_ColorsChanged = m_RasterFrame;
 
 	if( bNeedsUpdate || m_SpritesChanged || m_BlankChanged )
 	{
-		UpdateScreen( );
+		if( m_BlankChanged )
+		{
+			// The texture still holds whatever was on screen before blanking
+			m_RowsChanged  = ALL_ROWS;
+			m_BlankChanged = false;
+		}
 
-		m_BlankChanged = false;
+		UpdateScreen( );
 
 		return true;
 	}
@@ -425,12 +486,34 @@ bool cSdlTMS9918A::Retrace( )
 	return false;
 }
 
+void cSdlTMS9918A::CaptureFrame( )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::CaptureFrame", false );
+
+	// The bitmaps are only modified on this thread, so no need to hold m_Mutex
+	if( m_CaptureSource != nullptr )
+	{
+		m_Capture->AddFrame( m_CaptureSource->Width( ), m_CaptureSource->Height( ), m_CaptureSource->GetData( ));
+	}
+	else
+	{
+		m_Capture->AddFrame( VDP_WIDTH, VDP_HEIGHT, m_ColorTable[ 0 ] );
+	}
+}
+
 void cSdlTMS9918A::Render( )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9918A::Render", false );
 
 	SDL_LockMutex( m_Mutex );
 
+	// Nothing new since the last frame - leave the window alone
+	if(( m_TextureRows == 0 ) && ( m_PresentNeeded == false ))
+	{
+		SDL_UnlockMutex( m_Mutex );
+		return;
+	}
+
 	UINT32 background = m_ColorTable[ 0 ];
 
 	SDL_SetRenderDrawColor( m_sdlRenderer, COLOR_R( background ), COLOR_G( background ), COLOR_B( background ), 255 );
@@ -439,16 +522,94 @@ void cSdlTMS9918A::Render( )
 
 	if( m_ScreenSource != nullptr )
 	{
-		SDL_UpdateTexture( m_sdlTexture, nullptr, m_ScreenSource->GetData( ), m_ScreenSource->Pitch( ));
+		UpdateTexture( m_TextureRows );
+
+		m_TextureRows = 0;
 
 		SDL_RenderCopy( m_sdlRenderer, m_sdlTexture, nullptr, nullptr );
 	}
 
+	m_PresentNeeded = false;
+
 	SDL_RenderPresent( m_sdlRenderer );
 
 	SDL_UnlockMutex( m_Mutex );
 }
 
+void cSdlTMS9918A::Redraw( )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::Redraw", false );
+
+	SDL_LockMutex( m_Mutex );
+
+	m_PresentNeeded = true;
+
+	Render( );
+
+	SDL_UnlockMutex( m_Mutex );
+}
+
+void cSdlTMS9918A::UpdateTexture( UINT32 rows )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::UpdateTexture", false );
+
+	int scale = m_ScreenSource->Height( ) / VDP_HEIGHT;
+
+	// Scale2x/3x look at neighboring pixels, so the rows next to a change may differ too
+	if( scale > 1 )
+	{
+		rows |= ( rows << 1 ) | ( rows >> 1 );
+		rows &= ALL_ROWS;
+	}
+
+	int height = ROW_HEIGHT * scale;
+
+	// Upload each run of consecutive changed rows as a single rectangle
+	for( int row = 0; rows != 0; )
+	{
+		if(( rows & 1 ) == 0 )
+		{
+			rows >>= 1;
+			row++;
+			continue;
+		}
+
+		int count = 0;
+		while( rows & 1 )
+		{
+			rows >>= 1;
+			count++;
+		}
+
+		SDL_Rect rect = { 0, row * height, m_ScreenSource->Width( ), count * height };
+
+		const UINT32 *data = m_ScreenSource->GetData( ) + rect.y * m_ScreenSource->Width( );
+
+		SDL_UpdateTexture( m_sdlTexture, &rect, data, m_ScreenSource->Pitch( ));
+
+		row += count;
+	}
+}
+
+void cSdlTMS9918A::SetCaption( const char *caption )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::SetCaption", false );
+
+	if( m_sdlWindow == nullptr )
+	{
+		return;
+	}
+
+	std::string title = "TI-99/sim";
+	if( caption != nullptr )
+	{
+		title += " - ";
+		title += caption;
+	}
+
+	SDL_SetWindowTitle( m_sdlWindow, title.c_str( ));
+}
+
 //----------------------------------------------------------------------------
 
 void cSdlTMS9918A::CreateMainWindow( int width, int height, int scale )
@@ -511,15 +672,11 @@ void cSdlTMS9918A::ResizeWindow( int width, int height )
 
 	if( m_FullScreen == false )
 	{
-		SDL_LockMutex( m_Mutex );
-
-		Render( );
-
-		SDL_UnlockMutex( m_Mutex );
+		Redraw( );
 	}
 }
 
-void cSdlTMS9918A::SetColorTable( sRGBQUAD colorTable[ 17 ] )
+void cSdlTMS9918A::SetColorTable( const sRGBQUAD colorTable[ 17 ] )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9918A::SelectColorTable", true );
 
@@ -531,6 +688,7 @@ void cSdlTMS9918A::SetColorTable( sRGBQUAD colorTable[ 17 ] )
 
 		m_ChangesMade    = true;
 		m_SpritesChanged = true;
+		m_RowsChanged    = ALL_ROWS;
 		memset( m_ScreenChanged, true, sizeof( m_ScreenChanged ));
 		memset( m_PatternChanged, true, sizeof( m_PatternChanged ));
 
@@ -551,6 +709,15 @@ void cSdlTMS9918A::SetFrameRate( int onFrames, int offFrames )
 	m_OffFrames  = offFrames;
 }
 
+void cSdlTMS9918A::SetCapture( cFrameCapture *capture )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::SetCapture", true );
+
+	delete m_Capture;
+
+	m_Capture = capture;
+}
+
 void cSdlTMS9918A::UpdateCharacterPatternGraphics( int ch, UINT8 fore, UINT8 back, UINT8 *pattern )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9918A::UpdateCharacterPatternGraphics", false );
@@ -606,6 +773,8 @@ void cSdlTMS9918A::UpdateScreenGraphics( int x, int y, int ch )
 	DBG_ASSERT( y < 24 );
 	DBG_ASSERT( ch < 3 * 256 );
 
+	m_RowsChanged |= 1u << y;
+
 	UINT8 *pSrcData = m_CharacterPattern[ ch ];
 	UINT32 *pDstData = m_BitmapScreen->GetData( );
 
@@ -630,6 +799,8 @@ void cSdlTMS9918A::UpdateScreenText( int x, int y, int ch )
 	DBG_ASSERT( y < 24 );
 	DBG_ASSERT( ch < 256 );
 
+	m_RowsChanged |= 1u << y;
+
 	UINT8 *pSrcData = m_CharacterPattern[ ch ];
 	UINT32 *pDstData = m_BitmapScreen->GetData( );
 
@@ -655,6 +826,8 @@ void cSdlTMS9918A::UpdateScreenMultiColor( int x, int y, int ch )
 	DBG_ASSERT( y < 24 );
 	DBG_ASSERT( ch < 256 );
 
+	m_RowsChanged |= 1u << y;
+
 	UINT8 back = ( UINT8 ) ( m_Register[ 7 ] & 0x0F );
 
 	UINT8 *pSrcData = &(( sPatternDescriptor * ) ( m_Memory + m_PatternTableIndex ))->data[ ch ][( y & 0x03 ) * 2 ];
@@ -719,7 +892,7 @@ void cSdlTMS9918A::MarkScreenChanges( int ch )
 	}
 }
 
-void cSdlTMS9918A::DrawSprite( int index )
+UINT32 cSdlTMS9918A::DrawSprite( int index )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9918A::DrawSprite", false );
 
@@ -728,9 +901,11 @@ void cSdlTMS9918A::DrawSprite( int index )
 	UINT8 colorIndex = ( UINT8 ) ( sprite->earlyClock & 0x0F );
 	if( colorIndex == 0 )
 	{
-		return;
+		return 0;
 	}
 
+	UINT32 rows = 0;
+
 	int count = ( m_Register[ 1 ] & VDP_SPRITE_SIZE ) ? 4 : 1;
 	int size  = ( m_Register[ 1 ] & VDP_SPRITE_MAGNIFY ) ? 16 : 8;
 
@@ -758,6 +933,8 @@ void cSdlTMS9918A::DrawSprite( int index )
 			// Make sure the current row and sprite are visible
 			if(( row < VDP_HEIGHT ) && ( index <= m_MaxSprite[ row ] ))
 			{
+				rows |= 1u << ( row / ROW_HEIGHT );
+
 				UINT8 bits   = *pattern;
 				UINT32 *pData = pDstData + row * VDP_WIDTH;
 
@@ -788,6 +965,8 @@ void cSdlTMS9918A::DrawSprite( int index )
 			}
 		}
 	}
+
+	return rows;
 }
 
 bool cSdlTMS9918A::RefreshInvalid( )
@@ -799,6 +978,7 @@ bool cSdlTMS9918A::RefreshInvalid( )
 	if( needsUpdate )
 	{
 		m_ColorsChanged = false;
+		m_RowsChanged   = ALL_ROWS;
 
 		UINT8 fore = ( UINT8 ) ( m_Register[ 7 ] >> 4 );
 		UINT8 back = ( UINT8 ) ( m_Register[ 7 ] & 0x0F );
@@ -897,6 +1077,7 @@ bool cSdlTMS9918A::RefreshGraphics( )
 		}
 
 		m_ColorsChanged = false;
+		m_RowsChanged   = ALL_ROWS;
 	}
 
 	return needsUpdate;
@@ -971,6 +1152,30 @@ bool cSdlTMS9918A::RefreshMultiColor( )
 	return needsUpdate;
 }
 
+bool cSdlTMS9918A::RefreshRaster( )
+{
+	FUNCTION_ENTRY( this, "cSdlTMS9918A::RefreshRaster", false );
+
+	// Registers changed mid-frame - render the whole frame a scanline at a time
+	RenderFrame( &m_RasterScreen[ 0 ][ 0 ] );
+
+	UINT32 *pDst = m_BitmapScreen->GetData( );
+	UINT8 *pSrc = &m_RasterScreen[ 0 ][ 0 ];
+
+	for( int i = 0; i < VDP_WIDTH * VDP_HEIGHT; i++ )
+	{
+		*pDst++ = m_ColorTable[ *pSrc++ ];
+	}
+
+	// The character cache no longer matches the bitmap - repaint everything next frame
+	memset( m_ScreenChanged, true, sizeof( m_ScreenChanged ));
+
+	m_RowsChanged = ALL_ROWS;
+	m_RasterFrame = true;
+
+	return true;
+}
+
 cBitMap *cSdlTMS9918A::UpdateSprites( )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9918A::UpdateSprites", false );
@@ -986,23 +1191,34 @@ cBitMap *cSdlTMS9918A::UpdateSprites( )
 		}
 	}
 
+	UINT32 spriteRows = 0;
+
+	cBitMap *screen = m_BitmapScreen;
+
 	// Don't waste our time if there are no active sprites
-	if( i == 0 )
+	if( i != 0 )
 	{
-		return m_BitmapScreen;
-	}
+		m_BitmapSpriteScreen->Copy( m_BitmapScreen );
 
-	m_BitmapSpriteScreen->Copy( m_BitmapScreen );
+		// Draw sprites in reverse order (ie: lowest numbered sprite is on top)
+		while( --i >= 0 )
+		{
+			spriteRows |= DrawSprite( i );
+		}
 
-	// Draw sprites in reverse order (ie: lowest numbered sprite is on top)
-	while( --i >= 0 )
+		screen = m_BitmapSpriteScreen;
+	}
+
+	// Rows the sprites left and rows they moved into both need to be uploaded
+	if( m_SpritesChanged )
 	{
-		DrawSprite( i );
+		m_RowsChanged |= m_SpriteRows | spriteRows;
 	}
 
+	m_SpriteRows     = spriteRows;
 	m_SpritesChanged = false;
 
-	return m_BitmapSpriteScreen;
+	return screen;
 }
 
 void cSdlTMS9918A::UpdateScreen( )
@@ -1011,7 +1227,20 @@ void cSdlTMS9918A::UpdateScreen( )
 
 	SDL_LockMutex( m_Mutex );
 
-	m_ScreenSource = m_TextMode ? m_BitmapScreen : UpdateSprites( );
+	if( m_TextMode || m_RasterFrame )
+	{
+		// Sprites aren't displayed in text mode, and raster frames already include them
+		m_RowsChanged   |= m_SpriteRows;
+		m_SpriteRows     = 0;
+		m_SpritesChanged = false;
+		m_ScreenSource   = m_BitmapScreen;
+	}
+	else
+	{
+		m_ScreenSource = UpdateSprites( );
+	}
+
+	m_CaptureSource = m_ScreenSource;
 
 	if( m_ScaledScreen )
 	{
@@ -1019,6 +1248,10 @@ void cSdlTMS9918A::UpdateScreen( )
 		m_ScreenSource = m_ScaledScreen;
 	}
 
+	m_TextureRows |= m_RowsChanged;
+	m_RowsChanged  = 0;
+	m_RasterFrame  = false;
+
 	SDL_UnlockMutex( m_Mutex );
 }
 
@@ -35,7 +35,7 @@
 #include "logger.hpp"
 #include <SDL.h>
 #include "tms9919-sdl.hpp"
-#include "tms5220.hpp"
+#include "audio-stats.hpp"
 
 DBG_REGISTER( __FILE__ );
 
@@ -46,37 +46,17 @@ DBG_REGISTER( __FILE__ );
 	const int DEFAULT_SAMPLES = 512;
 #endif
 
-// NOTE: These numbers were taken from the MESS source code
-#define NOISE_RESET              0x00F35
-#define NOISE_WHITE_GENERATOR    0x12000
-#define NOISE_PERIODIC_GENERATOR 0x08000
-
-#define CLOCK_FREQUENCY         3579545
-
-cSdlTMS9919::cSdlTMS9919( int sampleFreq ) :
+cSdlTMS9919::cSdlTMS9919( int sampleFreq, bool stereo ) :
 	cBaseObject( "cSdlTMS9919" ),
-	m_VolumeTable( ),
 	m_Initialized( false ),
 	m_MasterVolume( 0 ),
 	m_AudioSpec( ),
-	m_Info( ),
-	m_ShiftRegister( NOISE_RESET ),
-	m_NoiseGenerator( 0 ),
 	m_MixBuffer( nullptr )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9919 ctor", true );
 
 	SetMasterVolume( 50 );
 
-	// Set loudest volume to max possible level / 4 (so 4 audio channels won't clip)
-	float volume = 32768.0f / 4.0f;
-	for( unsigned int i = 0; i < SIZE( m_VolumeTable ) - 1; i++ )
-	{
-		m_VolumeTable[ i ] = ( int ) volume;
-		volume = ( float ) ( volume / 1.258925412f );    // Reduce volume by 2dB
-	}
-	m_VolumeTable[ 15 ] = 0;
-
 	SDL_AudioSpec wanted;
 	memset( &wanted, 0, sizeof( SDL_AudioSpec ));
 
@@ -92,31 +72,29 @@ cSdlTMS9919::cSdlTMS9919( int sampleFreq ) :
 	// Set the audio format
 	wanted.freq     = sampleFreq;
 	wanted.format   = AUDIO_S16SYS;
-	wanted.channels = 1;
+	wanted.channels = stereo ? 2 : 1;
 	wanted.samples  = samples;
 	wanted.callback = _AudioCallback;
 	wanted.userdata = this;
 
 	// Open the audio device, forcing the desired format
-	if(( SDL_OpenAudio( &wanted, &m_AudioSpec ) < 0 ) || (( m_AudioSpec.format & 0x00FF ) != 16 ))
+	if(( SDL_OpenAudio( &wanted, &m_AudioSpec ) < 0 ) || (( m_AudioSpec.format & 0x00FF ) != 16 ) || ( m_AudioSpec.channels > 2 ))
 	{
 		DBG_ERROR( "Couldn't open audio: " << SDL_GetError( ));
 	}
 	else
 	{
 		DBG_TRACE( "Using " << (( m_AudioSpec.format & 0x8000 ) ? "signed " : "unsigned " ) << ( m_AudioSpec.format & 0x00FF ) << "-bit " << m_AudioSpec.freq << "Hz Audio" );
-		DBG_TRACE( "Buffer size: " << m_AudioSpec.samples );
+		DBG_TRACE( "Buffer size: " << m_AudioSpec.samples << " Channels: " << ( int ) m_AudioSpec.channels );
 		m_Initialized = true;
-		m_MixBuffer   = new INT16 [ m_AudioSpec.samples ];
-		memset( m_MixBuffer, m_AudioSpec.silence, sizeof( INT16 ) * m_AudioSpec.samples );
+		m_MixBuffer   = new INT16 [ m_AudioSpec.samples * m_AudioSpec.channels ];
+		memset( m_MixBuffer, m_AudioSpec.silence, sizeof( INT16 ) * m_AudioSpec.samples * m_AudioSpec.channels );
+		SetOutputChannels( m_AudioSpec.channels );
+		SetSampleRate( m_AudioSpec.freq );
+		// The callback takes a whole device buffer at once, so aim to keep 1.5 buffers queued up
+		SetTargetLatency( m_AudioSpec.samples * 3 / 2 );
 		SDL_PauseAudio( false );
 	}
-
-	uint8_t color = m_NoiseColor;
-	int type     = m_NoiseType;
-	m_NoiseColor = static_cast<uint8_t>( -1 );
-	m_NoiseType  = -1;
-	SetNoise( color, type );
 }
 
 cSdlTMS9919::~cSdlTMS9919( )
@@ -143,73 +121,39 @@ void cSdlTMS9919::AudioCallback( Uint8 *stream, int length )
 {
 	FUNCTION_ENTRY( this, "cSdlTMS9919::AudioCallback", false );
 
-	memset( stream, m_AudioSpec.silence, length );
+	INT64 startTime = ( m_Stats != nullptr ) ? cAudioStats::Now( ) : 0;
 
-	if( m_MasterVolume == 0 )
-	{
-		return;
-	}
+	memset( stream, m_AudioSpec.silence, length );
 
-	memset( m_MixBuffer, m_AudioSpec.silence, length );
+	int samples  = length / sizeof( INT16 );
+	int channels = m_AudioSpec.channels;
 
-	bool mix = false;
+	size_t first = m_Output.GetRead( ) / channels;
 
-	int samples = length / sizeof( INT16 );
+	// Always drain the generated samples so they don't go stale while muted
+	int count = ( int ) m_Output.Read( m_MixBuffer, samples );
 
-	for( int i = 0; i < 4; i++ )
+	// Running behind - pad with the last frame rather than clicking to 0
+	for( int i = count; i < samples; i++ )
 	{
-		sVoiceInfo *info = &m_Info[ i ];
-		if(( m_Attenuation[ i ] != 15 ) && ( info->period >= 1.0f ))
-		{
-			mix = true;
-			int left = samples, j = 0;
-			do
-			{
-				int count = ( info->toggle < left ) ? ( int ) info->toggle : left;
-				left -= count;
-				info->toggle -= count;
-				while( count-- )
-				{
-					m_MixBuffer[ j++ ] += info->setting;
-				}
-				if( info->toggle < 1.0f )
-				{
-					info->toggle += info->period;
-					if( i < 3 )
-					{
-						// Tone
-						info->setting = -info->setting;
-					}
-					else
-					{
-						// Noise
-						if( m_ShiftRegister & 1 )
-						{
-							m_ShiftRegister ^= m_NoiseGenerator;
-							// Protect against 0
-							if( m_ShiftRegister == 0 )
-							{
-								m_ShiftRegister = NOISE_RESET;
-							}
-							info->setting = -info->setting;
-						}
-						m_ShiftRegister >>= 1;
-					}
-				}
-			}
-			while( left > 0 );
-		}
+		m_MixBuffer[ i ] = ( count >= channels ) ? m_MixBuffer[ count - channels + ( i - count ) % channels ] : 0;
 	}
 
-	if( m_pSpeechSynthesizer != nullptr )
+	if( m_MasterVolume != 0 )
 	{
-		mix |= m_pSpeechSynthesizer->AudioCallback( m_MixBuffer, samples );
+		int volume = ( m_MasterVolume * SDL_MIX_MAXVOLUME ) / 100;
+		SDL_MixAudio( stream, (Uint8*) m_MixBuffer, length, volume );
 	}
 
-	if( mix == true )
+	if( m_Stats != nullptr )
 	{
-		int volume = ( m_MasterVolume * SDL_MIX_MAXVOLUME ) / 100;
-		SDL_MixAudio( stream, (Uint8*) m_MixBuffer, length, volume );
+		if( count < samples )
+		{
+			m_Stats->AddUnderrun( );
+		}
+
+		m_Stats->CheckProbe( first, count / channels );
+		m_Stats->AddCallback( cAudioStats::Now( ) - startTime );
 	}
 }
 
@@ -220,79 +164,26 @@ int cSdlTMS9919::GetPlaybackFrequency( )
 	return m_AudioSpec.freq;
 }
 
-void cSdlTMS9919::SetMasterVolume( int volume )
+void cSdlTMS9919::SetAudioStats( cAudioStats *stats )
 {
-	FUNCTION_ENTRY( this, "cSdlTMS9919::SetMasterVolume", true );
+	FUNCTION_ENTRY( this, "cSdlTMS9919::SetAudioStats", true );
 
-	m_MasterVolume = volume;
-}
-
-void cSdlTMS9919::SetNoise( uint8_t color, uint8_t type )
-{
-	FUNCTION_ENTRY( this, "cSdlTMS9919::SetNoise", true );
-
-	// The shift register is reset when the color is changed
-	bool reset = ( color != m_NoiseColor ) ? true : false;
+	// The callback may already be running
+	SDL_LockAudio( );
 
-	cTMS9919::SetNoise( color, type );
+	cTMS9919::SetAudioStats( stats );
 
-	if( m_Initialized == true )
+	if( stats != nullptr )
 	{
-		if( reset )
-		{
-			m_ShiftRegister = NOISE_RESET;
-		}
-		m_NoiseGenerator = ( color == NOISE_WHITE ) ? NOISE_WHITE_GENERATOR : NOISE_PERIODIC_GENERATOR;
-
-		sVoiceInfo *info = &m_Info[ 3 ];
-
-		if( m_Frequency[ 3 ] != 0 )
-		{
-			int volume = m_VolumeTable[ m_Attenuation[ 3 ]];
-			info->period  = ( float ) m_AudioSpec.freq / ( CLOCK_FREQUENCY / ( float ) m_Frequency[ 3 ]) / 2.0f;
-			info->setting = ( info->setting > 0 ) ? volume : -volume;
-		}
-		else
-		{
-			info->period = 0.0;
-		}
+		stats->SetDevice( m_AudioSpec.freq, m_AudioSpec.samples );
 	}
-}
-
-void cSdlTMS9919::SetFrequency( uint8_t tone, uint16_t freq )
-{
-	FUNCTION_ENTRY( this, "cSdlTMS9919::SetFrequency", true );
 
-	cTMS9919::SetFrequency( tone, freq );
-
-	if( m_Initialized == true )
-	{
-		sVoiceInfo *info = &m_Info[ tone ];
-
-		if(( freq < m_AudioSpec.freq / 2 ) && ( freq != 0 ))
-		{
-			int volume = m_VolumeTable[ m_Attenuation[ tone ]];
-			info->period  = ( float ) (( float ) m_AudioSpec.freq / ( CLOCK_FREQUENCY / ( float ) freq ) / 2.0f );
-			info->setting = ( info->setting > 0 ) ? volume : -volume;
-		}
-		else
-		{
-			info->period  = m_AudioSpec.samples;
-			info->setting = 0;
-		}
-	}
+	SDL_UnlockAudio( );
 }
 
-void cSdlTMS9919::SetAttenuation( uint8_t tone, uint8_t atten )
+void cSdlTMS9919::SetMasterVolume( int volume )
 {
-	FUNCTION_ENTRY( this, "cSdlTMS9919::SetAttenuation", true );
-
-	cTMS9919::SetAttenuation( tone, atten );
+	FUNCTION_ENTRY( this, "cSdlTMS9919::SetMasterVolume", true );
 
-	if( m_Initialized == true )
-	{
-		sVoiceInfo *info = &m_Info[ tone ];
-		int volume = m_VolumeTable[ m_Attenuation[ tone ]];
-		info->setting = ( info->setting > 0 ) ? volume : -volume;
-	}
+	m_MasterVolume = volume;
 }
@@ -26,9 +26,11 @@
 //
 //----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cstdio>
 #include <map>
 #include <set>
+#include <thread>
 #include "common.hpp"
 #include "logger.hpp"
 #include "cartridge.hpp"
@@ -98,12 +100,14 @@ int main( int argc, char *argv[] )
 	bool dumpCartridges = false;
 	bool dumpDisks      = false;
 	bool dumpFiles      = false;
+	int threads         = 0;
 
 	sOption optList[ ] =
 	{
 		{ 'c', "cartridges",           OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &dumpCartridges, nullptr,        "List all cartridges" },
 		{ 'd', "disks",                OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &dumpDisks,      nullptr,        "List all disks" },
-		{ 'f', "files",                OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &dumpFiles,      nullptr,        "List all files on disks" }
+		{ 'f', "files",                OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &dumpFiles,      nullptr,        "List all files on disks" },
+		{  0,  "threads=*n",           OPT_VALUE_PARSE_INT,           0,                 &threads,        nullptr,        "Number of threads used to decode HFE/PC99 images (default: all cores)" }
 	};
 
 	if( argc == 1 )
@@ -114,6 +118,9 @@ int main( int argc, char *argv[] )
 
 	int index = ParseArgs( 1, argc, argv, SIZE( optList ), optList );
 
+	// Every file on every disk is read, so decode whole images up front
+	cDiskMedia::SetLoadThreads(( threads > 0 ) ? threads : std::max( 1, ( int ) std::thread::hardware_concurrency( )));
+
 	std::list<std::string> paths;
 
 	while( argv[ index ] != nullptr )
@@ -35,6 +35,7 @@
 #include <cctype>
 #include <cstdio>
 #include <cstring>
+#include <thread>
 #include "common.hpp"
 #include "logger.hpp"
 #include "disk-media.hpp"
@@ -710,6 +711,7 @@ int main( int argc, char *argv[] )
 	bool verboseMode  = false;
 	bool showSha1     = false;
 	bool showLayout   = false;
+	int threads       = 0;
 
 	std::list<std::string> addFiles;
 	std::list<std::string> delFiles;
@@ -739,6 +741,7 @@ int main( int argc, char *argv[] )
 		{  0,  "output=*<format>",     OPT_NONE,                      true,              &outputFormat,   ParseFormat,    "Convert disk to the specified format (PC99,V9T9,AnaDisk,CF7+,HFE)" },
 		{ 'r', "remove=*<filename>",   OPT_NONE,                      true,              &delFiles,       ParseFileNames, "Remove <filename> from the disk image" },
 		{ 's', "sha1",                 OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &showSha1,       nullptr,        "Display the SHA1 checksum for each file" },
+		{  0,  "threads=*n",           OPT_VALUE_PARSE_INT,           0,                 &threads,        nullptr,        "Number of threads used to decode HFE/PC99 images (default: all cores)" },
 		{ 'v', "verbose",              OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &verboseMode,    nullptr,        "Display information about the disk image" }
 	};
 
@@ -768,6 +771,17 @@ int main( int argc, char *argv[] )
 	{
 		index = ParseArgs( index, argc, argv, SIZE( optList ), optList );
 
+		// The whole image is needed for most operations, so decode it up front.  A
+		// conversion streams the tracks to the new file instead unless told otherwise.
+		if( threads > 0 )
+		{
+			cDiskMedia::SetLoadThreads( threads );
+		}
+		else
+		{
+			cDiskMedia::SetLoadThreads(( outputFormat != FORMAT_UNKNOWN ) ? 1 : std::max( 1, ( int ) std::thread::hardware_concurrency( )));
+		}
+
 		if( index < argc )
 		{
 			if( fileSystem != nullptr )
@@ -32,6 +32,7 @@
 #include "common.hpp"
 #include "logger.hpp"
 #include "option.hpp"
+#include "speech-index.hpp"
 
 #ifdef __AMIGAOS4__
 #define AMIGA_VERSION_SIGN "ti99sim 0.16.0 compiling for AOS4 smarkusg (29.10.2024)"
@@ -43,30 +44,6 @@ DBG_REGISTER( __FILE__ );
 
 constexpr int ROM_SIZE      = 0x8000;
 
-struct sNode
-{
-	sNode       *prev;
-	sNode       *next;
-	size_t       phrase_offset;
-	std::string  phrase;
-	size_t       data_offset;
-	size_t       data_length;
-	const UINT8 *data;
-	bool copy;
-
-	sNode( ) :
-		prev( nullptr ),
-		next( nullptr ),
-		phrase_offset( 0 ),
-		phrase( ),
-		data_offset( 0 ),
-		data_length( 0 ),
-		data( nullptr ),
-		copy( false )
-	{
-	}
-};
-
 static int dataFormat;
 
 static const UINT8 *vsmDataPtr;
@@ -74,46 +51,6 @@ static int vsmBytesLeft;
 static int vsmBitsLeft;
 static int vsmData;
 
-static inline UINT16 GetUINT16( const void *_ptr )
-{
-	FUNCTION_ENTRY( nullptr, "GetUINT16", true );
-
-	const UINT8 *ptr = ( const UINT8 * ) _ptr;
-	return ( UINT16 ) (( ptr[ 0 ] << 8 ) | ptr[ 1 ] );
-}
-
-sNode *ReadNode( const UINT8 *rom, int offset )
-{
-	FUNCTION_ENTRY( nullptr, "ReadNode", true );
-
-	sNode *node = new sNode;
-
-	size_t length = rom[ offset ];
-
-	const UINT8 *ptr = &rom[ offset + length + 1 ];
-
-	int prevOffset = GetUINT16( ptr );
-	int nextOffset = GetUINT16( ptr + 2 );
-	int dataOffset = GetUINT16( ptr + 5 );
-
-	node->phrase      = { ( const char * ) rom + offset + 1, length };
-	node->data        = rom + dataOffset;
-	node->data_offset = dataOffset;
-	node->data_length = ptr[ 7 ];
-	node->copy        = false;
-
-	if( prevOffset )
-	{
-		node->prev = ReadNode( rom, prevOffset );
-	}
-	if( nextOffset )
-	{
-		node->next = ReadNode( rom, nextOffset );
-	}
-
-	return node;
-}
-
 int ReadBits( int count, const char *text, FILE *file )
 {
 	FUNCTION_ENTRY( nullptr, "ReadBits", false );
@@ -210,12 +147,12 @@ bool DumpFrame( FILE *file )
 	return true;
 }
 
-size_t DumpSpeechData( FILE *file, sNode *node )
+size_t DumpSpeechData( FILE *file, const UINT8 *rom, const cSpeechIndex::sPhrase &node )
 {
 	FUNCTION_ENTRY( nullptr, "DumpSpeechData", true );
 
-	vsmBytesLeft = node->data_length;
-	vsmDataPtr   = node->data;
+	vsmBytesLeft = node.dataLength;
+	vsmDataPtr   = rom + node.dataOffset;
 	vsmBitsLeft  = 0;
 
 	try
@@ -226,113 +163,100 @@ size_t DumpSpeechData( FILE *file, sNode *node )
 	}
 	catch( const char *msg )
 	{
-		fprintf( stderr, "Phrase: \"%s\" - %s\n", node->phrase.c_str( ), msg );
+		fprintf( stderr, "Phrase: \"%s\" - %s\n", node.phrase.c_str( ), msg );
 	}
 
 	return vsmBytesLeft;
 }
 
-void DumpPhrase( sNode *node, FILE *spchFile )
+void DumpPhrase( const UINT8 *rom, const cSpeechIndex::sPhrase &node, FILE *spchFile )
 {
 	FUNCTION_ENTRY( nullptr, "DumpPhrase", true );
 
-	if( node->prev )
-	{
-		DumpPhrase( node->prev, spchFile );
-	}
-
 	if( dataFormat == 0 )
 	{
-		int space = 20 - ( int ) node->phrase.size( );
-		fprintf( spchFile, "\"%s\"%*.*s -", node->phrase.c_str( ), space, space, "" );
+		int space = 20 - ( int ) node.phrase.size( );
+		fprintf( spchFile, "\"%s\"%*.*s -", node.phrase.c_str( ), space, space, "" );
 
-		for( size_t i = 0; i < node->data_length; i++ )
+		for( size_t i = 0; i < node.dataLength; i++ )
 		{
-			fprintf( spchFile, " %02X", node->data[ i ] );
+			fprintf( spchFile, " %02X", rom[ node.dataOffset + i ] );
 		}
 		fprintf( spchFile, "\n" );
 	}
 	else if( dataFormat == 1 )
 	{
-		fprintf( spchFile, "\"%s\"\n", node->phrase.c_str( ));
+		fprintf( spchFile, "\"%s\"\n", node.phrase.c_str( ));
 
-		DumpSpeechData( spchFile, node );
+		DumpSpeechData( spchFile, rom, node );
 	}
 	else
 	{
 		DBG_ERROR( "Unrecognized data format (" << dataFormat << ")" );
 	}
-
-	if( node->next )
-	{
-		DumpPhrase( node->next, spchFile );
-	}
 }
 
-void DumpROM( sNode *root, FILE *spchFile )
+void DumpROM( const UINT8 *rom, const cSpeechIndex &index, FILE *spchFile )
 {
 	FUNCTION_ENTRY( nullptr, "DumpROM", true );
 
 	fprintf( spchFile, "# TMS5220 Speech ROM data file\n" );
 	fprintf( spchFile, "\n" );
 
-	DumpPhrase( root, spchFile );
+	// The index is sorted, so this matches an in-order walk of the tree
+	for( auto &node : index.GetPhrases( ))
+	{
+		DumpPhrase( rom, node, spchFile );
+	}
 }
 
-size_t CheckData( FILE *file, sNode *node, int *phrases, int *unique, size_t *data_used, UINT8 *flags )
+size_t CheckData( FILE *file, const UINT8 *rom, const cSpeechIndex &index, int *phrases, int *unique, size_t *data_used )
 {
 	FUNCTION_ENTRY( nullptr, "CheckData", true );
 
-	size_t wasted = 0;
-
-	if( node->prev )
-	{
-		wasted += CheckData( file, node->prev, phrases, unique, data_used, flags );
-	}
+	UINT8 flags[ ROM_SIZE ];
+	memset( flags, 0, sizeof( flags ));
 
-	*phrases   += 1;
-	*data_used += 1 + node->phrase.size( ) + 6;
+	size_t wasted = 0;
 
-	if( file != nullptr )
+	for( auto &node : index.GetPhrases( ))
 	{
-		fprintf( file, "Phrase: \"%s\"\n", node->phrase.c_str( ));
-	}
+		*phrases   += 1;
+		*data_used += 1 + node.phrase.size( ) + 6;
 
-	size_t extra = DumpSpeechData( file, node );
+		if( file != nullptr )
+		{
+			fprintf( file, "Phrase: \"%s\"\n", node.phrase.c_str( ));
+		}
 
-	if(( vsmBytesLeft > 0 ) && ( verbose != 0 ))
-	{
-		fprintf( stderr, "%d bytes left processing phrase %s\n", ( int ) vsmBytesLeft, node->phrase.c_str( ));
-	}
+		size_t extra = DumpSpeechData( file, rom, node );
 
-	size_t offset = node->data_offset;
+		if(( vsmBytesLeft > 0 ) && ( verbose != 0 ))
+		{
+			fprintf( stderr, "%d bytes left processing phrase %s\n", ( int ) vsmBytesLeft, node.phrase.c_str( ));
+		}
 
-	if( flags[ offset ] == 0 )
-	{
-		*unique    += 1;
-		*data_used += node->data_length;
-		wasted     += extra;
-		memset( flags + offset, 1, node->data_length );
-	}
+		size_t offset = node.dataOffset;
 
-	if( node->next )
-	{
-		wasted += CheckData( file, node->next, phrases, unique, data_used, flags );
+		if( flags[ offset ] == 0 )
+		{
+			*unique    += 1;
+			*data_used += node.dataLength;
+			wasted     += extra;
+			memset( flags + offset, 1, node.dataLength );
+		}
 	}
 
 	return wasted;
 }
 
-void PrintStats( sNode *root )
+void PrintStats( const UINT8 *rom, const cSpeechIndex &index )
 {
-	UINT8 flags[ ROM_SIZE ];
-	memset( flags, 0, sizeof( flags ));
-
 	int phrases      = 0;
 	int unique       = 0;
 	size_t data_used = 1;
 
-	size_t data_wasted = CheckData(( verbose >= 1 ) ? stdout : nullptr, root, &phrases, &unique, &data_used, flags );
+	size_t data_wasted = CheckData(( verbose >= 1 ) ? stdout : nullptr, rom, index, &phrases, &unique, &data_used );
 
 	if(( data_wasted > 0 ) && ( verbose >= 1 ))
 	{
@@ -345,20 +269,6 @@ void PrintStats( sNode *root )
 	fprintf( stdout, "\n" );
 }
 
-void FreeTree( sNode *node )
-{
-	if( node->prev != nullptr )
-	{
-		FreeTree( node->prev );
-	}
-	if( node->next != nullptr )
-	{
-		FreeTree( node->next );
-	}
-
-	delete node;
-}
-
 bool ParseFileName( const char *arg, void *filename )
 {
 	FUNCTION_ENTRY( nullptr, "ParseFileName", true );
@@ -435,25 +345,27 @@ int main( int argc, char *argv[] )
 
 	fclose( romFile );
 
-	sNode *root = ReadNode( ROM, 1 );
+	cSpeechIndex phraseIndex;
+	if( phraseIndex.Build( ROM, sizeof( ROM )) == false )
+	{
+		fprintf( stderr, "File \"%s\" is not a valid speech ROM\n", argv[ index ] );
+		return -1;
+	}
 
 	FILE *datFile = fopen( outputFile, "wt" );
 	if( datFile == nullptr )
 	{
 		fprintf( stderr, "Unable to open output file \"%s\"\n", outputFile );
-		FreeTree( root );
 		return -1;
 	}
 
-	DumpROM( root, datFile );
+	DumpROM( ROM, phraseIndex, datFile );
 
 	fclose( datFile );
 
 	fprintf( stdout, "\n" );
 
-	PrintStats( root );
-
-	FreeTree( root );
+	PrintStats( ROM, phraseIndex );
 
 	return 0;
 }
@@ -32,6 +32,7 @@
 #include "common.hpp"
 #include "logger.hpp"
 #include "option.hpp"
+#include "speech-index.hpp"
 
 DBG_REGISTER( __FILE__ );
 
@@ -640,12 +641,12 @@ bool DumpFrame( FILE *file )
 	return true;
 }
 
-size_t DumpSpeechData( FILE *file, sNode *node )
+size_t DumpSpeechData( FILE *file, const UINT8 *rom, const cSpeechIndex::sPhrase &node )
 {
 	FUNCTION_ENTRY( nullptr, "DumpSpeechData", true );
 
-	vsmBytesLeft = node->data_length;
-	vsmDataPtr   = const_cast<UINT8 *>( node->data );
+	vsmBytesLeft = node.dataLength;
+	vsmDataPtr   = const_cast<UINT8 *>( rom + node.dataOffset );
 	vsmBitsLeft  = 0;
 
 	try
@@ -656,66 +657,59 @@ size_t DumpSpeechData( FILE *file, sNode *node )
 	}
 	catch( const char *msg )
 	{
-		fprintf( stderr, "Phrase: \"%s\" - %s\n", node->phrase.c_str( ), msg );
+		fprintf( stderr, "Phrase: \"%s\" - %s\n", node.phrase.c_str( ), msg );
 	}
 
 	return vsmBytesLeft;
 }
 
-size_t CheckData( FILE *file, sNode *node, int *phrases, int *unique, size_t *data_used, UINT8 *flags )
+size_t CheckData( FILE *file, const UINT8 *rom, const cSpeechIndex &index, int *phrases, int *unique, size_t *data_used )
 {
 	FUNCTION_ENTRY( nullptr, "CheckData", true );
 
+	UINT8 flags[ ROM_SIZE ];
+	memset( flags, 0, sizeof( flags ));
+
 	size_t wasted = 0;
 
-	if( node->prev )
+	for( auto &node : index.GetPhrases( ))
 	{
-		wasted += CheckData( file, node->prev, phrases, unique, data_used, flags );
-	}
-
-	*phrases   += 1;
-	*data_used += 1 + node->phrase.size( ) + 6;
+		*phrases   += 1;
+		*data_used += 1 + node.phrase.size( ) + 6;
 
-	if( file != nullptr )
-	{
-		fprintf( file, "Phrase: \"%s\"\n", node->phrase.c_str( ));
-	}
+		if( file != nullptr )
+		{
+			fprintf( file, "Phrase: \"%s\"\n", node.phrase.c_str( ));
+		}
 
-	size_t extra = DumpSpeechData( file, node );
+		size_t extra = DumpSpeechData( file, rom, node );
 
-	if(( vsmBytesLeft > 0 ) && ( verbose != 0 ))
-	{
-		fprintf( stderr, "%d bytes left processing phrase %s\n", ( int ) vsmBytesLeft, node->phrase.c_str( ));
-	}
+		if(( vsmBytesLeft > 0 ) && ( verbose != 0 ))
+		{
+			fprintf( stderr, "%d bytes left processing phrase %s\n", ( int ) vsmBytesLeft, node.phrase.c_str( ));
+		}
 
-	size_t offset = node->data_offset;
+		size_t offset = node.dataOffset;
 
-	if( flags[ offset ] == 0 )
-	{
-		*unique    += 1;
-		*data_used += node->data_length;
-		wasted     += extra;
-		memset( flags + offset, 1, node->data_length );
-	}
-
-	if( node->next )
-	{
-		wasted += CheckData( file, node->next, phrases, unique, data_used, flags );
+		if( flags[ offset ] == 0 )
+		{
+			*unique    += 1;
+			*data_used += node.dataLength;
+			wasted     += extra;
+			memset( flags + offset, 1, node.dataLength );
+		}
 	}
 
 	return wasted;
 }
 
-void PrintStats( sNode *root )
+void PrintStats( const UINT8 *rom, const cSpeechIndex &index )
 {
-	UINT8 flags[ ROM_SIZE ];
-	memset( flags, 0, sizeof( flags ));
-
 	int phrases      = 0;
 	int unique       = 0;
 	size_t data_used = 1;
 
-	size_t data_wasted = CheckData(( verbose >= 1 ) ? stdout : nullptr, root, &phrases, &unique, &data_used, flags );
+	size_t data_wasted = CheckData(( verbose >= 1 ) ? stdout : nullptr, rom, index, &phrases, &unique, &data_used );
 
 	if(( data_wasted > 0 ) && ( verbose >= 1 ))
 	{
@@ -836,7 +830,12 @@ int main( int argc, char *argv[] )
 
 	fclose( romFile );
 
-	PrintStats( root );
+	// Gather the statistics from the finished ROM rather than the phrase list
+	cSpeechIndex phraseIndex;
+	if( phraseIndex.Build( ROM, sizeof( ROM )) == true )
+	{
+		PrintStats( ROM, phraseIndex );
+	}
 
 	FreeTree( root );
 
@@ -36,7 +36,13 @@ static const char *__attribute__((used)) version_tag = "$VER: " AMIGA_VERSION_SI
 	#include <windows.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 #include <SDL.h>
 #include "common.hpp"
 #include "logger.hpp"
@@ -44,105 +50,45 @@ static const char *__attribute__((used)) version_tag = "$VER: " AMIGA_VERSION_SI
 #include "tms9919.hpp"
 #include "tms9919-sdl.hpp"
 #include "option.hpp"
+#include "speech-index.hpp"
+#include "support.hpp"
+#include "wave-file.hpp"
 
 DBG_REGISTER( __FILE__ );
 
-struct sNode
-{
-	char string[ 64 ];
-	UINT32 prevAddr;
-	UINT32 nextAddr;
-	UINT32 dataAddr;
-	int dataLength;
-};
-
-bool ReadNode( cTMS5220 *speech, UINT32 address, sNode *node )
-{
-	FUNCTION_ENTRY( nullptr, "ReadNode", true );
-
-	memset( node, 0, sizeof( sNode ));
+static cSpeechIndex phraseIndex;
 
-	speech->WriteData(( UINT8 ) ( 0x40 | (( address >>  0 ) & 0x000F )));   // Load Address
-	speech->WriteData(( UINT8 ) ( 0x40 | (( address >>  4 ) & 0x000F )));   // Load Address
-	speech->WriteData(( UINT8 ) ( 0x40 | (( address >>  8 ) & 0x000F )));   // Load Address
-	speech->WriteData(( UINT8 ) ( 0x40 | (( address >> 12 ) & 0x000F )));   // Load Address
-	speech->WriteData(( UINT8 ) ( 0x40 | (( address >> 16 ) & 0x000F )));   // Load Address
+bool LoadIndex( cTMS5220 *speech, bool useCache )
+{
+	FUNCTION_ENTRY( nullptr, "LoadIndex", true );
 
-	speech->WriteData( 0x10 );   // Read byte
-	int length = speech->ReadData( 0 );
-	for( int i = 0; i < length; i++ )
+	std::string cacheName;
+	if( useCache == true )
 	{
-		speech->WriteData( 0x10 );
-		node->string[ i ] = speech->ReadData( 0 );
+		cacheName = cSpeechIndex::GetCacheName( LocateFile( "console", "spchrom.bin" ).string( ));
 	}
-	node->string[ length ] = '\0';
-
-	speech->WriteData( 0x10 );
-	node->prevAddr = speech->ReadData( 0 ) << 8;
-	speech->WriteData( 0x10 );
-	node->prevAddr |= speech->ReadData( 0 );
-
-	speech->WriteData( 0x10 );
-	node->nextAddr = speech->ReadData( 0 ) << 8;
-	speech->WriteData( 0x10 );
-	node->nextAddr |= speech->ReadData( 0 );
-
-	speech->WriteData( 0x10 );
-	speech->ReadData( 0 );
-
-	speech->WriteData( 0x10 );
-	node->dataAddr = speech->ReadData( 0 ) << 8;
-	speech->WriteData( 0x10 );
-	node->dataAddr |= speech->ReadData( 0 );
-
-	speech->WriteData( 0x10 );
-	node->dataLength = speech->ReadData( 0 );
 
-	return true;
-}
-
-UINT32 LocateString( cTMS5220 *speech, const char *string, size_t length )
-{
-	// Reset the LoadPointer
-	speech->WriteData( 0x40 );   // Load Address
-	speech->WriteData( 0x40 );   // Load Address
-	speech->WriteData( 0x40 );   // Load Address
-	speech->WriteData( 0x40 );   // Load Address
-	speech->WriteData( 0x40 );   // Load Address
-
-	speech->WriteData( 0x10 );   // Read byte
-	if( speech->ReadData( 0 ) != 0xAA )
+	if( phraseIndex.Open( cacheName, speech->GetSpeechROM( ), speech->GetSpeechROMSize( )) == false )
 	{
 		fprintf( stderr, "Speech rom is invalid!\n" );
-		return 0;
+		return false;
 	}
 
-	sNode node;
-	UINT32 addr = 1;
+	return true;
+}
 
-	for( EVER )
-	{
-		ReadNode( speech, addr, &node );
-		int delta = strnicmp( string, node.string, length );
-		if(( strlen( node.string ) == length ) && ( delta == 0 ))
-		{
-			break;
-		}
-		addr = ( delta <= 0 ) ? node.prevAddr : node.nextAddr;
-		if( addr == 0 )
-		{
-			return 0;
-		}
-	}
+UINT32 LocateString( const char *string, size_t length )
+{
+	const cSpeechIndex::sPhrase *node = phraseIndex.Find( string, length );
 
-	return node.dataAddr;
+	return ( node != nullptr ) ? node->dataOffset : 0;
 }
 
-void SayPhrase( cTMS5220 *speech, const char *text, size_t length )
+void SayPhrase( cTMS9919 *sound, cTMS5220 *speech, const char *text, size_t length, std::vector<INT16> *output )
 {
 	FUNCTION_ENTRY( nullptr, "SayPhrase", true );
 
-	UINT32 address = LocateString( speech, text, length );
+	UINT32 address = LocateString( text, length );
 	if( verbose >= 2 )
 	{
 		fprintf( stdout, "Phrase: %*.*s Address: %04X\n", ( int ) length, ( int ) length, text, address );
@@ -158,16 +104,16 @@ void SayPhrase( cTMS5220 *speech, const char *text, size_t length )
 		if( length == 1 )
 		{
 			// Do the 'Uhoh' thing, but make sure we don't get stuck in a recursive loop
-			if( LocateString( speech, "UHOH", 4 ) != 0 )
+			if( LocateString( "UHOH", 4 ) != 0 )
 			{
-				SayPhrase( speech, "UHOH", 4 );
+				SayPhrase( sound, speech, "UHOH", 4, output );
 			}
 		}
 		else
 		{
 			for( size_t i = 0; i < length; i++ )
 			{
-				SayPhrase( speech, text + i, 1 );
+				SayPhrase( sound, speech, text + i, 1, output );
 			}
 		}
 		return;
@@ -183,18 +129,191 @@ void SayPhrase( cTMS5220 *speech, const char *text, size_t length )
 	// Speek
 	speech->WriteData( 0x50 );
 
-	// Wait for the phrase to complete
-	while( speech->ReadData( 0 ) & TMS5220_TS )
+	// There's no CPU to keep time, so generate audio whenever the device (or file) needs more
+	size_t chunk = std::max( sound->GetPlaybackFrequency( ), 0 ) / 100;
+	while(( chunk != 0 ) && ( speech->ReadData( 0 ) & TMS5220_TS ))
 	{
-		SDL_Delay( 200 );
+		if( output != nullptr )
+		{
+			sound->GenerateSamples( chunk );
+			size_t start = output->size( );
+			output->resize( start + sound->GetBufferedSamples( ));
+			output->resize( start + sound->ReadSamples( output->data( ) + start, output->size( ) - start ));
+		}
+		else if( sound->GetBufferedSamples( ) < 2 * chunk )
+		{
+			sound->GenerateSamples( chunk );
+		}
+		else
+		{
+			SDL_Delay( 5 );
+		}
 	}
 }
 
-void Say( cTMS5220 *speech, const char *text )
+void Say( cTMS9919 *sound, cTMS5220 *speech, const char *text, std::vector<INT16> *output = nullptr )
 {
 	FUNCTION_ENTRY( nullptr, "Say", true );
 
-	SayPhrase( speech, text, strlen( text ));
+	SayPhrase( sound, speech, text, strlen( text ), output );
+}
+
+// Different phrases can map to the same name (e.g. "UH OH" & "UH-OH"), so later ones get a numeric suffix
+std::string GetWaveName( const std::string &directory, const std::string &phrase, std::set<std::string> *used )
+{
+	FUNCTION_ENTRY( nullptr, "GetWaveName", true );
+
+	std::string name;
+
+	for( char ch : phrase )
+	{
+		name += isalnum( ch ) ? ( char ) tolower( ch ) : '_';
+	}
+
+	std::string unique = name;
+
+	for( int i = 2; used->insert( unique ).second == false; i++ )
+	{
+		unique = name + "_" + std::to_string( i );
+	}
+
+	return directory + "/" + unique + ".wav";
+}
+
+void RenderPhrases( cTMS9919 *sound, cTMS5220 *speech, const std::vector<std::string> *phrases, const std::vector<std::string> *filenames, std::atomic<size_t> *next, std::atomic<int> *failures )
+{
+	FUNCTION_ENTRY( nullptr, "RenderPhrases", true );
+
+	std::vector<INT16> samples;
+
+	for( size_t i = ( *next )++; i < phrases->size( ); i = ( *next )++ )
+	{
+		const std::string &phrase = ( *phrases )[ i ];
+
+		samples.clear( );
+
+		speech->WriteData( 0x70 );   // Reset
+
+		Say( sound, speech, phrase.c_str( ), &samples );
+
+		const std::string &filename = ( *filenames )[ i ];
+
+		if( cWaveFile::Save( filename, sound->GetPlaybackFrequency( ), 1, samples.data( ), samples.size( )) == false )
+		{
+			fprintf( stderr, "Unable to write '%s'\n", filename.c_str( ));
+			( *failures )++;
+		}
+		else if( verbose >= 1 )
+		{
+			fprintf( stdout, "%s: %zu samples\n", filename.c_str( ), samples.size( ));
+		}
+	}
+}
+
+int SayBatch( const std::vector<std::string> &phrases, const std::string &directory, int samplingRate, bool speechExact, int threads )
+{
+	FUNCTION_ENTRY( nullptr, "SayBatch", true );
+
+	if( threads <= 0 )
+	{
+		threads = std::max( 1, ( int ) std::thread::hardware_concurrency( ));
+	}
+
+	threads = std::min( threads, std::max( 1, ( int ) phrases.size( )));
+
+	// Every thread gets its own (SDL free) sound & speech chips - they're all created
+	// here since the object bookkeeping in debug builds isn't thread safe
+	std::vector<cRefPtr<cTMS9919>> sound;
+	std::vector<cRefPtr<cTMS5220>> speech;
+
+	for( int i = 0; i < threads; i++ )
+	{
+		cTMS9919 *tms9919 = new cTMS9919;
+		tms9919->SetSampleRate( samplingRate );
+
+		cTMS5220 *tms5220 = new cTMS5220;
+		tms5220->SetFixedPoint( speechExact );
+		tms5220->SetSoundChip( tms9919 );
+		tms9919->SetSpeechSynthesizer( tms5220 );
+
+		sound.push_back( tms9919 );
+		speech.push_back( tms5220 );
+	}
+
+	// Pick all the file names up front so the threads never race for the same one
+	std::set<std::string> used;
+	std::vector<std::string> filenames;
+
+	for( auto &phrase : phrases )
+	{
+		filenames.push_back( GetWaveName( directory, phrase, &used ));
+	}
+
+	std::atomic<size_t> next( 0 );
+	std::atomic<int> failures( 0 );
+
+	std::vector<std::thread> workers;
+
+	for( int i = 0; i < threads; i++ )
+	{
+		workers.emplace_back( RenderPhrases, sound[ i ].get( ), speech[ i ].get( ), &phrases, &filenames, &next, &failures );
+	}
+
+	for( auto &worker : workers )
+	{
+		worker.join( );
+	}
+
+	// Break the circular references between the chips
+	for( int i = 0; i < threads; i++ )
+	{
+		sound[ i ]->SetSpeechSynthesizer( nullptr );
+		speech[ i ]->SetSoundChip( nullptr );
+	}
+
+	return ( failures == 0 ) ? 0 : 1;
+}
+
+bool ParseFileName( const char *arg, void *ptr )
+{
+	FUNCTION_ENTRY( nullptr, "ParseFileName", true );
+
+	arg = strchr( arg, '=' ) + 1;
+
+	*( std::string * ) ptr = arg;
+
+	return true;
+}
+
+bool ReadPhraseList( const std::string &filename, std::vector<std::string> *phrases )
+{
+	FUNCTION_ENTRY( nullptr, "ReadPhraseList", true );
+
+	FILE *file = ( filename == "-" ) ? stdin : fopen( filename.c_str( ), "rt" );
+	if( file == nullptr )
+	{
+		fprintf( stderr, "Unable to open phrase list '%s'\n", filename.c_str( ));
+		return false;
+	}
+
+	char buffer[ 256 ];
+	while( fgets( buffer, sizeof( buffer ), file ) != nullptr )
+	{
+		std::string phrase( buffer );
+		phrase.erase( phrase.find_last_not_of( " \t\r\n" ) + 1 );
+		phrase.erase( 0, phrase.find_first_not_of( " \t" ));
+		if( phrase.empty( ) == false )
+		{
+			phrases->push_back( phrase );
+		}
+	}
+
+	if( file != stdin )
+	{
+		fclose( file );
+	}
+
+	return true;
 }
 
 bool ParseSampleRate( const char *arg, void *ptr )
@@ -227,6 +346,7 @@ void PrintUsage( )
 	FUNCTION_ENTRY( nullptr, "PrintUsage", true );
 
 	fprintf( stdout, "Usage: say [options] <Text-to-speak>\n" );
+	fprintf( stdout, "       say [options] --all | --batch=<file> [<Text-to-save>]\n" );
 	fprintf( stdout, "\n" );
 }
 
@@ -236,10 +356,22 @@ int main( int argc, char *argv[] )
 
 	int samplingRate   = 44100;
 	int volume         = 50;
+	bool speechExact   = false;
+	bool allPhrases    = false;
+	bool indexCache    = false;
+	int threads        = 0;
+	std::string batchFile;
+	std::string outputDir  = ".";
 
 	sOption optList[ ] =
 	{
+		{  0,  "all",                OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &allPhrases,     nullptr,         "Save every phrase in the speech ROM to a .wav file" },
+		{  0,  "batch=*<file>",      OPT_NONE,                      0,     &batchFile,      ParseFileName,   "Save each phrase listed in <file> (- for stdin) to a .wav file" },
+		{  0,  "index-cache",        OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &indexCache,     nullptr,         "Keep a phrase index file next to the speech ROM" },
+		{  0,  "output=*<dir>",      OPT_NONE,                      0,     &outputDir,      ParseFileName,   "Write .wav files to <dir>" },
 		{ 's', "sample=*<freq>",     OPT_NONE,                      0,     &samplingRate,   ParseSampleRate, "Select sampling frequency for audio playback" },
+		{  0,  "speech-exact",       OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &speechExact,    nullptr,         "Use the chip's integer speech synthesis model" },
+		{  0,  "threads=*n",         OPT_VALUE_PARSE_INT,           0,     &threads,        nullptr,         "Number of threads used to save .wav files" },
 		{ 'v', "verbose*=n",         OPT_VALUE_PARSE_INT,           1,     &verbose,        nullptr,         "Display extra information" },
 		{  0,  "volume=*n",          OPT_VALUE_PARSE_INT,           50,    &volume,         nullptr,         "Set the audio volume" }
 	};
@@ -252,6 +384,40 @@ int main( int argc, char *argv[] )
 
 	int index = ParseArgs( 1, argc, argv, SIZE( optList ), optList );
 
+	// Every chip loads the same ROM, so one index serves them all
+	{
+		cRefPtr<cTMS5220> speech = new cTMS5220;
+		if( LoadIndex( speech, indexCache ) == false )
+		{
+			return -1;
+		}
+	}
+
+	if(( allPhrases == true ) || ( batchFile.empty( ) == false ))
+	{
+		std::vector<std::string> phrases;
+
+		if( allPhrases == true )
+		{
+			for( auto &node : phraseIndex.GetPhrases( ))
+			{
+				phrases.push_back( node.phrase );
+			}
+		}
+
+		if(( batchFile.empty( ) == false ) && ( ReadPhraseList( batchFile, &phrases ) == false ))
+		{
+			return -1;
+		}
+
+		for( int i = index; i < argc; i++ )
+		{
+			phrases.push_back( argv[ i ] );
+		}
+
+		return SayBatch( phrases, outputDir, samplingRate, speechExact, threads );
+	}
+
 	if( SDL_Init( SDL_INIT_NOPARACHUTE ) < 0 )
 	{
 		fprintf( stderr, "Couldn't initialize SDL: %s\n", SDL_GetError( ));
@@ -265,6 +431,7 @@ int main( int argc, char *argv[] )
 	sound->SetMasterVolume( volume );
 
 	cRefPtr<cTMS5220> speech = new cTMS5220;
+	speech->SetFixedPoint( speechExact );
 
 	speech->SetSoundChip( sound );
 	sound->SetSpeechSynthesizer( speech );
@@ -273,7 +440,13 @@ int main( int argc, char *argv[] )
 
 	for( int i = index; i < argc; i++ )
 	{
-		Say( speech, argv[ i ] );
+		Say( sound, speech, argv[ i ] );
+	}
+
+	// Let the audio device play whatever is left
+	while( sound->GetBufferedSamples( ) > 0 )
+	{
+		SDL_Delay( 10 );
 	}
 
 	return 0;
@@ -0,0 +1,262 @@
+//----------------------------------------------------------------------------
+//
+// File:        sndlog.cpp
+// Date:        18-Oct-2026
+//
+// Description: Render a sound log to a .wav file without running the CPU
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifdef __AMIGAOS4__
+#define AMIGA_VERSION_SIGN "ti99sim 0.16.0 compiling for AOS4 smarkusg (29.10.2024)"
+static const char *__attribute__((used)) stackcookie = "$STACK: 500000";
+static const char *__attribute__((used)) version_tag = "$VER: " AMIGA_VERSION_SIGN ;
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "logger.hpp"
+#include "tms5220.hpp"
+#include "tms9919.hpp"
+#include "option.hpp"
+#include "audio-capture.hpp"
+#include "sound-log.hpp"
+#include "wave-file.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+// How far the sound chip is advanced at a time (cTMS9919 ignores gaps over 1/4 second)
+#define UPDATE_RATE         100
+
+struct sRenderer
+{
+	cTMS9919               *sound;
+	cWaveFile              *wave;
+	UINT64                  clock;
+	UINT64                  step;
+	std::vector<INT16>      buffer;
+};
+
+void RunUntil( sRenderer *renderer, UINT64 target )
+{
+	FUNCTION_ENTRY( nullptr, "RunUntil", false );
+
+	while( renderer->clock < target )
+	{
+		renderer->clock = std::min( target, renderer->clock + renderer->step );
+		renderer->sound->Update(( UINT32 ) renderer->clock );
+
+		// The mono mix always has to be drained, even if only the stems are being saved
+		renderer->buffer.resize( renderer->sound->GetBufferedSamples( ));
+		size_t count = renderer->sound->ReadSamples( renderer->buffer.data( ), renderer->buffer.size( ));
+
+		if( renderer->wave != nullptr )
+		{
+			renderer->wave->Write( renderer->buffer.data( ), count );
+		}
+	}
+}
+
+bool ParseFileName( const char *arg, void *ptr )
+{
+	FUNCTION_ENTRY( nullptr, "ParseFileName", true );
+
+	arg = strchr( arg, '=' ) + 1;
+
+	*( std::string * ) ptr = arg;
+
+	return true;
+}
+
+bool ParseSampleRate( const char *arg, void *ptr )
+{
+	FUNCTION_ENTRY( nullptr, "ParseSampleRate", true );
+
+	int freq = 0;
+
+	arg = strchr( arg, '=' ) + 1;
+
+	if( sscanf( arg, "%d", &freq ) != 1 )
+	{
+		fprintf( stderr, "Invalid sampling rate '%s'\n", arg );
+		return false;
+	}
+
+	if(( freq > 48000 ) || ( freq < 8000 ))
+	{
+		fprintf( stderr, "Sampling rate must be between 8000 and 48000\n" );
+		return false;
+	}
+
+	*( int * ) ptr = freq;
+
+	return true;
+}
+
+void PrintUsage( )
+{
+	FUNCTION_ENTRY( nullptr, "PrintUsage", true );
+
+	fprintf( stdout, "Usage: sndlog [options] file\n" );
+	fprintf( stdout, "\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+	FUNCTION_ENTRY( nullptr, "main", true );
+
+	int samplingRate   = 44100;
+	bool speechExact   = false;
+	bool flagSpeech    = true;
+	bool saveStems     = false;
+	int tail           = 1;
+	std::string outputFile;
+
+	sOption optList[ ] =
+	{
+		{  0,  "no-speech",          OPT_VALUE_SET | OPT_SIZE_BOOL, false, &flagSpeech,     nullptr,         "Ignore speech synthesizer accesses" },
+		{ 'o', "output=*<filename>", OPT_NONE,                      0,     &outputFile,     ParseFileName,   "Create output file <filename>" },
+		{ 's', "sample=*<freq>",     OPT_NONE,                      0,     &samplingRate,   ParseSampleRate, "Select sampling frequency" },
+		{  0,  "speech-exact",       OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &speechExact,    nullptr,         "Use the chip's integer speech synthesis model" },
+		{  0,  "stems",              OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &saveStems,      nullptr,         "Save each voice (tones, noise & speech) to its own channel" },
+		{  0,  "tail=*n",            OPT_VALUE_PARSE_INT,           0,     &tail,           nullptr,         "Keep rendering for n seconds after the last event" },
+		{ 'v', "verbose*=n",         OPT_VALUE_PARSE_INT,           1,     &verbose,        nullptr,         "Display extra information" }
+	};
+
+	if( argc == 1 )
+	{
+		PrintHelp( SIZE( optList ), optList );
+		return 0;
+	}
+
+	int index = ParseArgs( 1, argc, argv, SIZE( optList ), optList );
+
+	if( index >= argc )
+	{
+		fprintf( stderr, "No input file specified\n" );
+		return -1;
+	}
+
+	cSoundLog log;
+	if( log.Open( argv[ index ] ) == false )
+	{
+		fprintf( stderr, "Unable to read sound log \"%s\"\n", argv[ index ] );
+		return -1;
+	}
+
+	if( outputFile.empty( ))
+	{
+		outputFile = argv[ index ];
+		size_t dot = outputFile.rfind( '.' );
+		if(( dot != std::string::npos ) && ( outputFile.find_first_of( "/\\", dot ) == std::string::npos ))
+		{
+			outputFile.erase( dot );
+		}
+		outputFile += ".wav";
+	}
+
+	cRefPtr<cTMS9919> sound = new cTMS9919;
+	sound->SetSampleRate( samplingRate );
+	sound->SetCPU( nullptr, log.GetClockSpeed( ));
+
+	cRefPtr<cTMS5220> speech = flagSpeech ? new cTMS5220 : nullptr;
+	if( speech != nullptr )
+	{
+		speech->SetFixedPoint( speechExact );
+		speech->SetSoundChip( sound );
+		speech->SetCPU( nullptr, log.GetClockSpeed( ));
+		sound->SetSpeechSynthesizer( speech );
+	}
+
+	cWaveFile wave;
+
+	if( saveStems == true )
+	{
+		sound->SetStemCapture( new cAudioCapture( outputFile, samplingRate, SOUND_STEMS ));
+	}
+	else if( wave.Open( outputFile, samplingRate ) == false )
+	{
+		fprintf( stderr, "Unable to create output file \"%s\"\n", outputFile.c_str( ));
+		return -1;
+	}
+
+	auto start = std::chrono::steady_clock::now( );
+
+	sRenderer renderer = { sound, saveStems ? nullptr : &wave, 0, std::max<UINT64>( 1, log.GetClockSpeed( ) / UPDATE_RATE ), { } };
+
+	// Without a CPU, the chips see each access at the point the sound chip has been brought up to
+	cSoundLog::sEvent event;
+	while( log.Read( &event ))
+	{
+		RunUntil( &renderer, event.clock );
+
+		switch( event.type )
+		{
+			case LOG_TMS9919_WRITE :
+				sound->WriteData( event.data );
+				break;
+			case LOG_TMS5220_WRITE :
+				if( speech != nullptr )
+				{
+					speech->WriteData( event.data );
+				}
+				break;
+			case LOG_TMS5220_READ :
+				if( speech != nullptr )
+				{
+					speech->ReadData( 0 );
+				}
+				break;
+			case LOG_TMS5220_RESET :
+				if( speech != nullptr )
+				{
+					speech->Reset( );
+				}
+				break;
+			default :
+				break;
+		}
+	}
+
+	RunUntil( &renderer, renderer.clock + ( UINT64 ) std::max( 0, tail ) * log.GetClockSpeed( ));
+
+	double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+
+	// Break the circular reference between the chips (this also finishes writing any stems)
+	sound->SetSpeechSynthesizer( nullptr );
+	sound->SetStemCapture( nullptr );
+
+	if( wave.Close( ) == false )
+	{
+		fprintf( stderr, "Error writing output file \"%s\"\n", outputFile.c_str( ));
+		return -1;
+	}
+
+	if( verbose >= 1 )
+	{
+		double seconds = ( double ) renderer.clock / std::max<UINT32>( 1, log.GetClockSpeed( ));
+		fprintf( stdout, "%zu events, %.1f seconds of audio rendered in %.2f seconds (%.0fx real time)\n", log.GetEvents( ), seconds, elapsed, seconds / std::max( elapsed, 1e-6 ));
+	}
+
+	return 0;
+}
@@ -0,0 +1,278 @@
+//----------------------------------------------------------------------------
+//
+// File:        test-fdc.cpp
+// Date:        18-Oct-2026
+//
+// Description: Check the rotational timing of the emulated FD1771 controller
+//              (seek, index pulse, sector reads & Record Not Found)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include "common.hpp"
+#include "logger.hpp"
+#include "cartridge.hpp"
+#include "tms9900.hpp"
+#include "ti994a.hpp"
+#include "ti-disk.hpp"
+#include "option.hpp"
+#include "test.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+constexpr UINT32 CLOCKS_PER_MS   = CPU_SPEED_HZ / 1000;
+constexpr UINT32 CLOCKS_PER_REV  = MS_PER_REV * CLOCKS_PER_MS;
+
+constexpr int    ACCESS_CLOCKS   = 24;					// Cost of a MOVB to/from a controller register
+constexpr int    POLL_CLOCKS     = 100;					// Delay between status polls
+
+// Everything is measured by polling, so allow for a couple of polls of slop
+constexpr UINT32 TOLERANCE       = 2 * ( ACCESS_CLOCKS + POLL_CLOCKS );
+
+constexpr UINT8  CMD_RESTORE     = 0x00;
+constexpr UINT8  CMD_SEEK_20MS   = 0x13;				// Seek at the slowest (20ms) step rate, no verify
+constexpr UINT8  CMD_READ_SECTOR = 0x88;
+constexpr UINT8  CMD_FORCE_INT   = 0xD0;
+
+constexpr UINT8  MISSING_SECTOR  = 0xF0;				// Sector ID that isn't on any TI disk
+
+//----------------------------------------------------------------------------
+// cFDCTest
+//
+//   Drives the controller registers of a cDiskDevice directly from a bare
+//   CPU that only supplies the clock - there is no console or disk DSR
+//   involved.
+//----------------------------------------------------------------------------
+
+class cFDCTest
+{
+	cRefPtr<cTMS9900>       m_CPU;
+	cRefPtr<cDiskDevice>    m_Device;
+
+public:
+
+	cFDCTest( iCartridge *rom ) :
+		m_CPU( new cTMS9900 ),
+		m_Device( new cDiskDevice( rom ))
+	{
+		m_Device->AttachCPU( m_CPU );
+	}
+
+	void LoadDisk( int drive, const char *filename )	{ m_Device->LoadDisk( drive, filename ); }
+	void WriteCRU( ADDRESS address, int value )			{ m_Device->WriteCRU( address, value ); }
+
+	UINT32 GetClocks( )					{ return m_CPU->GetClocks( ); }
+	void Wait( int clocks )				{ m_CPU->AddClocks( clocks ); }
+
+	// The data bus to the controller is inverted
+	void Write( ADDRESS address, UINT8 value )
+	{
+		Wait( ACCESS_CLOCKS );
+		m_Device->WriteRegister( address, value ^ 0xFF );
+	}
+
+	UINT8 Read( ADDRESS address )
+	{
+		Wait( ACCESS_CLOCKS );
+		return m_Device->ReadRegister( address ) ^ 0xFF;
+	}
+
+	// Poll the status register until the command finishes - returns the final status
+	UINT8 WaitWhileBusy( )
+	{
+		UINT8 status;
+		while(( status = Read( REG_STATUS )) & STATUS_BUSY )
+		{
+			Wait( POLL_CLOCKS );
+		}
+		return status;
+	}
+
+private:
+
+	// Disable the copy constructor and assignment operator defaults
+	cFDCTest( const cFDCTest & ) = delete;		// no implementation
+	void operator =( const cFDCTest & ) = delete;	// no implementation
+
+};
+
+static UINT8 ReadSector( cFDCTest *fdc, int track, int sector, UINT32 *clocks )
+{
+	FUNCTION_ENTRY( nullptr, "ReadSector", true );
+
+	fdc->Write( REG_WR_TRACK, track );
+	fdc->Write( REG_WR_SECTOR, sector );
+
+	UINT32 start = fdc->GetClocks( );
+
+	fdc->Write( REG_COMMAND, CMD_READ_SECTOR );
+	for( int i = 0; i < DEFAULT_SECTOR_SIZE; i++ )
+	{
+		fdc->Read( REG_RD_DATA );
+	}
+
+	UINT8 status = fdc->WaitWhileBusy( );
+
+	*clocks = fdc->GetClocks( ) - start;
+
+	return status;
+}
+
+static int CheckDisk( const char *filename, int sectors )
+{
+	FUNCTION_ENTRY( nullptr, "CheckDisk", true );
+
+	cRefPtr<cCartridge> rom = new cCartridge( "none" );
+	cFDCTest check( rom );
+	cFDCTest *fdc = &check;
+
+	fdc->LoadDisk( 0, filename );
+
+	fdc->WriteCRU( 4, 1 );			// Select DSK1
+	fdc->WriteCRU( 6, 0 );			// Side 0
+	fdc->WriteCRU( 2, 1 );			// Enable wait states
+
+	fdc->Write( REG_COMMAND, CMD_RESTORE );
+	UINT8 status = fdc->WaitWhileBusy( );
+
+	if(( status & STATUS_NOT_READY ) || !( status & STATUS_TRACK_0 ))
+	{
+		fprintf( stdout, "  drive not ready (status %02X)  FAIL\n", status );
+		return 1;
+	}
+
+	int failures = 0;
+
+	// Type I - a single step at 20ms/step
+	fdc->Write( REG_WR_DATA, 1 );
+	UINT32 start = fdc->GetClocks( );
+	fdc->Write( REG_COMMAND, CMD_SEEK_20MS );
+	fdc->WaitWhileBusy( );
+	if( CheckRange( "seek 1 track", fdc->GetClocks( ) - start, 20 * CLOCKS_PER_MS, 20 * CLOCKS_PER_MS + TOLERANCE ) == false )
+	{
+		failures++;
+	}
+
+	// Type II - every sector on the track has to turn up within a revolution
+	UINT32 worst = 0;
+	for( int sector = 0; sector < sectors; sector++ )
+	{
+		UINT32 clocks;
+		status = ReadSector( fdc, 1, sector, &clocks );
+		if( status & ( STATUS_RECORD_NOT_FOUND | STATUS_NOT_FOUND ))
+		{
+			fprintf( stdout, "  sector %d: status %02X  FAIL\n", sector, status );
+			failures++;
+		}
+		worst = std::max( worst, clocks );
+	}
+	if( CheckRange( "slowest sector read", worst, 0, CLOCKS_PER_REV + TOLERANCE ) == false )
+	{
+		failures++;
+	}
+
+	// Record Not Found is reported once the ID search has run for RNF_REVOLUTIONS index pulses
+	UINT32 clocks;
+	status = ReadSector( fdc, 1, MISSING_SECTOR, &clocks );
+	if(( status & STATUS_NOT_FOUND ) != STATUS_NOT_FOUND )
+	{
+		fprintf( stdout, "  missing sector: status %02X  FAIL\n", status );
+		failures++;
+	}
+	if( CheckRange( "record not found", clocks, ( RNF_REVOLUTIONS - 1 ) * CLOCKS_PER_REV, RNF_REVOLUTIONS * CLOCKS_PER_REV + TOLERANCE ) == false )
+	{
+		failures++;
+	}
+
+	// A Force Interrupt switches the status register back to Type I so the index pulse can be watched
+	fdc->Write( REG_COMMAND, CMD_FORCE_INT );
+
+	const int revolutions = 4;
+
+	// Only count pulses that start while we're watching
+	int pulses = 0;
+	bool last = ( fdc->Read( REG_STATUS ) & STATUS_INDEX_PULSE ) ? true : false;
+	UINT32 firstEdge = 0;
+	UINT32 lastEdge = 0;
+	UINT32 width = 0;
+
+	start = fdc->GetClocks( );
+	while( fdc->GetClocks( ) - start < ( revolutions + 1 ) * CLOCKS_PER_REV )
+	{
+		UINT32 now = fdc->GetClocks( );
+		bool index = ( fdc->Read( REG_STATUS ) & STATUS_INDEX_PULSE ) ? true : false;
+		if( index && !last )
+		{
+			if( pulses++ == 0 )
+			{
+				firstEdge = now;
+			}
+			lastEdge = now;
+		}
+		if( index )
+		{
+			width += fdc->GetClocks( ) - now + POLL_CLOCKS;
+		}
+		last = index;
+		fdc->Wait( POLL_CLOCKS );
+	}
+
+	if( pulses < revolutions )
+	{
+		fprintf( stdout, "  index pulse: %d pulses in %d revolutions  FAIL\n", pulses, revolutions + 1 );
+		failures++;
+	}
+	else
+	{
+		UINT32 period = ( lastEdge - firstEdge ) / ( pulses - 1 );
+		if( CheckRange( "index period", period, CLOCKS_PER_REV - TOLERANCE, CLOCKS_PER_REV + TOLERANCE ) == false )
+		{
+			failures++;
+		}
+		UINT32 pulseWidth = CLOCKS_PER_REV * INDEX_PULSE_DEGREES / 360;
+		if( CheckRange( "index pulse width", width / pulses, pulseWidth - TOLERANCE, pulseWidth + TOLERANCE ) == false )
+		{
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+int TestFDC( const sTestOptions & )
+{
+	FUNCTION_ENTRY( nullptr, "TestFDC", true );
+
+	const int sectors = 9;
+
+	auto disk = TempFile( "fdc.dsk" );
+
+	if( CreateDisk( disk, 40, 1, sectors ) == false )
+	{
+		return 1;
+	}
+
+	int failures = CheckDisk( disk.string( ).c_str( ), sectors );
+
+	std::error_code error;
+	std::filesystem::remove( disk, error );
+
+	return failures;
+}
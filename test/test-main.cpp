@@ -0,0 +1,206 @@
+//----------------------------------------------------------------------------
+//
+// File:        test-main.cpp
+// Date:        18-Oct-2026
+//
+// Description: Run the emulator's self checks (make check)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "file-system.hpp"
+#include "isector.hpp"
+#include "option.hpp"
+#include "test.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+struct sTest
+{
+	const char     *name;
+	int           (*run)( const sTestOptions & );
+	const char     *description;
+};
+
+static const sTest tests[ ] =
+{
+	{ "sprite",  TestSprites,   "Sprite coincidence & fifth sprite status" },
+	{ "speech",  TestSpeech,    "Speech re-sampling filter" },
+	{ "track",   TestTracks,    "FM/MFM track encoding & decoding (HFE)" },
+	{ "fdc",     TestFDC,       "FD1771 seek, index & Record Not Found timing" },
+	{ "state",   TestState,     "VDP interrupt timing across a saved state" }
+};
+
+bool CheckRange( const char *name, UINT32 measured, UINT32 low, UINT32 high )
+{
+	FUNCTION_ENTRY( nullptr, "CheckRange", true );
+
+	bool ok = ( measured >= low ) && ( measured <= high );
+
+	fprintf( stdout, "  %-22s %8u  (expected %u-%u)  %s\n", name, measured, low, high, ok ? "OK" : "FAIL" );
+
+	return ok;
+}
+
+std::filesystem::path TempFile( const char *name )
+{
+	FUNCTION_ENTRY( nullptr, "TempFile", true );
+
+	std::error_code error;
+
+	auto dir = std::filesystem::temp_directory_path( error );
+	if( error )
+	{
+		dir = ".";
+	}
+
+	return dir / ( "test-ti99sim-" + std::to_string( getpid( )) + "-" + name );
+}
+
+bool CreateDisk( const std::filesystem::path &path, int tracks, int sides, int sectors, std::mt19937 *random )
+{
+	FUNCTION_ENTRY( nullptr, "CreateDisk", true );
+
+	int totalSectors = tracks * sides * sectors;
+
+	std::vector<UINT8> data( totalSectors * DEFAULT_SECTOR_SIZE, 0 );
+
+	if( random != nullptr )
+	{
+		for( auto &byte : data )
+		{
+			byte = static_cast<UINT8>(( *random )( ));
+		}
+	}
+
+	std::fill_n( data.begin( ), sizeof( VIB ), 0 );
+
+	VIB *vib = reinterpret_cast<VIB *>( data.data( ));
+
+	memcpy( vib->VolumeName, "TEST      ", sizeof( vib->VolumeName ));
+
+	UINT8 *formatted = reinterpret_cast<UINT8 *>( &vib->FormattedSectors );
+	formatted[ 0 ] = static_cast<UINT8>( totalSectors >> 8 );		// Big endian
+	formatted[ 1 ] = static_cast<UINT8>( totalSectors );
+
+	vib->SectorsPerTrack  = static_cast<UINT8>( sectors );
+	vib->TracksPerSide    = static_cast<UINT8>( tracks );
+	vib->Sides            = static_cast<UINT8>( sides );
+	vib->Density          = ( sectors > 9 ) ? 2 : 1;
+	memcpy( vib->DSK, "DSK", sizeof( vib->DSK ));
+
+	FILE *file = fopen( path.string( ).c_str( ), "wb" );
+	if( file == nullptr )
+	{
+		fprintf( stderr, "Unable to create \"%s\"\n", path.string( ).c_str( ));
+		return false;
+	}
+
+	bool ok = fwrite( data.data( ), 1, data.size( ), file ) == data.size( );
+
+	return ( fclose( file ) == 0 ) && ok;
+}
+
+void PrintUsage( )
+{
+	FUNCTION_ENTRY( nullptr, "PrintUsage", true );
+
+	fprintf( stdout, "Usage: test-ti99sim [options] [test ...]\n" );
+	fprintf( stdout, "\n" );
+	fprintf( stdout, "Tests:\n" );
+	for( auto &test : tests )
+	{
+		fprintf( stdout, "  %-10s %s\n", test.name, test.description );
+	}
+	fprintf( stdout, "\n" );
+}
+
+static bool ParseFileName( const char *arg, void *ptr )
+{
+	FUNCTION_ENTRY( nullptr, "ParseFileName", true );
+
+	arg = strchr( arg, '=' ) + 1;
+
+	*( std::string * ) ptr = arg;
+
+	return true;
+}
+
+int main( int argc, char *argv[] )
+{
+	FUNCTION_ENTRY( nullptr, "main", true );
+
+	sTestOptions options{ };
+
+	options.seed = 1;
+
+	sOption optList[ ] =
+	{
+		{ 'r', "rom=*<filename>",    OPT_NONE,                      0,     &options.speechROM, ParseFileName, "Use the speech ROM in <filename>" },
+		{  0,  "seed=*n",            OPT_VALUE_PARSE_INT,           0,     &options.seed,      nullptr,       "Seed for the random sprite layouts & sector data" },
+		{ 'v', "verbose*=n",         OPT_VALUE_PARSE_INT,           1,     &verbose,           nullptr,       "Display extra information" }
+	};
+
+	int index = ParseArgs( 1, argc, argv, SIZE( optList ), optList );
+
+	// Run every test unless some were named
+	std::vector<const sTest *> selected;
+
+	for( ; index < argc; index++ )
+	{
+		auto match = std::find_if( std::begin( tests ), std::end( tests ), [ & ]( const sTest &test ) { return strcmp( test.name, argv[ index ] ) == 0; } );
+		if( match == std::end( tests ))
+		{
+			fprintf( stderr, "Unknown test \"%s\"\n", argv[ index ] );
+			PrintHelp( SIZE( optList ), optList );
+			return -1;
+		}
+		selected.push_back( match );
+	}
+
+	if( selected.empty( ))
+	{
+		for( auto &test : tests )
+		{
+			selected.push_back( &test );
+		}
+	}
+
+	int failed = 0;
+
+	for( auto test : selected )
+	{
+		fprintf( stdout, "%s:\n", test->description );
+
+		int failures = test->run( options );
+
+		fprintf( stdout, "  %s\n", ( failures == 0 ) ? "PASSED" : "FAILED" );
+
+		failed += ( failures != 0 ) ? 1 : 0;
+	}
+
+	fprintf( stdout, "%zu tests, %d failed\n", selected.size( ), failed );
+
+	return ( failed == 0 ) ? 0 : 1;
+}
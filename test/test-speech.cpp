@@ -0,0 +1,271 @@
+//----------------------------------------------------------------------------
+//
+// File:        test-speech.cpp
+// Date:        18-Oct-2026
+//
+// Description: Check the speech re-sampling filter against an exact Lanczos
+//              filter using the whole speech ROM vocabulary
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "logger.hpp"
+#include "tms5220.hpp"
+#include "tms9919.hpp"
+#include "option.hpp"
+#include "speech-index.hpp"
+#include "support.hpp"
+#include "test.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+// Longest phrase we'll synthesize (~10 seconds)
+#define MAX_BLOCKS          3200
+
+// Largest difference from the exact filter allowed in any sample
+#define TOLERANCE           64
+
+typedef std::vector<double> sBlock;
+
+//----------------------------------------------------------------------------
+// Access to the synthesizer's 8 KHz output and re-sampling filter
+//----------------------------------------------------------------------------
+
+class cSpeechTest :
+	public cTMS5220
+{
+public:
+
+	cSpeechTest( ) :
+		cBaseObject( "cSpeechTest" ),
+		cTMS5220( )
+	{
+	}
+
+	bool LoadROM( const char *filename )
+	{
+		FILE *file = fopen( filename, "rb" );
+		if( file == nullptr )
+		{
+			return false;
+		}
+
+		bool ok = fread( m_SpeechRom, 1, sizeof( m_SpeechRom ), file ) == sizeof( m_SpeechRom );
+
+		fclose( file );
+
+		return ok;
+	}
+
+	// Run the synthesizer over a phrase in the speech ROM and keep the 8 KHz samples
+	void Synthesize( UINT32 address, std::vector<sBlock> *blocks )
+	{
+		WriteData( 0x70 );
+
+		for( int shift = 0; shift < 20; shift += 4 )
+		{
+			WriteData(( UINT8 ) ( 0x40 | (( address >> shift ) & 0x000F )));
+		}
+
+		WriteData( 0x50 );
+
+		for( int i = 0; ( i < MAX_BLOCKS ) && ( m_TalkStatus == true ); i++ )
+		{
+			if( CreateNextBuffer( ) == false )
+			{
+				break;
+			}
+			blocks->emplace_back( m_RawDataBuffer, m_RawDataBuffer + INTERPOLATION_SAMPLES );
+		}
+	}
+
+	// Re-sample one block of 8 KHz samples and append the finished samples to 'output'
+	void Resample( const sBlock &block, std::vector<double> *output )
+	{
+		memcpy( m_RawDataBuffer, block.data( ), sizeof( m_RawDataBuffer ));
+
+		ConvertBuffer( );
+
+		output->insert( output->end( ), m_PlaybackDataPtr, m_PlaybackDataPtr + m_PlaybackSamplesLeft );
+	}
+
+	double GetRatio( ) const					{ return m_PlaybackRatio; }
+	int GetInterval( ) const					{ return m_PlaybackInterval; }
+	int GetBufferSize( ) const					{ return m_PlaybackBufferSize; }
+
+protected:
+
+	virtual ~cSpeechTest( ) override
+	{
+	}
+
+};
+
+//----------------------------------------------------------------------------
+// Exact filter
+//
+//   Works each output sample out straight from the definition: the 8 KHz
+//   samples around it weighted by a Lanczos window (a = 5) evaluated in
+//   double precision.  The synthesizer's filter bank approximates this.
+//----------------------------------------------------------------------------
+
+const int SINC_WINDOW_SIZE	= 5;
+
+class cExactFilter
+{
+	double              ratio;
+	int                 interval;
+	std::vector<double> buffer;
+	double              offset;
+
+	static double sinc( double x )
+	{
+		x *= M_PI;
+
+		return sin( x ) / x;
+	}
+
+	static double lanczos( double x )
+	{
+		if(( x <= -SINC_WINDOW_SIZE ) || ( x >= SINC_WINDOW_SIZE )) return 0.0;
+
+		return ( x == 0.0 ) ? 1.0 : sinc( x ) * sinc( x / SINC_WINDOW_SIZE );
+	}
+
+public:
+
+	cExactFilter( double playbackRatio, int playbackInterval, int playbackBufferSize ) :
+		ratio( playbackRatio ),
+		interval( playbackInterval ),
+		buffer( playbackBufferSize, 0.0 ),
+		offset( 0.0 )
+	{
+	}
+
+	void Resample( const sBlock &block, std::vector<double> *output )
+	{
+		int size    = ( int ) buffer.size( );
+		int overlap = size - interval;
+
+		memmove( buffer.data( ), buffer.data( ) + interval, overlap * sizeof( double ));
+		memset( buffer.data( ) + overlap, 0, interval * sizeof( double ));
+
+		for( int i = 0; i < size; i++ )
+		{
+			double x = offset + ( double ) i / ratio;
+			for( int j = -SINC_WINDOW_SIZE; j <= SINC_WINDOW_SIZE; j++ )
+			{
+				int y = ( int ) floor( x ) + j - SINC_WINDOW_SIZE;
+				if(( y >= 0 ) && ( y < INTERPOLATION_SAMPLES ))
+				{
+					buffer[ i ] += block[ y ] * lanczos( x - y - SINC_WINDOW_SIZE );
+				}
+			}
+		}
+
+		offset = fmod( offset + size / ratio, 1.0 );
+
+		output->insert( output->end( ), buffer.begin( ), buffer.begin( ) + interval );
+	}
+};
+
+template<typename T>
+static void Filter( T &filter, const std::vector<sBlock> &blocks, std::vector<double> *output )
+{
+	for( auto &block : blocks )
+	{
+		filter.Resample( block, output );
+	}
+}
+
+int TestSpeech( const sTestOptions &options )
+{
+	FUNCTION_ENTRY( nullptr, "TestSpeech", true );
+
+	cRefPtr<cTMS9919> sound = new cTMS9919;
+	sound->SetSampleRate( 44100 );
+
+	cRefPtr<cSpeechTest> speech = new cSpeechTest;
+	speech->SetSoundChip( sound );
+
+	std::string romFile = options.speechROM;
+
+	if( romFile.empty( ))
+	{
+		romFile = LocateFile( "console", "spchrom.bin" ).string( );
+
+		// The speech ROM isn't part of the distribution - only complain if one was asked for
+		if( romFile.empty( ))
+		{
+			fprintf( stdout, "  no speech ROM found (spchrom.bin) - skipped\n" );
+			return 0;
+		}
+	}
+
+	if( speech->LoadROM( romFile.c_str( )) == false )
+	{
+		fprintf( stdout, "  unable to read speech ROM \"%s\"  FAIL\n", romFile.c_str( ));
+		return 1;
+	}
+
+	cSpeechIndex phraseIndex;
+	if(( phraseIndex.Build( speech->GetSpeechROM( ), speech->GetSpeechROMSize( )) == false ) || phraseIndex.GetPhrases( ).empty( ))
+	{
+		fprintf( stdout, "  speech ROM \"%s\" is invalid  FAIL\n", romFile.c_str( ));
+		return 1;
+	}
+
+	std::vector<sBlock> blocks;
+	for( auto &phrase : phraseIndex.GetPhrases( ))
+	{
+		speech->Synthesize( phrase.dataOffset, &blocks );
+	}
+
+	// Both filters start out empty, so they have to produce the same samples
+	cExactFilter exact( speech->GetRatio( ), speech->GetInterval( ), speech->GetBufferSize( ));
+
+	std::vector<double> expected, actual;
+
+	Filter( exact, blocks, &expected );
+	Filter( *speech, blocks, &actual );
+
+	if( expected.size( ) != actual.size( ))
+	{
+		fprintf( stdout, "  %zu samples, expected %zu  FAIL\n", actual.size( ), expected.size( ));
+		return 1;
+	}
+
+	double maxError = 0.0;
+	double peak     = 0.0;
+
+	for( size_t i = 0; i < expected.size( ); i++ )
+	{
+		maxError = std::max( maxError, fabs( actual[ i ] - expected[ i ] ));
+		peak     = std::max( peak, fabs( expected[ i ] ));
+	}
+
+	fprintf( stdout, "  %zu phrases, %zu samples, largest difference %.1f (peak %.0f)\n", phraseIndex.GetPhrases( ).size( ), expected.size( ), maxError, peak );
+
+	return CheckRange( "largest difference", static_cast<UINT32>( ceil( maxError )), 0, TOLERANCE ) ? 0 : 1;
+}
@@ -0,0 +1,396 @@
+//----------------------------------------------------------------------------
+//
+// File:        test-sprite.cpp
+// Date:        18-Oct-2026
+//
+// Description: Check the TMS9918A sprite coincidence/fifth sprite detection
+//              against a pixel by pixel reference
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <cstring>
+#include <random>
+#include <vector>
+#include "common.hpp"
+#include "logger.hpp"
+#include "tms9918a.hpp"
+#include "option.hpp"
+#include "test.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+// VRAM layout used for every test
+#define SPRITE_ATTR_REG     0x06		// 0x0300
+#define SPRITE_DESC_REG     0x01		// 0x0800
+
+#define SPRITE_ATTR_TABLE   ( SPRITE_ATTR_REG * sizeof( sSpriteAttribute ))
+#define SPRITE_DESC_TABLE   ( SPRITE_DESC_REG * sizeof( sSpriteDescriptor ))
+
+#define SPRITE_STATUS_MASK  ( VDP_COINCIDENCE_FLAG | VDP_FIFTH_SPRITE_FLAG | VDP_FIFTH_SPRITE_MASK )
+
+//----------------------------------------------------------------------------
+// Reference model
+//
+//   Works out the sprite status bits the slow way: scan each line for the
+//   sprites on it, stop after the 4th and flag the 5th, then plot the pixels
+//   of the displayed sprites and look for any that land on top of each other.
+//   This follows the rules cTMS9918A::RenderSprites uses to draw them.
+//----------------------------------------------------------------------------
+
+static UINT8 ReferenceStatus( const UINT8 *memory, UINT8 reg1 )
+{
+	FUNCTION_ENTRY( nullptr, "ReferenceStatus", false );
+
+	const sSpriteAttributeEntry *sprite = reinterpret_cast<const sSpriteAttribute *>( memory + SPRITE_ATTR_TABLE )->data;
+	const sSpriteDescriptor *desc = reinterpret_cast<const sSpriteDescriptor *>( memory + SPRITE_DESC_TABLE );
+
+	bool magnify = ( reg1 & VDP_SPRITE_MAGNIFY ) ? true : false;
+	int  count   = ( reg1 & VDP_SPRITE_SIZE ) ? 2 : 1;
+	int  range   = 8 * count * ( magnify ? 2 : 1 );
+
+	int active = 0;
+	while(( active < 32 ) && ( sprite[ active ].posY != 0xD0 ))
+	{
+		active++;
+	}
+
+	bool coincidence = false;
+	bool fifth = false;
+	int fifthIndex = ( active < 32 ) ? active : 31;
+
+	for( int line = 0; line < VDP_HEIGHT; line++ )
+	{
+		int pixels[ VDP_WIDTH ] = { };
+		int visible = 0;
+
+		for( int i = 0; i < active; i++ )
+		{
+			int dy = static_cast<UINT8>( line - sprite[ i ].posY - 1 );
+			if( dy >= range )
+			{
+				continue;
+			}
+
+			if( ++visible > 4 )
+			{
+				if( fifth == false )
+				{
+					fifth = true;
+					fifthIndex = i;
+				}
+				break;
+			}
+
+			int row  = magnify ? dy / 2 : dy;
+			int posX = ( sprite[ i ].earlyClock & 0x80 ) ? sprite[ i ].posX - 32 : sprite[ i ].posX;
+
+			UINT8 index = sprite[ i ].patternIndex + row / 8;
+			int bits = desc->data[ index ][ row % 8 ] << 8;
+			if( count == 2 )
+			{
+				bits |= desc->data[( index + 2 ) % 256 ][ row % 8 ];
+			}
+
+			for( int x = 0; x < range; x++ )
+			{
+				int col = posX + x;
+				if(( col >= 0 ) && ( col < VDP_WIDTH ) && ( bits & ( 0x8000 >> ( magnify ? x / 2 : x ))))
+				{
+					if( pixels[ col ]++ != 0 )
+					{
+						coincidence = true;
+					}
+				}
+			}
+		}
+	}
+
+	return ( coincidence ? VDP_COINCIDENCE_FLAG : 0 ) | ( fifth ? VDP_FIFTH_SPRITE_FLAG : 0 ) | fifthIndex;
+}
+
+//----------------------------------------------------------------------------
+// Test driver
+//----------------------------------------------------------------------------
+
+struct sContext
+{
+	cRefPtr<cTMS9918A>      vdp;
+	UINT8                   memory[ 0x4000 ];
+	UINT8                   reg1;
+	std::mt19937            random;
+};
+
+static void SetRegister1( sContext *ctx, UINT8 sprites )
+{
+	ctx->reg1 = VDP_16K_MASK | VDP_BLANK_MASK | sprites;
+	ctx->vdp->WriteRegister( 1, ctx->reg1 );
+}
+
+static void Initialize( sContext *ctx )
+{
+	FUNCTION_ENTRY( nullptr, "Initialize", true );
+
+	memset( ctx->memory, 0, sizeof( ctx->memory ));
+
+	ctx->vdp = new cTMS9918A( 60 );
+	ctx->vdp->SetMemory( ctx->memory );
+
+	SetRegister1( ctx, 0 );
+	ctx->vdp->WriteRegister( 5, SPRITE_ATTR_REG );
+	ctx->vdp->WriteRegister( 6, SPRITE_DESC_REG );
+}
+
+// Go through a retrace and return the sprite bits of the status register
+static UINT8 GetStatus( sContext *ctx )
+{
+	ctx->vdp->Retrace( );
+
+	return ctx->vdp->ReadStatus( ) & SPRITE_STATUS_MASK;
+}
+
+static void WriteSprite( sContext *ctx, int index, const sSpriteAttributeEntry &entry )
+{
+	ctx->vdp->WriteMemory( static_cast<UINT16>( SPRITE_ATTR_TABLE + index * sizeof( entry )), &entry.posY, sizeof( entry ));
+}
+
+static sSpriteAttributeEntry RandomSprite( sContext *ctx )
+{
+	auto next = [ & ]( int n ) { return static_cast<int>( ctx->random( ) % n ); };
+
+	sSpriteAttributeEntry entry;
+
+	// Keep most sprites in a small area so they overlap, with the occasional one wrapping or offscreen
+	switch( next( 8 ))
+	{
+		case 0 :
+			entry.posY = static_cast<UINT8>( 0xC0 + next( 64 ));
+			break;
+		default :
+			entry.posY = static_cast<UINT8>( 80 + next( 40 ));
+			break;
+	}
+	if( entry.posY == 0xD0 )
+	{
+		entry.posY++;
+	}
+
+	entry.posX         = static_cast<UINT8>(( next( 8 ) == 0 ) ? next( 256 ) : 100 + next( 40 ));
+	entry.patternIndex = static_cast<UINT8>( next( 256 ));
+	entry.earlyClock   = static_cast<UINT8>(( next( 8 ) == 0 ? 0x80 : 0x00 ) | next( 16 ));
+
+	return entry;
+}
+
+static void RandomPattern( sContext *ctx, size_t start, size_t length )
+{
+	std::vector<UINT8> data( length );
+
+	for( auto &byte : data )
+	{
+		// Sparse patterns so pairs that overlap don't always collide
+		byte = static_cast<UINT8>( ctx->random( ) & ctx->random( ) & ctx->random( ));
+	}
+
+	ctx->vdp->WriteMemory( static_cast<UINT16>( SPRITE_DESC_TABLE + start ), data.data( ), data.size( ));
+}
+
+static bool CheckFrame( sContext *ctx, int trial, int *failures )
+{
+	UINT8 expected = ReferenceStatus( ctx->memory, ctx->reg1 );
+	UINT8 actual   = GetStatus( ctx );
+
+	if( actual != expected )
+	{
+		if(( verbose >= 1 ) || ( *failures == 0 ))
+		{
+			fprintf( stdout, "  trial %d: status %02X expected %02X\n", trial, actual, expected );
+		}
+		( *failures )++;
+		return false;
+	}
+
+	return true;
+}
+
+// Build a random sprite layout and then change it a little at a time so the incremental updates get exercised
+static int RunTrials( sContext *ctx, int trials, int steps )
+{
+	FUNCTION_ENTRY( nullptr, "RunTrials", true );
+
+	static const UINT8 modes[ 4 ] = { 0, VDP_SPRITE_SIZE, VDP_SPRITE_MAGNIFY, VDP_SPRITE_SIZE | VDP_SPRITE_MAGNIFY };
+
+	int failures = 0;
+
+	for( int trial = 0; trial < trials; trial++ )
+	{
+		auto next = [ & ]( int n ) { return static_cast<int>( ctx->random( ) % n ); };
+
+		SetRegister1( ctx, modes[ next( 4 ) ] );
+
+		RandomPattern( ctx, 0, sizeof( sSpriteDescriptor ));
+
+		int active = 1 + next( 32 );
+		for( int i = 0; i < 32; i++ )
+		{
+			sSpriteAttributeEntry entry = RandomSprite( ctx );
+			if( i == active )
+			{
+				entry.posY = 0xD0;
+			}
+			WriteSprite( ctx, i, entry );
+		}
+
+		CheckFrame( ctx, trial, &failures );
+
+		for( int step = 0; step < steps; step++ )
+		{
+			switch( next( 5 ))
+			{
+				case 0 :
+				case 1 :
+					// Move a sprite
+					WriteSprite( ctx, next( 32 ), RandomSprite( ctx ));
+					break;
+				case 2 :
+					// Change part of a pattern
+					RandomPattern( ctx, next( sizeof( sSpriteDescriptor )), 1 + next( 8 ));
+					break;
+				case 3 :
+					// Move the terminator
+					{
+						int index = next( 32 );
+						UINT8 posY = ( ctx->memory[ SPRITE_ATTR_TABLE + index * 4 ] == 0xD0 ) ? 100 : 0xD0;
+						ctx->vdp->WriteMemory( static_cast<UINT16>( SPRITE_ATTR_TABLE + index * 4 ), &posY, 1 );
+					}
+					break;
+				default :
+					// Change the sprite size and/or magnification
+					SetRegister1( ctx, modes[ next( 4 ) ] );
+					break;
+			}
+
+			CheckFrame( ctx, trial, &failures );
+		}
+	}
+
+	return failures;
+}
+
+// 32 magnified 16x16 sprites in a staircase, one of them moving every frame
+//
+//   The sprites start 8 lines apart, so every line of the screen has exactly
+//   4 of them on it (the sprites near the bottom are offscreen or wrap around
+//   to the top).  Each one is a solid diamond, 28 pixels to the right of the
+//   one above, so the boxes of neighbouring sprites overlap while the
+//   diamonds just miss each other.  One sprite slides back & forth into its
+//   neighbours, and only its attribute entry is written each frame.
+static int RunStaircase( sContext *ctx, int frames )
+{
+	FUNCTION_ENTRY( nullptr, "RunStaircase", true );
+
+	const int MOVER = 12;
+	const int SWING = 8;
+
+	SetRegister1( ctx, VDP_SPRITE_SIZE | VDP_SPRITE_MAGNIFY );
+
+	// One 16x16 diamond at pattern 0 (characters 0-3)
+	std::vector<UINT8> pattern( 32, 0 );
+	for( int row = 0; row < 16; row++ )
+	{
+		int width = ( row < 8 ) ? row + 1 : 16 - row;
+		UINT16 bits = static_cast<UINT16>((( 1u << ( 2 * width )) - 1 ) << ( 8 - width ));
+		pattern[ row ]      = static_cast<UINT8>( bits >> 8 );
+		pattern[ row + 16 ] = static_cast<UINT8>( bits );
+	}
+	ctx->vdp->WriteMemory( SPRITE_DESC_TABLE, pattern.data( ), pattern.size( ));
+
+	auto sprite = [ & ]( int i, int shift )
+	{
+		sSpriteAttributeEntry entry;
+		entry.posY         = static_cast<UINT8>( i * 8 - 1 );
+		entry.posX         = static_cast<UINT8>( i * 28 + shift );
+		entry.patternIndex = 0;
+		entry.earlyClock   = 0x0F;
+		return entry;
+	};
+
+	for( int i = 0; i < 32; i++ )
+	{
+		WriteSprite( ctx, i, sprite( i, 0 ));
+	}
+
+	int coincident = 0;
+	int failures = 0;
+
+	for( int frame = 0; frame < frames; frame++ )
+	{
+		int phase = frame % ( 4 * SWING );
+		int shift = ( phase < 2 * SWING ) ? phase - SWING : 3 * SWING - phase;
+
+		WriteSprite( ctx, MOVER, sprite( MOVER, shift ));
+
+		UINT8 expected = ReferenceStatus( ctx->memory, ctx->reg1 );
+		UINT8 actual   = GetStatus( ctx );
+
+		coincident += ( expected & VDP_COINCIDENCE_FLAG ) ? 1 : 0;
+
+		if( actual != expected )
+		{
+			if(( verbose >= 1 ) || ( failures == 0 ))
+			{
+				fprintf( stdout, "  frame %d: status %02X expected %02X\n", frame, actual, expected );
+			}
+			failures++;
+		}
+	}
+
+	fprintf( stdout, "  staircase: %d frames, %d coincident, %d mismatched\n", frames, coincident, failures );
+
+	// The mover has to both hit and miss its neighbours for the frames to mean anything
+	if(( coincident == 0 ) || ( coincident == frames ))
+	{
+		fprintf( stdout, "  staircase: never changes coincidence  FAIL\n" );
+		failures++;
+	}
+
+	return failures;
+}
+
+int TestSprites( const sTestOptions &options )
+{
+	FUNCTION_ENTRY( nullptr, "TestSprites", true );
+
+	const int trials = 2000;
+	const int steps  = 20;
+	const int frames = 256;
+
+	sContext ctx;
+
+	ctx.random.seed( options.seed );
+
+	Initialize( &ctx );
+
+	int failures = RunTrials( &ctx, trials, steps );
+
+	fprintf( stdout, "  %d random layouts, %d frames checked, %d mismatched\n", trials, trials * ( steps + 1 ), failures );
+
+	failures += RunStaircase( &ctx, frames );
+
+	return failures;
+}
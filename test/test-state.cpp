@@ -0,0 +1,163 @@
+//----------------------------------------------------------------------------
+//
+// File:        test-state.cpp
+// Date:        18-Oct-2026
+//
+// Description: Check that loading a saved state keeps the VDP interrupt on
+//              the same schedule it had when the state was saved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <cstdio>
+#include "common.hpp"
+#include "logger.hpp"
+#include "ti994a.hpp"
+#include "tms9918a.hpp"
+#include "stateobject.hpp"
+#include "option.hpp"
+#include "test.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+// How often the timer hook runs - about as often as the CPU emulation calls it
+constexpr UINT32 HOOK_CLOCKS = 64;
+
+//----------------------------------------------------------------------------
+// cStateTest
+//
+//   A console with no ROMs that is clocked by hand, calling the timer hook
+//   the way the CPU emulation does, and that notes when each retrace fires.
+//----------------------------------------------------------------------------
+
+class cStateTest :
+	public cTI994A
+{
+	bool                m_Retraced;
+	UINT32              m_RetraceClock;
+
+public:
+
+	cStateTest( ) :
+		cBaseObject( "cStateTest" ),
+		cTI994A( nullptr ),
+		m_Retraced( false ),
+		m_RetraceClock( 0 )
+	{
+	}
+
+	using cTI994A::SaveState;
+	using cTI994A::ParseState;
+
+	UINT32 GetClocks( )					{ return m_CPU->GetClocks( ); }
+	UINT32 GetRetraceInterval( ) const	{ return m_RetraceInterval; }
+	int GetScanline( )					{ return dynamic_cast<cTMS9918A *>( m_VDP.get( ))->GetScanline( ); }
+
+	void Advance( UINT32 clocks )
+	{
+		for( UINT32 i = 0; i < clocks; i += HOOK_CLOCKS )
+		{
+			m_CPU->AddClocks( HOOK_CLOCKS );
+			TimerHookProc( m_CPU->GetClocks( ));
+		}
+	}
+
+	// Run until the next retrace and return the clock it fired at
+	UINT32 RunToRetrace( )
+	{
+		m_Retraced = false;
+
+		while( m_Retraced == false )
+		{
+			Advance( HOOK_CLOCKS );
+		}
+
+		return m_RetraceClock;
+	}
+
+protected:
+
+	virtual bool VideoRetrace( ) override
+	{
+		m_Retraced     = true;
+		m_RetraceClock = m_CPU->GetClocks( );
+
+		return cTI994A::VideoRetrace( );
+	}
+
+	virtual ~cStateTest( ) override
+	{
+	}
+
+};
+
+int TestState( const sTestOptions & )
+{
+	FUNCTION_ENTRY( nullptr, "TestState", true );
+
+	cRefPtr<cStateTest> computer = new cStateTest;
+
+	int failures = 0;
+
+	// Save a third of the way into a frame
+	computer->RunToRetrace( );
+	computer->Advance( computer->GetRetraceInterval( ) / 3 );
+
+	int scanline = computer->GetScanline( );
+	auto save = computer->SaveState( );
+
+	if( !save.has_value( ))
+	{
+		fprintf( stdout, "  unable to save the state  FAIL\n" );
+		return 1;
+	}
+
+	// Where the next retrace falls when nothing is loaded
+	UINT32 expected = computer->RunToRetrace( );
+
+	// Move on a couple of frames and part of another before going back to the saved state
+	computer->Advance( 5 * computer->GetRetraceInterval( ) / 2 );
+
+	if( computer->ParseState( *save ) == false )
+	{
+		fprintf( stdout, "  unable to load the saved state  FAIL\n" );
+		return 1;
+	}
+
+	if( CheckRange( "scanline after load", computer->GetScanline( ), scanline, scanline ) == false )
+	{
+		failures++;
+	}
+
+	UINT32 actual = computer->RunToRetrace( );
+
+	if( CheckRange( "next retrace (clock)", actual, expected, expected ) == false )
+	{
+		failures++;
+	}
+
+	// The frame after that is a whole interval later
+	UINT32 next = computer->RunToRetrace( );
+
+	if( CheckRange( "following frame", next - actual, computer->GetRetraceInterval( ) - HOOK_CLOCKS, computer->GetRetraceInterval( ) + HOOK_CLOCKS ) == false )
+	{
+		failures++;
+	}
+
+	return failures;
+}
@@ -0,0 +1,115 @@
+//----------------------------------------------------------------------------
+//
+// File:        test-track.cpp
+// Date:        18-Oct-2026
+//
+// Description: Check the FM/MFM track encoders & decoders by taking random
+//              disks through an HFE image and back
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <cstdio>
+#include "common.hpp"
+#include "logger.hpp"
+#include "disk-media.hpp"
+#include "idisk-sector.hpp"
+#include "option.hpp"
+#include "test.hpp"
+
+DBG_REGISTER( __FILE__ );
+
+// Write a v9t9 image full of random sectors, save it as HFE (encode) and read the HFE image back (decode)
+static int RoundTrip( const char *label, int tracks, int sides, int sectors, std::mt19937 *random )
+{
+	FUNCTION_ENTRY( nullptr, "RoundTrip", true );
+
+	auto source = TempFile( "track.dsk" );
+	auto target = TempFile( "track.hfe" );
+
+	int failures = 0;
+
+	if( CreateDisk( source, tracks, sides, sectors, random ) == false )
+	{
+		return 1;
+	}
+
+	{
+		cRefPtr<cDiskMedia> original = new cDiskMedia( source.string( ).c_str( ), FORMAT_UNKNOWN );
+
+		if( original->SaveFileAs( target.string( ).c_str( ), FORMAT_HFE ) == false )
+		{
+			fprintf( stdout, "  %s: unable to write \"%s\"  FAIL\n", label, target.string( ).c_str( ));
+			failures++;
+		}
+		else
+		{
+			cRefPtr<cDiskMedia> copy = new cDiskMedia( target.string( ).c_str( ), FORMAT_UNKNOWN );
+
+			if( copy->GetFormat( ) != FORMAT_HFE )
+			{
+				fprintf( stdout, "  %s: \"%s\" didn't load as HFE  FAIL\n", label, target.string( ).c_str( ));
+				failures++;
+			}
+			else
+			{
+				int total = tracks * sides * sectors;
+				int bad = 0;
+
+				for( int i = 0; i < total; i++ )
+				{
+					iDiskSector *expected = original->GetLogicalSector( i, sectors );
+					iDiskSector *actual = copy->GetLogicalSector( i, sectors );
+
+					if(( expected == nullptr ) || ( actual == nullptr ) || ( expected->Read( ) != actual->Read( )))
+					{
+						if(( verbose >= 1 ) || ( bad == 0 ))
+						{
+							fprintf( stdout, "  %s: sector %d differs\n", label, i );
+						}
+						bad++;
+					}
+				}
+
+				fprintf( stdout, "  %-22s %d sectors, %d mismatched\n", label, total, bad );
+
+				failures += bad;
+			}
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::remove( source, error );
+	std::filesystem::remove( target, error );
+
+	return failures;
+}
+
+int TestTracks( const sTestOptions &options )
+{
+	FUNCTION_ENTRY( nullptr, "TestTracks", true );
+
+	std::mt19937 random( options.seed );
+
+	int failures = 0;
+
+	failures += RoundTrip( "FM (SSSD)", 40, 1, 9, &random );
+	failures += RoundTrip( "MFM (DSDD)", 40, 2, 18, &random );
+
+	return failures;
+}
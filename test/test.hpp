@@ -0,0 +1,56 @@
+//----------------------------------------------------------------------------
+//
+// File:        test.hpp
+// Date:        18-Oct-2026
+//
+// Description: Shared declarations for the test-ti99sim checks
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef TEST_HPP_
+#define TEST_HPP_
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include "common.hpp"
+
+struct sTestOptions
+{
+	std::string     speechROM;				// Speech ROM to synthesize the vocabulary from (located if empty)
+	int             seed;					// Seed for the random sprite layouts & sector data
+};
+
+// Each test returns the number of failures it found
+extern int TestSprites( const sTestOptions & );
+extern int TestSpeech( const sTestOptions & );
+extern int TestTracks( const sTestOptions & );
+extern int TestFDC( const sTestOptions & );
+extern int TestState( const sTestOptions & );
+
+// Report a measurement against the range it has to fall in
+extern bool CheckRange( const char *name, UINT32 measured, UINT32 low, UINT32 high );
+
+// A name for a scratch file that is removed again by the test that made it
+extern std::filesystem::path TempFile( const char *name );
+
+// Write a v9t9 image with a VIB describing the geometry - the other sectors are blank or random
+extern bool CreateDisk( const std::filesystem::path &path, int tracks, int sides, int sectors, std::mt19937 *random = nullptr );
+
+#endif